@@ -1104,6 +1104,12 @@ call append("$", "maxmem\tmaximum amount of memory in Kbyte used for one buffer"
 call append("$", " \tset mm=" . &mm)
 call append("$", "maxmemtot\tmaximum amount of memory in Kbyte used for all buffers")
 call append("$", " \tset mmt=" . &mmt)
+call append("$", "memcompress\tmaximum memory in Kbyte for compressed text of hidden buffers")
+call append("$", " \tset mcm=" . &mcm)
+if has("mmap")
+  call append("$", "mmapsize\tminimal file size in Kbyte to map a file in memory")
+  call append("$", " \tset mms=" . &mms)
+endif
 
 
 call <SID>Header("command line editing")
@@ -82,6 +82,7 @@ SRC =	arabic.c						\
 	misc2.c							\
 	mouse.c							\
 	move.c							\
+	msgpack.c						\
 	normal.c						\
 	ops.c							\
 	option.c						\
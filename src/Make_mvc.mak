@@ -785,6 +785,7 @@ OBJ = \
 	$(OUTDIR)\misc2.obj \
 	$(OUTDIR)\mouse.obj \
 	$(OUTDIR)\move.obj \
+	$(OUTDIR)\msgpack.obj \
 	$(OUTDIR)\normal.obj \
 	$(OUTDIR)\ops.obj \
 	$(OUTDIR)\option.obj \
@@ -1690,6 +1691,8 @@ $(OUTDIR)/mouse.obj:	$(OUTDIR) mouse.c  $(INCL)
 
 $(OUTDIR)/move.obj:	$(OUTDIR) move.c  $(INCL)
 
+$(OUTDIR)/msgpack.obj:	$(OUTDIR) msgpack.c  $(INCL)
+
 $(OUTDIR)/mbyte.obj: $(OUTDIR) mbyte.c  $(INCL)
 
 $(OUTDIR)/netbeans.obj: $(OUTDIR) netbeans.c $(NBDEBUG_SRC) $(INCL) version.h
@@ -1733,7 +1736,7 @@ $(OUTDIR)/profiler.obj:	$(OUTDIR) profiler.c  $(INCL)
 
 $(OUTDIR)/quickfix.obj:	$(OUTDIR) quickfix.c  $(INCL)
 
-$(OUTDIR)/regexp.obj:	$(OUTDIR) regexp.c regexp_bt.c regexp_nfa.c  $(INCL)
+$(OUTDIR)/regexp.obj:	$(OUTDIR) regexp.c regexp_bt.c regexp_nfa.c regexp_dfa.c $(INCL)
 
 $(OUTDIR)/register.obj:	$(OUTDIR) register.c $(INCL)
 
@@ -1947,6 +1950,7 @@ proto.h: \
 	proto/misc2.pro \
 	proto/mouse.pro \
 	proto/move.pro \
+	proto/msgpack.pro \
 	proto/mbyte.pro \
 	proto/normal.pro \
 	proto/ops.pro \
@@ -29,5 +29,6 @@ typedef enum {
 	aid_sign_getplaced_list,
 	aid_insert_sign,
 	aid_sign_getinfo,
+	aid_mf_block,
 	aid_last
 } alloc_id_T;
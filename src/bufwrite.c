@@ -1133,6 +1133,16 @@ buf_write(
 	}
     }
 
+#ifdef FEAT_MMAP
+    // The file may be truncated while writing it, copy the lines from the
+    // mapping into memory first.
+    if (overwriting && ml_unmap(buf) == FAIL)
+    {
+	retval = FAIL;
+	goto fail;
+    }
+#endif
+
 #ifdef HAVE_ACL
     // For systems that support ACL: get the ACL from the original file.
     if (!newfile)
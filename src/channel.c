@@ -52,6 +52,12 @@
 # ifdef HAVE_LIBGEN_H
 #  include <libgen.h>
 # endif
+# ifdef CHANNEL_EPOLL
+#  include <sys/epoll.h>
+# endif
+# ifdef HAVE_WRITEV
+#  include <sys/uio.h>
+# endif
 # define SOCK_ERRNO
 # define sock_write(sd, buf, len) write(sd, buf, len)
 # define sock_read(sd, buf, len) read(sd, buf, len)
@@ -61,12 +67,23 @@
 # define fd_close(sd) close(sd)
 #endif
 
+// Maximum number of write queue entries written with one writev() call.
+#define CH_MAX_IOV 64
+
+// Maximum number of bytes of buffer lines collected for one write.
+#define CH_MAX_LINES_WRITE 65536
+
 static void channel_read(channel_T *channel, ch_part_T part, char *func);
 static ch_mode_T channel_get_mode(channel_T *channel, ch_part_T part);
 static int channel_get_timeout(channel_T *channel, ch_part_T part);
 static ch_part_T channel_part_send(channel_T *channel);
 static ch_part_T channel_part_read(channel_T *channel);
 static void free_job_options(jobopt_T *opt);
+static void channel_write_input(channel_T *channel);
+#ifdef CHANNEL_EPOLL
+static void channel_epoll_sync(channel_T *channel);
+static void channel_epoll_remove(sock_T fd);
+#endif
 
 #define FOR_ALL_CHANNELS(ch) \
     for ((ch) = first_channel; (ch) != NULL; (ch) = (ch)->ch_next)
@@ -170,6 +187,11 @@ ch_logfile(char_u *fname, char_u *opt)
 	    semsg(_(e_notopen), fname);
 	    return;
 	}
+#if defined(UNIX) && defined(FD_CLOEXEC)
+	// A child started with posix_spawn() can't close the log file like
+	// after fork(), make sure it doesn't inherit it.
+	(void)fcntl(fileno(file), F_SETFD, FD_CLOEXEC);
+#endif
     }
     log_fd = file;
 
@@ -383,13 +405,13 @@ channel_still_useful(channel_T *channel)
     // If there is no callback then nobody can get readahead.  If the fd is
     // closed and there is no readahead then the callback won't be called.
     has_sock_msg = channel->ch_part[PART_SOCK].ch_fd != INVALID_FD
-		|| channel->ch_part[PART_SOCK].ch_head.rq_next != NULL
+		|| channel_peek(channel, PART_SOCK, NULL) != NULL
 		|| channel->ch_part[PART_SOCK].ch_json_head.jq_next != NULL;
     has_out_msg = channel->ch_part[PART_OUT].ch_fd != INVALID_FD
-		  || channel->ch_part[PART_OUT].ch_head.rq_next != NULL
+		  || channel_peek(channel, PART_OUT, NULL) != NULL
 		  || channel->ch_part[PART_OUT].ch_json_head.jq_next != NULL;
     has_err_msg = channel->ch_part[PART_ERR].ch_fd != INVALID_FD
-		  || channel->ch_part[PART_ERR].ch_head.rq_next != NULL
+		  || channel_peek(channel, PART_ERR, NULL) != NULL
 		  || channel->ch_part[PART_ERR].ch_json_head.jq_next != NULL;
     return (channel->ch_callback.cb_name != NULL && (has_sock_msg
 		|| has_out_msg || has_err_msg))
@@ -1113,6 +1135,9 @@ channel_open(
     channel->ch_port = port;
     channel->ch_to_be_closed |= (1U << PART_SOCK);
 
+#ifdef CHANNEL_EPOLL
+    channel_epoll_sync(channel);
+#endif
 #ifdef FEAT_GUI
     channel_gui_register_one(channel, PART_SOCK);
 #endif
@@ -1245,6 +1270,10 @@ channel_set_options(channel_T *channel, jobopt_T *opt)
 							      &opt->jo_err_cb);
     if (opt->jo_set & JO_CLOSE_CALLBACK)
 	free_set_callback(&channel->ch_close_cb, &opt->jo_close_cb);
+    if (opt->jo_set2 & JO2_DRAIN_CB)
+	free_set_callback(&channel->ch_drain_cb, &opt->jo_drain_cb);
+    if (opt->jo_set2 & JO2_HIGHWATER)
+	channel->ch_highwater = opt->jo_highwater;
     channel->ch_drop_never = opt->jo_drop_never;
 
     if ((opt->jo_set & JO_OUT_IO) && opt->jo_io[PART_OUT] == JIO_BUFFER)
@@ -1404,7 +1433,8 @@ channel_open_func(typval_T *argvars)
     opt.jo_mode = MODE_JSON;
     opt.jo_timeout = 2000;
     if (get_job_options(&argvars[1], &opt,
-	    JO_MODE_ALL + JO_CB_ALL + JO_WAITTIME + JO_TIMEOUT_ALL, 0) == FAIL)
+	    JO_MODE_ALL + JO_CB_ALL + JO_WAITTIME + JO_TIMEOUT_ALL,
+	    JO2_DRAIN_CB + JO2_HIGHWATER) == FAIL)
 	goto theend;
     if (opt.jo_timeout < 0)
     {
@@ -1423,6 +1453,259 @@ theend:
     return channel;
 }
 
+#ifdef CHANNEL_EPOLL
+/*
+ * The fds of all channels are kept in an epoll set.  The events each fd is
+ * registered for are updated when a channel part is opened or closed and when
+ * writing starts or stops.  Waiting for channels then only requires adding
+ * the epoll fd to select() or poll(), no matter how many channels are open.
+ */
+
+// The epoll fd, -1 when not created yet, -2 when epoll can't be used.
+static int epoll_fd = -1;
+
+// Per fd: the channel it belongs to and the events it is registered for.
+typedef struct {
+    channel_T	*ee_channel;	// NULL when not registered
+    int		ee_events;
+} epoll_entry_T;
+
+static epoll_entry_T	*epoll_entries = NULL;
+static int		epoll_entries_len = 0;
+
+// Number of keep-open channels that are polled instead of waited for.
+static int		epoll_keep_open_count = 0;
+
+# if !defined(HAVE_SELECT)
+// Index of the epoll fd in the poll() array.
+static int		epoll_poll_idx = -1;
+# endif
+
+// Number of events handled by one epoll_wait() call.
+# define EPOLL_MAX_EVENTS 64
+
+/*
+ * Stop using epoll, e.g. when an fd can't be added to the set.  The channels
+ * are then added to select() or poll() one by one.
+ */
+    static void
+channel_epoll_disable(void)
+{
+    channel_T	*channel;
+
+    ch_error(NULL, "epoll failed: %s, using select()/poll()",
+							      strerror(errno));
+    if (epoll_fd >= 0)
+	close(epoll_fd);
+    epoll_fd = -2;
+    VIM_CLEAR(epoll_entries);
+    epoll_entries_len = 0;
+    epoll_keep_open_count = 0;
+    FOR_ALL_CHANNELS(channel)
+	channel->ch_epoll_polled = FALSE;
+}
+
+/*
+ * Return the epoll events "part" of "channel" needs.
+ * Sets "*polled" when the part needs to be polled instead.
+ */
+    static int
+channel_epoll_part_events(channel_T *channel, ch_part_T part, int *polled)
+{
+    chanpart_T	*ch_part = &channel->ch_part[part];
+
+    if (part == PART_IN)
+	return ch_part->ch_bufref.br_buf != NULL
+		    || ch_part->ch_writeque.wq_next != NULL ? EPOLLOUT : 0;
+    if (channel->ch_keep_open)
+    {
+	// A keep-open channel would be ready all the time, see
+	// channel_select_setup().
+	*polled = TRUE;
+	return 0;
+    }
+    return EPOLLIN;
+}
+
+/*
+ * Register "fd" of "channel" for "events".  Remove it from the epoll set when
+ * "events" is zero.
+ */
+    static void
+channel_epoll_set(channel_T *channel, sock_T fd, int events)
+{
+    epoll_entry_T	*entry;
+    struct epoll_event	ev;
+    int			op;
+
+    if (fd >= epoll_entries_len)
+    {
+	int		new_len = fd + 64;
+	epoll_entry_T	*new_entries;
+
+	if (events == 0)
+	    return;  // was never registered
+	new_entries = vim_realloc(epoll_entries,
+					     new_len * sizeof(epoll_entry_T));
+	if (new_entries == NULL)
+	{
+	    channel_epoll_disable();
+	    return;
+	}
+	vim_memset(new_entries + epoll_entries_len, 0,
+			(new_len - epoll_entries_len) * sizeof(epoll_entry_T));
+	epoll_entries = new_entries;
+	epoll_entries_len = new_len;
+    }
+
+    entry = &epoll_entries[fd];
+    if (events == 0)
+    {
+	if (entry->ee_channel != NULL
+		&& epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL) < 0
+		&& errno != EBADF && errno != ENOENT)
+	    channel_epoll_disable();
+	else
+	{
+	    entry->ee_channel = NULL;
+	    entry->ee_events = 0;
+	}
+	return;
+    }
+    if (entry->ee_channel == channel && entry->ee_events == events)
+	return;
+
+    vim_memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    op = entry->ee_channel == NULL ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (epoll_ctl(epoll_fd, op, fd, &ev) < 0
+	    && (op == EPOLL_CTL_MOD || errno != EEXIST
+			  || epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0))
+    {
+	// E.g. a regular file, which epoll does not support.
+	channel_epoll_disable();
+	return;
+    }
+    entry->ee_channel = channel;
+    entry->ee_events = events;
+}
+
+/*
+ * Update the epoll set for the current state of "channel".
+ */
+    static void
+channel_epoll_sync(channel_T *channel)
+{
+    ch_part_T	part;
+    ch_part_T	other;
+    int		polled = FALSE;
+
+    if (epoll_fd == -1)
+    {
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0)
+	    channel_epoll_disable();
+    }
+    if (epoll_fd < 0)
+	return;
+
+    for (part = PART_SOCK; part < PART_COUNT; ++part)
+    {
+	sock_T	fd = channel->ch_part[part].ch_fd;
+	int	events = 0;
+
+	if (fd == INVALID_FD)
+	    continue;
+	// When using a pty the same fd is used for several parts.
+	for (other = PART_SOCK; other < PART_COUNT; ++other)
+	    if (channel->ch_part[other].ch_fd == fd)
+		events |= channel_epoll_part_events(channel, other, &polled);
+	channel_epoll_set(channel, fd, events);
+	if (epoll_fd < 0)
+	    return;
+    }
+
+    if (polled != channel->ch_epoll_polled)
+    {
+	epoll_keep_open_count += polled ? 1 : -1;
+	channel->ch_epoll_polled = polled;
+    }
+}
+
+/*
+ * Remove "fd" from the epoll set, must be done before closing it.
+ */
+    static void
+channel_epoll_remove(sock_T fd)
+{
+    if (epoll_fd >= 0 && fd < epoll_entries_len
+				      && epoll_entries[fd].ee_channel != NULL)
+	channel_epoll_set(epoll_entries[fd].ee_channel, fd, 0);
+}
+
+/*
+ * Read from and write to the channels the epoll set says are ready.
+ */
+    static void
+channel_epoll_handle_events(char *func)
+{
+    struct epoll_event	events[EPOLL_MAX_EVENTS];
+    int			count;
+    int			i;
+
+    count = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, 0);
+    for (i = 0; i < count && epoll_fd >= 0; ++i)
+    {
+	sock_T	    fd = events[i].data.fd;
+	int	    ready = events[i].events;
+	channel_T   *channel;
+	ch_part_T   part;
+
+	// The fd may have been closed while handling a previous event.
+	if (fd >= epoll_entries_len || epoll_entries[fd].ee_channel == NULL)
+	    continue;
+	channel = epoll_entries[fd].ee_channel;
+
+	if ((epoll_entries[fd].ee_events & EPOLLIN)
+				  && (ready & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+	    for (part = PART_SOCK; part < PART_IN; ++part)
+		if (channel->ch_part[part].ch_fd == fd)
+		{
+		    channel_read(channel, part, func);
+		    break;
+		}
+
+	if (epoll_fd >= 0 && fd < epoll_entries_len
+		&& epoll_entries[fd].ee_channel == channel
+		&& (epoll_entries[fd].ee_events & EPOLLOUT)
+		&& (ready & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+		&& channel->CH_IN_FD == fd)
+	{
+	    channel_write_input(channel);
+	    // Stop waiting for writing when everything was written.
+	    channel_epoll_sync(channel);
+	}
+    }
+}
+
+/*
+ * Read from the keep-open channels, these are polled.
+ */
+    static void
+channel_epoll_read_keep_open(char *func)
+{
+    channel_T	*channel;
+    ch_part_T	part;
+
+    FOR_ALL_CHANNELS(channel)
+	if (channel->ch_epoll_polled)
+	    for (part = PART_SOCK; part < PART_IN; ++part)
+		if (channel->ch_part[part].ch_fd != INVALID_FD)
+		    channel_read(channel, part, func);
+}
+#endif
+
     static void
 ch_close_part(channel_T *channel, ch_part_T part)
 {
@@ -1430,6 +1713,9 @@ ch_close_part(channel_T *channel, ch_part_T part)
 
     if (*fd != INVALID_FD)
     {
+#ifdef CHANNEL_EPOLL
+	channel_epoll_remove(*fd);
+#endif
 	if (part == PART_SOCK)
 	    sock_close(*fd);
 	else
@@ -1448,6 +1734,10 @@ ch_close_part(channel_T *channel, ch_part_T part)
 	    }
 	}
 	*fd = INVALID_FD;
+#ifdef CHANNEL_EPOLL
+	// Another part may still use the same fd.
+	channel_epoll_sync(channel);
+#endif
 
 	// channel is closed, may want to end the job if it was the last
 	channel->ch_to_be_closed &= ~(1U << part);
@@ -1499,6 +1789,9 @@ channel_set_pipes(channel_T *channel, sock_T in, sock_T out, sock_T err)
 # endif
 	}
     }
+#ifdef CHANNEL_EPOLL
+    channel_epoll_sync(channel);
+#endif
 }
 
 /*
@@ -1539,6 +1832,10 @@ channel_set_job(channel_T *channel, job_T *job, jobopt_T *options)
 	    in_part->ch_buf_bot = options->jo_in_bot;
 	else
 	    in_part->ch_buf_bot = in_part->ch_bufref.br_buf->b_ml.ml_line_count;
+#ifdef CHANNEL_EPOLL
+	// Wait for the input to be writable.
+	channel_epoll_sync(channel);
+#endif
     }
 }
 
@@ -1569,34 +1866,6 @@ channel_set_req_callback(
     }
 }
 
-    static void
-write_buf_line(buf_T *buf, linenr_T lnum, channel_T *channel)
-{
-    char_u  *line = ml_get_buf(buf, lnum, FALSE);
-    int	    len = (int)STRLEN(line);
-    char_u  *p;
-    int	    i;
-
-    // Need to make a copy to be able to append a NL.
-    if ((p = alloc(len + 2)) == NULL)
-	return;
-    memcpy((char *)p, (char *)line, len);
-
-    if (channel->ch_write_text_mode)
-	p[len] = CAR;
-    else
-    {
-	for (i = 0; i < len; ++i)
-	    if (p[i] == NL)
-		p[i] = NUL;
-
-	p[len] = NL;
-    }
-    p[len + 1] = NUL;
-    channel_send(channel, PART_IN, p, len + 1, "write_buf_line");
-    vim_free(p);
-}
-
 /*
  * Return TRUE if "channel" can be written to.
  * Returns FALSE if the input is closed or the write would block.
@@ -1666,6 +1935,77 @@ can_write_buf_line(channel_T *channel)
     return TRUE;
 }
 
+/*
+ * Write lines "lnum" to "last" of "buf" to the input of "channel".  Lines are
+ * collected in chunks of up to CH_MAX_LINES_WRITE bytes to reduce the number
+ * of system calls.  Stops when the channel can't be written to or when text
+ * is left in the write queue.
+ * Returns the number of the first line that was not written.
+ */
+    static linenr_T
+write_buf_lines(
+	buf_T	    *buf,
+	linenr_T    lnum,
+	linenr_T    last,
+	channel_T   *channel)
+{
+    chanpart_T	*in_part = &channel->ch_part[PART_IN];
+    linenr_T	first = lnum;
+    garray_T	ga;
+
+#ifndef MSWIN
+    // A large write must not block, what can't be written is queued.
+    if (!in_part->ch_nonblocking)
+	channel_set_nonblock(channel, PART_IN);
+#endif
+
+    while (lnum <= last && in_part->ch_writeque.wq_next == NULL
+					       && can_write_buf_line(channel))
+    {
+	ga_init2(&ga, 1, CH_MAX_LINES_WRITE);
+	for ( ; lnum <= last && ga.ga_len < CH_MAX_LINES_WRITE; ++lnum)
+	{
+	    char_u  *line = ml_get_buf(buf, lnum, FALSE);
+	    int	    len = (int)STRLEN(line);
+	    char_u  *p;
+	    int	    i;
+
+	    // Need to make a copy to be able to append a NL.
+	    if (ga_grow(&ga, len + 1) == FAIL)
+		break;
+	    p = (char_u *)ga.ga_data + ga.ga_len;
+	    mch_memmove(p, line, len);
+	    if (channel->ch_write_text_mode)
+		p[len] = CAR;
+	    else
+	    {
+		for (i = 0; i < len; ++i)
+		    if (p[i] == NL)
+			p[i] = NUL;
+		p[len] = NL;
+	    }
+	    ga.ga_len += len + 1;
+	    if (in_part->ch_block_write != 0)
+	    {
+		// for testing: write one line at a time
+		++lnum;
+		break;
+	    }
+	}
+	if (ga.ga_len == 0)
+	    break;
+	if (channel_send_take(channel, PART_IN, ga.ga_data, ga.ga_len,
+						     "write_buf_line") == FAIL)
+	    break;
+    }
+
+    if (lnum - first == 1)
+	ch_log(channel, "written line %d to channel", (int)first);
+    else if (lnum > first)
+	ch_log(channel, "written %d lines to channel", (int)(lnum - first));
+    return lnum;
+}
+
 /*
  * Write any buffer lines to the input channel.
  */
@@ -1674,8 +2014,8 @@ channel_write_in(channel_T *channel)
 {
     chanpart_T *in_part = &channel->ch_part[PART_IN];
     linenr_T    lnum;
+    linenr_T    last;
     buf_T	*buf = in_part->ch_bufref.br_buf;
-    int		written = 0;
 
     if (buf == NULL || in_part->ch_buf_append)
 	return;  // no buffer or using appending
@@ -1687,22 +2027,13 @@ channel_write_in(channel_T *channel)
 	return;
     }
 
-    for (lnum = in_part->ch_buf_top; lnum <= in_part->ch_buf_bot
-				   && lnum <= buf->b_ml.ml_line_count; ++lnum)
-    {
-	if (!can_write_buf_line(channel))
-	    break;
-	write_buf_line(buf, lnum, channel);
-	++written;
-    }
-
-    if (written == 1)
-	ch_log(channel, "written line %d to channel", (int)lnum - 1);
-    else if (written > 1)
-	ch_log(channel, "written %d lines to channel", written);
+    last = in_part->ch_buf_bot;
+    if (last > buf->b_ml.ml_line_count)
+	last = buf->b_ml.ml_line_count;
+    lnum = write_buf_lines(buf, in_part->ch_buf_top, last, channel);
 
     in_part->ch_buf_top = lnum;
-    if (lnum > buf->b_ml.ml_line_count || lnum > in_part->ch_buf_bot)
+    if (lnum > last && in_part->ch_writeque.wq_next == NULL)
     {
 #if defined(FEAT_TERMINAL)
 	// Send CTRL-D or "eof_chars" to close stdin on MS-Windows.
@@ -1717,7 +2048,7 @@ channel_write_in(channel_T *channel)
 	// Close the pipe/socket, so that the other side gets EOF.
 	ch_close_part(channel, PART_IN);
     }
-    else
+    else if (lnum <= last)
 	ch_log(channel, "Still %ld more lines to write",
 				   (long)(buf->b_ml.ml_line_count - lnum + 1));
 }
@@ -1791,26 +2122,14 @@ channel_write_new_lines(buf_T *buf)
     {
 	chanpart_T  *in_part = &channel->ch_part[PART_IN];
 	linenr_T    lnum;
-	int	    written = 0;
 
 	if (in_part->ch_bufref.br_buf == buf && in_part->ch_buf_append)
 	{
 	    if (in_part->ch_fd == INVALID_FD)
 		continue;  // pipe was closed
 	    found_one = TRUE;
-	    for (lnum = in_part->ch_buf_bot; lnum < buf->b_ml.ml_line_count;
-								       ++lnum)
-	    {
-		if (!can_write_buf_line(channel))
-		    break;
-		write_buf_line(buf, lnum, channel);
-		++written;
-	    }
-
-	    if (written == 1)
-		ch_log(channel, "written line %d to channel", (int)lnum - 1);
-	    else if (written > 1)
-		ch_log(channel, "written %d lines to channel", written);
+	    lnum = write_buf_lines(buf, in_part->ch_buf_bot,
+					   buf->b_ml.ml_line_count - 1, channel);
 	    if (lnum < buf->b_ml.ml_line_count)
 		ch_log(channel, "Still %ld more lines to write",
 				       (long)(buf->b_ml.ml_line_count - lnum));
@@ -1842,95 +2161,172 @@ invoke_callback(channel_T *channel, callback_T *callback, typval_T *argv)
     channel_need_redraw = TRUE;
 }
 
+// Minimal size of the read buffer.
+#define READQ_MIN_SIZE 4096
+
+// A read buffer larger than this is freed when it becomes empty.
+#define READQ_KEEP_SIZE (64 * 1024)
+
 /*
- * Return the first node from "channel"/"part" without removing it.
+ * Return the text read from "channel"/"part" and not consumed yet.  The text
+ * is NUL terminated and stays valid until more is read.  When "lenp" is not
+ * NULL its length is stored in "*lenp".
  * Returns NULL if there is nothing.
  */
-    readq_T *
-channel_peek(channel_T *channel, ch_part_T part)
+    char_u *
+channel_peek(channel_T *channel, ch_part_T part, long_u *lenp)
 {
-    readq_T *head = &channel->ch_part[part].ch_head;
+    readq_T *rq = &channel->ch_part[part].ch_readq;
 
-    return head->rq_next;
+    if (rq->rq_start == rq->rq_end)
+	return NULL;
+    if (lenp != NULL)
+	*lenp = rq->rq_end - rq->rq_start;
+    return rq->rq_buffer + rq->rq_start;
 }
 
 /*
- * Return a pointer to the first NL in "node".
- * Skips over NUL characters.
+ * Return a pointer to the first NL in the text of "channel"/"part".
+ * Skips over NUL characters.  Text that was searched before is not searched
+ * again.
  * Returns NULL if there is no NL.
  */
     char_u *
-channel_first_nl(readq_T *node)
+channel_first_nl(channel_T *channel, ch_part_T part)
 {
-    char_u  *buffer = node->rq_buffer;
-    long_u  i;
+    readq_T *rq = &channel->ch_part[part].ch_readq;
+    char_u  *nl;
 
-    for (i = 0; i < node->rq_buflen; ++i)
-	if (buffer[i] == NL)
-	    return buffer + i;
-    return NULL;
+    if (rq->rq_scanned < rq->rq_start)
+	rq->rq_scanned = rq->rq_start;
+    if (rq->rq_scanned >= rq->rq_end)
+	return NULL;
+    nl = memchr(rq->rq_buffer + rq->rq_scanned, NL,
+					       rq->rq_end - rq->rq_scanned);
+    if (nl == NULL)
+    {
+	rq->rq_scanned = rq->rq_end;
+	return NULL;
+    }
+    rq->rq_scanned = (long_u)(nl - rq->rq_buffer);
+    return nl;
+}
+
+/*
+ * Clear the text read from "channel"/"part".
+ */
+    static void
+channel_clear_readq(channel_T *channel, ch_part_T part)
+{
+    readq_T *rq = &channel->ch_part[part].ch_readq;
+
+    VIM_CLEAR(rq->rq_buffer);
+    rq->rq_size = 0;
+    rq->rq_start = 0;
+    rq->rq_end = 0;
+    rq->rq_scanned = 0;
+    CLEAR_FIELD(rq->rq_json);
+    json_decode_free(rq->rq_decode);
+    rq->rq_decode = NULL;
+}
+
+/*
+ * Consume "len" bytes from the start of the text of "channel"/"part".
+ * Caller must check these bytes are available.
+ */
+    void
+channel_consume(channel_T *channel, ch_part_T part, int len)
+{
+    readq_T *rq = &channel->ch_part[part].ch_readq;
+
+    if (len == 0)
+	return;
+    rq->rq_start += len;
+    CLEAR_FIELD(rq->rq_json);
+    json_decode_free(rq->rq_decode);
+    rq->rq_decode = NULL;
+    if (rq->rq_start < rq->rq_end)
+	return;
+
+    // Everything was consumed, start at the beginning again.
+    if (rq->rq_size > READQ_KEEP_SIZE)
+	channel_clear_readq(channel, part);
+    else
+    {
+	rq->rq_start = 0;
+	rq->rq_end = 0;
+	rq->rq_scanned = 0;
+	if (rq->rq_buffer != NULL)
+	    *rq->rq_buffer = NUL;
+    }
 }
 
 /*
- * Return the first buffer from channel "channel"/"part" and remove it.
+ * Remove the first "len" bytes of the text of "channel"/"part" and return
+ * them in allocated memory, NUL terminated.  When "skip" is TRUE one more
+ * byte is removed, e.g. the NL ending a message.
+ * When this is all the text the buffer itself is returned, without copying.
+ * The caller must free the result.
+ */
+    static char_u *
+channel_take(channel_T *channel, ch_part_T part, long_u len, int skip)
+{
+    readq_T *rq = &channel->ch_part[part].ch_readq;
+    char_u  *res;
+
+    if (rq->rq_buffer == NULL)
+	return vim_strsave((char_u *)"");
+    if (rq->rq_start == 0 && len + (skip ? 1 : 0) == rq->rq_end)
+    {
+	res = rq->rq_buffer;
+	res[len] = NUL;
+	rq->rq_buffer = NULL;
+	channel_clear_readq(channel, part);
+	return res;
+    }
+    // Can't use vim_strnsave(), the text may contain NUL bytes.
+    res = alloc(len + 1);
+    if (res == NULL)
+	return NULL;
+    mch_memmove(res, rq->rq_buffer + rq->rq_start, len);
+    res[len] = NUL;
+    channel_consume(channel, part, (int)len + (skip ? 1 : 0));
+    return res;
+}
+
+/*
+ * Return all the text from channel "channel"/"part" and remove it.
  * The caller must free it.
  * Returns NULL if there is nothing.
  */
     char_u *
 channel_get(channel_T *channel, ch_part_T part, int *outlen)
 {
-    readq_T *head = &channel->ch_part[part].ch_head;
-    readq_T *node = head->rq_next;
-    char_u *p;
+    long_u  len;
 
-    if (node == NULL)
+    if (channel_peek(channel, part, &len) == NULL)
 	return NULL;
     if (outlen != NULL)
-	*outlen += node->rq_buflen;
-    // dispose of the node but keep the buffer
-    p = node->rq_buffer;
-    head->rq_next = node->rq_next;
-    if (node->rq_next == NULL)
-	head->rq_prev = NULL;
-    else
-	node->rq_next->rq_prev = NULL;
-    vim_free(node);
-    return p;
+	*outlen += len;
+    return channel_take(channel, part, len, FALSE);
 }
 
 /*
- * Returns the whole buffer contents concatenated for "channel"/"part".
+ * Returns the whole buffer contents for "channel"/"part".
  * Replaces NUL bytes with NL.
  */
     static char_u *
 channel_get_all(channel_T *channel, ch_part_T part, int *outlen)
 {
-    readq_T *head = &channel->ch_part[part].ch_head;
-    readq_T *node;
-    long_u  len = 0;
+    long_u  len;
     char_u  *res;
     char_u  *p;
 
-    // Concatenate everything into one buffer.
-    for (node = head->rq_next; node != NULL; node = node->rq_next)
-	len += node->rq_buflen;
-    res = alloc(len + 1);
+    if (channel_peek(channel, part, &len) == NULL)
+	len = 0;
+    res = channel_take(channel, part, len, FALSE);
     if (res == NULL)
 	return NULL;
-    p = res;
-    for (node = head->rq_next; node != NULL; node = node->rq_next)
-    {
-	mch_memmove(p, node->rq_buffer, node->rq_buflen);
-	p += node->rq_buflen;
-    }
-    *p = NUL;
-
-    // Free all buffers
-    do
-    {
-	p = channel_get(channel, part, NULL);
-	vim_free(p);
-    } while (p != NULL);
 
     if (outlen != NULL)
     {
@@ -1971,147 +2367,111 @@ channel_get_all(channel_T *channel, ch_part_T part, int *outlen)
 }
 
 /*
- * Consume "len" bytes from the head of "node".
- * Caller must check these bytes are available.
+ * Remove the first line from the text of "channel"/"part" and return it in
+ * allocated memory, without the NL.  When there is no NL all the text is
+ * returned.
+ * NUL bytes are converted to NL, the internal representation.
  */
-    void
-channel_consume(channel_T *channel, ch_part_T part, int len)
+    static char_u *
+channel_get_line(channel_T *channel, ch_part_T part)
 {
-    readq_T *head = &channel->ch_part[part].ch_head;
-    readq_T *node = head->rq_next;
-    char_u *buf = node->rq_buffer;
+    char_u  *text;
+    char_u  *nl;
+    char_u  *msg;
+    char_u  *p;
+    long_u  len;
 
-    mch_memmove(buf, buf + len, node->rq_buflen - len);
-    node->rq_buflen -= len;
-    node->rq_buffer[node->rq_buflen] = NUL;
+    text = channel_peek(channel, part, &len);
+    if (text == NULL)
+	return NULL;
+    nl = channel_first_nl(channel, part);
+    if (nl != NULL)
+	len = (long_u)(nl - text);
+    msg = channel_take(channel, part, len, nl != NULL);
+    if (msg != NULL)
+	for (p = msg; p < msg + len; ++p)
+	    if (*p == NUL)
+		*p = NL;
+    return msg;
 }
 
 /*
- * Collapses the first and second buffer for "channel"/"part".
- * Returns FAIL if that is not possible.
- * When "want_nl" is TRUE collapse more buffers until a NL is found.
+ * Make room for appending "len" bytes to the text of "channel"/"part".
+ * Returns FAIL when out of memory.
  */
-    int
-channel_collapse(channel_T *channel, ch_part_T part, int want_nl)
+    static int
+channel_readq_room(channel_T *channel, ch_part_T part, long_u len)
 {
-    readq_T *head = &channel->ch_part[part].ch_head;
-    readq_T *node = head->rq_next;
-    readq_T *last_node;
-    readq_T *n;
-    char_u  *newbuf;
-    char_u  *p;
-    long_u len;
+    readq_T *rq = &channel->ch_part[part].ch_readq;
+    long_u  used = rq->rq_end - rq->rq_start;
+    long_u  new_size;
+    char_u  *new_buffer;
 
-    if (node == NULL || node->rq_next == NULL)
-	return FAIL;
-
-    last_node = node->rq_next;
-    len = node->rq_buflen + last_node->rq_buflen;
-    if (want_nl)
-	while (last_node->rq_next != NULL
-		&& channel_first_nl(last_node) == NULL)
-	{
-	    last_node = last_node->rq_next;
-	    len += last_node->rq_buflen;
-	}
+    if (rq->rq_end + len <= rq->rq_size)
+	return OK;
 
-    p = newbuf = alloc(len + 1);
-    if (newbuf == NULL)
-	return FAIL;	    // out of memory
-    mch_memmove(p, node->rq_buffer, node->rq_buflen);
-    p += node->rq_buflen;
-    vim_free(node->rq_buffer);
-    node->rq_buffer = newbuf;
-    for (n = node; n != last_node; )
+    if (rq->rq_start >= used && used + len <= rq->rq_size)
     {
-	n = n->rq_next;
-	mch_memmove(p, n->rq_buffer, n->rq_buflen);
-	p += n->rq_buflen;
-	vim_free(n->rq_buffer);
+	// Move the unread text to the start.  It is not longer than the text
+	// that was consumed, thus this does not make reading quadratic.
+	mch_memmove(rq->rq_buffer, rq->rq_buffer + rq->rq_start, used);
     }
-    *p = NUL;
-    node->rq_buflen = (long_u)(p - newbuf);
-
-    // dispose of the collapsed nodes and their buffers
-    for (n = node->rq_next; n != last_node; )
-    {
-	n = n->rq_next;
-	vim_free(n->rq_prev);
-    }
-    node->rq_next = last_node->rq_next;
-    if (last_node->rq_next == NULL)
-	head->rq_prev = node;
     else
-	last_node->rq_next->rq_prev = node;
-    vim_free(last_node);
+    {
+	new_size = rq->rq_size * 2;
+	if (new_size < used + len)
+	    new_size = used + len;
+	if (new_size < READQ_MIN_SIZE)
+	    new_size = READQ_MIN_SIZE;
+	new_buffer = alloc(new_size + 1);
+	if (new_buffer == NULL)
+	    return FAIL;
+	if (used > 0)
+	    mch_memmove(new_buffer, rq->rq_buffer + rq->rq_start, used);
+	vim_free(rq->rq_buffer);
+	rq->rq_buffer = new_buffer;
+	rq->rq_size = new_size;
+    }
+    rq->rq_scanned = rq->rq_scanned > rq->rq_start
+					    ? rq->rq_scanned - rq->rq_start : 0;
+    rq->rq_start = 0;
+    rq->rq_end = used;
+    rq->rq_buffer[used] = NUL;
     return OK;
 }
 
 /*
- * Store "buf[len]" on "channel"/"part".
- * When "prepend" is TRUE put in front, otherwise append at the end.
+ * Append "buf[len]" to the text of "channel"/"part".
  * Returns OK or FAIL.
  */
     static int
 channel_save(channel_T *channel, ch_part_T part, char_u *buf, int len,
-						      int prepend, char *lead)
+								   char *lead)
 {
-    readq_T *node;
-    readq_T *head = &channel->ch_part[part].ch_head;
+    readq_T *rq = &channel->ch_part[part].ch_readq;
     char_u  *p;
     int	    i;
 
-    node = ALLOC_ONE(readq_T);
-    if (node == NULL)
+    if (channel_readq_room(channel, part, (long_u)len) == FAIL)
 	return FAIL;	    // out of memory
+
     // A NUL is added at the end, because netbeans code expects that.
     // Otherwise a NUL may appear inside the text.
-    node->rq_buffer = alloc(len + 1);
-    if (node->rq_buffer == NULL)
-    {
-	vim_free(node);
-	return FAIL;	    // out of memory
-    }
-
+    p = rq->rq_buffer + rq->rq_end;
     if (channel->ch_part[part].ch_mode == MODE_NL)
     {
 	// Drop any CR before a NL.
-	p = node->rq_buffer;
 	for (i = 0; i < len; ++i)
 	    if (buf[i] != CAR || i + 1 >= len || buf[i + 1] != NL)
 		*p++ = buf[i];
-	*p = NUL;
-	node->rq_buflen = (long_u)(p - node->rq_buffer);
     }
     else
     {
-	mch_memmove(node->rq_buffer, buf, len);
-	node->rq_buffer[len] = NUL;
-	node->rq_buflen = (long_u)len;
-    }
-
-    if (prepend)
-    {
-	// prepend node to the head of the queue
-	node->rq_next = head->rq_next;
-	node->rq_prev = NULL;
-	if (head->rq_next == NULL)
-	    head->rq_prev = node;
-	else
-	    head->rq_next->rq_prev = node;
-	head->rq_next = node;
-    }
-    else
-    {
-	// append node to the tail of the queue
-	node->rq_next = NULL;
-	node->rq_prev = head->rq_prev;
-	if (head->rq_prev == NULL)
-	    head->rq_next = node;
-	else
-	    head->rq_prev->rq_next = node;
-	head->rq_prev = node;
+	mch_memmove(p, buf, len);
+	p += len;
     }
+    *p = NUL;
+    rq->rq_end = (long_u)(p - rq->rq_buffer);
 
     if (ch_log_active() && lead != NULL)
     {
@@ -2124,47 +2484,106 @@ channel_save(channel_T *channel, ch_part_T part, char_u *buf, int len,
 }
 
 /*
- * Try to fill the buffer of "reader".
- * Returns FALSE when nothing was added.
+ * Add the decoded message "listtv" to the queue of "channel"/"part".
+ * Only accepts a list with at least two items, otherwise it is dropped.
+ * Takes over the value of "listtv".
+ */
+    static void
+channel_add_json(channel_T *channel, ch_part_T part, typval_T *listtv)
+{
+    jsonq_T	*head = &channel->ch_part[part].ch_json_head;
+    jsonq_T	*item;
+
+    if (listtv->v_type != VAR_LIST || listtv->vval.v_list->lv_len < 2)
+    {
+	if (listtv->v_type != VAR_LIST)
+	    ch_error(channel, "Did not receive a list, discarding");
+	else
+	    ch_error(channel, "Expected list with two items, got %d",
+						 listtv->vval.v_list->lv_len);
+	clear_tv(listtv);
+	return;
+    }
+
+    item = ALLOC_ONE(jsonq_T);
+    if (item == NULL)
+    {
+	clear_tv(listtv);
+	return;
+    }
+    item->jq_no_callback = FALSE;
+    item->jq_value = alloc_tv();
+    if (item->jq_value == NULL)
+    {
+	vim_free(item);
+	clear_tv(listtv);
+	return;
+    }
+    *item->jq_value = *listtv;
+    item->jq_prev = head->jq_prev;
+    head->jq_prev = item;
+    item->jq_next = NULL;
+    if (item->jq_prev == NULL)
+	head->jq_next = item;
+    else
+	item->jq_prev->jq_next = item;
+}
+
+// Time in msec that decoding a JSON message may take before it is
+// interrupted, to remain responsive while a large message is decoded.
+#define JSON_DECODE_MSEC 5L
+
+// A MessagePack message longer than this is considered invalid.
+#define MSGPACK_MAX_MSGLEN (256L * 1024L * 1024L)
+
+/*
+ * Use the read buffer of "channel"/"part" and decode a MessagePack message
+ * that is complete.  A message starts with its length as a four byte
+ * big-endian number.  The message is added to the queue.
+ * Return TRUE if there is more to read.
  */
     static int
-channel_fill(js_read_T *reader)
+channel_parse_msgpack(channel_T *channel, ch_part_T part)
 {
-    channel_T	*channel = (channel_T *)reader->js_cookie;
-    ch_part_T	part = reader->js_cookie_arg;
-    char_u	*next = channel_get(channel, part, NULL);
-    int		keeplen;
-    int		addlen;
-    char_u	*p;
+    char_u	*buf;
+    long_u	buflen;
+    long_u	msglen;
+    typval_T	listtv;
 
-    if (next == NULL)
+    buf = channel_peek(channel, part, &buflen);
+    if (buf == NULL || buflen < 4)
 	return FALSE;
-
-    keeplen = reader->js_end - reader->js_buf;
-    if (keeplen > 0)
+    msglen = ((long_u)buf[0] << 24) | ((long_u)buf[1] << 16)
+					  | ((long_u)buf[2] << 8) | buf[3];
+    if (msglen > MSGPACK_MAX_MSGLEN)
+    {
+	// Most likely not a length at all, we can't find the start of the
+	// next message.
+	ch_error(channel, "Message length %lu too big - discarding input",
+								      msglen);
+	channel_consume(channel, part, (int)buflen);
+	return FALSE;
+    }
+    if (buflen - 4 < msglen)
     {
-	// Prepend unused text.
-	addlen = (int)STRLEN(next);
-	p = alloc(keeplen + addlen + 1);
-	if (p == NULL)
-	{
-	    vim_free(next);
-	    return FALSE;
-	}
-	mch_memmove(p, reader->js_buf, keeplen);
-	mch_memmove(p + keeplen, next, addlen + 1);
-	vim_free(next);
-	next = p;
+	// The length is known, no need for a deadline.
+	ch_log(channel, "Incomplete message (%ld of %ld bytes)",
+					      (long)buflen - 4, (long)msglen);
+	return FALSE;
     }
 
-    vim_free(reader->js_buf);
-    reader->js_buf = next;
-    return TRUE;
+    if (msgpack_decode(buf + 4, msglen, &listtv) == OK)
+	channel_add_json(channel, part, &listtv);
+    else
+	ch_error(channel, "Decoding failed - discarding message");
+    channel_consume(channel, part, (int)(msglen + 4));
+    return buflen > msglen + 4;
 }
 
 /*
  * Use the read buffer of "channel"/"part" and parse a JSON message that is
  * complete.  The messages are added to the queue.
+ * For MODE_MSGPACK a MessagePack message is decoded instead.
  * Return TRUE if there is more to read.
  */
     static int
@@ -2172,77 +2591,61 @@ channel_parse_json(channel_T *channel, ch_part_T part)
 {
     js_read_T	reader;
     typval_T	listtv;
-    jsonq_T	*item;
     chanpart_T	*chanpart = &channel->ch_part[part];
-    jsonq_T	*head = &chanpart->ch_json_head;
     int		status;
     int		ret;
+    long_u	buflen;
+    int		options = chanpart->ch_mode == MODE_JS ? JSON_JS : 0;
 
-    if (channel_peek(channel, part) == NULL)
-	return FALSE;
+    if (chanpart->ch_mode == MODE_MSGPACK)
+	return channel_parse_msgpack(channel, part);
 
-    reader.js_buf = channel_get(channel, part, NULL);
+    // Decode directly from the read buffer, it contains all the text that
+    // was received.
+    reader.js_buf = channel_peek(channel, part, &buflen);
+    if (reader.js_buf == NULL)
+	return FALSE;
+    reader.js_end = reader.js_buf + buflen;
     reader.js_used = 0;
-    reader.js_fill = channel_fill;
+    reader.js_fill = NULL;
     reader.js_cookie = channel;
     reader.js_cookie_arg = part;
 
     // When a message is incomplete we wait for a short while for more to
     // arrive.  After the delay drop the input, otherwise a truncated string
     // or list will make us hang.
-    // Do not generate error messages, they will be written in a channel log.
-    ++emsg_silent;
-    status = json_decode(&reader, &listtv,
-				  chanpart->ch_mode == MODE_JS ? JSON_JS : 0);
-    --emsg_silent;
-    if (status == OK)
+    // First check whether the message is complete.  This only looks at the
+    // text received since the last time, thus a large message arriving in
+    // many pieces is decoded only once instead of every time a piece arrives.
+    if (chanpart->ch_readq.rq_decode != NULL)
+	// The message is complete, decoding it was interrupted.
+	status = OK;
+    else
+	status = json_scan_message(&chanpart->ch_readq.rq_json,
+					     reader.js_buf, buflen, options);
+    if (status != MAYBE)
     {
-	// Only accept the response when it is a list with at least two
-	// items.
-	if (listtv.v_type != VAR_LIST || listtv.vval.v_list->lv_len < 2)
-	{
-	    if (listtv.v_type != VAR_LIST)
-		ch_error(channel, "Did not receive a list, discarding");
-	    else
-		ch_error(channel, "Expected list with two items, got %d",
-						  listtv.vval.v_list->lv_len);
-	    clear_tv(&listtv);
-	}
-	else
+	// Do not generate error messages, they will be written in a channel
+	// log.
+	++emsg_silent;
+	status = json_decode_resume(&reader, &chanpart->ch_readq.rq_decode,
+					  &listtv, options, JSON_DECODE_MSEC);
+	--emsg_silent;
+	if (chanpart->ch_readq.rq_decode != NULL)
 	{
-	    item = ALLOC_ONE(jsonq_T);
-	    if (item == NULL)
-		clear_tv(&listtv);
-	    else
-	    {
-		item->jq_no_callback = FALSE;
-		item->jq_value = alloc_tv();
-		if (item->jq_value == NULL)
-		{
-		    vim_free(item);
-		    clear_tv(&listtv);
-		}
-		else
-		{
-		    *item->jq_value = listtv;
-		    item->jq_prev = head->jq_prev;
-		    head->jq_prev = item;
-		    item->jq_next = NULL;
-		    if (item->jq_prev == NULL)
-			head->jq_next = item;
-		    else
-			item->jq_prev->jq_next = item;
-		}
-	    }
+	    // Decoding takes long, continue after checking for typed keys.
+	    ch_log(channel, "Decoding interrupted at byte %d",
+							     reader.js_used);
+	    return TRUE;
 	}
     }
+    if (status == OK)
+	channel_add_json(channel, part, &listtv);
 
     if (status == OK)
 	chanpart->ch_wait_len = 0;
     else if (status == MAYBE)
     {
-	size_t buflen = STRLEN(reader.js_buf);
-
 	if (chanpart->ch_wait_len < buflen)
 	{
 	    // First time encountering incomplete message or after receiving
@@ -2298,19 +2701,20 @@ channel_parse_json(channel_T *channel, ch_part_T part)
 	ch_error(channel, "Decoding failed - discarding input");
 	ret = FALSE;
 	chanpart->ch_wait_len = 0;
+	channel_consume(channel, part, (int)buflen);
     }
     else if (reader.js_buf[reader.js_used] != NUL)
     {
-	// Put the unread part back into the channel.
-	channel_save(channel, part, reader.js_buf + reader.js_used,
-			(int)(reader.js_end - reader.js_buf) - reader.js_used,
-								  TRUE, NULL);
+	// Leave the unread part in the channel.
+	channel_consume(channel, part, reader.js_used);
 	ret = status == MAYBE ? FALSE: TRUE;
     }
     else
+    {
+	channel_consume(channel, part, (int)buflen);
 	ret = FALSE;
+    }
 
-    vim_free(reader.js_buf);
     return ret;
 }
 
@@ -2512,6 +2916,26 @@ channel_push_json(channel_T *channel, ch_part_T part, typval_T *rettv)
 
 #define CH_JSON_MAX_ARGS 4
 
+/*
+ * Encode ["nr", "val"] for sending in "ch_mode", which is MODE_JSON, MODE_JS
+ * or MODE_MSGPACK.  The length of the result is stored in "*lenp".
+ * Returns NULL when "val" can't be encoded or out of memory.
+ */
+    static char_u *
+channel_encode_nr_expr(ch_mode_T ch_mode, int nr, typval_T *val, int *lenp)
+{
+    char_u *text;
+
+    if (ch_mode == MODE_MSGPACK)
+	return msgpack_encode_nr_expr(nr, val, lenp);
+    text = json_encode_nr_expr(nr, val,
+			     (ch_mode == MODE_JS ? JSON_JS : 0) | JSON_NL, lenp);
+    if (text != NULL && *text == NUL)
+	// encoding failed
+	VIM_CLEAR(text);
+    return text;
+}
+
 /*
  * Execute a command received over "channel"/"part"
  * "argv[0]" is the command string.
@@ -2522,7 +2946,7 @@ channel_exe_cmd(channel_T *channel, ch_part_T part, typval_T *argv)
 {
     char_u  *cmd = argv[0].vval.v_string;
     char_u  *arg;
-    int	    options = channel->ch_part[part].ch_mode == MODE_JS ? JSON_JS : 0;
+    ch_mode_T ch_mode = channel->ch_part[part].ch_mode;
 
     if (argv[1].v_type != VAR_STRING)
     {
@@ -2594,6 +3018,7 @@ channel_exe_cmd(channel_T *channel, ch_part_T part, typval_T *argv)
 	    typval_T	res_tv;
 	    typval_T	err_tv;
 	    char_u	*json = NULL;
+	    int		json_len = 0;
 
 	    // Don't pollute the display with errors.
 	    ++emsg_skip;
@@ -2614,23 +3039,20 @@ channel_exe_cmd(channel_T *channel, ch_part_T part, typval_T *argv)
 		int id = argv[id_idx].vval.v_number;
 
 		if (tv != NULL)
-		    json = json_encode_nr_expr(id, tv, options | JSON_NL);
-		if (tv == NULL || (json != NULL && *json == NUL))
+		    json = channel_encode_nr_expr(ch_mode, id, tv, &json_len);
+		if (json == NULL)
 		{
 		    // If evaluation failed or the result can't be encoded
 		    // then return the string "ERROR".
-		    vim_free(json);
 		    err_tv.v_type = VAR_STRING;
 		    err_tv.vval.v_string = (char_u *)"ERROR";
-		    json = json_encode_nr_expr(id, &err_tv, options | JSON_NL);
+		    json = channel_encode_nr_expr(ch_mode, id, &err_tv,
+								   &json_len);
 		}
 		if (json != NULL)
-		{
-		    channel_send(channel,
+		    channel_send_take(channel,
 				 part == PART_SOCK ? PART_SOCK : PART_IN,
-				 json, (int)STRLEN(json), (char *)cmd);
-		    vim_free(json);
-		}
+				 json, json_len, (char *)cmd);
 	    }
 	    --emsg_skip;
 	    if (tv == &res_tv)
@@ -2667,8 +3089,17 @@ invoke_one_time_callback(
     vim_free(item);
 }
 
+/*
+ * Append "count" messages in "msgs[]" to "buffer", one line each.
+ * Undo, marks and the cursor are updated once for all of them.
+ */
     static void
-append_to_buffer(buf_T *buffer, char_u *msg, channel_T *channel, ch_part_T part)
+append_to_buffer(
+	buf_T	    *buffer,
+	char_u	    **msgs,
+	int	    count,
+	channel_T   *channel,
+	ch_part_T   part)
 {
     bufref_T	save_curbuf = {NULL, 0, 0};
     win_T	*save_curwin = NULL;
@@ -2698,7 +3129,11 @@ append_to_buffer(buf_T *buffer, char_u *msg, channel_T *channel, ch_part_T part)
     }
 
     // Append to the buffer
-    ch_log(channel, "appending line %d to buffer", (int)lnum + 1 - empty);
+    if (count == 1)
+	ch_log(channel, "appending line %d to buffer", (int)lnum + 1 - empty);
+    else
+	ch_log(channel, "appending lines %d to %d to buffer",
+			(int)lnum + 1 - empty, (int)lnum + count - empty);
 
     buffer->b_p_ma = TRUE;
 
@@ -2712,12 +3147,14 @@ append_to_buffer(buf_T *buffer, char_u *msg, channel_T *channel, ch_part_T part)
     if (empty)
     {
 	// The buffer is empty, replace the first (dummy) line.
-	ml_replace(lnum, msg, TRUE);
+	ml_replace(lnum, msgs[0], TRUE);
 	lnum = 0;
+	if (count > 1)
+	    ml_append_lines(1, msgs + 1, NULL, count - 1, FALSE);
     }
     else
-	ml_append(lnum, msg, 0, FALSE);
-    appended_lines_mark(lnum, 1L);
+	ml_append_lines(lnum, msgs, NULL, count, FALSE);
+    appended_lines_mark(lnum, (long)count);
 
     // Restore curbuf/curwin/curtab
     restore_win_for_buf(save_curwin, save_curtab, &save_curbuf);
@@ -2740,12 +3177,12 @@ append_to_buffer(buf_T *buffer, char_u *msg, channel_T *channel, ch_part_T part)
 			    : (wp->w_cursor.lnum == lnum
 				&& wp->w_cursor.col == 0);
 
-		// If the cursor is at or above the new line, move it one line
-		// down.  If the topline is outdated update it now.
+		// If the cursor is at or above the new lines, move it below
+		// them.  If the topline is outdated update it now.
 		if (move_cursor || wp->w_topline > buffer->b_ml.ml_line_count)
 		{
 		    if (move_cursor)
-			++wp->w_cursor.lnum;
+			wp->w_cursor.lnum += count;
 		    save_curwin = curwin;
 		    curwin = wp;
 		    curbuf = curwin->w_buffer;
@@ -2776,6 +3213,23 @@ append_to_buffer(buf_T *buffer, char_u *msg, channel_T *channel, ch_part_T part)
     }
 }
 
+/*
+ * Get the next message ending in NL from "channel"/"part", without the NL.
+ * NUL bytes are converted to NL, the internal representation.
+ * Returns NULL when there is no complete message (or out of memory).
+ * When the channel was closed the remaining text is returned.
+ */
+    static char_u *
+channel_get_nl_msg(channel_T *channel, ch_part_T part)
+{
+    if (channel_peek(channel, part, NULL) == NULL)
+	return NULL;
+    if (channel_first_nl(channel, part) == NULL
+			      && channel->ch_part[part].ch_fd != INVALID_FD)
+	return NULL; // incomplete message
+    return channel_get_line(channel, part);
+}
+
     static void
 drop_messages(channel_T *channel, ch_part_T part)
 {
@@ -2833,7 +3287,7 @@ may_invoke_callback(channel_T *channel, ch_part_T part)
 	buffer = NULL;
     }
 
-    if (ch_mode == MODE_JSON || ch_mode == MODE_JS)
+    if (ch_mode == MODE_JSON || ch_mode == MODE_JS || ch_mode == MODE_MSGPACK)
     {
 	listitem_T	*item;
 	int		argc = 0;
@@ -2871,7 +3325,7 @@ may_invoke_callback(channel_T *channel, ch_part_T part)
 	}
 	seq_nr = argv[0].vval.v_number;
     }
-    else if (channel_peek(channel, part) == NULL)
+    else if (channel_peek(channel, part, NULL) == NULL)
     {
 	// nothing to read on RAW or NL channel
 	return FALSE;
@@ -2890,51 +3344,9 @@ may_invoke_callback(channel_T *channel, ch_part_T part)
 
 	if (ch_mode == MODE_NL)
 	{
-	    char_u  *nl = NULL;
-	    char_u  *buf;
-	    readq_T *node;
-
-	    // See if we have a message ending in NL in the first buffer.  If
-	    // not try to concatenate the first and the second buffer.
-	    while (TRUE)
-	    {
-		node = channel_peek(channel, part);
-		nl = channel_first_nl(node);
-		if (nl != NULL)
-		    break;
-		if (channel_collapse(channel, part, TRUE) == FAIL)
-		{
-		    if (ch_part->ch_fd == INVALID_FD && node->rq_buflen > 0)
-			break;
-		    return FALSE; // incomplete message
-		}
-	    }
-	    buf = node->rq_buffer;
-
-	    // Convert NUL to NL, the internal representation.
-	    for (p = buf; (nl == NULL || p < nl)
-					    && p < buf + node->rq_buflen; ++p)
-		if (*p == NUL)
-		    *p = NL;
-
-	    if (nl == NULL)
-	    {
-		// get the whole buffer, drop the NL
-		msg = channel_get(channel, part, NULL);
-	    }
-	    else if (nl + 1 == buf + node->rq_buflen)
-	    {
-		// get the whole buffer
-		msg = channel_get(channel, part, NULL);
-		*nl = NUL;
-	    }
-	    else
-	    {
-		// Copy the message into allocated memory (excluding the NL)
-		// and remove it from the buffer (including the NL).
-		msg = vim_strnsave(buf, nl - buf);
-		channel_consume(channel, part, (int)(nl - buf) + 1);
-	    }
+	    msg = channel_get_nl_msg(channel, part);
+	    if (msg == NULL)
+		return FALSE; // incomplete message
 	}
 	else
 	{
@@ -2981,8 +3393,10 @@ may_invoke_callback(channel_T *channel, ch_part_T part)
 	if (buffer != NULL)
 	{
 	    if (msg == NULL)
-		// JSON or JS mode: re-encode the message.
-		msg = json_encode(listtv, ch_mode);
+		// JSON, JS or MessagePack mode: re-encode the message as
+		// JSON or JS.
+		msg = json_encode(listtv,
+			     ch_mode == MODE_MSGPACK ? (int)MODE_JSON : ch_mode);
 	    if (msg != NULL)
 	    {
 #ifdef FEAT_TERMINAL
@@ -2990,7 +3404,30 @@ may_invoke_callback(channel_T *channel, ch_part_T part)
 		    write_to_term(buffer, msg, channel);
 		else
 #endif
-		    append_to_buffer(buffer, msg, channel, part);
+		if (ch_mode == MODE_NL && callback == NULL)
+		{
+		    garray_T	ga;
+
+		    // Nothing to invoke for each message: append all the
+		    // complete lines that are available at once.
+		    ga_init2(&ga, sizeof(char_u *), 100);
+		    if (ga_grow(&ga, 1) == OK)
+		    {
+			((char_u **)ga.ga_data)[ga.ga_len++] = msg;
+			while (ga_grow(&ga, 1) == OK
+				&& (p = channel_get_nl_msg(channel, part))
+								      != NULL)
+			    ((char_u **)ga.ga_data)[ga.ga_len++] = p;
+			append_to_buffer(buffer, (char_u **)ga.ga_data,
+						ga.ga_len, channel, part);
+			// the first one is "msg", freed below
+			while (ga.ga_len > 1)
+			    vim_free(((char_u **)ga.ga_data)[--ga.ga_len]);
+		    }
+		    ga_clear(&ga);
+		}
+		else
+		    append_to_buffer(buffer, &msg, 1, channel, part);
 	    }
 	}
 
@@ -3051,7 +3488,7 @@ channel_has_readahead(channel_T *channel, ch_part_T part)
 {
     ch_mode_T	ch_mode = channel->ch_part[part].ch_mode;
 
-    if (ch_mode == MODE_JSON || ch_mode == MODE_JS)
+    if (ch_mode == MODE_JSON || ch_mode == MODE_JS || ch_mode == MODE_MSGPACK)
     {
 	jsonq_T   *head = &channel->ch_part[part].ch_json_head;
 
@@ -3060,9 +3497,10 @@ channel_has_readahead(channel_T *channel, ch_part_T part)
 	    // process.
 	    channel_parse_json(channel, part);
 
-	return head->jq_next != NULL;
+	return head->jq_next != NULL
+			   || channel->ch_part[part].ch_readq.rq_decode != NULL;
     }
-    return channel_peek(channel, part) != NULL;
+    return channel_peek(channel, part, NULL) != NULL;
 }
 
 /*
@@ -3137,6 +3575,7 @@ channel_part_info(channel_T *channel, dict_T *dict, char *name, ch_part_T part)
 	case MODE_RAW: s = "RAW"; break;
 	case MODE_JSON: s = "JSON"; break;
 	case MODE_JS: s = "JS"; break;
+	case MODE_MSGPACK: s = "MSGPACK"; break;
     }
     dict_add_string(dict, namebuf, (char_u *)s);
 
@@ -3155,6 +3594,12 @@ channel_part_info(channel_T *channel, dict_T *dict, char *name, ch_part_T part)
 
     STRCPY(namebuf + tail, "timeout");
     dict_add_number(dict, namebuf, chanpart->ch_timeout);
+
+    if (part == PART_SOCK || part == PART_IN)
+    {
+	STRCPY(namebuf + tail, "queued");
+	dict_add_number(dict, namebuf, (varnumber_T)chanpart->ch_wq_len);
+    }
 }
 
     static void
@@ -3293,8 +3738,7 @@ channel_clear_one(channel_T *channel, ch_part_T part)
     jsonq_T *json_head = &ch_part->ch_json_head;
     cbq_T   *cb_head = &ch_part->ch_cb_head;
 
-    while (channel_peek(channel, part) != NULL)
-	vim_free(channel_get(channel, part, NULL));
+    channel_clear_readq(channel, part);
 
     while (cb_head->cq_next != NULL)
     {
@@ -3317,6 +3761,8 @@ channel_clear_one(channel_T *channel, ch_part_T part)
     while (ch_part->ch_writeque.wq_next != NULL)
 	remove_from_writeque(&ch_part->ch_writeque,
 						 ch_part->ch_writeque.wq_next);
+    ch_part->ch_wq_len = 0;
+    ch_part->ch_wq_full = FALSE;
 }
 
 /*
@@ -3333,6 +3779,7 @@ channel_clear(channel_T *channel)
     channel_clear_one(channel, PART_IN);
     free_callback(&channel->ch_callback);
     free_callback(&channel->ch_close_cb);
+    free_callback(&channel->ch_drain_cb);
 }
 
 #if defined(EXITFREE) || defined(PROTO)
@@ -3506,9 +3953,18 @@ channel_wait(channel_T *channel, sock_T fd, int timeout)
 	    break;
 	}
 #else
+	channel_T	*ch;
+	int		count = 1;
+	struct pollfd	*fds;
+
+	// Room for "fd" and the input of every channel.
+	FOR_ALL_CHANNELS(ch)
+	    ++count;
+	fds = ALLOC_MULT(struct pollfd, count);
+	if (fds == NULL)
+	    return CW_ERROR;
 	for (;;)
 	{
-	    struct pollfd   fds[MAX_OPEN_CHANNELS + 1];
 	    int		    nfd = 1;
 
 	    fds[0].fd = fd;
@@ -3517,12 +3973,16 @@ channel_wait(channel_T *channel, sock_T fd, int timeout)
 	    if (poll(fds, nfd, timeout) > 0)
 	    {
 		if (fds[0].revents & POLLIN)
+		{
+		    vim_free(fds);
 		    return CW_READY;
+		}
 		channel_write_any_lines();
 		continue;
 	    }
 	    break;
 	}
+	vim_free(fds);
 #endif
     }
     return CW_NOT_READY;
@@ -3552,7 +4012,7 @@ ch_close_part_on_error(
     // Only send "DETACH" for a netbeans channel.
     if (channel->ch_nb_close_cb != NULL)
 	channel_save(channel, PART_SOCK, (char_u *)DETACH_MSG_RAW,
-			      (int)STRLEN(DETACH_MSG_RAW), FALSE, "PUT ");
+			      (int)STRLEN(DETACH_MSG_RAW), "PUT ");
 
     // When reading is not possible close this part of the channel.  Don't
     // close the channel yet, there may be something to read on another part.
@@ -3628,7 +4088,7 @@ channel_read(channel_T *channel, ch_part_T part, char *func)
 	    break;	// error or nothing more to read
 
 	// Store the read message in the queue.
-	channel_save(channel, part, buf, len, FALSE, "RECV ");
+	channel_save(channel, part, buf, len, "RECV ");
 	readlen += len;
 	if (len < MAXMSGSIZE)
 	    break;	// did read everything that's available
@@ -3659,27 +4119,21 @@ channel_read(channel_T *channel, ch_part_T part, char *func)
 channel_read_block(
 	channel_T *channel, ch_part_T part, int timeout, int raw, int *outlen)
 {
-    char_u	*buf;
     char_u	*msg;
     ch_mode_T	mode = channel->ch_part[part].ch_mode;
     sock_T	fd = channel->ch_part[part].ch_fd;
-    char_u	*nl;
-    readq_T	*node;
 
     ch_log(channel, "Blocking %s read, timeout: %d msec",
 				     mode == MODE_RAW ? "RAW" : "NL", timeout);
 
     while (TRUE)
     {
-	node = channel_peek(channel, part);
-	if (node != NULL)
+	if (channel_peek(channel, part, NULL) != NULL)
 	{
 	    if (mode == MODE_RAW || (mode == MODE_NL
-					   && channel_first_nl(node) != NULL))
+				   && channel_first_nl(channel, part) != NULL))
 		// got a complete message
 		break;
-	    if (channel_collapse(channel, part, mode == MODE_NL) == OK)
-		continue;
 	    // If not blocking or nothing more is coming then return what we
 	    // have.
 	    if (raw || fd == INVALID_FD)
@@ -3699,41 +4153,10 @@ channel_read_block(
 
     // We have a complete message now.
     if (mode == MODE_RAW || outlen != NULL)
-    {
 	msg = channel_get_all(channel, part, outlen);
-    }
     else
-    {
-	char_u *p;
-
-	buf = node->rq_buffer;
-	nl = channel_first_nl(node);
-
-	// Convert NUL to NL, the internal representation.
-	for (p = buf; (nl == NULL || p < nl) && p < buf + node->rq_buflen; ++p)
-	    if (*p == NUL)
-		*p = NL;
-
-	if (nl == NULL)
-	{
-	    // must be a closed channel with missing NL
-	    msg = channel_get(channel, part, NULL);
-	}
-	else if (nl + 1 == buf + node->rq_buflen)
-	{
-	    // get the whole buffer
-	    msg = channel_get(channel, part, NULL);
-	    *nl = NUL;
-	}
-	else
-	{
-	    // Copy the message into allocated memory and remove it from the
-	    // buffer.
-	    msg = vim_strnsave(buf, nl - buf);
-	    channel_consume(channel, part, (int)(nl - buf) + 1);
-	}
-    }
-    if (ch_log_active())
+	msg = channel_get_line(channel, part);
+    if (ch_log_active() && msg != NULL)
 	ch_log(channel, "Returning %d bytes", (int)STRLEN(msg));
     return msg;
 }
@@ -4077,21 +4500,224 @@ channel_set_nonblock(channel_T *channel, ch_part_T part)
 }
 
 /*
- * Write "buf" (NUL terminated string) to "channel"/"part".
+ * Append "buf_arg[done]" to "buf_arg[len_arg]" to the write queue of
+ * "channel"/"part".
+ * When "takep" is not NULL and "*takep" is "buf_arg" the allocated "buf_arg"
+ * may be put in the queue instead of copying the text, "*takep" is then set
+ * to NULL.
+ */
+    static void
+channel_writeque_add(
+	channel_T *channel,
+	ch_part_T part,
+	char_u	  *buf_arg,
+	int	  len_arg,
+	int	  done,
+	char_u	  **takep)
+{
+    chanpart_T	*ch_part = &channel->ch_part[part];
+    writeq_T	*wq = &ch_part->ch_writeque;
+    char_u	*buf = buf_arg + done;
+    int		len = len_arg - done;
+
+    if (len <= 0)
+	return;
+    ch_log(channel, "Adding %d bytes to the write queue", len);
+
+    // Append the not written bytes of the argument to the write buffer.
+    // Limit entries to 4000 bytes.
+    if (wq->wq_prev != NULL && wq->wq_prev->wq_ga.ga_len + len < 4000)
+    {
+	writeq_T *last = wq->wq_prev;
+
+	// append to the last entry
+	if (ga_grow(&last->wq_ga, len) == FAIL)
+	    return;
+	mch_memmove((char *)last->wq_ga.ga_data + last->wq_ga.ga_len,
+								    buf, len);
+	last->wq_ga.ga_len += len;
+    }
+    else
+    {
+	writeq_T *last = ALLOC_ONE(writeq_T);
+
+	if (last == NULL)
+	    return;
+	last->wq_prev = wq->wq_prev;
+	last->wq_next = NULL;
+	ga_init2(&last->wq_ga, 1, 1000);
+	last->wq_sent = 0;
+	if (takep != NULL && buf_arg == *takep)
+	{
+	    // Keep the argument in the queue, avoids copying a large
+	    // message.
+	    last->wq_ga.ga_data = buf_arg;
+	    last->wq_ga.ga_len = len_arg;
+	    last->wq_ga.ga_maxlen = len_arg;
+	    last->wq_sent = done;
+	    *takep = NULL;
+	}
+	else if (ga_grow(&last->wq_ga, len) == OK)
+	{
+	    mch_memmove(last->wq_ga.ga_data, buf, len);
+	    last->wq_ga.ga_len = len;
+	}
+	else
+	{
+	    vim_free(last);
+	    return;
+	}
+	if (wq->wq_prev == NULL)
+	    wq->wq_next = last;
+	else
+	    wq->wq_prev->wq_next = last;
+	wq->wq_prev = last;
+    }
+    ch_part->ch_wq_len += len;
+    if (!ch_part->ch_wq_full && ch_part->ch_wq_len > channel->ch_highwater)
+    {
+	ch_log(channel, "Write queue above %ld bytes", channel->ch_highwater);
+	ch_part->ch_wq_full = TRUE;
+    }
+}
+
+/*
+ * Remove "len" written bytes from the start of the write queue of
+ * "channel"/"part".  When the queue was above the high water mark and is now
+ * empty the drain callback is to be invoked.
+ */
+    static void
+channel_writeque_written(channel_T *channel, ch_part_T part, long_u len)
+{
+    chanpart_T	*ch_part = &channel->ch_part[part];
+    writeq_T	*wq = &ch_part->ch_writeque;
+
+    while (len > 0 && wq->wq_next != NULL)
+    {
+	writeq_T    *entry = wq->wq_next;
+	long_u	    left = entry->wq_ga.ga_len - entry->wq_sent;
+
+	if (len < left)
+	{
+	    // Skip over the bytes that were written.
+	    entry->wq_sent += (int)len;
+	    ch_part->ch_wq_len -= len;
+	    return;
+	}
+	len -= left;
+	ch_part->ch_wq_len -= left;
+	remove_from_writeque(wq, entry);
+    }
+
+    if (wq->wq_next == NULL)
+    {
+	ch_log(channel, "Write queue empty");
+	ch_part->ch_wq_len = 0;
+	if (ch_part->ch_wq_full)
+	{
+	    ch_part->ch_wq_full = FALSE;
+	    if (channel->ch_drain_cb.cb_name != NULL)
+		channel->ch_drain_pending = TRUE;
+	}
+    }
+}
+
+#ifdef HAVE_WRITEV
+/*
+ * Write the entries of the write queue of "channel"/"part" and then
+ * "buf[len]" with one writev() call.  Removes what was written from the
+ * queue.
+ * Returns the number of bytes of "buf" that were written, -1 for an error.
+ */
+    static int
+channel_writev(channel_T *channel, ch_part_T part, char_u *buf, int len)
+{
+    chanpart_T	*ch_part = &channel->ch_part[part];
+    struct iovec iov[CH_MAX_IOV];
+    writeq_T	*entry;
+    int		count = 0;
+    long_u	queued = 0;
+    ssize_t	res;
+
+    for (entry = ch_part->ch_writeque.wq_next;
+			   entry != NULL && count < CH_MAX_IOV;
+							entry = entry->wq_next)
+    {
+	iov[count].iov_base = (char *)entry->wq_ga.ga_data + entry->wq_sent;
+	iov[count].iov_len = entry->wq_ga.ga_len - entry->wq_sent;
+	queued += iov[count].iov_len;
+	++count;
+    }
+    // Only add "buf" when it can follow all the queued text.
+    if (entry == NULL && len > 0 && count < CH_MAX_IOV)
+    {
+	iov[count].iov_base = buf;
+	iov[count].iov_len = len;
+	++count;
+    }
+
+    do
+	res = writev(ch_part->ch_fd, iov, count);
+    while (res < 0 && errno == EINTR);
+    if (res < 0)
+    {
+	if (errno == EWOULDBLOCK
+# ifdef EAGAIN
+		|| errno == EAGAIN
+# endif
+		)
+	    return 0; // nothing got written
+	return -1;
+    }
+    ch_log(channel, "Sent %ld bytes now", (long)res);
+
+    if ((long_u)res <= queued)
+    {
+	channel_writeque_written(channel, part, (long_u)res);
+	return 0;
+    }
+    channel_writeque_written(channel, part, queued);
+    return (int)(res - queued);
+}
+#endif
+
+/*
+ * Give an error for a failed write on "channel", once.
+ * Return FAIL.
+ */
+    static int
+channel_write_error(channel_T *channel, char *fun)
+{
+    if (!channel->ch_error && fun != NULL)
+    {
+	ch_error(channel, "%s(): write failed", fun);
+	semsg(_("E631: %s(): write failed"), fun);
+    }
+    channel->ch_error = TRUE;
+    return FAIL;
+}
+
+/*
+ * Write "buf_arg[len_arg]" to "channel"/"part".
+ * When "takep" is not NULL and "buf_arg" can't be written at once, the
+ * allocated "buf_arg" may be put in the write queue instead of copying the
+ * text, "*takep" is then set to NULL.
  * When "fun" is not NULL an error message might be given.
  * Return FAIL or OK.
  */
-    int
-channel_send(
+    static int
+channel_send_buf(
 	channel_T *channel,
 	ch_part_T part,
 	char_u	  *buf_arg,
 	int	  len_arg,
+	char_u	  **takep,
 	char	  *fun)
 {
     int		res;
     sock_T	fd;
     chanpart_T	*ch_part = &channel->ch_part[part];
+    writeq_T	*wq = &ch_part->ch_writeque;
     int		did_use_queue = FALSE;
 
     fd = ch_part->ch_fd;
@@ -4119,17 +4745,36 @@ channel_send(
 	did_repeated_msg = 0;
     }
 
+#ifdef HAVE_WRITEV
+    if (wq->wq_next != NULL && ch_part->ch_nonblocking)
+    {
+	// Write what was queued and the argument with one system call.
+	res = channel_writev(channel, part, buf_arg, len_arg);
+	if (res < 0)
+	    return channel_write_error(channel, fun);
+	if (wq->wq_next != NULL || res < len_arg)
+	{
+	    channel_writeque_add(channel, part, buf_arg, len_arg, res, takep);
+# ifdef CHANNEL_EPOLL
+	    // Wait for the fd to be writable again.
+	    channel_epoll_sync(channel);
+# endif
+	}
+	channel->ch_error = FALSE;
+	return OK;
+    }
+#endif
+
     for (;;)
     {
-	writeq_T    *wq = &ch_part->ch_writeque;
 	char_u	    *buf;
 	int	    len;
 
 	if (wq->wq_next != NULL)
 	{
 	    // first write what was queued
-	    buf = wq->wq_next->wq_ga.ga_data;
-	    len = wq->wq_next->wq_ga.ga_len;
+	    buf = (char_u *)wq->wq_next->wq_ga.ga_data + wq->wq_next->wq_sent;
+	    len = wq->wq_next->wq_ga.ga_len - wq->wq_next->wq_sent;
 	    did_use_queue = TRUE;
 	}
 	else
@@ -4163,102 +4808,76 @@ channel_send(
 
 	if (res >= 0 && ch_part->ch_nonblocking)
 	{
-	    writeq_T *entry = wq->wq_next;
-
 	    if (did_use_queue)
 		ch_log(channel, "Sent %d bytes now", res);
-	    if (res == len)
+	    if (wq->wq_next != NULL)
 	    {
-		// Wrote all the buf[len] bytes.
-		if (entry != NULL)
-		{
-		    // Remove the entry from the write queue.
-		    remove_from_writeque(wq, entry);
+		channel_writeque_written(channel, part, (long_u)res);
+		if (res == len)
+		    // Wrote the whole entry, continue with the next one.
 		    continue;
-		}
-		if (did_use_queue)
-		    ch_log(channel, "Write queue empty");
+		// Can't write more now.
+		res = 0;
 	    }
-	    else
-	    {
-		// Wrote only buf[res] bytes, can't write more now.
-		if (entry != NULL)
-		{
-		    if (res > 0)
-		    {
-			// Remove the bytes that were written.
-			mch_memmove(entry->wq_ga.ga_data,
-				    (char *)entry->wq_ga.ga_data + res,
-				    len - res);
-			entry->wq_ga.ga_len -= res;
-		    }
-		    buf = buf_arg;
-		    len = len_arg;
-		}
-		else
-		{
-		    buf += res;
-		    len -= res;
-		}
-		ch_log(channel, "Adding %d bytes to the write queue", len);
-
-		// Append the not written bytes of the argument to the write
-		// buffer.  Limit entries to 4000 bytes.
-		if (wq->wq_prev != NULL
-			&& wq->wq_prev->wq_ga.ga_len + len < 4000)
-		{
-		    writeq_T *last = wq->wq_prev;
-
-		    // append to the last entry
-		    if (len > 0 && ga_grow(&last->wq_ga, len) == OK)
-		    {
-			mch_memmove((char *)last->wq_ga.ga_data
-							  + last->wq_ga.ga_len,
-				    buf, len);
-			last->wq_ga.ga_len += len;
-		    }
-		}
-		else
-		{
-		    writeq_T *last = ALLOC_ONE(writeq_T);
+	    else if (res == len)
+		// Wrote all the buf[len] bytes.
+		break;
 
-		    if (last != NULL)
-		    {
-			last->wq_prev = wq->wq_prev;
-			last->wq_next = NULL;
-			if (wq->wq_prev == NULL)
-			    wq->wq_next = last;
-			else
-			    wq->wq_prev->wq_next = last;
-			wq->wq_prev = last;
-			ga_init2(&last->wq_ga, 1, 1000);
-			if (len > 0 && ga_grow(&last->wq_ga, len) == OK)
-			{
-			    mch_memmove(last->wq_ga.ga_data, buf, len);
-			    last->wq_ga.ga_len = len;
-			}
-		    }
-		}
-	    }
+	    // Wrote only buf_arg[res] bytes, can't write more now.
+	    channel_writeque_add(channel, part, buf_arg, len_arg, res, takep);
+#ifdef CHANNEL_EPOLL
+	    // Wait for the fd to be writable again.
+	    channel_epoll_sync(channel);
+#endif
 	}
 	else if (res != len)
-	{
-	    if (!channel->ch_error && fun != NULL)
-	    {
-		ch_error(channel, "%s(): write failed", fun);
-		semsg(_("E631: %s(): write failed"), fun);
-	    }
-	    channel->ch_error = TRUE;
-	    return FAIL;
-	}
-
-	channel->ch_error = FALSE;
-	return OK;
+	    return channel_write_error(channel, fun);
+	break;
     }
+
+    channel->ch_error = FALSE;
+    return OK;
+}
+
+/*
+ * Write "buf" (NUL terminated string) to "channel"/"part".
+ * When "fun" is not NULL an error message might be given.
+ * Return FAIL or OK.
+ */
+    int
+channel_send(
+	channel_T *channel,
+	ch_part_T part,
+	char_u	  *buf,
+	int	  len,
+	char	  *fun)
+{
+    return channel_send_buf(channel, part, buf, len, NULL, fun);
+}
+
+/*
+ * Like channel_send() for allocated "buf".  "buf" is freed, or kept in the
+ * write queue when it can't be written at once.
+ */
+    int
+channel_send_take(
+	channel_T *channel,
+	ch_part_T part,
+	char_u	  *buf,
+	int	  len,
+	char	  *fun)
+{
+    char_u  *take = buf;
+    int	    res;
+
+    res = channel_send_buf(channel, part, buf, len, &take, fun);
+    vim_free(take);
+    return res;
 }
 
 /*
  * Common for "ch_sendexpr()" and "ch_sendraw()".
+ * When "take" is TRUE "text" is allocated and is freed or kept.
  * Returns the channel if the caller should read the response.
  * Sets "part_read" to the read fd.
  * Otherwise returns NULL.
@@ -4268,6 +4887,7 @@ send_common(
 	typval_T    *argvars,
 	char_u	    *text,
 	int	    len,
+	int	    take,
 	int	    id,
 	int	    eval,
 	jobopt_T    *opt,
@@ -4280,12 +4900,12 @@ send_common(
     clear_job_options(opt);
     channel = get_channel_arg(&argvars[0], TRUE, FALSE, 0);
     if (channel == NULL)
-	return NULL;
+	goto fail;
     part_send = channel_part_send(channel);
     *part_read = channel_part_read(channel);
 
     if (get_job_options(&argvars[2], opt, JO_CALLBACK + JO_TIMEOUT, 0) == FAIL)
-	return NULL;
+	goto fail;
 
     // Set the callback. An empty callback means no callback and not reading
     // the response. With "ch_evalexpr()" and "ch_evalraw()" a callback is not
@@ -4295,15 +4915,21 @@ send_common(
 	if (eval)
 	{
 	    semsg(_("E917: Cannot use a callback with %s()"), fun);
-	    return NULL;
+	    goto fail;
 	}
 	channel_set_req_callback(channel, *part_read, &opt->jo_callback, id);
     }
 
-    if (channel_send(channel, part_send, text, len, fun) == OK
+    if ((take ? channel_send_take(channel, part_send, text, len, fun)
+		  : channel_send(channel, part_send, text, len, fun)) == OK
 					   && opt->jo_callback.cb_name == NULL)
 	return channel;
     return NULL;
+
+fail:
+    if (take)
+	vim_free(text);
+    return NULL;
 }
 
 /*
@@ -4321,6 +4947,7 @@ ch_expr_common(typval_T *argvars, typval_T *rettv, int eval)
     ch_part_T	part_read;
     jobopt_T    opt;
     int		timeout;
+    int		len;
 
     // return an empty string by default
     rettv->v_type = VAR_STRING;
@@ -4339,14 +4966,12 @@ ch_expr_common(typval_T *argvars, typval_T *rettv, int eval)
     }
 
     id = ++channel->ch_last_msg_id;
-    text = json_encode_nr_expr(id, &argvars[1],
-				 (ch_mode == MODE_JS ? JSON_JS : 0) | JSON_NL);
+    text = channel_encode_nr_expr(ch_mode, id, &argvars[1], &len);
     if (text == NULL)
 	return;
 
-    channel = send_common(argvars, text, (int)STRLEN(text), id, eval, &opt,
+    channel = send_common(argvars, text, len, TRUE, id, eval, &opt,
 			    eval ? "ch_evalexpr" : "ch_sendexpr", &part_read);
-    vim_free(text);
     if (channel != NULL && eval)
     {
 	if (opt.jo_set & JO_TIMEOUT)
@@ -4396,7 +5021,7 @@ ch_raw_common(typval_T *argvars, typval_T *rettv, int eval)
 	text = tv_get_string_buf(&argvars[1], buf);
 	len = (int)STRLEN(text);
     }
-    channel = send_common(argvars, text, len, 0, eval, &opt,
+    channel = send_common(argvars, text, len, FALSE, 0, eval, &opt,
 			      eval ? "ch_evalraw" : "ch_sendraw", &part_read);
     if (channel != NULL && eval)
     {
@@ -4413,6 +5038,25 @@ ch_raw_common(typval_T *argvars, typval_T *rettv, int eval)
 #define KEEP_OPEN_TIME 20  // msec
 
 #if (defined(UNIX) && !defined(HAVE_SELECT)) || defined(PROTO)
+/*
+ * Return the maximum number of entries channel_poll_setup() adds.
+ */
+    int
+channel_poll_count(void)
+{
+    channel_T	*channel;
+    int		count = 0;
+
+# ifdef CHANNEL_EPOLL
+    if (epoll_fd >= 0)
+	return 1;
+# endif
+    // each channel may use sock, out, err and in
+    FOR_ALL_CHANNELS(channel)
+	count += 4;
+    return count;
+}
+
 /*
  * Add open channels to the poll struct.
  * Return the adjusted struct index.
@@ -4426,6 +5070,19 @@ channel_poll_setup(int nfd_in, void *fds_in, int *towait)
     struct	pollfd *fds = fds_in;
     ch_part_T	part;
 
+# ifdef CHANNEL_EPOLL
+    if (epoll_fd >= 0)
+    {
+	if (epoll_keep_open_count > 0
+			       && (*towait < 0 || *towait > KEEP_OPEN_TIME))
+	    *towait = KEEP_OPEN_TIME;
+	epoll_poll_idx = nfd;
+	fds[nfd].fd = epoll_fd;
+	fds[nfd].events = POLLIN;
+	return nfd + 1;
+    }
+# endif
+
     FOR_ALL_CHANNELS(channel)
     {
 	for (part = PART_SOCK; part < PART_IN; ++part)
@@ -4473,6 +5130,20 @@ channel_poll_check(int ret_in, void *fds_in)
     int		idx;
     chanpart_T	*in_part;
 
+# ifdef CHANNEL_EPOLL
+    if (epoll_fd >= 0)
+    {
+	if (ret > 0 && (fds[epoll_poll_idx].revents & POLLIN))
+	{
+	    channel_epoll_handle_events("channel_poll_check");
+	    --ret;
+	}
+	if (epoll_keep_open_count > 0)
+	    channel_epoll_read_keep_open("channel_poll_check_keep_open");
+	return ret;
+    }
+# endif
+
     FOR_ALL_CHANNELS(channel)
     {
 	for (part = PART_SOCK; part < PART_IN; ++part)
@@ -4524,6 +5195,23 @@ channel_select_setup(
     fd_set	*wfds = wfds_in;
     ch_part_T	part;
 
+# ifdef CHANNEL_EPOLL
+    if (epoll_fd >= 0)
+    {
+	if (epoll_keep_open_count > 0 && (*tvp == NULL || tv->tv_sec > 0
+				   || tv->tv_usec > KEEP_OPEN_TIME * 1000))
+	{
+	    *tvp = tv;
+	    tv->tv_sec = 0;
+	    tv->tv_usec = KEEP_OPEN_TIME * 1000;
+	}
+	FD_SET(epoll_fd, rfds);
+	if (maxfd < epoll_fd)
+	    maxfd = epoll_fd;
+	return maxfd;
+    }
+# endif
+
     FOR_ALL_CHANNELS(channel)
     {
 	for (part = PART_SOCK; part < PART_IN; ++part)
@@ -4573,6 +5261,21 @@ channel_select_check(int ret_in, void *rfds_in, void *wfds_in)
     ch_part_T	part;
     chanpart_T	*in_part;
 
+# ifdef CHANNEL_EPOLL
+    if (epoll_fd >= 0)
+    {
+	if (ret > 0 && FD_ISSET(epoll_fd, rfds))
+	{
+	    FD_CLR(epoll_fd, rfds);
+	    channel_epoll_handle_events("channel_select_check");
+	    --ret;
+	}
+	if (epoll_keep_open_count > 0)
+	    channel_epoll_read_keep_open("channel_select_check_keep_open");
+	return ret;
+    }
+# endif
+
     FOR_ALL_CHANNELS(channel)
     {
 	for (part = PART_SOCK; part < PART_IN; ++part)
@@ -4689,6 +5392,34 @@ channel_parse_messages(void)
 	    }
 	}
 
+	if (part == PART_SOCK && channel->ch_drain_pending)
+	{
+	    channel->ch_drain_pending = FALSE;
+	    if (channel->ch_drain_cb.cb_name != NULL)
+	    {
+		typval_T    argv[1];
+		typval_T    rettv;
+
+		// Increase the refcount, in case the callback causes the
+		// channel to be unreferenced or closed.
+		++channel->ch_refcount;
+		ch_log(channel, "Invoking drain callback %s",
+					 (char *)channel->ch_drain_cb.cb_name);
+		argv[0].v_type = VAR_CHANNEL;
+		argv[0].vval.v_channel = channel;
+		call_callback(&channel->ch_drain_cb, -1, &rettv, 1, argv);
+		clear_tv(&rettv);
+		channel_need_redraw = TRUE;
+		ret = TRUE;
+		if (channel_unref(channel))
+		{
+		    // channel was freed, start over
+		    channel = first_channel;
+		    continue;
+		}
+	    }
+	}
+
 	if (channel->ch_part[part].ch_fd != INVALID_FD
 				      || channel_has_readahead(channel, part))
 	{
@@ -4735,8 +5466,8 @@ channel_parse_messages(void)
 }
 
 /*
- * Return TRUE if any channel has readahead.  That means we should not block on
- * waiting for input.
+ * Return TRUE if any channel has readahead or a drain callback to invoke.
+ * That means we should not block on waiting for input.
  */
     int
 channel_any_readahead(void)
@@ -4746,7 +5477,8 @@ channel_any_readahead(void)
 
     while (channel != NULL)
     {
-	if (channel_has_readahead(channel, part))
+	if (channel_has_readahead(channel, part)
+		|| (part == PART_SOCK && channel->ch_drain_pending))
 	    return TRUE;
 	if (part < PART_ERR)
 	    ++part;
@@ -4759,6 +5491,23 @@ channel_any_readahead(void)
     return FALSE;
 }
 
+/*
+ * Return TRUE if decoding a message on any channel was interrupted.  It
+ * should be continued without waiting.
+ */
+    int
+channel_any_decoding(void)
+{
+    channel_T	*channel;
+    ch_part_T	part;
+
+    for (channel = first_channel; channel != NULL; channel = channel->ch_next)
+	for (part = PART_SOCK; part < PART_COUNT; ++part)
+	    if (channel->ch_part[part].ch_readq.rq_decode != NULL)
+		return TRUE;
+    return FALSE;
+}
+
 /*
  * Mark references to lists used in channels.
  */
@@ -4767,16 +5516,23 @@ set_ref_in_channel(int copyID)
 {
     int		abort = FALSE;
     channel_T	*channel;
+    ch_part_T	part;
     typval_T	tv;
 
     for (channel = first_channel; !abort && channel != NULL;
 						   channel = channel->ch_next)
+    {
 	if (channel_still_useful(channel))
 	{
 	    tv.v_type = VAR_CHANNEL;
 	    tv.vval.v_channel = channel;
 	    abort = abort || set_ref_in_item(&tv, copyID, NULL, NULL);
 	}
+	// A message being decoded is not referenced from anywhere else.
+	for (part = PART_SOCK; part < PART_COUNT; ++part)
+	    abort = abort || json_decode_set_ref(
+			     channel->ch_part[part].ch_readq.rq_decode, copyID);
+    }
     return abort;
 }
 
@@ -4837,6 +5593,8 @@ handle_mode(typval_T *item, jobopt_T *opt, ch_mode_T *modep, int jo)
 	*modep = MODE_JS;
     else if (STRCMP(val, "json") == 0)
 	*modep = MODE_JSON;
+    else if (STRCMP(val, "msgpack") == 0)
+	*modep = MODE_MSGPACK;
     else
     {
 	semsg(_(e_invarg2), val);
@@ -4900,6 +5658,10 @@ free_job_options(jobopt_T *opt)
 	partial_unref(opt->jo_close_cb.cb_partial);
     else if (opt->jo_close_cb.cb_name != NULL)
 	func_unref(opt->jo_close_cb.cb_name);
+    if (opt->jo_drain_cb.cb_partial != NULL)
+	partial_unref(opt->jo_drain_cb.cb_partial);
+    else if (opt->jo_drain_cb.cb_name != NULL)
+	func_unref(opt->jo_drain_cb.cb_name);
     if (opt->jo_exit_cb.cb_partial != NULL)
 	partial_unref(opt->jo_exit_cb.cb_partial);
     else if (opt->jo_exit_cb.cb_name != NULL)
@@ -5139,6 +5901,18 @@ get_job_options(typval_T *tv, jobopt_T *opt, int supported, int supported2)
 		    return FAIL;
 		}
 	    }
+	    else if (STRCMP(hi->hi_key, "drain_cb") == 0)
+	    {
+		if (!(supported2 & JO2_DRAIN_CB))
+		    break;
+		opt->jo_set2 |= JO2_DRAIN_CB;
+		opt->jo_drain_cb = get_callback(item);
+		if (opt->jo_drain_cb.cb_name == NULL)
+		{
+		    semsg(_(e_invargval), "drain_cb");
+		    return FAIL;
+		}
+	    }
 	    else if (STRCMP(hi->hi_key, "drop") == 0)
 	    {
 		int never = FALSE;
@@ -5455,6 +6229,18 @@ get_job_options(typval_T *tv, jobopt_T *opt, int supported, int supported2)
 		opt->jo_set |= JO_TIMEOUT;
 		opt->jo_timeout = tv_get_number(item);
 	    }
+	    else if (STRCMP(hi->hi_key, "highwater") == 0)
+	    {
+		if (!(supported2 & JO2_HIGHWATER))
+		    break;
+		opt->jo_set2 |= JO2_HIGHWATER;
+		opt->jo_highwater = tv_get_number(item);
+		if (opt->jo_highwater < 0)
+		{
+		    semsg(_(e_invargval), "highwater");
+		    return FAIL;
+		}
+	    }
 	    else if (STRCMP(hi->hi_key, "out_timeout") == 0)
 	    {
 		if (!(supported & JO_OUT_TIMEOUT))
@@ -6102,7 +6888,7 @@ job_start(
 	if (get_job_options(&argvars[1], &opt,
 		    JO_MODE_ALL + JO_CB_ALL + JO_TIMEOUT_ALL + JO_STOPONEXIT
 			 + JO_EXIT_CB + JO_OUT_IO + JO_BLOCK_WRITE,
-		     JO2_ENV + JO2_CWD) == FAIL)
+		     JO2_ENV + JO2_CWD + JO2_DRAIN_CB + JO2_HIGHWATER) == FAIL)
 	    goto theend;
     }
 
@@ -6670,7 +7456,8 @@ f_ch_setoptions(typval_T *argvars, typval_T *rettv UNUSED)
 	return;
     clear_job_options(&opt);
     if (get_job_options(&argvars[1], &opt,
-			    JO_CB_ALL + JO_TIMEOUT_ALL + JO_MODE_ALL, 0) == OK)
+			    JO_CB_ALL + JO_TIMEOUT_ALL + JO_MODE_ALL,
+			    JO2_DRAIN_CB + JO2_HIGHWATER) == OK)
 	channel_set_options(channel, &opt);
     free_job_options(&opt);
 }
@@ -458,7 +458,6 @@ f_deletebufline(typval_T *argvars, typval_T *rettv)
 {
     buf_T	*buf;
     linenr_T	first, last;
-    linenr_T	lnum;
     long	count;
     int		is_curbuf;
     buf_T	*curbuf_save = NULL;
@@ -512,8 +511,7 @@ f_deletebufline(typval_T *argvars, typval_T *rettv)
 	return;
     }
 
-    for (lnum = first; lnum <= last; ++lnum)
-	ml_delete_flags(first, ML_DEL_MESSAGE);
+    ml_delete_range(first, count, ML_DEL_MESSAGE);
 
     FOR_ALL_TAB_WINDOWS(tp, wp)
 	if (wp->w_buffer == buf)
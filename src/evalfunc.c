@@ -138,6 +138,7 @@ static void f_matchlist(typval_T *argvars, typval_T *rettv);
 static void f_matchstr(typval_T *argvars, typval_T *rettv);
 static void f_matchstrpos(typval_T *argvars, typval_T *rettv);
 static void f_max(typval_T *argvars, typval_T *rettv);
+static void f_memfileinfo(typval_T *argvars, typval_T *rettv);
 static void f_min(typval_T *argvars, typval_T *rettv);
 #ifdef FEAT_MZSCHEME
 static void f_mzeval(typval_T *argvars, typval_T *rettv);
@@ -169,6 +170,7 @@ static void f_rand(typval_T *argvars, typval_T *rettv);
 static void f_range(typval_T *argvars, typval_T *rettv);
 static void f_reg_executing(typval_T *argvars, typval_T *rettv);
 static void f_reg_recording(typval_T *argvars, typval_T *rettv);
+static void f_regcacheinfo(typval_T *argvars, typval_T *rettv);
 static void f_rename(typval_T *argvars, typval_T *rettv);
 static void f_repeat(typval_T *argvars, typval_T *rettv);
 #ifdef FEAT_FLOAT
@@ -733,6 +735,7 @@ static funcentry_T global_functions[] =
     {"matchstr",	2, 4, FEARG_1,	  ret_string,	f_matchstr},
     {"matchstrpos",	2, 4, FEARG_1,	  ret_list_any,	f_matchstrpos},
     {"max",		1, 1, FEARG_1,	  ret_any,	f_max},
+    {"memfileinfo",	0, 1, FEARG_1,	  ret_dict_number, f_memfileinfo},
     {"menu_info",	1, 2, FEARG_1,	  ret_dict_any,
 #ifdef FEAT_MENU
 	    f_menu_info
@@ -829,6 +832,7 @@ static funcentry_T global_functions[] =
     {"reduce",		2, 3, FEARG_1,	  ret_any,	f_reduce},
     {"reg_executing",	0, 0, 0,	  ret_string,	f_reg_executing},
     {"reg_recording",	0, 0, 0,	  ret_string,	f_reg_recording},
+    {"regcacheinfo",	0, 0, 0,	  ret_dict_number, f_regcacheinfo},
     {"reltime",		0, 2, FEARG_1,	  ret_list_any,	f_reltime},
     {"reltimefloat",	1, 1, FEARG_1,	  ret_float,	FLOAT_FUNC(f_reltimefloat)},
     {"reltimestr",	1, 1, FEARG_1,	  ret_string,	f_reltimestr},
@@ -1006,6 +1010,7 @@ static funcentry_T global_functions[] =
     {"test_garbagecollect_soon", 0, 0, 0, ret_void,	f_test_garbagecollect_soon},
     {"test_getvalue",	1, 1, FEARG_1,	  ret_number,	f_test_getvalue},
     {"test_ignore_error", 1, 1, FEARG_1,  ret_void,	f_test_ignore_error},
+    {"test_memcompress_now", 0, 0, 0,	  ret_void,	f_test_memcompress_now},
     {"test_null_blob",	0, 0, 0,	  ret_blob,	f_test_null_blob},
     {"test_null_channel", 0, 0, 0,	  ret_channel,	JOB_FUNC(f_test_null_channel)},
     {"test_null_dict",	0, 0, 0,	  ret_dict_any,	f_test_null_dict},
@@ -4030,6 +4035,13 @@ f_has(typval_T *argvars, typval_T *rettv)
 		1
 #else
 		0
+#endif
+		},
+	{"mmap",
+#ifdef FEAT_MMAP
+		1
+#else
+		0
 #endif
 		},
 	{"modify_fname", 1},
@@ -5805,6 +5817,26 @@ f_max(typval_T *argvars, typval_T *rettv)
     max_min(argvars, rettv, TRUE);
 }
 
+/*
+ * "memfileinfo([{buf}])" function
+ */
+    static void
+f_memfileinfo(typval_T *argvars, typval_T *rettv)
+{
+    buf_T	*buf;
+
+    if (rettv_dict_alloc(rettv) == FAIL)
+	return;
+    if (argvars[0].v_type == VAR_UNKNOWN)
+	mf_get_info(NULL, rettv->vval.v_dict);
+    else
+    {
+	buf = tv_get_buf(&argvars[0], FALSE);
+	if (buf != NULL && buf->b_ml.ml_mfp != NULL)
+	    mf_get_info(buf->b_ml.ml_mfp, rettv->vval.v_dict);
+    }
+}
+
 /*
  * "min()" function
  */
@@ -6416,6 +6448,16 @@ f_reg_recording(typval_T *argvars UNUSED, typval_T *rettv)
     return_register(reg_recording, rettv);
 }
 
+/*
+ * "regcacheinfo()" function
+ */
+    static void
+f_regcacheinfo(typval_T *argvars UNUSED, typval_T *rettv)
+{
+    if (rettv_dict_alloc(rettv) == OK)
+	regcache_get_info(rettv->vval.v_dict);
+}
+
 /*
  * "rename({from}, {to})" function
  */
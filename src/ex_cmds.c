@@ -632,8 +632,7 @@ ex_sort(exarg_T *eap)
 
     // delete the original lines if appending worked
     if (i == count)
-	for (i = 0; i < count; ++i)
-	    ml_delete(eap->line1);
+	ml_delete_range(eap->line1, count, 0);
     else
 	count = 0;
 
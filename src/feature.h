@@ -382,6 +382,16 @@
 # define FEAT_BYTEOFF
 #endif
 
+/*
+ * +mmap		'mmapsize' option: map large files in memory when
+ *			reading them, instead of copying every line into the
+ *			swap file.  Unix only.
+ */
+#if defined(FEAT_NORMAL) && defined(UNIX) && defined(HAVE_MMAP) \
+	&& defined(HAVE_SYS_MMAN_H)
+# define FEAT_MMAP
+#endif
+
 /*
  * +wildignore		'wildignore' and 'backupskip' options
  *			Needed for Unix to make "crontab -e" work.
@@ -25,14 +25,19 @@
 #define USE_MCH_ACCESS
 
 static char_u *next_fenc(char_u **pp, int *alloced);
+#ifdef FEAT_MMAP
+static int readfile_mmap(int fd, off_T *sizep, char_u **fencp, int *fenc_alloced, char_u **fenc_next, int fileformat, int try_unix, int try_dos, int try_mac);
+#endif
 #ifdef FEAT_EVAL
 static char_u *readfile_charconvert(char_u *fname, char_u *fenc, int *fdp);
 #endif
 #ifdef FEAT_CRYPT
 static char_u *check_for_cryptkey(char_u *cryptkey, char_u *ptr, long *sizep, off_T *filesizep, int newfile, char_u *fname, int *did_ask);
 #endif
+static int readfile_append_lines(linenr_T lnum, char_u **lines, colnr_T *lens, int *countp, int newfile);
 static linenr_T readfile_linenr(linenr_T linecnt, char_u *p, char_u *endp);
 static char_u *check_for_bom(char_u *p, long size, int *lenp, int flags);
+static char_u *skip_ascii(char_u *p, char_u *end);
 static char *e_auchangedbuf = N_("E812: Autocommands changed buffer or buffer name");
 
 #ifdef FEAT_EVAL
@@ -149,7 +154,14 @@ readfile(
     int		read_undo_file = FALSE;
 #endif
     int		split = 0;		// number of split lines
+#ifdef FEAT_MMAP
+    int		mapped = FALSE;		// file was mapped in memory
+#endif
 #define UNKNOWN	 0x0fffffff		// file size is unknown
+#define READ_LINES_BATCH 128		// nr of lines appended at once
+    char_u	*read_lines[READ_LINES_BATCH];  // lines to be appended
+    colnr_T	read_lens[READ_LINES_BATCH];
+    int		read_lines_count = 0;	// nr of lines in read_lines[]
     linenr_T	linecnt;
     int		error = FALSE;		// errors encountered
     int		ff_error = EOL_UNKNOWN; // file format with errors
@@ -839,6 +851,46 @@ readfile(
 	fenc = next_fenc(&fenc_next, &fenc_alloced);
     }
 
+#ifdef FEAT_MMAP
+    /*
+     * Map a large file in memory instead of reading it, see 'mmapsize'.
+     */
+    if (p_mms > 0 && newfile && wasempty && from == 0
+	    && lines_to_skip == 0 && lines_to_read == MAXLNUM
+	    && !read_stdin && !read_buffer && !read_fifo && !filtering
+	    && !recoverymode && !(flags & READ_DUMMY)
+# ifdef FEAT_PERSISTENT_UNDO
+	    && !curbuf->b_p_udf
+# endif
+	    )
+    {
+	if (eap != NULL && eap->force_ff != 0)
+	    fileformat = get_fileformat_force(curbuf, eap);
+	else if (curbuf->b_p_bin)
+	    fileformat = EOL_UNIX;
+	else if (*p_ffs == NUL)
+	    fileformat = get_fileformat(curbuf);
+	else
+	    fileformat = EOL_UNKNOWN;
+	if (readfile_mmap(fd, &filesize, &fenc, &fenc_alloced, &fenc_next,
+				fileformat, try_unix, try_dos, try_mac) == OK)
+	{
+	    mapped = TRUE;
+	    fileformat = EOL_UNIX;
+	    if (set_options)
+		set_fileformat(EOL_UNIX, OPT_LOCAL);
+	    lnum = curbuf->b_ml.ml_line_count;
+	    if (curbuf->b_ml.ml_mapped->mm_no_eol)
+	    {
+		if (set_options)
+		    curbuf->b_p_eol = FALSE;
+		read_no_eol_lnum = lnum;
+	    }
+	    goto failed;
+	}
+    }
+#endif
+
     /*
      * Jump back here to retry reading the file in different ways.
      * Reasons to retry:
@@ -874,8 +926,9 @@ retry:
 	    goto failed;
 	}
 	// Delete the previously read lines.
-	while (lnum > from)
-	    ml_delete(lnum--);
+	if (lnum > from)
+	    ml_delete_range(from + 1, lnum - from, 0);
+	lnum = from;
 	file_rewind = FALSE;
 	if (set_options)
 	{
@@ -1935,66 +1988,66 @@ retry:
 		// Reading UTF-8: Check if the bytes are valid UTF-8.
 		for (p = ptr; ; ++p)
 		{
-		    int	 todo = (int)((ptr + size) - p);
+		    int	 todo;
 		    int	 l;
 
+		    // ASCII is valid, skip over it quickly.
+		    p = skip_ascii(p, ptr + size);
+		    todo = (int)((ptr + size) - p);
 		    if (todo <= 0)
 			break;
-		    if (*p >= 0x80)
+		    // A length of 1 means it's an illegal byte.  Accept
+		    // an incomplete character at the end though, the next
+		    // read() will get the next bytes, we'll check it
+		    // then.
+		    l = utf_ptr2len_len(p, todo);
+		    if (l > todo && !incomplete_tail)
 		    {
-			// A length of 1 means it's an illegal byte.  Accept
-			// an incomplete character at the end though, the next
-			// read() will get the next bytes, we'll check it
-			// then.
-			l = utf_ptr2len_len(p, todo);
-			if (l > todo && !incomplete_tail)
+			// Avoid retrying with a different encoding when
+			// a truncated file is more likely, or attempting
+			// to read the rest of an incomplete sequence when
+			// we have already done so.
+			if (p > ptr || filesize > 0)
+			    incomplete_tail = TRUE;
+			// Incomplete byte sequence, move it to conv_rest[]
+			// and try to read the rest of it, unless we've
+			// already done so.
+			if (p > ptr)
 			{
-			    // Avoid retrying with a different encoding when
-			    // a truncated file is more likely, or attempting
-			    // to read the rest of an incomplete sequence when
-			    // we have already done so.
-			    if (p > ptr || filesize > 0)
-				incomplete_tail = TRUE;
-			    // Incomplete byte sequence, move it to conv_rest[]
-			    // and try to read the rest of it, unless we've
-			    // already done so.
-			    if (p > ptr)
-			    {
-				conv_restlen = todo;
-				mch_memmove(conv_rest, p, conv_restlen);
-				size -= conv_restlen;
-				break;
-			    }
+			    conv_restlen = todo;
+			    mch_memmove(conv_rest, p, conv_restlen);
+			    size -= conv_restlen;
+			    break;
 			}
-			if (l == 1 || l > todo)
-			{
-			    // Illegal byte.  If we can try another encoding
-			    // do that, unless at EOF where a truncated
-			    // file is more likely than a conversion error.
-			    if (can_retry && !incomplete_tail)
-				break;
+		    }
+		    if (l == 1 || l > todo)
+		    {
+			// Illegal byte.  If we can try another encoding
+			// do that, unless at EOF where a truncated
+			// file is more likely than a conversion error.
+			if (can_retry && !incomplete_tail)
+			    break;
 #ifdef USE_ICONV
-			    // When we did a conversion report an error.
-			    if (iconv_fd != (iconv_t)-1 && conv_error == 0)
-				conv_error = readfile_linenr(linecnt, ptr, p);
+			// When we did a conversion report an error.
+			if (iconv_fd != (iconv_t)-1 && conv_error == 0)
+			    conv_error = readfile_linenr(linecnt, ptr, p);
 #endif
-			    // Remember the first linenr with an illegal byte
-			    if (conv_error == 0 && illegal_byte == 0)
-				illegal_byte = readfile_linenr(linecnt, ptr, p);
+			// Remember the first linenr with an illegal byte
+			if (conv_error == 0 && illegal_byte == 0)
+			    illegal_byte = readfile_linenr(linecnt, ptr, p);
 
-			    // Drop, keep or replace the bad byte.
-			    if (bad_char_behavior == BAD_DROP)
-			    {
-				mch_memmove(p, p + 1, todo - 1);
-				--p;
-				--size;
-			    }
-			    else if (bad_char_behavior != BAD_KEEP)
-				*p = bad_char_behavior;
+			// Drop, keep or replace the bad byte.
+			if (bad_char_behavior == BAD_DROP)
+			{
+			    mch_memmove(p, p + 1, todo - 1);
+			    --p;
+			    --size;
 			}
-			else
-			    p += l - 1;
+			else if (bad_char_behavior != BAD_KEEP)
+			    *p = bad_char_behavior;
 		    }
+		    else
+			p += l - 1;
 		}
 		if (p < ptr + size && !incomplete_tail)
 		{
@@ -2107,7 +2160,12 @@ rewind_retry:
 		    {
 			*ptr = NUL;	    // end of line
 			len = (colnr_T) (ptr - line_start + 1);
-			if (ml_append(lnum, line_start, len, newfile) == FAIL)
+			read_lines[read_lines_count] = line_start;
+			read_lens[read_lines_count] = len;
+			if (++read_lines_count == READ_LINES_BATCH
+				&& readfile_append_lines(lnum + 1, read_lines,
+					read_lens, &read_lines_count, newfile)
+								      == FAIL)
 			{
 			    error = TRUE;
 			    break;
@@ -2132,13 +2190,33 @@ rewind_retry:
 	}
 	else
 	{
+	    char_u  *next_nul;	// next NUL in the buffer or its end
+	    char_u  *stop;
+
+	    next_nul = memchr(ptr, NUL, (size_t)size);
+	    if (next_nul == NULL)
+		next_nul = ptr + size;
 	    --ptr;
 	    while (++ptr, --size >= 0)
 	    {
 		if ((c = *ptr) != NUL && c != NL)  // catch most common case
+		{
+		    // Skip to just before the next NL or NUL, memchr() is much
+		    // faster than checking every byte here.
+		    stop = memchr(ptr, NL, (size_t)(next_nul - ptr));
+		    if (stop == NULL)
+			stop = next_nul;
+		    size -= (long)(stop - ptr) - 1;
+		    ptr = stop - 1;
 		    continue;
+		}
 		if (c == NUL)
+		{
 		    *ptr = NL;	// NULs are replaced by newlines!
+		    next_nul = memchr(ptr + 1, NUL, (size_t)size);
+		    if (next_nul == NULL)
+			next_nul = ptr + 1 + size;
+		}
 		else
 		{
 		    if (skip_count == 0)
@@ -2172,12 +2250,20 @@ rewind_retry:
 					set_fileformat(EOL_UNIX, OPT_LOCAL);
 				    file_rewind = TRUE;
 				    keep_fileformat = TRUE;
+				    // Lines not appended yet are dropped.
+				    lnum -= read_lines_count;
+				    read_lines_count = 0;
 				    goto retry;
 				}
 				ff_error = EOL_DOS;
 			    }
 			}
-			if (ml_append(lnum, line_start, len, newfile) == FAIL)
+			read_lines[read_lines_count] = line_start;
+			read_lens[read_lines_count] = len;
+			if (++read_lines_count == READ_LINES_BATCH
+				&& readfile_append_lines(lnum + 1, read_lines,
+					read_lens, &read_lines_count, newfile)
+								      == FAIL)
 			{
 			    error = TRUE;
 			    break;
@@ -2200,6 +2286,10 @@ rewind_retry:
 		}
 	    }
 	}
+	// Append the remaining lines before the buffer is reused.
+	if (read_lines_count > 0 && readfile_append_lines(lnum, read_lines,
+				read_lens, &read_lines_count, newfile) == FAIL)
+	    error = TRUE;
 	linerest = (long)(ptr - line_start);
 	ui_breakcheck();
     }
@@ -2299,6 +2389,12 @@ failed:
      */
     if (!recoverymode)
     {
+#ifdef FEAT_MMAP
+	// a mapped file does not have the line from the empty buffer
+	if (mapped)
+	    --linecnt;
+	else
+#endif
 	// need to delete the last line, which comes from the empty buffer
 	if (newfile && wasempty && !(curbuf->b_ml.ml_flags & ML_EMPTY))
 	{
@@ -2752,6 +2848,100 @@ next_fenc(char_u **pp, int *alloced)
     return r;
 }
 
+/*
+ * Append the "*countp" lines collected by readfile() in "lines[]" and
+ * "lens[]" to the current buffer, the last one becomes line "lnum".
+ * Resets "*countp" to zero.
+ */
+    static int
+readfile_append_lines(
+    linenr_T	lnum,
+    char_u	**lines,
+    colnr_T	*lens,
+    int		*countp,
+    int		newfile)
+{
+    int		count = *countp;
+
+    *countp = 0;
+    return ml_append_lines(lnum - count, lines, lens, (long)count, newfile);
+}
+
+#ifdef FEAT_MMAP
+/*
+ * Map file "fd" in memory instead of reading it, if it is large enough, see
+ * 'mmapsize'.  Only when no conversion is needed and the lines end in a NL.
+ * When "*fencp" is "ucs-bom" and there is no BOM the next encoding from
+ * "*fenc_next" is used, like when reading the file.
+ * Returns OK when mapped and sets "*sizep" to the file size.
+ */
+    static int
+readfile_mmap(
+    int		fd,
+    off_T	*sizep,
+    char_u	**fencp,
+    int		*fenc_alloced,
+    char_u	**fenc_next,
+    int		fileformat,
+    int		try_unix,
+    int		try_dos,
+    int		try_mac)
+{
+    stat_T	st;
+    char_u	buf[8192];
+    long	len;
+    char_u	*p;
+    int		bom_len;
+
+    if (mch_fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)
+				      || (off_T)st.st_size < (off_T)p_mms * 1024)
+	return FAIL;
+
+    // Check the start of the file for encryption, a BOM and the line break.
+    len = read_eintr(fd, buf, sizeof(buf));
+    vim_lseek(fd, (off_T)0L, SEEK_SET);
+    if (len < 4)
+	return FAIL;
+# ifdef FEAT_CRYPT
+    if (crypt_method_nr_from_magic((char *)buf, len) >= 0)
+	return FAIL;
+# endif
+    if (check_for_bom(buf, len, &bom_len, FIO_ALL) != NULL)
+	return FAIL;
+
+    if (fileformat == EOL_UNKNOWN)
+    {
+	p = memchr(buf, NL, len);
+	if (p == NULL || !try_unix || (try_dos && p > buf && p[-1] == CAR)
+		|| (try_mac && memchr(buf, CAR, len) != NULL))
+	    return FAIL;
+    }
+    else if (fileformat != EOL_UNIX)
+	return FAIL;
+
+    if (STRCMP(*fencp, ENC_UCSBOM) == 0)
+    {
+	// No BOM, skip "ucs-bom".
+	if (*fenc_alloced)
+	    vim_free(*fencp);
+	if (*fenc_next != NULL)
+	    *fencp = next_fenc(fenc_next, fenc_alloced);
+	else
+	{
+	    *fencp = (char_u *)"";
+	    *fenc_alloced = FALSE;
+	}
+    }
+    if (need_conversion(*fencp))
+	return FAIL;
+
+    if (ml_open_mapped(curbuf, fd, (off_T)st.st_size) == FAIL)
+	return FAIL;
+    *sizep = (off_T)st.st_size;
+    return OK;
+}
+#endif
+
 #ifdef FEAT_EVAL
 /*
  * Convert a file with the 'charconvert' expression.
@@ -3250,6 +3440,30 @@ check_for_bom(
     return (char_u *)name;
 }
 
+// A long_u with the high bit set in every byte.
+#define ASCII_HIGH_BITS	(((long_u)-1 / 0xff) * 0x80)
+
+/*
+ * Return a pointer to the first byte from "p" that is not ASCII, or "end"
+ * when there is none.  Checks a few words at a time, text is mostly ASCII.
+ */
+    static char_u *
+skip_ascii(char_u *p, char_u *end)
+{
+    long_u	w[4];
+
+    while (end - p >= (long)sizeof(w))
+    {
+	mch_memmove(w, p, sizeof(w));	// "p" may not be aligned
+	if (((w[0] | w[1] | w[2] | w[3]) & ASCII_HIGH_BITS) != 0)
+	    break;
+	p += sizeof(w);
+    }
+    while (p < end && *p < 0x80)
+	++p;
+    return p;
+}
+
 /*
  * Try to find a shortname by comparing the fullname with the current
  * directory.
@@ -3955,14 +4169,11 @@ move_lines(buf_T *frombuf, buf_T *tobuf)
     if (retval != FAIL)
     {
 	curbuf = frombuf;
-	for (lnum = curbuf->b_ml.ml_line_count; lnum > 0; --lnum)
-	    if (ml_delete(lnum) == FAIL)
-	    {
-		// Oops!  We could try putting back the saved lines, but that
-		// might fail again...
-		retval = FAIL;
-		break;
-	    }
+	if (ml_delete_range((linenr_T)1, (long)curbuf->b_ml.ml_line_count, 0)
+								      == FAIL)
+	    // Oops!  We could try putting back the saved lines, but that
+	    // might fail again...
+	    retval = FAIL;
     }
 
     curbuf = tbuf;
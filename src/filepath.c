@@ -3652,6 +3652,117 @@ has_special_wildchar(char_u *p)
 }
 #endif
 
+#ifdef UNIX
+/*
+ * Find the first "{a,b}" group in "p" that expand_braces() expands: one with
+ * a comma outside of nested groups.  "${name}" is not a group.
+ * Sets "*endp" to the matching '}'.
+ * Returns a pointer to the '{', NULL if there is no such group.
+ */
+    static char_u *
+find_brace_group(char_u *p, char_u **endp)
+{
+    char_u	*s;
+    char_u	*e;
+    int		depth;
+    int		has_comma;
+
+    for (s = p; *s != NUL; MB_PTR_ADV(s))
+    {
+	if (*s == '\\' && s[1] != NUL)
+	    ++s;
+	else if (*s == '{' && (s == p || s[-1] != '$'))
+	{
+	    depth = 0;
+	    has_comma = FALSE;
+	    for (e = s + 1; *e != NUL; MB_PTR_ADV(e))
+	    {
+		if (*e == '\\' && e[1] != NUL)
+		    ++e;
+		else if (*e == '{')
+		    ++depth;
+		else if (*e == '}')
+		{
+		    if (depth == 0)
+			break;
+		    --depth;
+		}
+		else if (*e == ',' && depth == 0)
+		    has_comma = TRUE;
+	    }
+	    if (*e == NUL)
+		return NULL;	// no matching '}'
+	    if (has_comma)
+	    {
+		*endp = e;
+		return s;
+	    }
+	    // Without a comma "{a}" is not expanded, but "{a,b}" inside it is.
+	}
+    }
+    return NULL;
+}
+
+/*
+ * Expand the "{a,b}" groups in "pat", like the shell does: "x{a,b}y" becomes
+ * "xay" and "xby", in that order.  Groups may be nested.  The resulting
+ * patterns are added to "gap" in allocated memory.
+ * Returns FAIL when out of memory.
+ */
+    static int
+expand_braces(garray_T *gap, char_u *pat)
+{
+    char_u	*start;
+    char_u	*end;
+    char_u	*alt;
+    char_u	*p;
+    char_u	*s;
+    int		depth = 0;
+    int		len;
+    int		retval;
+
+    start = find_brace_group(pat, &end);
+    if (start == NULL)
+    {
+	if (ga_grow(gap, 1) == FAIL || (s = vim_strsave(pat)) == NULL)
+	    return FAIL;
+	((char_u **)gap->ga_data)[gap->ga_len++] = s;
+	return OK;
+    }
+
+    alt = start + 1;
+    for (p = alt; ; MB_PTR_ADV(p))
+    {
+	if (p == end || (*p == ',' && depth == 0))
+	{
+	    // Concatenate the text before the group, the alternative and the
+	    // text after the group, which may contain more groups.
+	    len = (int)(start - pat);
+	    s = alloc(len + (p - alt) + STRLEN(end + 1) + 1);
+	    if (s == NULL)
+		return FAIL;
+	    mch_memmove(s, pat, len);
+	    mch_memmove(s + len, alt, p - alt);
+	    STRCPY(s + len + (p - alt), end + 1);
+	    retval = expand_braces(gap, s);
+	    vim_free(s);
+	    if (retval == FAIL)
+		return FAIL;
+	    if (p == end)
+		break;
+	    alt = p + 1;
+	}
+	else if (*p == '\\' && p[1] != NUL)
+	    ++p;
+	else if (*p == '{')
+	    ++depth;
+	else if (*p == '}')
+	    --depth;
+    }
+    return OK;
+}
+#endif
+
 /*
  * Generic wildcard expansion code.
  *
@@ -3662,6 +3773,8 @@ has_special_wildchar(char_u *p)
  * set, and "file" may contain an error message.
  * Return OK when some files found.  "num_file" is set to the number of
  * matches, "file" to the array of matches.  Call FreeWild() later.
+ * On Unix the shell is only used for what Vim cannot expand itself, such as
+ * `cmd`.
  */
     int
 gen_expand_wildcards(
@@ -3680,6 +3793,9 @@ gen_expand_wildcards(
 #if defined(FEAT_SEARCHPATH)
     int			did_expand_in_path = FALSE;
 #endif
+#ifdef UNIX
+    garray_T		ga_brace;
+#endif
 
     /*
      * expand_env() is called to expand things like "~user".  If this fails,
@@ -3712,6 +3828,28 @@ gen_expand_wildcards(
     }
 #endif
 
+#ifdef UNIX
+    /*
+     * Expand "{a,b}" here, instead of starting a shell for it.  The
+     * resulting patterns are expanded one by one below.
+     */
+    ga_init2(&ga_brace, (int)sizeof(char_u *), 10);
+    for (i = 0; i < num_pat; ++i)
+	if (find_brace_group(pat[i], &p) != NULL)
+	    break;
+    if (i < num_pat)
+    {
+	for (i = 0; i < num_pat; ++i)
+	    if (expand_braces(&ga_brace, pat[i]) == FAIL)
+	    {
+		ga_clear_strings(&ga_brace);
+		return FAIL;
+	    }
+	num_pat = ga_brace.ga_len;
+	pat = (char_u **)ga_brace.ga_data;
+    }
+#endif
+
     recursive = TRUE;
 
     /*
@@ -3754,6 +3892,7 @@ gen_expand_wildcards(
 		    ga_clear_strings(&ga);
 		    i = mch_expand_wildcards(num_pat, pat, num_file, file,
 							 flags|EW_KEEPDOLLAR);
+		    ga_clear_strings(&ga_brace);
 		    recursive = FALSE;
 		    return i;
 		}
@@ -3812,6 +3951,9 @@ gen_expand_wildcards(
 	if (p != pat[i])
 	    vim_free(p);
     }
+#ifdef UNIX
+    ga_clear_strings(&ga_brace);
+#endif
 
     // When returning FAIL the array must be freed here.
     if (retval == FAIL)
@@ -1566,6 +1566,7 @@ before_blocking(void)
  *
  * All the changed memfiles are synced if c == 0 or when the number of typed
  * characters reaches 'updatecount' and 'updatecount' is non-zero.
+ * When c == 0 the blocks of hidden buffers may also be compressed.
  */
     static void
 updatescript(int c)
@@ -1577,6 +1578,8 @@ updatescript(int c)
     if (c == 0 || (p_uc > 0 && ++count >= p_uc))
     {
 	ml_sync_all(c == 0, TRUE);
+	if (c == 0)
+	    mf_compress_hidden(FALSE);
 	count = 0;
     }
 }
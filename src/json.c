@@ -61,30 +61,45 @@ json_encode(typval_T *val, int options)
 /*
  * Encode ["nr", "val"] into a JSON format string in allocated memory.
  * "options" can contain JSON_JS, JSON_NO_NONE and JSON_NL.
+ * When "lenp" is not NULL the length of the result is stored there.
  * Returns NULL when out of memory.
  */
     char_u *
-json_encode_nr_expr(int nr, typval_T *val, int options)
+json_encode_nr_expr(int nr, typval_T *val, int options, int *lenp)
 {
-    typval_T	listtv;
-    typval_T	nrtv;
     garray_T	ga;
+    char_u	numbuf[NUMBUFLEN];
 
-    nrtv.v_type = VAR_NUMBER;
-    nrtv.vval.v_number = nr;
-    if (rettv_list_alloc(&listtv) == FAIL)
-	return NULL;
-    if (list_append_tv(listtv.vval.v_list, &nrtv) == FAIL
-	    || list_append_tv(listtv.vval.v_list, val) == FAIL)
+    // Write the list directly instead of encoding a list with the two
+    // items, that would copy "val" when it is a string.  The result is the
+    // same.
+    // The result is not pre-sized from the list and dict lengths: that
+    // needs another pass over all items and strings, while growing by
+    // half each time only reallocates a few times, and for large sizes
+    // realloc() can usually move the pages without copying.
+    ga_init2(&ga, 1, 4000);
+    vim_snprintf((char *)numbuf, NUMBUFLEN, "[%d,", nr);
+    ga_concat(&ga, numbuf);
+    if (json_encode_item(&ga, val, get_copyID(), options & JSON_JS) == FAIL)
     {
-	list_unref(listtv.vval.v_list);
-	return NULL;
+	ga_clear(&ga);
+	ga.ga_data = vim_strsave((char_u *)"");
+	if (ga.ga_data == NULL)
+	    return NULL;
+	ga.ga_len = 0;
     }
-
-    ga_init2(&ga, 1, 4000);
-    if (json_encode_gap(&ga, &listtv, options) == OK && (options & JSON_NL))
-	ga_append(&ga, '\n');
-    list_unref(listtv.vval.v_list);
+    else
+    {
+	if ((options & JSON_JS) && val->v_type == VAR_SPECIAL
+					  && val->vval.v_number == VVAL_NONE)
+	    // add an extra comma if the last item is v:none
+	    ga_append(&ga, ',');
+	ga_append(&ga, ']');
+	if (options & JSON_NL)
+	    ga_append(&ga, '\n');
+    }
+    if (lenp != NULL)
+	*lenp = ga.ga_len;
     ga_append(&ga, NUL);
     return ga.ga_data;
 }
@@ -115,10 +130,30 @@ write_string(garray_T *gap, char_u *str)
 	    convert_setup(&conv, NULL, NULL);
 	}
 #endif
+	// Most text is copied as-is, make room for it at once.
+	if (ga_grow(gap, (int)STRLEN(res) + 2) == FAIL)
+	    return;
 	ga_append(gap, '"');
 	while (*res != NUL)
 	{
-	    int c;
+	    int	    c;
+	    char_u  *s;
+
+	    // Copy a run of ASCII characters that don't need escaping at
+	    // once.
+	    for (s = res; *res >= 0x20 && *res < 0x80 && *res != '"'
+							 && *res != '\\'; ++res)
+		;
+	    if (res > s)
+	    {
+		if (ga_grow(gap, (int)(res - s)) == FAIL)
+		    break;
+		mch_memmove((char_u *)gap->ga_data + gap->ga_len, s,
+							     (size_t)(res - s));
+		gap->ga_len += (int)(res - s);
+		continue;
+	    }
+
 	    // always use utf-8 encoding, ignore 'encoding'
 	    c = utf_ptr2char(res);
 
@@ -410,15 +445,45 @@ json_decode_string(js_read_T *reader, typval_T *res, int quote)
     garray_T    ga;
     int		len;
     char_u	*p;
+    char_u	*s;
     int		c;
     varnumber_T	nr;
 
+    p = reader->js_buf + reader->js_used + 1; // skip over " or '
     if (res != NULL)
+    {
+	// Find the end of the string, so that the result can be allocated
+	// once: escapes only make the text shorter.  When the end was not
+	// read yet the array grows as needed.
+	for (s = p; *s != quote && *s != NUL; ++s)
+	    if (*s == '\\' && s[1] != NUL)
+		++s;
 	ga_init2(&ga, 1, 200);
+	if (ga_grow(&ga, (int)(s - p) + 1) == FAIL)
+	    return FAIL;
+    }
 
-    p = reader->js_buf + reader->js_used + 1; // skip over " or '
     while (*p != quote)
     {
+	// Copy a run of ASCII characters at once, this is the common case.
+	for (s = p; *p != quote && *p != '\\' && *p != NUL && *p < 0x80; ++p)
+	    ;
+	if (p > s)
+	{
+	    if (res != NULL)
+	    {
+		len = (int)(p - s);
+		if (ga_grow(&ga, len) == FAIL)
+		{
+		    ga_clear(&ga);
+		    return FAIL;
+		}
+		mch_memmove((char *)ga.ga_data + ga.ga_len, s, (size_t)len);
+		ga.ga_len += len;
+	    }
+	    continue;
+	}
+
 	// The JSON is always expected to be utf-8, thus use utf functions
 	// here. The string is converted below if needed.
 	if (*p == NUL || p[1] == NUL || utf_ptr2len(p) < utf_byte2len(*p))
@@ -584,39 +649,103 @@ typedef struct {
 } json_dec_item_T;
 
 /*
- * Decode one item and put it in "res".  If "res" is NULL only advance.
+ * State of decoding an item.  Kept while decoding a channel message is
+ * interrupted, see json_decode_resume().
+ */
+struct js_decode_S
+{
+    garray_T	jd_stack;	// json_dec_item_T entries
+    typval_T	*jd_res;	// where the result goes or NULL
+    typval_T	*jd_cur_item;	// where the current item goes or NULL
+    typval_T	jd_item;	// current array or object item
+    typval_T	jd_tv;		// result for json_decode_resume()
+    int		jd_used;	// "js_used" of the reader
+    int		jd_interrupted;	// decoding to be continued
+    char_u	jd_key_buf[NUMBUFLEN];	// used for a key that is a number
+};
+
+/*
+ * Start decoding an item into "res" with state "st".
+ */
+    static void
+json_decode_init(js_decode_T *st, typval_T *res)
+{
+    CLEAR_POINTER(st);
+    ga_init2(&st->jd_stack, sizeof(json_dec_item_T), 100);
+    st->jd_res = res;
+    st->jd_cur_item = res;
+    init_tv(&st->jd_item);
+    if (res != NULL)
+	init_tv(res);
+}
+
+/*
+ * Free what "st" holds, after decoding finished or failed.
+ */
+    static void
+json_decode_clear(js_decode_T *st)
+{
+    garray_T	*stack = &st->jd_stack;
+    int		i;
+
+    for (i = 0; i < stack->ga_len; i++)
+	clear_tv(&(((json_dec_item_T *)stack->ga_data) + i)->jd_key_tv);
+    ga_clear(stack);
+}
+
+/*
+ * Decode one item, continuing with the state in "st".  The item is put where
+ * json_decode_init() was told, if that was NULL only advance.
  * Must already have skipped white space.
+ * When "msec" is more than zero and decoding takes longer than that, stop
+ * at the next array or object item and set "st->jd_interrupted".  Calling
+ * this again with the same "st" and "reader" continues.
  *
  * Return FAIL for a decoding error (and give an error).
- * Return MAYBE for an incomplete message.
+ * Return MAYBE for an incomplete message or when interrupted.
  */
     static int
-json_decode_item(js_read_T *reader, typval_T *res, int options)
+json_decode_run(js_read_T *reader, js_decode_T *st, int options, long msec)
 {
     char_u	*p;
-    int		i;
     int		len;
     int		retval;
-    garray_T	stack;
-    typval_T	item;
-    typval_T	*cur_item;
+    garray_T	*stack = &st->jd_stack;
+    typval_T	*res = st->jd_res;
+    typval_T	*cur_item = st->jd_cur_item;
     json_dec_item_T *top_item;
-    char_u	key_buf[NUMBUFLEN];
-
-    ga_init2(&stack, sizeof(json_dec_item_T), 100);
-    cur_item = res;
-    init_tv(&item);
-    if (res != NULL)
-    init_tv(res);
+    hashtab_T	*key_ht = NULL;
+    hash_T	key_hash = 0;
+    hashitem_T	*key_hi = NULL;
+#ifdef ELAPSED_FUNC
+    elapsed_T	start_tv;
+    int		count = 0;
+
+    if (msec > 0)
+	ELAPSED_INIT(start_tv);
+#endif
 
+    st->jd_interrupted = FALSE;
     fill_numbuflen(reader);
     p = reader->js_buf + reader->js_used;
     for (;;)
     {
 	top_item = NULL;
-	if (stack.ga_len > 0)
+	if (stack->ga_len > 0)
 	{
-	    top_item = ((json_dec_item_T *)stack.ga_data) + stack.ga_len - 1;
+#ifdef ELAPSED_FUNC
+	    // Between items of an array or object decoding can be continued
+	    // later.  Checking the time is relatively slow, don't do it for
+	    // every item.
+	    if (msec > 0 && (++count & 0xff) == 0
+					    && ELAPSED_FUNC(start_tv) >= msec)
+	    {
+		st->jd_cur_item = cur_item;
+		st->jd_interrupted = TRUE;
+		return MAYBE;
+	    }
+#endif
+	    top_item = ((json_dec_item_T *)stack->ga_data) + stack->ga_len - 1;
 	    json_skip_white(reader);
 	    p = reader->js_buf + reader->js_used;
 	    if (*p == NUL)
@@ -631,8 +760,8 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 		if (*p == (top_item->jd_type == JSON_ARRAY ? ']' : '}'))
 		{
 		    ++reader->js_used; // consume the ']' or '}'
-		    --stack.ga_len;
-		    if (stack.ga_len == 0)
+		    --stack->ga_len;
+		    if (stack->ga_len == 0)
 		    {
 			retval = OK;
 			goto theend;
@@ -675,7 +804,7 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 			retval = FAIL;
 			break;
 		    }
-		    if (ga_grow(&stack, 1) == FAIL)
+		    if (ga_grow(stack, 1) == FAIL)
 		    {
 			retval = FAIL;
 			break;
@@ -689,14 +818,14 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 		    }
 
 		    ++reader->js_used; // consume the '['
-		    top_item = ((json_dec_item_T *)stack.ga_data)
-								+ stack.ga_len;
+		    top_item = ((json_dec_item_T *)stack->ga_data)
+								+ stack->ga_len;
 		    top_item->jd_type = JSON_ARRAY;
-		    ++stack.ga_len;
+		    ++stack->ga_len;
 		    if (cur_item != NULL)
 		    {
 			top_item->jd_tv = *cur_item;
-			cur_item = &item;
+			cur_item = &st->jd_item;
 		    }
 		    continue;
 
@@ -706,7 +835,7 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 			retval = FAIL;
 			break;
 		    }
-		    if (ga_grow(&stack, 1) == FAIL)
+		    if (ga_grow(stack, 1) == FAIL)
 		    {
 			retval = FAIL;
 			break;
@@ -720,10 +849,10 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 		    }
 
 		    ++reader->js_used; // consume the '{'
-		    top_item = ((json_dec_item_T *)stack.ga_data)
-								+ stack.ga_len;
+		    top_item = ((json_dec_item_T *)stack->ga_data)
+								+ stack->ga_len;
 		    top_item->jd_type = JSON_OBJECT_KEY;
-		    ++stack.ga_len;
+		    ++stack->ga_len;
 		    if (cur_item != NULL)
 		    {
 			top_item->jd_tv = *cur_item;
@@ -802,11 +931,24 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 			else
 #endif
 			{
-			    varnumber_T nr;
+			    varnumber_T nr = 0;
 
-			    vim_str2nr(reader->js_buf + reader->js_used,
-				    NULL, &len, 0, // what
-				    &nr, NULL, 0, TRUE);
+			    if (sp - p < (sizeof(varnumber_T) > 4 ? 19 : 10))
+			    {
+				char_u *dp;
+
+				// Too few digits to overflow, this is the
+				// common case.
+				for (dp = *p == '-' ? p + 1 : p; dp < sp; ++dp)
+				    nr = nr * 10 + (*dp - '0');
+				if (*p == '-')
+				    nr = -nr;
+				len = (int)(sp - p);
+			    }
+			    else
+				vim_str2nr(reader->js_buf + reader->js_used,
+					NULL, &len, 0, // what
+					&nr, NULL, 0, TRUE);
 			    if (len == 0)
 			    {
 				semsg(_(e_json_error), p);
@@ -914,13 +1056,14 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 	    // toplevel.
 	    if (retval == FAIL)
 		break;
-	    if (retval == MAYBE || stack.ga_len == 0)
+	    if (retval == MAYBE || stack->ga_len == 0)
 		goto theend;
 
 	    if (top_item != NULL && top_item->jd_type == JSON_OBJECT_KEY
 		    && cur_item != NULL)
 	    {
-		top_item->jd_key = tv_get_string_buf_chk(cur_item, key_buf);
+		top_item->jd_key = tv_get_string_buf_chk(cur_item,
+							       st->jd_key_buf);
 		if (top_item->jd_key == NULL)
 		{
 		    emsg(_(e_invarg));
@@ -931,7 +1074,7 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 	}
 
 item_end:
-	top_item = ((json_dec_item_T *)stack.ga_data) + stack.ga_len - 1;
+	top_item = ((json_dec_item_T *)stack->ga_data) + stack->ga_len - 1;
 	switch (top_item->jd_type)
 	{
 	    case JSON_ARRAY:
@@ -949,7 +1092,7 @@ item_end:
 		    list_append(top_item->jd_tv.vval.v_list, li);
 		}
 		if (cur_item != NULL)
-		    cur_item = &item;
+		    cur_item = &st->jd_item;
 
 		json_skip_white(reader);
 		p = reader->js_buf + reader->js_used;
@@ -988,13 +1131,19 @@ item_end:
 		json_skip_white(reader);
 		top_item->jd_type = JSON_OBJECT;
 		if (cur_item != NULL)
-		    cur_item = &item;
+		    cur_item = &st->jd_item;
 		break;
 
 	    case JSON_OBJECT:
-		if (cur_item != NULL
-			&& dict_find(top_item->jd_tv.vval.v_dict,
-						 top_item->jd_key, -1) != NULL)
+		if (cur_item != NULL)
+		{
+		    // Look up the key once, to check for a duplicate and to
+		    // find where to add it.
+		    key_ht = &top_item->jd_tv.vval.v_dict->dv_hashtab;
+		    key_hash = hash_hash(top_item->jd_key);
+		    key_hi = hash_lookup(key_ht, top_item->jd_key, key_hash);
+		}
+		if (cur_item != NULL && !HASHITEM_EMPTY(key_hi))
 		{
 		    semsg(_("E938: Duplicate key in JSON: \"%s\""),
 							     top_item->jd_key);
@@ -1016,7 +1165,8 @@ item_end:
 		    }
 		    di->di_tv = *cur_item;
 		    di->di_tv.v_lock = 0;
-		    if (dict_add(top_item->jd_tv.vval.v_dict, di) == FAIL)
+		    if (hash_add_item(key_ht, key_hi, di->di_key, key_hash)
+								       == FAIL)
 		    {
 			dictitem_free(di);
 			retval = FAIL;
@@ -1056,13 +1206,28 @@ item_end:
     semsg(_(e_json_error), p);
 
 theend:
-    for (i = 0; i < stack.ga_len; i++)
-	clear_tv(&(((json_dec_item_T *)stack.ga_data) + i)->jd_key_tv);
-    ga_clear(&stack);
-
     return retval;
 }
 
+/*
+ * Decode one item and put it in "res".  If "res" is NULL only advance.
+ * Must already have skipped white space.
+ *
+ * Return FAIL for a decoding error (and give an error).
+ * Return MAYBE for an incomplete message.
+ */
+    static int
+json_decode_item(js_read_T *reader, typval_T *res, int options)
+{
+    js_decode_T	st;
+    int		ret;
+
+    json_decode_init(&st, res);
+    ret = json_decode_run(reader, &st, options, 0L);
+    json_decode_clear(&st);
+    return ret;
+}
+
 /*
  * Decode the JSON from "reader" and store the result in "res".
  * "options" can be JSON_JS or zero;
@@ -1096,6 +1261,8 @@ json_decode_all(js_read_T *reader, typval_T *res, int options)
 /*
  * Decode the JSON from "reader" and store the result in "res".
  * "options" can be JSON_JS or zero;
+ * When "reader->js_end" is not NULL it must point to the NUL at the end of the
+ * text, this avoids a strlen() over text that may hold many more messages.
  * Return FAIL for a decoding error.
  * Return MAYBE for an incomplete message.
  * Consumes the message anyway.
@@ -1106,13 +1273,180 @@ json_decode(js_read_T *reader, typval_T *res, int options)
     int ret;
 
     // We find the end once, to avoid calling strlen() many times.
-    reader->js_end = reader->js_buf + STRLEN(reader->js_buf);
+    if (reader->js_end == NULL)
+	reader->js_end = reader->js_buf + STRLEN(reader->js_buf);
     json_skip_white(reader);
     ret = json_decode_item(reader, res, options);
     json_skip_white(reader);
 
     return ret;
 }
+
+/*
+ * Like json_decode(), but stop when it takes more than "msec" msec, so that
+ * a large message does not make Vim unresponsive.
+ * When "*stp" is NULL decoding starts at the start of "reader->js_buf".
+ * When decoding is interrupted MAYBE is returned and the state is put in
+ * "*stp".  Call again with the same text in "reader" to continue.  When done
+ * "*stp" is NULL and "reader->js_used" is after the message.
+ */
+    int
+json_decode_resume(
+	js_read_T   *reader,
+	js_decode_T **stp,
+	typval_T    *res,
+	int	    options,
+	long	    msec)
+{
+    js_decode_T	*st = *stp;
+    int		ret;
+
+    if (reader->js_end == NULL)
+	reader->js_end = reader->js_buf + STRLEN(reader->js_buf);
+    if (st == NULL)
+    {
+	st = ALLOC_ONE(js_decode_T);
+	if (st == NULL)
+	    return FAIL;
+	json_decode_init(st, &st->jd_tv);
+	json_skip_white(reader);
+    }
+    else
+	reader->js_used = st->jd_used;
+
+    ret = json_decode_run(reader, st, options, msec);
+    if (st->jd_interrupted)
+    {
+	st->jd_used = reader->js_used;
+	*stp = st;
+	return MAYBE;
+    }
+
+    json_skip_white(reader);
+    if (ret == OK)
+	*res = st->jd_tv;
+    else
+	clear_tv(&st->jd_tv);
+    json_decode_clear(st);
+    vim_free(st);
+    *stp = NULL;
+    return ret;
+}
+
+/*
+ * Free the state of an interrupted json_decode_resume().
+ */
+    void
+json_decode_free(js_decode_T *st)
+{
+    int		i;
+
+    if (st == NULL)
+	return;
+    // The arrays and objects on the stack have not been added to the one
+    // they are in yet, except the outer one, which is "jd_tv".
+    for (i = 1; i < st->jd_stack.ga_len; i++)
+	clear_tv(&(((json_dec_item_T *)st->jd_stack.ga_data) + i)->jd_tv);
+    clear_tv(&st->jd_tv);
+    json_decode_clear(st);
+    vim_free(st);
+}
+
+/*
+ * Mark the lists and dicts of an interrupted json_decode_resume() with
+ * "copyID", they are not referenced from anywhere else.
+ */
+    int
+json_decode_set_ref(js_decode_T *st, int copyID)
+{
+    int		abort = FALSE;
+    int		i;
+
+    if (st == NULL)
+	return FALSE;
+    for (i = 0; !abort && i < st->jd_stack.ga_len; i++)
+	abort = set_ref_in_item(
+		    &(((json_dec_item_T *)st->jd_stack.ga_data) + i)->jd_tv,
+							   copyID, NULL, NULL);
+    return abort;
+}
+
+/*
+ * Scan "buf[len]" for the end of a JSON message, continuing where the
+ * previous call with the same "scan" stopped.  Only brackets and strings are
+ * recognized, the items are not decoded.  This makes it cheap to find out
+ * if a message that arrives in many pieces is complete, each byte is looked
+ * at only once.
+ * "options" can be JSON_JS or zero.
+ * "scan" must be cleared before scanning a new message, and when "buf" no
+ * longer starts with the same text.
+ * Return OK when the message is complete, "scan->js_scanned" is then the
+ * offset just after it.
+ * Return MAYBE when the message is incomplete.
+ * Return FAIL when the message does not start with an object or array, the
+ * end can then only be found by decoding it.
+ */
+    int
+json_scan_message(js_scan_T *scan, char_u *buf, long_u len, int options)
+{
+    char_u  *p = buf + scan->js_scanned;
+    char_u  *end = buf + len;
+
+    while (p < end)
+    {
+	if (scan->js_quote != NUL)
+	{
+	    // Inside a string: skip over anything but the quote and a
+	    // backslash.
+	    if (scan->js_escape)
+		scan->js_escape = FALSE;
+	    else if (*p == '\\')
+		scan->js_escape = TRUE;
+	    else if (*p == scan->js_quote)
+		scan->js_quote = NUL;
+	    ++p;
+	    continue;
+	}
+
+	switch (*p)
+	{
+	    case '[':
+	    case '{':
+		++scan->js_depth;
+		break;
+
+	    case ']':
+	    case '}':
+		if (scan->js_depth == 0)
+		    return FAIL;
+		if (--scan->js_depth == 0)
+		{
+		    scan->js_scanned = (long_u)(p + 1 - buf);
+		    return OK;
+		}
+		break;
+
+	    case '"':
+		scan->js_quote = '"';
+		break;
+
+	    case '\'':
+		if (options & JSON_JS)
+		    scan->js_quote = '\'';
+		break;
+
+	    default:
+		// Only white space may come before the first bracket.
+		if (scan->js_depth == 0 && (*p == NUL || *p > ' '))
+		    return FAIL;
+		break;
+	}
+	++p;
+    }
+
+    scan->js_scanned = len;
+    return MAYBE;
+}
 #endif
 
 /*
@@ -9,6 +9,8 @@
 
 /*
  * json_test.c: Unittests for json.c
+ *
+ * Run "./json_test bench" to measure decoding speed.
  */
 
 #undef NDEBUG
@@ -189,15 +191,134 @@ test_fill_called_on_string(void)
     reader.js_cookie =	      " \"foobar\"  ";
     assert(json_decode_string(&reader, NULL, '"') == OK);
 }
+
+# if defined(FEAT_JOB_CHANNEL)
+/*
+ * Test json_scan_message() with a message that arrives in pieces.
+ */
+    static void
+test_scan_message(void)
+{
+    js_scan_T	scan;
+    char_u	*msg = (char_u *)" [1, \"a]\\\"}\", {\"b\": [2]}] [3]";
+    long_u	len;
+
+    // Feed the message one byte at a time, it is complete after the last
+    // bracket of the first array.
+    CLEAR_FIELD(scan);
+    for (len = 0; len < 25; ++len)
+	assert(json_scan_message(&scan, msg, len, 0) == MAYBE);
+    assert(json_scan_message(&scan, msg, STRLEN(msg), 0) == OK);
+    assert(scan.js_scanned == 25);
+
+    // A single quote only starts a string for JS.
+    CLEAR_FIELD(scan);
+    assert(json_scan_message(&scan, (char_u *)"['a]'", 5, JSON_JS) == MAYBE);
+    CLEAR_FIELD(scan);
+    assert(json_scan_message(&scan, (char_u *)"['a]'", 5, 0) == OK);
+
+    // Not an array or object: cannot tell.
+    CLEAR_FIELD(scan);
+    assert(json_scan_message(&scan, (char_u *)"  123", 5, 0) == FAIL);
+    CLEAR_FIELD(scan);
+    assert(json_scan_message(&scan, (char_u *)" ]", 2, 0) == FAIL);
+}
+# endif
+
+/*
+ * Make a message that looks like a language server completion response of
+ * about "size" bytes.  Returns allocated memory.
+ */
+    static char_u *
+make_lsp_message(long size)
+{
+    garray_T	ga;
+    char	buf[1000];
+    int		i;
+
+    ga_init2(&ga, 1, size + 1000);
+    ga_concat(&ga, (char_u *)"{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":"
+				      "{\"isIncomplete\":false,\"items\":[");
+    for (i = 0; ga.ga_len < size; ++i)
+    {
+	vim_snprintf(buf, sizeof(buf), "%s{\"label\":\"completion_item_%d\","
+		"\"kind\":%d,\"detail\":\"func(ctx context.Context, n int) "
+		"(string, error)\",\"documentation\":{\"kind\":\"markdown\","
+		"\"value\":\"Returns the \\\"name\\\" of item %d.\\n\\n"
+		"See also \\u00e9t\\u00e9 and `other`.\"},\"sortText\":\"%05d\","
+		"\"filterText\":\"completion_item_%d\",\"score\":%d.%d,"
+		"\"textEdit\":{\"range\":{\"start\":{\"line\":%d,"
+		"\"character\":4},\"end\":{\"line\":%d,\"character\":12}},"
+		"\"newText\":\"completion_item_%d\"},\"deprecated\":false,"
+		"\"data\":null}",
+		i == 0 ? "" : ",", i, i % 25, i, i, i, i % 100, i % 7, i, i, i);
+	ga_concat(&ga, (char_u *)buf);
+    }
+    ga_concat(&ga, (char_u *)"]}}");
+    ga_append(&ga, NUL);
+    return ga.ga_data;
+}
+
+/*
+ * Measure how fast json_decode_all() decodes large messages.
+ * Only done when running "json_test bench".
+ */
+    static void
+bench_decode(void)
+{
+    static long sizes[] = {1, 10, 50};
+    int		i;
+    int		round;
+
+    set_option_value((char_u *)"encoding", 0, (char_u *)"utf-8", 0);
+    for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); ++i)
+    {
+	char_u	    *msg = make_lsp_message(sizes[i] * 1024L * 1024L);
+	long	    len = (long)STRLEN(msg);
+	double	    best = 0.0;
+
+	for (round = 0; round < 3; ++round)
+	{
+	    js_read_T	reader;
+	    typval_T	tv;
+	    clock_t	start = clock();
+	    double	secs;
+
+	    CLEAR_FIELD(reader);
+	    reader.js_buf = msg;
+	    assert(json_decode_all(&reader, &tv, 0) == OK);
+	    secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+	    clear_tv(&tv);
+	    if (round == 0 || secs < best)
+		best = secs;
+	}
+	printf("json_decode: %5.1f Mbyte, %6.1f Mbyte/s\n",
+		len / 1024.0 / 1024.0, len / 1024.0 / 1024.0 / best);
+	vim_free(msg);
+    }
+}
 #endif
 
     int
-main(void)
+main(int argc, char **argv)
 {
 #if defined(FEAT_EVAL)
+    if (argc > 1 && strcmp(argv[1], "bench") == 0)
+    {
+	CLEAR_FIELD(params);
+	params.argc = argc;
+	params.argv = argv;
+	common_init(&params);
+	bench_decode();
+	return 0;
+    }
+
     test_decode_find_end();
     test_fill_called_on_find_end();
     test_fill_called_on_string();
+# if defined(FEAT_JOB_CHANNEL)
+    test_scan_message();
+# endif
 #endif
     return 0;
 }
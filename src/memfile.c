@@ -65,10 +65,32 @@ extern int dos2;			// this is in os_amiga.c
 # endif
 #endif
 
+#ifdef HAVE_WRITEV
+# include <sys/uio.h>
+#endif
+
 #define MEMFILE_PAGE_SIZE 4096		// default page size
 
+// Maximum number of blocks written with one writev() call.
+#define MF_MAX_IOV 64
+
 static long_u	total_mem_used = 0;	// total memory used for memfiles
 
+// Block cache statistics for all memfiles, including closed ones.
+static long_u	total_hits = 0;
+static long_u	total_misses = 0;
+static long_u	total_evictions = 0;
+
+// Compressed blocks of hidden buffers, see 'memcompress'.
+static long_u	total_comp_used = 0;	// bytes used for compressed blocks
+static long_u	total_compressed = 0;	// nr of bytes given to mf_compress()
+static long_u	total_decompressed = 0;	// nr of bytes decompressed
+
+// Values for the LZ compression used for blocks of hidden buffers.
+#define MF_LZ_MINMATCH	4	// minimal length of a match
+#define MF_LZ_HASH_BITS	12	// log2 of the number of hash table entries
+#define MF_LZ_MAXOFF	65535	// maximal offset of a match
+
 static void mf_ins_hash(memfile_T *, bhdr_T *);
 static void mf_rem_hash(memfile_T *, bhdr_T *);
 static bhdr_T *mf_find_hash(memfile_T *, blocknr_T);
@@ -82,6 +104,14 @@ static bhdr_T *mf_rem_free(memfile_T *);
 static int  mf_read(memfile_T *, bhdr_T *);
 static int  mf_write(memfile_T *, bhdr_T *);
 static int  mf_write_block(memfile_T *mfp, bhdr_T *hp, off_T offset, unsigned size);
+static int  mf_sync_list(memfile_T *mfp, int flags, int *done);
+#ifdef HAVE_WRITEV
+static int  mf_sync_sorted(memfile_T *mfp, int flags, int *done);
+static int  mf_write_blocks(memfile_T *mfp, bhdr_T **hps, int count);
+#endif
+#ifdef MF_FSYNC_THREAD
+static int  mf_fsync_start(memfile_T *mfp);
+#endif
 static int  mf_trans_add(memfile_T *, bhdr_T *);
 static void mf_do_open(memfile_T *, char_u *, int);
 static void mf_hash_init(mf_hashtab_T *);
@@ -91,6 +121,18 @@ static mf_hashitem_T *mf_hash_find(mf_hashtab_T *, blocknr_T);
 static void mf_hash_add_item(mf_hashtab_T *, mf_hashitem_T *);
 static void mf_hash_rem_item(mf_hashtab_T *, mf_hashitem_T *);
 static int mf_hash_grow(mf_hashtab_T *);
+static void mf_blockidx_init(mf_blockidx_T *);
+static void mf_blockidx_free(mf_blockidx_T *);
+static bhdr_T *mf_blockidx_find(mf_blockidx_T *, blocknr_T);
+static int mf_blockidx_reserve(mf_blockidx_T *);
+static void mf_blockidx_add(mf_blockidx_T *, bhdr_T *);
+static void mf_blockidx_rem(mf_blockidx_T *, bhdr_T *);
+static int mf_blockidx_grow(mf_blockidx_T *);
+static int mf_compress(memfile_T *mfp, bhdr_T *hp, char_u *buf);
+static int mf_decompress(memfile_T *mfp, bhdr_T *hp);
+static int mf_comp_forget(memfile_T *mfp, bhdr_T *hp);
+static unsigned mf_lz_compress(char_u *src, unsigned len, char_u *dst, unsigned dstlen);
+static int mf_lz_decompress(char_u *src, unsigned len, char_u *dst, unsigned dstlen);
 
 /*
  * The functions for using a memfile:
@@ -156,7 +198,16 @@ mf_open(char_u *fname, int flags)
     mfp->mf_used_last = NULL;
     mfp->mf_dirty = FALSE;
     mfp->mf_used_count = 0;
-    mf_hash_init(&mfp->mf_hash);
+    mfp->mf_hits = 0;
+    mfp->mf_misses = 0;
+    mfp->mf_evictions = 0;
+    mfp->mf_comp_count = 0;
+    mfp->mf_comp_size = 0;
+    mfp->mf_hidden_count = 0;
+#ifdef MF_FSYNC_THREAD
+    mfp->mf_fsync_running = FALSE;
+#endif
+    mf_blockidx_init(&mfp->mf_blocks);
     mf_hash_init(&mfp->mf_trans);
     mfp->mf_page_size = MEMFILE_PAGE_SIZE;
 #ifdef FEAT_CRYPT
@@ -242,6 +293,7 @@ mf_close(memfile_T *mfp, int del_file)
 
     if (mfp == NULL)		    // safety check
 	return;
+    (void)mf_fsync_wait(mfp);
     if (mfp->mf_fd >= 0)
     {
 	if (close(mfp->mf_fd) < 0)
@@ -252,13 +304,14 @@ mf_close(memfile_T *mfp, int del_file)
 					    // free entries in used list
     for (hp = mfp->mf_used_first; hp != NULL; hp = nextp)
     {
+	(void)mf_comp_forget(mfp, hp);
 	total_mem_used -= hp->bh_page_count * mfp->mf_page_size;
 	nextp = hp->bh_next;
 	mf_free_bhdr(hp);
     }
     while (mfp->mf_free_first != NULL)	    // free entries in free list
 	vim_free(mf_rem_free(mfp));
-    mf_hash_free(&mfp->mf_hash);
+    mf_blockidx_free(&mfp->mf_blocks);
     mf_hash_free_all(&mfp->mf_trans);	    // free hashtable and its items
     vim_free(mfp->mf_fname);
     vim_free(mfp->mf_ffname);
@@ -290,6 +343,7 @@ mf_close_file(
 	// TODO: should check if all blocks are really in core
     }
 
+    (void)mf_fsync_wait(mfp);
     if (close(mfp->mf_fd) < 0)			// close the file
 	emsg(_(e_swapclose));
     mfp->mf_fd = -1;
@@ -327,6 +381,10 @@ mf_new(memfile_T *mfp, int negative, int page_count)
     bhdr_T	*freep;	// first block in free list
     char_u	*p;
 
+    // Make sure the block can be added to the block index.
+    if (mf_blockidx_reserve(&mfp->mf_blocks) == FAIL)
+	return NULL;
+
     /*
      * If we reached the maximum size for the used memory blocks, release one
      * If a bhdr_T is returned, use it and adjust the page_count if necessary.
@@ -390,6 +448,7 @@ mf_new(memfile_T *mfp, int negative, int page_count)
 	}
     }
     hp->bh_flags = BH_LOCKED | BH_DIRTY;	// new block is always dirty
+    hp->bh_csize = 0;
     mfp->mf_dirty = TRUE;
     hp->bh_page_count = page_count;
     mf_ins_used(mfp, hp);
@@ -422,40 +481,51 @@ mf_get(memfile_T *mfp, blocknr_T nr, int page_count)
      * see if it is in the cache
      */
     hp = mf_find_hash(mfp, nr);
-    if (hp == NULL)	// not in the hash list
+    if (hp != NULL)
     {
-	if (nr < 0 || nr >= mfp->mf_infile_count)   // can't be in the file
+	if (hp->bh_csize != 0 && mf_decompress(mfp, hp) == FAIL)
 	    return NULL;
 
-	// could check here if the block is in the free list
+	// In the cache: only mark it as used, mf_release() will move it to
+	// the front of the used list when it gets there.
+	hp->bh_flags |= BH_LOCKED | BH_REFERENCED;
+	++mfp->mf_hits;
+	++total_hits;
+	return hp;
+    }
 
-	/*
-	 * Check if we need to flush an existing block.
-	 * If so, use that block.
-	 * If not, allocate a new block.
-	 */
-	hp = mf_release(mfp, page_count);
-	if (hp == NULL && (hp = mf_alloc_bhdr(mfp, page_count)) == NULL)
-	    return NULL;
+    if (nr < 0 || nr >= mfp->mf_infile_count)   // can't be in the file
+	return NULL;
 
-	hp->bh_bnum = nr;
-	hp->bh_flags = 0;
-	hp->bh_page_count = page_count;
-	if (mf_read(mfp, hp) == FAIL)	    // cannot read the block!
-	{
-	    mf_free_bhdr(hp);
-	    return NULL;
-	}
-    }
-    else
+    // could check here if the block is in the free list
+
+    if (mf_blockidx_reserve(&mfp->mf_blocks) == FAIL)
+	return NULL;
+
+    /*
+     * Check if we need to flush an existing block.
+     * If so, use that block.
+     * If not, allocate a new block.
+     */
+    hp = mf_release(mfp, page_count);
+    if (hp == NULL && (hp = mf_alloc_bhdr(mfp, page_count)) == NULL)
+	return NULL;
+
+    hp->bh_bnum = nr;
+    hp->bh_flags = 0;
+    hp->bh_csize = 0;
+    hp->bh_page_count = page_count;
+    if (mf_read(mfp, hp) == FAIL)	    // cannot read the block!
     {
-	mf_rem_used(mfp, hp);	// remove from list, insert in front below
-	mf_rem_hash(mfp, hp);
+	mf_free_bhdr(hp);
+	return NULL;
     }
+    ++mfp->mf_misses;
+    ++total_misses;
 
     hp->bh_flags |= BH_LOCKED;
     mf_ins_used(mfp, hp);	// put in front of used list
-    mf_ins_hash(mfp, hp);	// put in front of hash list
+    mf_ins_hash(mfp, hp);	// add to the block index
 
     return hp;
 }
@@ -485,6 +555,7 @@ mf_put(
     if (dirty)
     {
 	flags |= BH_DIRTY;
+	flags &= ~BH_NOCOMPRESS;    // contents changed, may compress now
 	mfp->mf_dirty = TRUE;
     }
     hp->bh_flags = flags;
@@ -498,6 +569,7 @@ mf_put(
     void
 mf_free(memfile_T *mfp, bhdr_T *hp)
 {
+    (void)mf_comp_forget(mfp, hp);
     vim_free(hp->bh_data);	// free the memory
     mf_rem_hash(mfp, hp);	// get *hp out of the hash list
     mf_rem_used(mfp, hp);	// get *hp out of the used list
@@ -538,7 +610,7 @@ fdtofh(int filedescriptor)
 mf_sync(memfile_T *mfp, int flags)
 {
     int		status;
-    bhdr_T	*hp;
+    int		done = FALSE;
     int		got_int_save = got_int;
 
     if (mfp->mf_fd < 0)	    // there is no file, nothing to do
@@ -551,44 +623,25 @@ mf_sync(memfile_T *mfp, int flags)
     // previously.
     got_int = FALSE;
 
-    /*
-     * sync from last to first (may reduce the probability of an inconsistent
-     * file) If a write fails, it is very likely caused by a full filesystem.
-     * Then we only try to write blocks within the existing file. If that also
-     * fails then we give up.
-     */
-    status = OK;
-    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
-	if (((flags & MFS_ALL) || hp->bh_bnum >= 0)
-		&& (hp->bh_flags & BH_DIRTY)
-		&& (status == OK || (hp->bh_bnum >= 0
-		    && hp->bh_bnum < mfp->mf_infile_count)))
-	{
-	    if ((flags & MFS_ZERO) && hp->bh_bnum != 0)
-		continue;
-	    if (mf_write(mfp, hp) == FAIL)
-	    {
-		if (status == FAIL)	// double error: quit syncing
-		    break;
-		status = FAIL;
-	    }
-	    if (flags & MFS_STOP)
-	    {
-		// Stop when char available now.
-		if (ui_char_avail())
-		    break;
-	    }
-	    else
-		ui_breakcheck();
-	    if (got_int)
-		break;
-	}
+#ifdef MF_FSYNC_THREAD
+    // Clean up after a background fsync() that has finished.
+    if (mfp->mf_fsync_running && mfp->mf_fsync_done)
+	(void)mf_fsync_wait(mfp);
+#endif
+
+#ifdef HAVE_WRITEV
+    status = MAYBE;
+    if (!(flags & MFS_ZERO))
+	status = mf_sync_sorted(mfp, flags, &done);
+    if (status == MAYBE)
+#endif
+	status = mf_sync_list(mfp, flags, &done);
 
     /*
      * If the whole list is flushed, the memfile is not dirty anymore.
      * In case of an error this flag is also set, to avoid trying all the time.
      */
-    if (hp == NULL || status == FAIL)
+    if (done || status == FAIL)
 	mfp->mf_dirty = FALSE;
 
     if ((flags & MFS_FLUSH) && *p_sws != NUL)
@@ -600,8 +653,15 @@ mf_sync(memfile_T *mfp, int flags)
 	 */
 	if (STRCMP(p_sws, "fsync") == 0)
 	{
-	    if (vim_fsync(mfp->mf_fd))
+#  ifdef MF_FSYNC_THREAD
+	    // Wait for a previous fsync() to finish, the file may have
+	    // been changed since it started.
+	    if (mf_fsync_wait(mfp) == FAIL)
 		status = FAIL;
+	    if (!(flags & MFS_ASYNC) || mf_fsync_start(mfp) == FAIL)
+#  endif
+		if (vim_fsync(mfp->mf_fd))
+		    status = FAIL;
 	}
 	else
 # endif
@@ -675,6 +735,243 @@ mf_sync(memfile_T *mfp, int flags)
     return status;
 }
 
+/*
+ * Write the dirty blocks of memfile "mfp" for mf_sync(), one at a time.
+ * Sets "*done" when all blocks were handled.
+ */
+    static int
+mf_sync_list(memfile_T *mfp, int flags, int *done)
+{
+    bhdr_T	*hp;
+    int		status;
+
+    /*
+     * sync from last to first (may reduce the probability of an inconsistent
+     * file) If a write fails, it is very likely caused by a full filesystem.
+     * Then we only try to write blocks within the existing file. If that also
+     * fails then we give up.
+     */
+    status = OK;
+    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
+	if (((flags & MFS_ALL) || hp->bh_bnum >= 0)
+		&& (hp->bh_flags & BH_DIRTY)
+		&& (status == OK || (hp->bh_bnum >= 0
+		    && hp->bh_bnum < mfp->mf_infile_count)))
+	{
+	    if ((flags & MFS_ZERO) && hp->bh_bnum != 0)
+		continue;
+	    if (mf_write(mfp, hp) == FAIL)
+	    {
+		if (status == FAIL)	// double error: quit syncing
+		    break;
+		status = FAIL;
+	    }
+	    if (flags & MFS_STOP)
+	    {
+		// Stop when char available now.
+		if (ui_char_avail())
+		    break;
+	    }
+	    else
+		ui_breakcheck();
+	    if (got_int)
+		break;
+	}
+    *done = (hp == NULL);
+    return status;
+}
+
+#if defined(HAVE_WRITEV) || defined(PROTO)
+/*
+ * Compare block headers on their block number, for qsort().
+ */
+    static int
+mf_block_compare(const void *s1, const void *s2)
+{
+    blocknr_T	n1 = (*(bhdr_T **)s1)->bh_bnum;
+    blocknr_T	n2 = (*(bhdr_T **)s2)->bh_bnum;
+
+    return n1 == n2 ? 0 : n1 > n2 ? 1 : -1;
+}
+
+/*
+ * Write the dirty blocks of memfile "mfp" for mf_sync(), in the order of
+ * their position in the file.  Blocks that follow each other in the file are
+ * written with one system call, a slow file system then only needs to be
+ * accessed once for them.
+ * Sets "*done" when all blocks were handled.
+ * Returns MAYBE when out of memory, mf_sync_list() must be used then.
+ */
+    static int
+mf_sync_sorted(memfile_T *mfp, int flags, int *done)
+{
+    bhdr_T	*hp;
+    bhdr_T	**blocks;
+    int		count = 0;
+    int		i;
+    int		j = 0;
+    int		status = OK;
+
+    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
+	if (((flags & MFS_ALL) || hp->bh_bnum >= 0)
+						&& (hp->bh_flags & BH_DIRTY))
+	    ++count;
+    if (count == 0)
+    {
+	*done = TRUE;
+	return OK;
+    }
+    blocks = ALLOC_MULT(bhdr_T *, count);
+    if (blocks == NULL)
+	return MAYBE;
+
+    count = 0;
+    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
+	if (((flags & MFS_ALL) || hp->bh_bnum >= 0)
+						&& (hp->bh_flags & BH_DIRTY))
+	{
+	    // Assign a file block number now, so that the block can be sorted.
+	    // When this fails mf_write() below tries again.
+	    if (hp->bh_bnum < 0)
+		(void)mf_trans_add(mfp, hp);
+	    blocks[count++] = hp;
+	}
+    qsort((void *)blocks, (size_t)count, sizeof(bhdr_T *), mf_block_compare);
+
+    // If a write fails, it is very likely caused by a full filesystem.  Then
+    // we only try to write blocks within the existing file. If that also
+    // fails then we give up.
+    for (i = 0; i < count; i = j)
+    {
+	hp = blocks[i];
+	j = i + 1;
+	if (!(hp->bh_flags & BH_DIRTY))
+	    continue;	    // already written to fill a gap in the file
+	if (status == FAIL && (hp->bh_bnum < 0
+				      || hp->bh_bnum >= mfp->mf_infile_count))
+	    continue;
+
+	// Find the dirty blocks that directly follow this one in the file.
+	// The first one must not be beyond the end of the file, mf_write()
+	// fills the gap.
+	if (status == OK && hp->bh_bnum >= 0
+				       && hp->bh_bnum <= mfp->mf_infile_count)
+	    while (j < count && j - i < MF_MAX_IOV
+		    && (blocks[j]->bh_flags & BH_DIRTY)
+		    && blocks[j]->bh_bnum == blocks[j - 1]->bh_bnum
+					       + blocks[j - 1]->bh_page_count)
+		++j;
+
+	if (j - i == 1 || mf_write_blocks(mfp, blocks + i, j - i) == FAIL)
+	{
+	    // Write one block, this fills gaps in the file, retries and gives
+	    // an error message.
+	    j = i + 1;
+	    if (mf_write(mfp, hp) == FAIL)
+	    {
+		if (status == FAIL)	// double error: quit syncing
+		    break;
+		status = FAIL;
+	    }
+	}
+	if (flags & MFS_STOP)
+	{
+	    // Stop when char available now.
+	    if (ui_char_avail())
+		break;
+	}
+	else
+	    ui_breakcheck();
+	if (got_int)
+	    break;
+    }
+    *done = (j >= count);
+
+    vim_free(blocks);
+    return status;
+}
+#endif
+
+#if defined(MF_FSYNC_THREAD) || defined(PROTO)
+/*
+ * Function executed by the thread started by mf_fsync_start().
+ */
+    static void *
+mf_fsync_thread_main(void *arg)
+{
+    memfile_T	*mfp = (memfile_T *)arg;
+
+    mfp->mf_fsync_result = vim_fsync(mfp->mf_fsync_fd);
+    mfp->mf_fsync_done = TRUE;
+    return NULL;
+}
+
+/*
+ * Start a thread that flushes the swap file of "mfp" to disk.  The thread
+ * must not use anything else, the main thread continues to use "mfp".
+ * Returns FAIL when the thread could not be started.
+ */
+    static int
+mf_fsync_start(memfile_T *mfp)
+{
+    sigset_t	all_signals;
+    sigset_t	old_signals;
+    int		r;
+
+    mfp->mf_fsync_fd = mfp->mf_fd;
+    mfp->mf_fsync_done = FALSE;
+    mfp->mf_fsync_result = 0;
+
+    // Signals must be handled by the main thread, the new thread inherits
+    // the signal mask.
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+    r = pthread_create(&mfp->mf_fsync_thread, NULL,
+						   mf_fsync_thread_main, mfp);
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+    if (r != 0)
+	return FAIL;
+    mfp->mf_fsync_running = TRUE;
+    return OK;
+}
+#endif
+
+/*
+ * Wait for flushing the swap file of "mfp" in the background to finish.
+ * This must be done before closing the file descriptor, and before relying
+ * on the swap file to be on disk.
+ * Returns FAIL if fsync() failed.
+ */
+    int
+mf_fsync_wait(memfile_T *mfp UNUSED)
+{
+#ifdef MF_FSYNC_THREAD
+    if (mfp->mf_fsync_running)
+    {
+	(void)pthread_join(mfp->mf_fsync_thread, NULL);
+	mfp->mf_fsync_running = FALSE;
+	if (mfp->mf_fsync_result != 0)
+	    return FAIL;
+    }
+#endif
+    return OK;
+}
+
+/*
+ * Wait for flushing swap files in the background to finish for all buffers.
+ */
+    void
+mf_fsync_wait_all(void)
+{
+#ifdef MF_FSYNC_THREAD
+    buf_T	*buf;
+
+    FOR_ALL_BUFFERS(buf)
+	if (buf->b_ml.ml_mfp != NULL)
+	    (void)mf_fsync_wait(buf->b_ml.ml_mfp);
+#endif
+}
+
 /*
  * For all blocks in memory file *mfp that have a positive block number set
  * the dirty flag.  These are blocks that need to be written to a newly
@@ -692,30 +989,31 @@ mf_set_dirty(memfile_T *mfp)
 }
 
 /*
- * insert block *hp in front of hashlist of memfile *mfp
+ * Add block *hp to the block index of memfile *mfp.
+ * mf_blockidx_reserve() must have been called first.
  */
     static void
 mf_ins_hash(memfile_T *mfp, bhdr_T *hp)
 {
-    mf_hash_add_item(&mfp->mf_hash, (mf_hashitem_T *)hp);
+    mf_blockidx_add(&mfp->mf_blocks, hp);
 }
 
 /*
- * remove block *hp from hashlist of memfile list *mfp
+ * remove block *hp from the block index of memfile *mfp
  */
     static void
 mf_rem_hash(memfile_T *mfp, bhdr_T *hp)
 {
-    mf_hash_rem_item(&mfp->mf_hash, (mf_hashitem_T *)hp);
+    mf_blockidx_rem(&mfp->mf_blocks, hp);
 }
 
 /*
- * look in hash lists of memfile *mfp for block header with number 'nr'
+ * look in the block index of memfile *mfp for block header with number 'nr'
  */
     static bhdr_T *
 mf_find_hash(memfile_T *mfp, blocknr_T nr)
 {
-    return (bhdr_T *)mf_hash_find(&mfp->mf_hash, nr);
+    return mf_blockidx_find(&mfp->mf_blocks, nr);
 }
 
 /*
@@ -754,8 +1052,13 @@ mf_rem_used(memfile_T *mfp, bhdr_T *hp)
 }
 
 /*
- * Release the least recently used block from the used list if the number
+ * Release a block that was not used recently from the used list if the number
  * of used memory blocks gets to big.
+ * This is the CLOCK algorithm: the last block in the used list is looked at.
+ * If it is locked or was used since the last time, it is moved to the front
+ * of the list and its BH_REFERENCED flag is reset.  Otherwise it is released.
+ * Each block is moved at most once per round, thus the amortized cost of
+ * finding a block to release is constant.
  *
  * Return the block header to the caller, including the memory block, so
  * it can be re-used. Make sure the page_count is right.
@@ -768,6 +1071,8 @@ mf_release(memfile_T *mfp, int page_count)
     bhdr_T	*hp;
     int		need_release;
     buf_T	*buf;
+    long_u	n;
+    int		was_compressed;
 
     // don't release while in mf_close_file()
     if (mf_dont_release)
@@ -805,11 +1110,22 @@ mf_release(memfile_T *mfp, int page_count)
     if (mfp->mf_fd < 0 || !need_release)
 	return NULL;
 
-    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
-	if (!(hp->bh_flags & BH_LOCKED))
+    // After going around twice every unlocked block has been looked at with
+    // BH_REFERENCED reset.
+    for (n = 2 * mfp->mf_blocks.mbi_count + 1; ; --n)
+    {
+	hp = mfp->mf_used_last;
+	if (hp == NULL || n == 0)  // not a single one that can be released
+	    return NULL;
+	if (!(hp->bh_flags & (BH_LOCKED | BH_REFERENCED)))
 	    break;
-    if (hp == NULL)	// not a single one that can be released
-	return NULL;
+	hp->bh_flags &= ~BH_REFERENCED;
+	if (hp != mfp->mf_used_first)
+	{
+	    mf_rem_used(mfp, hp);	// give it a second chance
+	    mf_ins_used(mfp, hp);
+	}
+    }
 
     /*
      * If the block is dirty, write it.
@@ -818,14 +1134,17 @@ mf_release(memfile_T *mfp, int page_count)
     if ((hp->bh_flags & BH_DIRTY) && mf_write(mfp, hp) == FAIL)
 	return NULL;
 
+    was_compressed = mf_comp_forget(mfp, hp);
     mf_rem_used(mfp, hp);
     mf_rem_hash(mfp, hp);
+    ++mfp->mf_evictions;
+    ++total_evictions;
 
     /*
      * If a bhdr_T is returned, make sure that the page_count of bh_data is
      * right
      */
-    if (hp->bh_page_count != page_count)
+    if (hp->bh_page_count != page_count || was_compressed)
     {
 	vim_free(hp->bh_data);
 	if ((hp->bh_data = alloc(mfp->mf_page_size * page_count)) == NULL)
@@ -850,6 +1169,7 @@ mf_release_all(void)
     buf_T	*buf;
     memfile_T	*mfp;
     bhdr_T	*hp;
+    bhdr_T	*prev;
     int		retval = FALSE;
 
     FOR_ALL_BUFFERS(buf)
@@ -857,27 +1177,33 @@ mf_release_all(void)
 	mfp = buf->b_ml.ml_mfp;
 	if (mfp != NULL)
 	{
-	    // If no swap file yet, may open one
-	    if (mfp->mf_fd < 0 && buf->b_may_swap)
+	    // If no swap file yet, may open one.  Not for a mapped file, it
+	    // would have to be copied into memory first.
+	    if (mfp->mf_fd < 0 && buf->b_may_swap
+#ifdef FEAT_MMAP
+		    && buf->b_ml.ml_mapped == NULL
+#endif
+		    )
 		ml_open_file(buf);
 
 	    // only if there is a swapfile
 	    if (mfp->mf_fd >= 0)
 	    {
-		for (hp = mfp->mf_used_last; hp != NULL; )
+		for (hp = mfp->mf_used_last; hp != NULL; hp = prev)
 		{
+		    prev = hp->bh_prev;
 		    if (!(hp->bh_flags & BH_LOCKED)
 			    && (!(hp->bh_flags & BH_DIRTY)
 				|| mf_write(mfp, hp) != FAIL))
 		    {
+			(void)mf_comp_forget(mfp, hp);
 			mf_rem_used(mfp, hp);
 			mf_rem_hash(mfp, hp);
 			mf_free_bhdr(hp);
-			hp = mfp->mf_used_last;	// re-start, list was changed
+			++mfp->mf_evictions;
+			++total_evictions;
 			retval = TRUE;
 		    }
-		    else
-			hp = hp->bh_prev;
 		}
 	    }
 	}
@@ -885,6 +1211,54 @@ mf_release_all(void)
     return retval;
 }
 
+#if defined(FEAT_EVAL) || defined(PROTO)
+/*
+ * Put block cache statistics of memfile "mfp" in dictionary "d".  When "mfp"
+ * is NULL use the totals for all memfiles.
+ * This is used by the memfileinfo() function.
+ */
+    void
+mf_get_info(memfile_T *mfp, dict_T *d)
+{
+    buf_T	*buf;
+    long_u	blocks = 0;
+    long_u	comp_blocks = 0;
+
+    if (mfp == NULL)
+    {
+	FOR_ALL_BUFFERS(buf)
+	    if (buf->b_ml.ml_mfp != NULL)
+	    {
+		blocks += buf->b_ml.ml_mfp->mf_blocks.mbi_count;
+		comp_blocks += buf->b_ml.ml_mfp->mf_comp_count;
+	    }
+	dict_add_number(d, "hits", (varnumber_T)total_hits);
+	dict_add_number(d, "misses", (varnumber_T)total_misses);
+	dict_add_number(d, "evictions", (varnumber_T)total_evictions);
+	dict_add_number(d, "blocks", (varnumber_T)blocks);
+	dict_add_number(d, "memused", (varnumber_T)(total_mem_used >> 10));
+	dict_add_number(d, "compblocks", (varnumber_T)comp_blocks);
+	dict_add_number(d, "compressed", (varnumber_T)total_compressed);
+	dict_add_number(d, "decompressed", (varnumber_T)total_decompressed);
+	dict_add_number(d, "compmem", (varnumber_T)(total_comp_used >> 10));
+    }
+    else
+    {
+	dict_add_number(d, "hits", (varnumber_T)mfp->mf_hits);
+	dict_add_number(d, "misses", (varnumber_T)mfp->mf_misses);
+	dict_add_number(d, "evictions", (varnumber_T)mfp->mf_evictions);
+	dict_add_number(d, "blocks", (varnumber_T)mfp->mf_blocks.mbi_count);
+	dict_add_number(d, "memused", (varnumber_T)
+		       (((long_u)mfp->mf_used_count * mfp->mf_page_size) >> 10));
+	dict_add_number(d, "memmax", (varnumber_T)
+		   (((long_u)mfp->mf_used_count_max * mfp->mf_page_size) >> 10));
+	dict_add_number(d, "swapfile", mfp->mf_fd >= 0);
+	dict_add_number(d, "compblocks", (varnumber_T)mfp->mf_comp_count);
+	dict_add_number(d, "compmem", (varnumber_T)(mfp->mf_comp_size >> 10));
+    }
+}
+#endif
+
 /*
  * Allocate a block header and a block of memory for it
  */
@@ -895,12 +1269,14 @@ mf_alloc_bhdr(memfile_T *mfp, int page_count)
 
     if ((hp = ALLOC_ONE(bhdr_T)) != NULL)
     {
-	if ((hp->bh_data = alloc(mfp->mf_page_size * page_count)) == NULL)
+	if ((hp->bh_data = alloc_id(mfp->mf_page_size * page_count,
+						       aid_mf_block)) == NULL)
 	{
 	    vim_free(hp);	    // not enough memory
 	    return NULL;
 	}
 	hp->bh_page_count = page_count;
+	hp->bh_csize = 0;
     }
     return hp;
 }
@@ -1049,7 +1425,10 @@ mf_write(memfile_T *mfp, bhdr_T *hp)
 		// gets disconnected and then re-connected, we can maybe fix it
 		// by closing and then re-opening the file.
 		if (mfp->mf_fd >= 0)
+		{
+		    (void)mf_fsync_wait(mfp);
 		    close(mfp->mf_fd);
+		}
 		mfp->mf_fd = mch_open_rw((char *)mfp->mf_fname, mfp->mf_flags);
 		mfp->mf_reopen = (mfp->mf_fd < 0);
 	    }
@@ -1090,9 +1469,13 @@ mf_write_block(
     off_T	offset UNUSED,
     unsigned	size)
 {
-    char_u	*data = hp->bh_data;
+    char_u	*data;
     int		result = OK;
 
+    if (hp->bh_csize != 0 && mf_decompress(mfp, hp) == FAIL)
+	return FAIL;
+    data = hp->bh_data;
+
 #ifdef FEAT_CRYPT
     // Encrypt if 'key' is set and this is a data block.
     if (*mfp->mf_buffer->b_p_key != NUL)
@@ -1114,6 +1497,86 @@ mf_write_block(
     return result;
 }
 
+#if defined(HAVE_WRITEV) || defined(PROTO)
+/*
+ * Write "count" blocks "hps" that follow each other in the file with one
+ * writev() call.  The first block must not be beyond the end of the file.
+ * Takes care of encryption.
+ * Return FAIL or OK.  On failure the blocks may have been written partly,
+ * they are still dirty.
+ */
+    static int
+mf_write_blocks(memfile_T *mfp, bhdr_T **hps, int count)
+{
+    struct iovec    iov[MF_MAX_IOV];
+    off_T	    offset;
+    size_t	    total = 0;
+    ssize_t	    len;
+    unsigned	    size;
+    int		    i;
+    int		    result = OK;
+
+    if (mfp->mf_fd < 0)
+	return FAIL;
+    for (i = 0; i < count; ++i)
+	if (hps[i]->bh_csize != 0 && mf_decompress(mfp, hps[i]) == FAIL)
+	    return FAIL;
+
+    offset = (off_T)mfp->mf_page_size * hps[0]->bh_bnum;
+    for (i = 0; i < count; ++i)
+    {
+	size = mfp->mf_page_size * hps[i]->bh_page_count;
+	iov[i].iov_base = (void *)hps[i]->bh_data;
+	iov[i].iov_len = size;
+#ifdef FEAT_CRYPT
+	// Encrypt if 'key' is set and this is a data block.
+	if (*mfp->mf_buffer->b_p_key != NUL)
+	{
+	    iov[i].iov_base = (void *)ml_encrypt_data(mfp, hps[i]->bh_data,
+						 offset + (off_T)total, size);
+	    if (iov[i].iov_base == NULL)
+	    {
+		result = FAIL;
+		break;
+	    }
+	}
+#endif
+	total += size;
+    }
+
+    if (result == OK)
+    {
+	if (vim_lseek(mfp->mf_fd, offset, SEEK_SET) != offset)
+	    result = FAIL;
+	else
+	{
+	    do
+		len = writev(mfp->mf_fd, iov, count);
+	    while (len < 0 && errno == EINTR);
+	    if (len < 0 || (size_t)len != total)
+		result = FAIL;
+	}
+    }
+
+#ifdef FEAT_CRYPT
+    for (--i; i >= 0; --i)
+	if (iov[i].iov_base != (void *)hps[i]->bh_data)
+	    vim_free(iov[i].iov_base);
+#endif
+    if (result == FAIL)
+	return FAIL;
+
+    did_swapwrite_msg = FALSE;
+    for (i = 0; i < count; ++i)
+	hps[i]->bh_flags &= ~BH_DIRTY;
+    if (hps[count - 1]->bh_bnum + hps[count - 1]->bh_page_count
+						     > mfp->mf_infile_count)
+	mfp->mf_infile_count = hps[count - 1]->bh_bnum
+					       + hps[count - 1]->bh_page_count;
+    return OK;
+}
+#endif
+
 /*
  * Make block number for *hp positive and add it to the translation list
  *
@@ -1167,9 +1630,9 @@ mf_trans_add(memfile_T *mfp, bhdr_T *hp)
     np->nt_old_bnum = hp->bh_bnum;	    // adjust number
     np->nt_new_bnum = new_bnum;
 
-    mf_rem_hash(mfp, hp);		    // remove from old hash list
+    mf_rem_hash(mfp, hp);		    // remove with old number
     hp->bh_bnum = new_bnum;
-    mf_ins_hash(mfp, hp);		    // insert in new hash list
+    mf_ins_hash(mfp, hp);		    // add with new number
 
     // Insert "np" into "mf_trans" hashtable with key "np->nt_old_bnum"
     mf_hash_add_item(&mfp->mf_trans, (mf_hashitem_T *)np);
@@ -1319,6 +1782,331 @@ mf_do_open(
     }
 }
 
+/*
+ * Compression of the blocks of hidden buffers follows.  When a buffer has not
+ * been displayed for a while, its blocks in memory are compressed, until the
+ * memory used for compressed blocks reaches 'memcompress'.  A compressed block
+ * is decompressed by mf_get() or when it is written to the swap file.
+ * bh_csize is not zero for a compressed block, bh_data then has that many
+ * bytes.  total_mem_used only counts the compressed size.
+ */
+
+/*
+ * Compress blocks of hidden buffers.  Called when nothing was typed for
+ * 'updatetime'.  A buffer must also have been hidden the previous time,
+ * unless "force" is TRUE.  Stops when a character is typed.
+ */
+    void
+mf_compress_hidden(int force)
+{
+    buf_T	*buf;
+    memfile_T	*mfp;
+    bhdr_T	*hp;
+    char_u	*tmp = NULL;
+    unsigned	tmp_size = 0;
+    unsigned	size;
+
+    if (p_mcm <= 0)
+	return;
+
+    FOR_ALL_BUFFERS(buf)
+    {
+	mfp = buf->b_ml.ml_mfp;
+	if (mfp == NULL)
+	    continue;
+	if (buf->b_nwindows > 0)
+	{
+	    mfp->mf_hidden_count = 0;
+	    continue;
+	}
+	if (mfp->mf_hidden_count < 2)
+	    ++mfp->mf_hidden_count;
+	if (mfp->mf_hidden_count < 2 && !force)
+	    continue;
+
+	// Block zero is used by ml_setflags(), locked blocks may be used
+	// without calling mf_get().
+	for (hp = mfp->mf_used_first; hp != NULL; hp = hp->bh_next)
+	{
+	    if (hp->bh_csize != 0 || hp->bh_bnum == 0
+			    || (hp->bh_flags & (BH_LOCKED | BH_NOCOMPRESS)))
+		continue;
+	    if ((total_comp_used >> 10) >= (long_u)p_mcm)
+		goto theend;
+	    size = mfp->mf_page_size * hp->bh_page_count;
+	    if (size > tmp_size)
+	    {
+		vim_free(tmp);
+		tmp = alloc(size);
+		if (tmp == NULL)
+		    return;
+		tmp_size = size;
+	    }
+	    (void)mf_compress(mfp, hp, tmp);
+	}
+	if (!force && ui_char_avail())
+	    break;
+    }
+theend:
+    vim_free(tmp);
+}
+
+/*
+ * Compress the data of block "hp", using "buf" as scratch space for the
+ * compressed data, it must be as big as the block.
+ * Returns FAIL when compressing does not save enough memory.
+ */
+    static int
+mf_compress(memfile_T *mfp, bhdr_T *hp, char_u *buf)
+{
+    unsigned	size = mfp->mf_page_size * hp->bh_page_count;
+    unsigned	csize;
+    char_u	*data;
+
+    // Only keep the result when it saves at least a quarter.
+    csize = mf_lz_compress(hp->bh_data, size, buf, size - size / 4);
+    total_compressed += size;
+    if (csize == 0 || (data = alloc(csize)) == NULL)
+    {
+	hp->bh_flags |= BH_NOCOMPRESS;
+	return FAIL;
+    }
+    mch_memmove(data, buf, csize);
+    vim_free(hp->bh_data);
+    hp->bh_data = data;
+    hp->bh_csize = csize;
+
+    ++mfp->mf_comp_count;
+    mfp->mf_comp_size += csize;
+    total_comp_used += csize;
+    total_mem_used -= size - csize;
+    return OK;
+}
+
+/*
+ * Decompress the data of block "hp", that was compressed by mf_compress().
+ * Returns FAIL when out of memory.
+ */
+    static int
+mf_decompress(memfile_T *mfp, bhdr_T *hp)
+{
+    unsigned	size = mfp->mf_page_size * hp->bh_page_count;
+    char_u	*data;
+
+    if ((data = alloc(size)) == NULL)
+	return FAIL;
+    if (mf_lz_decompress(hp->bh_data, hp->bh_csize, data, size) == FAIL)
+    {
+	vim_free(data);
+	iemsg(_("E1901: Compressed block is corrupted"));
+	return FAIL;
+    }
+    (void)mf_comp_forget(mfp, hp);
+    vim_free(hp->bh_data);
+    hp->bh_data = data;
+    total_decompressed += size;
+    return OK;
+}
+
+/*
+ * To be called when the data of block "hp" is going to be freed or replaced.
+ * Updates the counters if it was compressed.
+ * Returns TRUE if it was compressed.
+ */
+    static int
+mf_comp_forget(memfile_T *mfp, bhdr_T *hp)
+{
+    if (hp->bh_csize == 0)
+	return FALSE;
+    --mfp->mf_comp_count;
+    mfp->mf_comp_size -= hp->bh_csize;
+    total_comp_used -= hp->bh_csize;
+    total_mem_used += mfp->mf_page_size * hp->bh_page_count - hp->bh_csize;
+    hp->bh_csize = 0;
+    return TRUE;
+}
+
+/*
+ * Read four bytes at "p", which may not be aligned.
+ */
+    static UINT32_T
+mf_lz_read32(char_u *p)
+{
+    UINT32_T	v;
+
+    mch_memmove(&v, p, sizeof(v));
+    return v;
+}
+
+/*
+ * Append a sequence to "dst" at "*op": "litlen" literal bytes from "lit"
+ * and, when "mlen" is not zero, a match of "mlen" bytes "offset" bytes back.
+ * Returns FAIL when it does not fit in "dstlen" bytes.
+ */
+    static int
+mf_lz_put_seq(
+    char_u	*dst,
+    unsigned	*op,
+    unsigned	dstlen,
+    char_u	*lit,
+    unsigned	litlen,
+    unsigned	offset,
+    unsigned	mlen)
+{
+    unsigned	o = *op;
+    unsigned	ml = mlen == 0 ? 0 : mlen - MF_LZ_MINMATCH;
+    unsigned	n;
+
+    // token, literal length, literals, offset, match length
+    if ((long_u)o + 1 + litlen / 255 + 1 + litlen + 2 + ml / 255 + 1
+								     > dstlen)
+	return FAIL;
+
+    dst[o++] = ((litlen < 15 ? litlen : 15) << 4) | (ml < 15 ? ml : 15);
+    if (litlen >= 15)
+    {
+	for (n = litlen - 15; n >= 255; n -= 255)
+	    dst[o++] = 255;
+	dst[o++] = n;
+    }
+    mch_memmove(dst + o, lit, (size_t)litlen);
+    o += litlen;
+    if (mlen != 0)
+    {
+	dst[o++] = offset & 0xff;
+	dst[o++] = offset >> 8;
+	if (ml >= 15)
+	{
+	    for (n = ml - 15; n >= 255; n -= 255)
+		dst[o++] = 255;
+	    dst[o++] = n;
+	}
+    }
+    *op = o;
+    return OK;
+}
+
+/*
+ * Compress "len" bytes at "src" into "dst", which has room for "dstlen"
+ * bytes.  This is a simple LZ77 compression in the style of LZ4, fast and
+ * good enough for text.  The result is a series of sequences, each has:
+ * - a token byte: the high four bits are the number of literal bytes, the
+ *   low four bits the match length minus MF_LZ_MINMATCH; a value of 15 is
+ *   followed by bytes that are added to it until a byte is not 255
+ * - the literal bytes
+ * - the match offset in two bytes, least significant byte first
+ * The last sequence only has literal bytes.
+ * Returns the compressed size, zero when it does not fit in "dstlen".
+ */
+    static unsigned
+mf_lz_compress(char_u *src, unsigned len, char_u *dst, unsigned dstlen)
+{
+    UINT32_T	table[1 << MF_LZ_HASH_BITS];
+    unsigned	ip = 0;	    // current position in "src"
+    unsigned	anchor = 0; // start of the pending literal bytes
+    unsigned	op = 0;	    // current position in "dst"
+    unsigned	limit;
+    unsigned	ref;
+    unsigned	mlen;
+    UINT32_T	seq;
+    UINT32_T	h;
+
+    CLEAR_FIELD(table);
+    limit = len > MF_LZ_MINMATCH ? len - MF_LZ_MINMATCH : 0;
+    while (ip < limit)
+    {
+	seq = mf_lz_read32(src + ip);
+	h = (UINT32_T)(seq * (UINT32_T)2654435761U) >> (32 - MF_LZ_HASH_BITS);
+	ref = table[h];
+	table[h] = ip;
+	if (ref >= ip || ip - ref > MF_LZ_MAXOFF
+					  || mf_lz_read32(src + ref) != seq)
+	{
+	    // Skip faster when there are no matches for a while.
+	    ip += 1 + ((ip - anchor) >> 6);
+	    continue;
+	}
+
+	mlen = MF_LZ_MINMATCH;
+	while (ip + mlen < len && src[ref + mlen] == src[ip + mlen])
+	    ++mlen;
+	if (mf_lz_put_seq(dst, &op, dstlen, src + anchor, ip - anchor,
+						     ip - ref, mlen) == FAIL)
+	    return 0;
+	ip += mlen;
+	anchor = ip;
+    }
+
+    if (mf_lz_put_seq(dst, &op, dstlen, src + anchor, len - anchor, 0, 0)
+								      == FAIL)
+	return 0;
+    return op;
+}
+
+/*
+ * Decompress "len" bytes at "src", compressed with mf_lz_compress(), into
+ * exactly "dstlen" bytes at "dst".
+ * Returns FAIL when the data is invalid.
+ */
+    static int
+mf_lz_decompress(char_u *src, unsigned len, char_u *dst, unsigned dstlen)
+{
+    unsigned	ip = 0;
+    unsigned	op = 0;
+    unsigned	litlen;
+    unsigned	mlen;
+    unsigned	offset;
+    unsigned	n;
+    int		token;
+
+    for (;;)
+    {
+	if (ip >= len)
+	    return FAIL;
+	token = src[ip++];
+
+	litlen = token >> 4;
+	if (litlen == 15)
+	    do
+	    {
+		if (ip >= len)
+		    return FAIL;
+		n = src[ip++];
+		litlen += n;
+	    } while (n == 255);
+	if (litlen > len - ip || litlen > dstlen - op)
+	    return FAIL;
+	mch_memmove(dst + op, src + ip, (size_t)litlen);
+	ip += litlen;
+	op += litlen;
+	if (ip == len)
+	    break;	    // the last sequence has no match
+
+	if (len - ip < 2)
+	    return FAIL;
+	offset = src[ip] | (src[ip + 1] << 8);
+	ip += 2;
+	mlen = token & 15;
+	if (mlen == 15)
+	    do
+	    {
+		if (ip >= len)
+		    return FAIL;
+		n = src[ip++];
+		mlen += n;
+	    } while (n == 255);
+	mlen += MF_LZ_MINMATCH;
+	if (offset == 0 || offset > op || mlen > dstlen - op)
+	    return FAIL;
+	// The match may overlap with the bytes being produced, copy one byte
+	// at a time.
+	for (n = 0; n < mlen; ++n)
+	    dst[op + n] = dst[op - offset + n];
+	op += mlen;
+    }
+    return op == dstlen ? OK : FAIL;
+}
+
 /*
  * Implementation of mf_hashtab_T follows.
  */
@@ -1512,3 +2300,164 @@ mf_hash_grow(mf_hashtab_T *mht)
 
     return OK;
 }
+
+/*
+ * Implementation of mf_blockidx_T follows.
+ */
+
+/*
+ * Return the slot where the search for block "nr" starts.  Block numbers are
+ * mostly consecutive, use multiplicative hashing to spread them out.
+ */
+    static long_u
+mf_blockidx_hash(mf_blockidx_T *mbi, blocknr_T nr)
+{
+    UINT32_T	h = (UINT32_T)nr * (UINT32_T)0x9e3779b9;
+
+    return (long_u)(h >> mbi->mbi_shift);
+}
+
+/*
+ * Initialize an empty block index.
+ */
+    static void
+mf_blockidx_init(mf_blockidx_T *mbi)
+{
+    long_u	n;
+
+    CLEAR_POINTER(mbi);
+    mbi->mbi_slots = mbi->mbi_small_slots;
+    mbi->mbi_mask = MBI_INIT_SIZE - 1;
+    mbi->mbi_shift = 32;
+    for (n = MBI_INIT_SIZE; n > 1; n >>= 1)
+	--mbi->mbi_shift;
+}
+
+/*
+ * Free the array of a block index.  Does not free the block headers!
+ */
+    static void
+mf_blockidx_free(mf_blockidx_T *mbi)
+{
+    if (mbi->mbi_slots != mbi->mbi_small_slots)
+	vim_free(mbi->mbi_slots);
+}
+
+/*
+ * Find block "nr" in block index "mbi".
+ * Returns NULL if the block is not in the index.
+ */
+    static bhdr_T *
+mf_blockidx_find(mf_blockidx_T *mbi, blocknr_T nr)
+{
+    long_u	idx = mf_blockidx_hash(mbi, nr);
+    bhdr_T	*hp;
+
+    while ((hp = mbi->mbi_slots[idx]) != NULL)
+    {
+	if (hp->bh_bnum == nr)
+	    return hp;
+	idx = (idx + 1) & mbi->mbi_mask;
+    }
+    return NULL;
+}
+
+/*
+ * Make sure one more block can be added to block index "mbi".  The index is
+ * kept at most half full, so that probe sequences remain short.
+ * Returns FAIL when out of memory and the index is full.
+ */
+    static int
+mf_blockidx_reserve(mf_blockidx_T *mbi)
+{
+    if ((mbi->mbi_count + 1) * 2 > mbi->mbi_mask + 1
+	    && mf_blockidx_grow(mbi) == FAIL
+	    // there must always be an empty slot to end a search
+	    && mbi->mbi_count + 1 > mbi->mbi_mask)
+	return FAIL;
+    return OK;
+}
+
+/*
+ * Add block header "hp" to block index "mbi".
+ * Its number must not be in the index yet.
+ */
+    static void
+mf_blockidx_add(mf_blockidx_T *mbi, bhdr_T *hp)
+{
+    long_u	idx = mf_blockidx_hash(mbi, hp->bh_bnum);
+
+    while (mbi->mbi_slots[idx] != NULL)
+	idx = (idx + 1) & mbi->mbi_mask;
+    mbi->mbi_slots[idx] = hp;
+    mbi->mbi_count++;
+}
+
+/*
+ * Remove block header "hp" from block index "mbi".
+ * "hp" must have been added to "mbi".
+ */
+    static void
+mf_blockidx_rem(mf_blockidx_T *mbi, bhdr_T *hp)
+{
+    long_u	mask = mbi->mbi_mask;
+    long_u	idx = mf_blockidx_hash(mbi, hp->bh_bnum);
+    long_u	next;
+    long_u	home;
+
+    while (mbi->mbi_slots[idx] != hp)
+	idx = (idx + 1) & mask;
+    mbi->mbi_count--;
+
+    // Move back following entries that would not be found with an empty
+    // slot at "idx".
+    for (;;)
+    {
+	mbi->mbi_slots[idx] = NULL;
+	next = idx;
+	for (;;)
+	{
+	    next = (next + 1) & mask;
+	    if (mbi->mbi_slots[next] == NULL)
+		return;
+	    home = mf_blockidx_hash(mbi, mbi->mbi_slots[next]->bh_bnum);
+	    // Can move when "idx" is cyclically in between "home" and "next".
+	    if (((next - home) & mask) >= ((next - idx) & mask))
+		break;
+	}
+	mbi->mbi_slots[idx] = mbi->mbi_slots[next];
+	idx = next;
+    }
+}
+
+/*
+ * Double the number of slots in block index "mbi" and add the blocks again.
+ * Returns FAIL when out of memory.
+ */
+    static int
+mf_blockidx_grow(mf_blockidx_T *mbi)
+{
+    bhdr_T	**old_slots = mbi->mbi_slots;
+    long_u	old_size = mbi->mbi_mask + 1;
+    long_u	i;
+
+    if (mbi->mbi_shift <= 1)
+	return FAIL;
+    mbi->mbi_slots = lalloc_clear(old_size * 2 * sizeof(bhdr_T *), FALSE);
+    if (mbi->mbi_slots == NULL)
+    {
+	mbi->mbi_slots = old_slots;
+	return FAIL;
+    }
+    mbi->mbi_mask = old_size * 2 - 1;
+    mbi->mbi_shift--;
+    mbi->mbi_count = 0;
+
+    for (i = 0; i < old_size; i++)
+	if (old_slots[i] != NULL)
+	    mf_blockidx_add(mbi, old_slots[i]);
+
+    if (old_slots != mbi->mbi_small_slots)
+	vim_free(old_slots);
+    return OK;
+}
@@ -135,9 +135,171 @@ test_mf_hash(void)
     mf_hash_free_all(&ht);
 }
 
+/*
+ * Test mf_blockidx_*() functions.
+ */
+    static void
+test_mf_blockidx(void)
+{
+    mf_blockidx_T   mbi;
+    bhdr_T	    **hdrs;
+    bhdr_T	    *hp;
+    blocknr_T	    key;
+    long_u	    i;
+    long_u	    num_slots;
+
+    mf_blockidx_init(&mbi);
+    hdrs = ALLOC_CLEAR_MULT(bhdr_T *, TEST_COUNT);
+    assert(hdrs != NULL);
+
+    // insert positive and negative keys and check invariants
+    for (i = 0; i < TEST_COUNT; i++)
+    {
+	assert(mbi.mbi_count == i);
+
+	key = (i & 1) ? -(blocknr_T)i : (blocknr_T)i;
+	assert(mf_blockidx_find(&mbi, key) == NULL);
+
+	assert(mf_blockidx_reserve(&mbi) == OK);
+
+	// check that number of slots is a power of 2 and the index is at
+	// most half full
+	num_slots = mbi.mbi_mask + 1;
+	assert((num_slots & (num_slots - 1)) == 0);
+	assert((i + 1) * 2 <= num_slots);
+	assert((num_slots == MBI_INIT_SIZE)
+				       == (mbi.mbi_slots == mbi.mbi_small_slots));
+
+	hp = LALLOC_CLEAR_ONE(bhdr_T);
+	assert(hp != NULL);
+	hp->bh_bnum = key;
+	hdrs[i] = hp;
+	mf_blockidx_add(&mbi, hp);
+
+	assert(mf_blockidx_find(&mbi, key) == hp);
+    }
+
+    // check presence of inserted items
+    for (i = 0; i < TEST_COUNT; i++)
+	assert(mf_blockidx_find(&mbi, hdrs[i]->bh_bnum) == hdrs[i]);
+
+    // delete some items, in an order that moves entries back
+    for (i = 0; i < TEST_COUNT; i++)
+    {
+	if (i % 100 < 70)
+	{
+	    hp = hdrs[i];
+	    mf_blockidx_rem(&mbi, hp);
+	    assert(mf_blockidx_find(&mbi, hp->bh_bnum) == NULL);
+
+	    assert(mf_blockidx_reserve(&mbi) == OK);
+	    mf_blockidx_add(&mbi, hp);
+	    assert(mf_blockidx_find(&mbi, hp->bh_bnum) == hp);
+
+	    mf_blockidx_rem(&mbi, hp);
+	    assert(mf_blockidx_find(&mbi, hp->bh_bnum) == NULL);
+	}
+    }
+    assert(mbi.mbi_count == TEST_COUNT - TEST_COUNT / 100 * 70);
+
+    // check again, also a key that is not there
+    for (i = 0; i < TEST_COUNT; i++)
+    {
+	hp = mf_blockidx_find(&mbi, hdrs[i]->bh_bnum);
+	if (i % 100 < 70)
+	    assert(hp == NULL);
+	else
+	    assert(hp == hdrs[i]);
+    }
+    assert(mf_blockidx_find(&mbi, TEST_COUNT) == NULL);
+
+    mf_blockidx_free(&mbi);
+    for (i = 0; i < TEST_COUNT; i++)
+	vim_free(hdrs[i]);
+    vim_free(hdrs);
+}
+
+/*
+ * Compress "len" bytes of "src" and check that decompressing gives back the
+ * same data.  Returns the compressed size.
+ */
+    static unsigned
+check_lz_roundtrip(char_u *src, unsigned len)
+{
+    char_u	*comp = alloc(len + len / 32 + 16);
+    char_u	*dest = alloc(len + 1);
+    unsigned	csize;
+
+    assert(comp != NULL && dest != NULL);
+    csize = mf_lz_compress(src, len, comp, len + len / 32 + 16);
+    assert(csize > 0);
+    assert(mf_lz_decompress(comp, csize, dest, len) == OK);
+    assert(memcmp(src, dest, len) == 0);
+
+    // a wrong size or truncated data must be detected
+    assert(mf_lz_decompress(comp, csize, dest, len - 1) == FAIL);
+    assert(mf_lz_decompress(comp, csize - 1, dest, len) == FAIL);
+
+    // when the output doesn't fit zero is returned
+    if (csize > 1)
+	assert(mf_lz_compress(src, len, comp, csize - 1) == 0);
+
+    vim_free(comp);
+    vim_free(dest);
+    return csize;
+}
+
+/*
+ * Test mf_lz_compress() and mf_lz_decompress().
+ */
+    static void
+test_mf_lz(void)
+{
+    unsigned	len = 16384;
+    char_u	*buf = alloc(len);
+    unsigned	i;
+    UINT32_T	r = 12345;
+    char	*line = "    if (mf_lz_compress(src, len) == 0)\n";
+
+    assert(buf != NULL);
+
+    // random data does not compress
+    for (i = 0; i < len; ++i)
+    {
+	r = r * 1103515245 + 12345;
+	buf[i] = r >> 16;
+    }
+    assert(check_lz_roundtrip(buf, len) > len);
+
+    // text compresses well, also long matches and literal runs
+    for (i = 0; i < len; ++i)
+	buf[i] = line[i % STRLEN(line)];
+    assert(check_lz_roundtrip(buf, len) < len / 10);
+
+    // a block with only NULs, like the unused part of a data block
+    vim_memset(buf, 0, len);
+    assert(check_lz_roundtrip(buf, len) < 100);
+
+    // mixed random and repeated parts
+    for (i = 0; i < len; ++i)
+    {
+	r = r * 1103515245 + 12345;
+	buf[i] = (i / 700) % 2 ? line[i % 7] : (char_u)(r >> 16);
+    }
+    (void)check_lz_roundtrip(buf, len);
+
+    // short inputs
+    for (i = 1; i < 20; ++i)
+	(void)check_lz_roundtrip(buf, i);
+
+    vim_free(buf);
+}
+
     int
 main(void)
 {
     test_mf_hash();
+    test_mf_blockidx();
+    test_mf_lz();
     return 0;
 }
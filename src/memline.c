@@ -248,6 +248,9 @@ static void ml_flush_line(buf_T *);
 static bhdr_T *ml_new_data(memfile_T *, int, int);
 static bhdr_T *ml_new_ptr(memfile_T *);
 static bhdr_T *ml_find_line(buf_T *, linenr_T, int);
+static bhdr_T *ml_leaf_cache_find(buf_T *buf, linenr_T lnum);
+static void ml_leaf_cache_add(buf_T *buf, blocknr_T bnum, int page_count);
+static void ml_leaf_cache_clear(buf_T *buf);
 static int ml_add_stack(buf_T *);
 static void ml_lineadd(buf_T *, int);
 static int b0_magic_wrong(ZERO_BL *);
@@ -259,7 +262,15 @@ static long char_to_long(char_u *);
 #ifdef FEAT_CRYPT
 static cryptstate_T *ml_crypt_prepare(memfile_T *mfp, off_T offset, int reading);
 #endif
+#ifdef FEAT_MMAP
+static int ml_append_int(buf_T *buf, linenr_T lnum, char_u *line, colnr_T len, int flags);
+static int ml_delete_int(buf_T *buf, linenr_T lnum, int flags);
+static int ml_delete_range_int(buf_T *buf, linenr_T lnum, long count, int flags);
+static char_u *ml_get_mapped(buf_T *buf, linenr_T lnum);
+static void ml_free_mapped(buf_T *buf);
+#endif
 #ifdef FEAT_BYTEOFF
+static int ml_chunk_find(buf_T *buf, linenr_T lnum, long offset, int ffdos, linenr_T *curlinep, long *sizep);
 static void ml_updatechunk(buf_T *buf, long line, long len, int updtype);
 #endif
 
@@ -285,8 +296,12 @@ ml_open(buf_T *buf)
     buf->b_ml.ml_stack_top = 0;	// nothing in the stack
     buf->b_ml.ml_locked = NULL;	// no cached block
     buf->b_ml.ml_line_lnum = 0;	// no cached line
+    buf->b_ml.ml_leaf_cache = NULL;
 #ifdef FEAT_BYTEOFF
     buf->b_ml.ml_chunksize = NULL;
+    buf->b_ml.ml_chunktree = NULL;
+    buf->b_ml.ml_chunktree_size = 0;
+    buf->b_ml.ml_chunktree_len = 0;
 #endif
 
     if (cmdmod.noswapfile)
@@ -528,6 +543,7 @@ ml_set_crypt_key(
 	buf->b_ml.ml_stack_top = 0;
 	VIM_CLEAR(buf->b_ml.ml_stack);
 	buf->b_ml.ml_stack_size = 0;	// no stack yet
+	ml_leaf_cache_clear(buf);
 
 	for ( ; !got_int; line_breakcheck())
 	{
@@ -676,6 +692,7 @@ ml_setname(buf_T *buf)
 	// need to close the swap file before renaming
 	if (mfp->mf_fd >= 0)
 	{
+	    (void)mf_fsync_wait(mfp);
 	    close(mfp->mf_fd);
 	    mfp->mf_fd = -1;
 	}
@@ -750,6 +767,12 @@ ml_open_file(buf_T *buf)
     if (mfp == NULL || mfp->mf_fd >= 0 || !buf->b_p_swf || cmdmod.noswapfile)
 	return;		// nothing to do
 
+#ifdef FEAT_MMAP
+    // The swap file must contain the text, copy it from a mapped file.
+    if (ml_unmap(buf) == FAIL)
+	return;
+#endif
+
 #ifdef FEAT_SPELL
     // For a spell buffer use a temp file name.
     if (buf->b_spell)
@@ -844,8 +867,15 @@ ml_close(buf_T *buf, int del_file)
     if (buf->b_ml.ml_line_lnum != 0 && (buf->b_ml.ml_flags & ML_LINE_DIRTY))
 	vim_free(buf->b_ml.ml_line_ptr);
     vim_free(buf->b_ml.ml_stack);
+    VIM_CLEAR(buf->b_ml.ml_leaf_cache);
 #ifdef FEAT_BYTEOFF
     VIM_CLEAR(buf->b_ml.ml_chunksize);
+    VIM_CLEAR(buf->b_ml.ml_chunktree);
+    buf->b_ml.ml_chunktree_size = 0;
+    buf->b_ml.ml_chunktree_len = 0;
+#endif
+#ifdef FEAT_MMAP
+    ml_free_mapped(buf);
 #endif
     buf->b_ml.ml_mfp = NULL;
 
@@ -1199,6 +1229,7 @@ ml_recover(int checkext)
     buf->b_ml.ml_stack_top = 0;		// nothing in the stack
     buf->b_ml.ml_line_lnum = 0;		// no cached line
     buf->b_ml.ml_locked = NULL;		// no locked block
+    buf->b_ml.ml_leaf_cache = NULL;
     buf->b_ml.ml_flags = 0;
 #ifdef FEAT_CRYPT
     buf->b_p_key = empty_option;
@@ -1208,6 +1239,9 @@ ml_recover(int checkext)
     /*
      * open the memfile from the old swap file
      */
+    // The swap file may be flushed to disk in the background.
+    mf_fsync_wait_all();
+
     p = vim_strsave(fname_used); // save "fname_used" for the message:
 				 // mf_open() will consume "fname_used"!
     mfp = mf_open(fname_used, O_RDONLY);
@@ -1718,6 +1752,7 @@ theend:
 	free_string_option(buf->b_p_cm);
 #endif
 	vim_free(buf->b_ml.ml_stack);
+	vim_free(buf->b_ml.ml_leaf_cache);
 	vim_free(buf);
     }
     if (serious_error && called_from_main)
@@ -2372,8 +2407,11 @@ ml_sync_all(int check_file, int check_char)
 	}
 	if (buf->b_ml.ml_mfp->mf_dirty)
 	{
-	    (void)mf_sync(buf->b_ml.ml_mfp, (check_char ? MFS_STOP : 0)
-					| (bufIsChanged(buf) ? MFS_FLUSH : 0));
+	    // When waiting for a character flushing to disk may be done in
+	    // the background.
+	    (void)mf_sync(buf->b_ml.ml_mfp,
+			       (check_char ? MFS_STOP | MFS_ASYNC : 0)
+			       | (bufIsChanged(buf) ? MFS_FLUSH : 0));
 	    if (check_char && ui_char_avail())	// character available now
 		break;
 	}
@@ -2416,6 +2454,7 @@ ml_preserve(buf_T *buf, int message)
 
     // stack is invalid after mf_sync(.., MFS_ALL)
     buf->b_ml.ml_stack_top = 0;
+    ml_leaf_cache_clear(buf);
 
     /*
      * Some of the data blocks may have been changed from negative to
@@ -2448,6 +2487,7 @@ ml_preserve(buf_T *buf, int message)
 	if (mf_sync(mfp, MFS_ALL | MFS_FLUSH) == FAIL)
 	    status = FAIL;
 	buf->b_ml.ml_stack_top = 0;	    // stack is invalid now
+	ml_leaf_cache_clear(buf);
     }
 theend:
     got_int |= got_int_save;
@@ -2548,6 +2588,16 @@ errorret:
 	return (char_u *)"";
     }
 
+#ifdef FEAT_MMAP
+    if (buf->b_ml.ml_mapped != NULL)
+    {
+	if (!will_change)
+	    return ml_get_mapped(buf, lnum);
+	if (ml_unmap(buf) == FAIL)
+	    goto errorret;
+    }
+#endif
+
     /*
      * See if it is the same line as requested last time.
      * Otherwise may need to flush last used line.
@@ -2616,6 +2666,401 @@ ml_line_alloced(void)
     return (curbuf->b_ml.ml_flags & ML_LINE_DIRTY);
 }
 
+#if defined(FEAT_MMAP) || defined(PROTO)
+/*
+ * Arguments and results for ml_mapped_find().
+ */
+typedef struct
+{
+    mlmapped_T	*mmf_mm;
+    linenr_T	mmf_lnum;	// line to find, zero to find "mmf_offset"
+    long	mmf_offset;	// byte offset to find when "mmf_lnum" is zero
+    int		mmf_ffdos;	// count a CR for every line
+    int		mmf_copy;	// copy the line into "mm_line"
+    off_T	mmf_start;	// result: offset of the line in the file
+    colnr_T	mmf_len;	// result: length of the line, excluding the NL
+} mmfind_T;
+
+/*
+ * Find a line in a mapped file.  Accesses the mapping, must be called through
+ * mch_call_protected(), a file that was truncated causes a SIGBUS.
+ * Returns NOTDONE when the line does not exist, FAIL when out of memory.
+ */
+    static int
+ml_mapped_find(void *arg)
+{
+    mmfind_T	*mf = (mmfind_T *)arg;
+    mlmapped_T	*mm = mf->mmf_mm;
+    linenr_T	lnum;
+    off_T	off;
+    off_T	end;
+    char_u	*p;
+
+    if (mf->mmf_lnum > 0)
+    {
+	// Start at the index entry for the line, or at the line found last
+	// time when that is closer: lines are often obtained in sequence.
+	lnum = ((mf->mmf_lnum - 1) / MM_INDEX_STEP) * MM_INDEX_STEP + 1;
+	off = mm->mm_index[(mf->mmf_lnum - 1) / MM_INDEX_STEP];
+	if (mm->mm_lnum > lnum && mm->mm_lnum <= mf->mmf_lnum)
+	{
+	    lnum = mm->mm_lnum;
+	    off = mm->mm_start;
+	}
+    }
+    else
+    {
+	// Use a binary search over the index to find where to start.
+	linenr_T    lo = 0;
+	linenr_T    hi = (mm->mm_lnum_count - 1) / MM_INDEX_STEP;
+	linenr_T    mid;
+
+	while (lo < hi)
+	{
+	    mid = (lo + hi + 1) / 2;
+	    if (mm->mm_index[mid] + mf->mmf_ffdos * mid * MM_INDEX_STEP
+							   <= mf->mmf_offset)
+		lo = mid;
+	    else
+		hi = mid - 1;
+	}
+	lnum = lo * MM_INDEX_STEP + 1;
+	off = mm->mm_index[lo];
+    }
+
+    for (;;)
+    {
+	if (lnum > mm->mm_lnum_count)
+	    return NOTDONE;
+	p = memchr(mm->mm_addr + off, NL, (size_t)(mm->mm_size - off));
+	end = p == NULL ? mm->mm_size : (off_T)(p - mm->mm_addr);
+	if (mf->mmf_lnum > 0 ? lnum == mf->mmf_lnum
+		    : end + 1 + mf->mmf_ffdos * lnum > (off_T)mf->mmf_offset)
+	    break;
+	off = end + 1;
+	++lnum;
+    }
+    mm->mm_lnum = lnum;
+    mm->mm_start = off;
+    mf->mmf_lnum = lnum;
+    mf->mmf_start = off;
+    mf->mmf_len = (colnr_T)(end - off);
+
+    if (mf->mmf_copy)
+    {
+	if (mf->mmf_len >= mm->mm_line_size)
+	{
+	    char_u *np = alloc(mf->mmf_len + 100);
+
+	    if (np == NULL)
+		return FAIL;
+	    vim_free(mm->mm_line);
+	    mm->mm_line = np;
+	    mm->mm_line_size = mf->mmf_len + 100;
+	}
+	mch_memmove(mm->mm_line, mm->mm_addr + off, (size_t)mf->mmf_len);
+	mm->mm_line[mf->mmf_len] = NUL;
+	// A NUL in the file is stored as a NL.
+	for (p = mm->mm_line;
+		(p = memchr(p, NUL, mm->mm_line + mf->mmf_len - p)) != NULL;
+									  ++p)
+	    *p = NL;
+    }
+    return OK;
+}
+
+/*
+ * Call ml_mapped_find() for "buf" and catch a crash when the mapped file was
+ * truncated.  Gives an error message once when the mapping failed.
+ */
+    static int
+ml_mapped_call(buf_T *buf, mmfind_T *mf)
+{
+    mlmapped_T	*mm = buf->b_ml.ml_mapped;
+    int		retval;
+
+    if (mm->mm_failed)
+	return FAIL;
+    mf->mmf_mm = mm;
+    retval = mch_call_protected(ml_mapped_find, mf);
+    if (retval == OK)
+	return OK;
+    if (retval == FAIL)
+    {
+	// Could not access the file, it was probably truncated.  Do not
+	// access it again.
+	mm->mm_failed = TRUE;
+	semsg(_("E1900: Mapped file changed, cannot read lines: %s"),
+							       buf->b_fname);
+    }
+    return FAIL;
+}
+
+/*
+ * Map the file "fd" with "size" bytes in memory for "buf", instead of reading
+ * it into the memline, see 'mmapsize'.  The buffer must be empty.
+ * The file is read once to find the line breaks, using a small buffer, so
+ * that the file does not need to stay in memory.
+ * Returns FAIL when the file cannot be mapped, the file position is then at
+ * the start.
+ */
+    int
+ml_open_mapped(buf_T *buf, int fd, off_T size)
+{
+    mlmapped_T	*mm;
+    garray_T	index;
+    char_u	*chunk;
+    char_u	*p;
+    char_u	*chunk_end;
+    long	len;
+    off_T	chunk_off = 0;
+    off_T	line_start = 0;
+    linenr_T	lnum = 1;
+    void	*addr;
+    int		retval = FAIL;
+
+    if (buf->b_ml.ml_mfp == NULL || buf->b_ml.ml_mapped != NULL
+	    || size <= 0 || (off_T)(size_t)size != size)
+	return FAIL;
+
+#define MM_CHUNK_SIZE	(1024L * 1024L)
+    chunk = alloc(MM_CHUNK_SIZE);
+    if (chunk == NULL)
+	return FAIL;
+    ga_init2(&index, (int)sizeof(off_T), 1000);
+    if (ga_grow(&index, 1) == FAIL)
+	goto theend;
+    ((off_T *)index.ga_data)[index.ga_len++] = 0;
+
+    while (chunk_off < size)
+    {
+	len = read_eintr(fd, chunk, MM_CHUNK_SIZE);
+	if (len <= 0)
+	    goto theend;
+	chunk_end = chunk + len;
+	for (p = chunk; (p = memchr(p, NL, chunk_end - p)) != NULL; ++p)
+	{
+	    if (chunk_off + (p - chunk) - line_start >= MAXCOL)
+		goto theend;	// line too long
+	    line_start = chunk_off + (p - chunk) + 1;
+	    if (lnum++ % MM_INDEX_STEP == 0)
+	    {
+		if (ga_grow(&index, 1) == FAIL)
+		    goto theend;
+		((off_T *)index.ga_data)[index.ga_len++] = line_start;
+	    }
+	}
+	chunk_off += len;
+	if (chunk_off - line_start >= MAXCOL)
+	    goto theend;	// line too long
+	ui_breakcheck();
+	if (got_int)
+	    goto theend;
+    }
+    if (chunk_off != size)
+	goto theend;	// file changed while reading it
+
+    addr = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fd, (off_t)0);
+    if (addr == MAP_FAILED)
+	goto theend;
+    mm = ALLOC_CLEAR_ONE(mlmapped_T);
+    if (mm == NULL)
+    {
+	munmap(addr, (size_t)size);
+	goto theend;
+    }
+
+    // The swap file only has the empty line, delete it.  It is created
+    // again when the buffer is changed.
+    if (buf->b_ml.ml_mfp->mf_fd >= 0)
+    {
+	mf_close_file(buf, TRUE);
+	buf->b_may_swap = TRUE;
+    }
+
+    mm->mm_addr = addr;
+    mm->mm_size = size;
+    mm->mm_no_eol = (line_start != size);
+    mm->mm_lnum_count = mm->mm_no_eol ? lnum : lnum - 1;
+    mm->mm_index = (off_T *)index.ga_data;
+    index.ga_data = NULL;
+    buf->b_ml.ml_mapped = mm;
+    buf->b_ml.ml_line_count = mm->mm_lnum_count;
+    buf->b_ml.ml_line_lnum = 0;
+    buf->b_ml.ml_flags &= ~ML_EMPTY;
+    retval = OK;
+
+theend:
+    vim_free(chunk);
+    ga_clear(&index);
+    vim_lseek(fd, (off_T)0L, SEEK_SET);
+    return retval;
+}
+
+/*
+ * Get line "lnum" from the file mapped for "buf".  Like ml_get_buf() it
+ * returns a pointer that is valid until the next line is obtained.
+ */
+    static char_u *
+ml_get_mapped(buf_T *buf, linenr_T lnum)
+{
+    mmfind_T	mf;
+
+    if (buf->b_ml.ml_line_lnum == lnum)
+	return buf->b_ml.ml_line_ptr;
+
+    CLEAR_FIELD(mf);
+    mf.mmf_lnum = lnum;
+    mf.mmf_copy = TRUE;
+    if (ml_mapped_call(buf, &mf) == FAIL)
+    {
+	buf->b_ml.ml_line_lnum = 0;
+	buf->b_ml.ml_line_len = 1;
+	return (char_u *)"";
+    }
+    buf->b_ml.ml_line_ptr = buf->b_ml.ml_mapped->mm_line;
+    buf->b_ml.ml_line_len = mf.mmf_len + 1;
+    buf->b_ml.ml_line_lnum = lnum;
+    return buf->b_ml.ml_line_ptr;
+}
+
+/*
+ * Free the mapping of "buf", without changing the memline.
+ */
+    static void
+ml_free_mapped(buf_T *buf)
+{
+    mlmapped_T	*mm = buf->b_ml.ml_mapped;
+
+    if (mm == NULL)
+	return;
+    munmap(mm->mm_addr, (size_t)mm->mm_size);
+    vim_free(mm->mm_index);
+    vim_free(mm->mm_line);
+    vim_free(mm->mm_marks);
+    vim_free(mm);
+    buf->b_ml.ml_mapped = NULL;
+}
+
+/*
+ * When the file for "buf" is mapped in memory: copy all the lines into the
+ * memline and remove the mapping.  Must be done before the buffer is changed
+ * or the file is overwritten.  Lines marked with ml_setmarked() stay marked.
+ * Returns FAIL when not all lines could be copied, the buffer is then still
+ * mapped and an error message was given.
+ */
+    int
+ml_unmap(buf_T *buf)
+{
+    mlmapped_T	*mm = buf->b_ml.ml_mapped;
+    linenr_T	count;
+    linenr_T	lnum;
+    linenr_T	save_lowest_marked = lowest_marked;
+    char_u	*line;
+    colnr_T	len;
+    int		ret = OK;
+
+    if (mm == NULL)
+	return OK;
+
+    // Lines are added to the memline before the empty line from ml_open().
+    // Detach the mapping first, ml_append_int() must not see it.
+    count = buf->b_ml.ml_line_count;
+    buf->b_ml.ml_mapped = NULL;
+    buf->b_ml.ml_line_count = 1;
+    buf->b_ml.ml_line_lnum = 0;
+#ifdef FEAT_NETBEANS_INTG
+    netbeansFireChanges = 0;
+#endif
+    for (lnum = 1; lnum <= count; ++lnum)
+    {
+	buf->b_ml.ml_mapped = mm;
+	line = ml_get_mapped(buf, lnum);
+	len = buf->b_ml.ml_line_len;
+	buf->b_ml.ml_mapped = NULL;
+	buf->b_ml.ml_line_lnum = 0;
+	if (ml_append_int(buf, lnum - 1, line, len,
+		    ML_APPEND_NEW | (mm->mm_marks != NULL
+			       && (mm->mm_marks[(lnum - 1) >> 3]
+					       & (1 << ((lnum - 1) & 7))) != 0
+						  ? ML_APPEND_MARK : 0)) == FAIL)
+	    break;
+    }
+    if (lnum <= count)
+    {
+	// Out of memory or the swap file can't be written.  Throwing away
+	// the lines that were not copied would truncate the buffer, go back
+	// to using the mapping.
+	if (lnum > 1)
+	    ml_delete_range_int(buf, 1, lnum - 1, 0);
+	buf->b_ml.ml_line_count = count;
+	buf->b_ml.ml_line_lnum = 0;
+	ret = FAIL;
+    }
+    else
+	// Delete the empty line from ml_open().
+	ml_delete_int(buf, buf->b_ml.ml_line_count, 0);
+#ifdef FEAT_NETBEANS_INTG
+    netbeansFireChanges = 1;
+#endif
+    lowest_marked = save_lowest_marked;
+
+    buf->b_ml.ml_mapped = mm;
+    if (ret == FAIL)
+	semsg(_("E1903: Cannot copy the lines of mapped file: %s"),
+							       buf->b_fname);
+    else
+	ml_free_mapped(buf);
+    return ret;
+}
+
+/*
+ * Find the byte offset for "lnum" or the line for "*offp" in a mapped file,
+ * like ml_find_line_or_offset().
+ */
+    static long
+ml_find_mapped_offset(buf_T *buf, linenr_T lnum, long *offp)
+{
+    mlmapped_T	*mm = buf->b_ml.ml_mapped;
+    int		ffdos = (get_fileformat(buf) == EOL_DOS);
+    mmfind_T	mf;
+    long	size;
+
+    CLEAR_FIELD(mf);
+    mf.mmf_ffdos = ffdos;
+    if (lnum > 0)
+    {
+	if (lnum > buf->b_ml.ml_line_count)
+	    size = (long)mm->mm_size + (mm->mm_no_eol ? 1 : 0);
+	else
+	{
+	    mf.mmf_lnum = lnum;
+	    if (ml_mapped_call(buf, &mf) == FAIL)
+		return -1;
+	    size = (long)mf.mmf_start;
+	}
+	// Count extra CR characters.
+	if (ffdos)
+	    size += lnum - 1;
+
+	// Don't count the last line break if 'noeol' and ('bin' or
+	// 'nofixeol').
+	if ((!buf->b_p_fixeol || buf->b_p_bin) && !buf->b_p_eol
+					   && lnum > buf->b_ml.ml_line_count)
+	    size -= ffdos + 1;
+	return size;
+    }
+
+    if (offp == NULL || *offp <= 0)
+	return 1;   // offset 0 must be in line 1
+    mf.mmf_offset = *offp;
+    if (ml_mapped_call(buf, &mf) == FAIL)
+	return -1;	// beyond the end
+    *offp -= (long)mf.mmf_start + ffdos * (mf.mmf_lnum - 1);
+    return mf.mmf_lnum;
+}
+#endif
+
 #ifdef FEAT_PROP_POPUP
 /*
  * Add text properties that continue from the previous line.
@@ -2712,6 +3157,10 @@ ml_append_int(
     if (lnum > buf->b_ml.ml_line_count || buf->b_ml.ml_mfp == NULL)
 	return FAIL;  // lnum out of range
 
+#ifdef FEAT_MMAP
+    if (ml_unmap(buf) == FAIL)
+	return FAIL;
+#endif
     if (lowest_marked && lowest_marked > lnum)
 	lowest_marked = lnum + 1;
 
@@ -3286,6 +3735,232 @@ ml_append_buf(
 }
 #endif
 
+/*
+ * Append as many of the "count" lines in "lines[]" as fit in the data block
+ * that contains line "lnum", after that line.  "lens[]" has the length of
+ * each line including the NUL, or is NULL.
+ * Unlike calling ml_append_int() for every line the text following the
+ * insert position is moved and the indexes are adjusted only once.
+ * Returns the number of lines appended, zero when the first line does not
+ * fit.  Then ml_append_int() must be used to split the block.
+ */
+    static long
+ml_append_fill_block(
+    buf_T	*buf,
+    linenr_T	lnum,		// append after this line, not zero
+    char_u	**lines,
+    colnr_T	*lens,
+    long	count,
+    int		flags)		// ML_APPEND_ flags
+{
+    bhdr_T	*hp;
+    DATA_BL	*dp;
+    int		db_idx;
+    int		line_count;
+    int		offset;
+    int		total_len = 0;
+    int		space_left;
+    int		len;
+    long	n;
+    long	i;
+
+    // This also releases a locked block that does not contain "lnum".
+    if ((hp = ml_find_line(buf, lnum, ML_INSERT)) == NULL)
+	return 0;
+    dp = (DATA_BL *)(hp->bh_data);
+    db_idx = lnum - buf->b_ml.ml_locked_low;
+    // line count before the insertion
+    line_count = buf->b_ml.ml_locked_high - buf->b_ml.ml_locked_low;
+
+    // Find out how many lines fit in the free space.
+    space_left = (int)dp->db_free;
+    for (n = 0; n < count; ++n)
+    {
+	len = lens == NULL ? (colnr_T)STRLEN(lines[n]) + 1 : lens[n];
+	if (len + (int)INDEX_SIZE > space_left)
+	    break;
+	space_left -= len + INDEX_SIZE;
+	total_len += len;
+    }
+    if (n == 0)
+    {
+	// ml_find_line() counted one line that is not going to be inserted.
+	--(buf->b_ml.ml_locked_lineadd);
+	--(buf->b_ml.ml_locked_high);
+	return 0;
+    }
+    buf->b_ml.ml_locked_lineadd += n - 1;
+    buf->b_ml.ml_locked_high += n - 1;
+    buf->b_ml.ml_line_count += n;
+    buf->b_ml.ml_flags &= ~ML_EMPTY;
+
+    dp->db_txt_start -= total_len;
+    dp->db_free = space_left;
+    dp->db_line_count += n;
+
+    // Move the text of the lines that follow to the front once and adjust
+    // their indexes.
+    offset = ((dp->db_index[db_idx]) & DB_INDEX_MASK);
+    if (line_count > db_idx + 1)
+    {
+	mch_memmove((char *)dp + dp->db_txt_start,
+				(char *)dp + dp->db_txt_start + total_len,
+			   (size_t)(offset - (dp->db_txt_start + total_len)));
+	for (i = line_count - 1; i > db_idx; --i)
+	    dp->db_index[i + n] = dp->db_index[i] - total_len;
+    }
+
+    // Copy the new lines into the gap, the text grows downwards.
+    for (i = 0; i < n; ++i)
+    {
+	len = lens == NULL ? (colnr_T)STRLEN(lines[i]) + 1 : lens[i];
+	offset -= len;
+	mch_memmove((char *)dp + offset, lines[i], (size_t)len);
+	dp->db_index[db_idx + 1 + i] = offset;
+	if (flags & ML_APPEND_MARK)
+	    dp->db_index[db_idx + 1 + i] |= DB_MARKED;
+#ifdef FEAT_BYTEOFF
+	ml_updatechunk(buf, lnum + 1 + i, (long)len, ML_CHNK_ADDLINE);
+#endif
+#ifdef FEAT_NETBEANS_INTG
+	if (netbeans_active())
+	{
+	    if (len > 1)
+		netbeans_inserted(buf, lnum + 1 + i, (colnr_T)0, lines[i],
+								     len - 1);
+	    netbeans_inserted(buf, lnum + 1 + i, (colnr_T)(len - 1),
+							   (char_u *)"\n", 1);
+	}
+#endif
+    }
+
+    buf->b_ml.ml_flags |= ML_LOCKED_DIRTY;
+    if (!(flags & ML_APPEND_NEW))
+	buf->b_ml.ml_flags |= ML_LOCKED_POS;
+    return n;
+}
+
+/*
+ * Append "count" lines from "lines[]" after line "lnum" in buffer "buf".
+ * "lens[]" has the length of each line including the NUL, or is NULL to use
+ * STRLEN().  Data blocks are filled sequentially and only split when full,
+ * instead of looking up the block for every line.
+ */
+    static int
+ml_append_lines_int(
+    buf_T	*buf,
+    linenr_T	lnum,		// append after this line (can be 0)
+    char_u	**lines,
+    colnr_T	*lens,
+    long	count,
+    int		flags)		// ML_APPEND_ flags
+{
+    long	done = 0;
+    long	n;
+#ifdef FEAT_JOB_CHANNEL
+    int		save_write_to = buf->b_write_to_channel;
+#endif
+    int		ret = OK;
+
+    if (lnum > buf->b_ml.ml_line_count || buf->b_ml.ml_mfp == NULL)
+	return FAIL;  // lnum out of range
+
+#ifdef FEAT_MMAP
+    if (ml_unmap(buf) == FAIL)
+	return FAIL;
+#endif
+    if (lowest_marked && lowest_marked > lnum)
+	lowest_marked = lnum + 1;
+#ifdef FEAT_JOB_CHANNEL
+    // Write the new lines to the channel once, below.
+    buf->b_write_to_channel = FALSE;
+#endif
+
+    while (done < count)
+    {
+	n = 0;
+#ifdef FEAT_PROP_POPUP
+	// Text properties may continue in every line, let ml_append_int()
+	// handle that.
+	if (!buf->b_has_textprop || (flags & ML_APPEND_UNDO))
+#endif
+	    if (lnum + done > 0)
+		n = ml_append_fill_block(buf, lnum + done, lines + done,
+				   lens == NULL ? NULL : lens + done,
+				   count - done, flags);
+	if (n == 0)
+	{
+	    // Does not fit: this splits the data block, following lines then
+	    // go into the block with free space.
+	    if (ml_append_int(buf, lnum + done, lines[done],
+			       lens == NULL ? 0 : lens[done], flags) == FAIL)
+	    {
+		ret = FAIL;
+		break;
+	    }
+	    n = 1;
+	}
+	done += n;
+    }
+
+#ifdef FEAT_JOB_CHANNEL
+    buf->b_write_to_channel = save_write_to;
+    if (done > 0 && buf->b_write_to_channel)
+	channel_write_new_lines(buf);
+#endif
+    return ret;
+}
+
+/*
+ * Like ml_append_buf() but append "count" lines at once.  "lens[]" has the
+ * length of each line including the NUL, or is NULL.
+ * The caller should call appended_lines_mark() once for all the lines.
+ */
+    int
+ml_append_buf_lines(
+    buf_T	*buf,
+    linenr_T	lnum,		// append after this line (can be 0)
+    char_u	**lines,	// text of the new lines
+    colnr_T	*lens,		// lengths including NUL, or NULL
+    long	count,		// number of lines in "lines[]"
+    int		newfile)	// flag, see ml_append()
+{
+    if (buf->b_ml.ml_mfp == NULL || lnum > buf->b_ml.ml_line_count)
+	return FAIL;
+    if (count <= 0)
+	return OK;
+
+    if (buf->b_ml.ml_line_lnum != 0)
+	ml_flush_line(buf);
+#ifdef FEAT_EVAL
+    // When inserting above recorded changes: flush the changes before changing
+    // the text.  Then flush the cached line, it may become invalid.
+    may_invoke_listeners(buf, lnum + 1, lnum + 1, count);
+    if (buf->b_ml.ml_line_lnum != 0)
+	ml_flush_line(buf);
+#endif
+
+    return ml_append_lines_int(buf, lnum, lines, lens, count,
+						newfile ? ML_APPEND_NEW : 0);
+}
+
+/*
+ * Like ml_append() but append "count" lines at once in the current buffer.
+ */
+    int
+ml_append_lines(
+    linenr_T	lnum,		// append after this line (can be 0)
+    char_u	**lines,	// text of the new lines
+    colnr_T	*lens,		// lengths including NUL, or NULL
+    long	count,		// number of lines in "lines[]"
+    int		newfile)	// flag, see ml_append()
+{
+    // When starting up, we might still need to create the memfile
+    if (curbuf->b_ml.ml_mfp == NULL && open_buffer(FALSE, NULL, 0) == FAIL)
+	return FAIL;
+    return ml_append_buf_lines(curbuf, lnum, lines, lens, count, newfile);
+}
+
 /*
  * Replace line lnum, with buffering, in current buffer.
  *
@@ -3330,6 +4005,10 @@ ml_replace_len(
     // When starting up, we might still need to create the memfile
     if (curbuf->b_ml.ml_mfp == NULL && open_buffer(FALSE, NULL, 0) == FAIL)
 	return FAIL;
+#ifdef FEAT_MMAP
+    if (ml_unmap(curbuf) == FAIL)
+	return FAIL;
+#endif
 
     if (!has_props)
 	++len;  // include the NUL after the text
@@ -3528,6 +4207,10 @@ ml_delete_int(buf_T *buf, linenr_T lnum, int flags)
     int		textprop_save_len;
 #endif
 
+#ifdef FEAT_MMAP
+    if (ml_unmap(buf) == FAIL)
+	return FAIL;
+#endif
     if (lowest_marked && lowest_marked > lnum)
 	lowest_marked--;
 
@@ -3729,6 +4412,199 @@ ml_delete_flags(linenr_T lnum, int flags)
     return ml_delete_int(curbuf, lnum, flags);
 }
 
+/*
+ * Delete "count" lines starting at "lnum" in buffer "buf", but not all the
+ * lines.  Lines are removed per data block: a block that only contains
+ * deleted lines is freed and its entry removed from the pointer blocks,
+ * otherwise the text and indexes are moved once.
+ */
+    static int
+ml_delete_range_int(buf_T *buf, linenr_T lnum, long count, int flags)
+{
+    bhdr_T	*hp;
+    memfile_T	*mfp = buf->b_ml.ml_mfp;
+    DATA_BL	*dp;
+    PTR_BL	*pp;
+    infoptr_T	*ip;
+    int		line_count;	// number of lines in the block
+    int		idx;
+    int		pb_idx;
+    int		stack_idx;
+    int		n;
+    int		i;
+    int		line_start;
+    int		text_end;
+    long	line_size;
+
+    if (lowest_marked && lowest_marked > lnum)
+	lowest_marked -= lowest_marked - lnum < count
+					      ? lowest_marked - lnum : count;
+
+    while (count > 0)
+    {
+	// Release the locked block, so that the line counts in the pointer
+	// blocks are up to date.
+	ml_find_line(buf, (linenr_T)0, ML_FLUSH);
+	if ((hp = ml_find_line(buf, lnum, ML_FIND)) == NULL)
+	    return FAIL;
+	// Line numbers below this block are going to change.
+	ml_leaf_cache_clear(buf);
+
+	dp = (DATA_BL *)(hp->bh_data);
+	line_count = buf->b_ml.ml_locked_high - buf->b_ml.ml_locked_low + 1;
+	idx = lnum - buf->b_ml.ml_locked_low;
+	n = line_count - idx;
+	if (n > count)
+	    n = count;
+
+	for (i = idx; i < idx + n; ++i)
+	{
+	    line_start = ((dp->db_index[i]) & DB_INDEX_MASK);
+	    if (i == 0)		// first line in block, text at the end
+		line_size = dp->db_txt_end - line_start;
+	    else
+		line_size = ((dp->db_index[i - 1]) & DB_INDEX_MASK)
+								  - line_start;
+#ifdef FEAT_NETBEANS_INTG
+	    if (netbeans_active())
+		netbeans_removed(buf, lnum, 0, (long)line_size);
+#endif
+#ifdef FEAT_BYTEOFF
+	    ml_updatechunk(buf, lnum, line_size, ML_CHNK_DELLINE);
+#endif
+	}
+
+	buf->b_ml.ml_line_count -= n;
+	count -= n;
+
+	if (n == line_count)
+	{
+	    // All lines in the data block are deleted: free it and remove
+	    // the entry from the pointer block, and a pointer block that
+	    // becomes empty from its parent.
+	    mf_free(mfp, hp);
+	    buf->b_ml.ml_locked = NULL;
+
+	    for (stack_idx = buf->b_ml.ml_stack_top - 1; stack_idx >= 0;
+								  --stack_idx)
+	    {
+		buf->b_ml.ml_stack_top = 0;	// stack is invalid when failing
+		ip = &(buf->b_ml.ml_stack[stack_idx]);
+		pb_idx = ip->ip_index;
+		if ((hp = mf_get(mfp, ip->ip_bnum, 1)) == NULL)
+		    return FAIL;
+		pp = (PTR_BL *)(hp->bh_data);   // must be pointer block
+		if (pp->pb_id != PTR_ID)
+		{
+		    iemsg(_("E317: pointer block id wrong 4"));
+		    mf_put(mfp, hp, FALSE, FALSE);
+		    return FAIL;
+		}
+		if (--(pp->pb_count) == 0)  // the pointer block becomes empty
+		    mf_free(mfp, hp);
+		else
+		{
+		    if (pb_idx != (int)pp->pb_count)
+			mch_memmove(&pp->pb_pointer[pb_idx],
+				&pp->pb_pointer[pb_idx + 1],
+			     (size_t)(pp->pb_count - pb_idx) * sizeof(PTR_EN));
+		    mf_put(mfp, hp, TRUE, FALSE);
+
+		    // fix line counts for the rest of the blocks in the stack
+		    buf->b_ml.ml_stack_top = stack_idx;	// truncate stack
+		    ml_lineadd(buf, -n);
+		    ip->ip_high -= n;
+		    ++(buf->b_ml.ml_stack_top);
+		    break;
+		}
+	    }
+	    CHECK(stack_idx < 0, _("deleted block 1?"));
+	}
+	else
+	{
+	    // Delete the text by moving the next lines forwards once, and
+	    // the indexes by moving the next indexes backwards.
+	    line_start = ((dp->db_index[idx + n - 1]) & DB_INDEX_MASK);
+	    if (idx == 0)
+		text_end = dp->db_txt_end;
+	    else
+		text_end = ((dp->db_index[idx - 1]) & DB_INDEX_MASK);
+	    line_size = text_end - line_start;
+
+	    mch_memmove((char *)dp + dp->db_txt_start + line_size,
+			(char *)dp + dp->db_txt_start,
+			(size_t)(line_start - dp->db_txt_start));
+	    for (i = idx; i < line_count - n; ++i)
+		dp->db_index[i] = dp->db_index[i + n] + line_size;
+
+	    dp->db_free += line_size + n * INDEX_SIZE;
+	    dp->db_txt_start += line_size;
+	    dp->db_line_count -= n;
+
+	    buf->b_ml.ml_locked_lineadd -= n;
+	    buf->b_ml.ml_locked_high -= n;
+	    // mark the block dirty and make sure it is in the file
+	    buf->b_ml.ml_flags |= (ML_LOCKED_DIRTY | ML_LOCKED_POS);
+	}
+    }
+    return OK;
+}
+
+/*
+ * Delete "count" lines starting at "lnum" in the current buffer.  Much
+ * faster than calling ml_delete() "count" times for many lines.
+ * "flags" are used like with ml_delete_flags().
+ *
+ * Check: The caller of this function should probably also call
+ * deleted_lines() after this.
+ *
+ * return FAIL for failure, OK otherwise
+ */
+    int
+ml_delete_range(linenr_T lnum, long count, int flags)
+{
+    buf_T	*buf = curbuf;
+
+    ml_flush_line(buf);
+    if (lnum < 1 || lnum > buf->b_ml.ml_line_count || buf->b_ml.ml_mfp == NULL)
+	return FAIL;
+    if (count > buf->b_ml.ml_line_count - lnum + 1)
+	count = buf->b_ml.ml_line_count - lnum + 1;
+    if (count <= 0)
+	return OK;
+
+#ifdef FEAT_EVAL
+    // When inserting above recorded changes: flush the changes before changing
+    // the text.
+    may_invoke_listeners(buf, lnum, lnum + count, -count);
+#endif
+
+#ifdef FEAT_PROP_POPUP
+    // Text properties may continue in the next or previous line, let
+    // ml_delete_int() update them.
+    if (buf->b_has_textprop && !(flags & ML_DEL_UNDO))
+    {
+	for ( ; count > 0; --count)
+	    if (ml_delete_int(buf, lnum, flags) == FAIL)
+		return FAIL;
+	return OK;
+    }
+#endif
+
+#ifdef FEAT_MMAP
+    if (ml_unmap(buf) == FAIL)
+	return FAIL;
+#endif
+    if (count < buf->b_ml.ml_line_count)
+	return ml_delete_range_int(buf, lnum, count, flags);
+
+    // Deleting all lines: the last one is replaced with an empty line.
+    if (count > 1 && ml_delete_range_int(buf, (linenr_T)2, count - 1, flags)
+								      == FAIL)
+	return FAIL;
+    return ml_delete_int(buf, (linenr_T)1, flags);
+}
+
 /*
  * set the DB_MARKED flag for line 'lnum'
  */
@@ -3745,6 +4621,20 @@ ml_setmarked(linenr_T lnum)
     if (lowest_marked == 0 || lowest_marked > lnum)
 	lowest_marked = lnum;
 
+#ifdef FEAT_MMAP
+    if (curbuf->b_ml.ml_mapped != NULL)
+    {
+	mlmapped_T *mm = curbuf->b_ml.ml_mapped;
+
+	// Use a bitmap, avoids copying the mapped file into the memline.
+	if (mm->mm_marks == NULL)
+	    mm->mm_marks = alloc_clear(mm->mm_lnum_count / 8 + 1);
+	if (mm->mm_marks != NULL)
+	    mm->mm_marks[(lnum - 1) >> 3] |= 1 << ((lnum - 1) & 7);
+	return;
+    }
+#endif
+
     /*
      * find the data block containing the line
      * This also fills the stack with the blocks from the root to the data block
@@ -3772,6 +4662,24 @@ ml_firstmarked(void)
     if (curbuf->b_ml.ml_mfp == NULL)
 	return (linenr_T) 0;
 
+#ifdef FEAT_MMAP
+    if (curbuf->b_ml.ml_mapped != NULL)
+    {
+	char_u *marks = curbuf->b_ml.ml_mapped->mm_marks;
+
+	if (marks != NULL)
+	    for (lnum = lowest_marked; lnum <= curbuf->b_ml.ml_line_count;
+									++lnum)
+		if (marks[(lnum - 1) >> 3] & (1 << ((lnum - 1) & 7)))
+		{
+		    marks[(lnum - 1) >> 3] &= ~(1 << ((lnum - 1) & 7));
+		    lowest_marked = lnum + 1;
+		    return lnum;
+		}
+	return (linenr_T) 0;
+    }
+#endif
+
     /*
      * The search starts with lowest_marked line. This is the last line where
      * a mark was found, adjusted by inserting/deleting lines.
@@ -3816,6 +4724,15 @@ ml_clearmarked(void)
     if (curbuf->b_ml.ml_mfp == NULL)	    // nothing to do
 	return;
 
+#ifdef FEAT_MMAP
+    if (curbuf->b_ml.ml_mapped != NULL)
+    {
+	VIM_CLEAR(curbuf->b_ml.ml_mapped->mm_marks);
+	lowest_marked = 0;
+	return;
+    }
+#endif
+
     /*
      * The search starts with line lowest_marked.
      */
@@ -4003,6 +4920,7 @@ ml_new_ptr(memfile_T *mfp)
  * the stack is updated to reflect the last line in the block AFTER the
  * insert or delete, also if the pointer block has not been updated yet. But
  * if ml_locked != NULL ml_locked_lineadd must be added to ip_high.
+ * For ML_FIND recently used data blocks are found in ml_leaf_cache.
  *
  * return: NULL for failure, pointer to block header otherwise
  */
@@ -4022,8 +4940,17 @@ ml_find_line(buf_T *buf, linenr_T lnum, int action)
     int		page_count;
     int		idx;
 
+#ifdef FEAT_MMAP
+    // Lines of a mapped file are not in the memline.
+    if (action != ML_FLUSH && ml_unmap(buf) == FAIL)
+	return NULL;
+#endif
     mfp = buf->b_ml.ml_mfp;
 
+    // Inserting or deleting a line changes the line numbers of blocks.
+    if (action == ML_INSERT || action == ML_DELETE)
+	ml_leaf_cache_clear(buf);
+
     /*
      * If there is a locked block check if the wanted line is in it.
      * If not, flush and release the locked block.
@@ -4072,6 +4999,10 @@ ml_find_line(buf_T *buf, linenr_T lnum, int action)
     low = 1;
     high = buf->b_ml.ml_line_count;
 
+    if (action == ML_FIND && !mf_dont_release
+		  && (hp = ml_leaf_cache_find(buf, lnum)) != NULL)
+	return hp;
+
     if (action == ML_FIND)	// first try stack entries
     {
 	for (top = buf->b_ml.ml_stack_top - 1; top >= 0; --top)
@@ -4116,6 +5047,8 @@ ml_find_line(buf_T *buf, linenr_T lnum, int action)
 	    buf->b_ml.ml_locked_high = high;
 	    buf->b_ml.ml_locked_lineadd = 0;
 	    buf->b_ml.ml_flags &= ~(ML_LOCKED_DIRTY | ML_LOCKED_POS);
+	    if (action == ML_FIND)
+		ml_leaf_cache_add(buf, bnum, page_count);
 	    return hp;
 	}
 
@@ -4203,6 +5136,114 @@ error_noblock:
     return NULL;
 }
 
+/*
+ * Find the data block with line "lnum" in the cache of recently used data
+ * blocks.  When found the block is locked and the stack is restored, like
+ * ml_find_line() does.
+ * Returns NULL when not found.
+ */
+    static bhdr_T *
+ml_leaf_cache_find(buf_T *buf, linenr_T lnum)
+{
+    mlleaf_T	*lc;
+    bhdr_T	*hp;
+    int		i;
+
+    if (buf->b_ml.ml_leaf_cache == NULL)
+	return NULL;
+    for (i = 0; i < ML_LEAF_CACHE_SIZE; ++i)
+    {
+	lc = &buf->b_ml.ml_leaf_cache[i];
+	if (lc->lc_bnum != 0 && lc->lc_low <= lnum && lc->lc_high >= lnum)
+	    break;
+    }
+    if (i == ML_LEAF_CACHE_SIZE
+			      || lc->lc_stack_top > buf->b_ml.ml_stack_size)
+	return NULL;
+
+    // A negative block number fails when it was changed to a positive one,
+    // then the pointer block needs to be updated by walking down the tree.
+    hp = mf_get(buf->b_ml.ml_mfp, lc->lc_bnum, lc->lc_page_count);
+    if (hp == NULL || ((DATA_BL *)(hp->bh_data))->db_id != DATA_ID
+		    || (linenr_T)((DATA_BL *)(hp->bh_data))->db_line_count
+						!= lc->lc_high - lc->lc_low + 1)
+    {
+	if (hp != NULL)
+	    mf_put(buf->b_ml.ml_mfp, hp, FALSE, FALSE);
+	lc->lc_bnum = 0;
+	return NULL;
+    }
+
+    lc->lc_used = ++buf->b_ml.ml_leaf_clock;
+    mch_memmove(buf->b_ml.ml_stack, lc->lc_stack,
+				  (size_t)lc->lc_stack_top * sizeof(infoptr_T));
+    buf->b_ml.ml_stack_top = lc->lc_stack_top;
+    buf->b_ml.ml_locked = hp;
+    buf->b_ml.ml_locked_low = lc->lc_low;
+    buf->b_ml.ml_locked_high = lc->lc_high;
+    buf->b_ml.ml_locked_lineadd = 0;
+    buf->b_ml.ml_flags &= ~(ML_LOCKED_DIRTY | ML_LOCKED_POS);
+    return hp;
+}
+
+/*
+ * Remember the locked data block "bnum" and the stack leading to it in the
+ * cache of recently used data blocks, replacing the least recently used one.
+ */
+    static void
+ml_leaf_cache_add(buf_T *buf, blocknr_T bnum, int page_count)
+{
+    mlleaf_T	*lc;
+    mlleaf_T	*oldest = NULL;
+    int		i;
+
+    if (buf->b_ml.ml_stack_top > ML_LEAF_CACHE_DEPTH)
+	return;
+    if (buf->b_ml.ml_leaf_cache == NULL)
+    {
+	buf->b_ml.ml_leaf_cache = ALLOC_CLEAR_MULT(mlleaf_T,
+							   ML_LEAF_CACHE_SIZE);
+	if (buf->b_ml.ml_leaf_cache == NULL)
+	    return;
+    }
+
+    for (i = 0; i < ML_LEAF_CACHE_SIZE; ++i)
+    {
+	lc = &buf->b_ml.ml_leaf_cache[i];
+	if (lc->lc_bnum == 0)
+	{
+	    oldest = lc;
+	    break;
+	}
+	// unsigned arithmetic also works when ml_leaf_clock wrapped around
+	if (oldest == NULL || buf->b_ml.ml_leaf_clock - lc->lc_used
+				   > buf->b_ml.ml_leaf_clock - oldest->lc_used)
+	    oldest = lc;
+    }
+
+    oldest->lc_bnum = bnum;
+    oldest->lc_page_count = page_count;
+    oldest->lc_low = buf->b_ml.ml_locked_low;
+    oldest->lc_high = buf->b_ml.ml_locked_high;
+    oldest->lc_used = ++buf->b_ml.ml_leaf_clock;
+    oldest->lc_stack_top = buf->b_ml.ml_stack_top;
+    mch_memmove(oldest->lc_stack, buf->b_ml.ml_stack,
+			     (size_t)oldest->lc_stack_top * sizeof(infoptr_T));
+}
+
+/*
+ * Forget all cached data blocks, after line numbers changed.
+ */
+    static void
+ml_leaf_cache_clear(buf_T *buf)
+{
+    int		i;
+
+    if (buf->b_ml.ml_leaf_cache != NULL)
+	for (i = 0; i < ML_LEAF_CACHE_SIZE; ++i)
+	    buf->b_ml.ml_leaf_cache[i].lc_bnum = 0;
+}
+
 /*
  * add an entry to the info pointer stack
  *
@@ -5356,6 +6397,117 @@ ml_crypt_prepare(memfile_T *mfp, off_T offset, int reading)
 
 #if defined(FEAT_BYTEOFF) || defined(PROTO)
 
+/*
+ * The sums of chunks are kept in a Fenwick tree, so that finding the chunk
+ * for a line or byte offset and updating a chunk take O(log n) time.  When
+ * chunks are split or joined the tree is rebuilt the next time it is used.
+ */
+
+/*
+ * Add "lines" and "size" to chunk "curix" in the tree.
+ */
+    static void
+ml_chunktree_add(buf_T *buf, int curix, int lines, long size)
+{
+    chunksize_T	*tree = buf->b_ml.ml_chunktree;
+    int		i;
+
+    if (buf->b_ml.ml_chunktree_len == 0)
+	return;	    // rebuilt when needed
+    for (i = curix + 1; i <= buf->b_ml.ml_chunktree_len; i += i & -i)
+    {
+	tree[i].mlcs_numlines += lines;
+	tree[i].mlcs_totalsize += size;
+    }
+}
+
+/*
+ * Build the tree from ml_chunksize when it is not valid.
+ * Returns FAIL when out of memory.
+ */
+    static int
+ml_chunktree_build(buf_T *buf)
+{
+    int		n = buf->b_ml.ml_usedchunks;
+    chunksize_T	*tree;
+    int		i;
+    int		j;
+
+    if (buf->b_ml.ml_chunktree_len != 0)
+	return OK;
+    if (buf->b_ml.ml_chunktree_size < n + 1)
+    {
+	tree = ALLOC_MULT(chunksize_T, buf->b_ml.ml_numchunks + 1);
+	if (tree == NULL)
+	    return FAIL;
+	vim_free(buf->b_ml.ml_chunktree);
+	buf->b_ml.ml_chunktree = tree;
+	buf->b_ml.ml_chunktree_size = buf->b_ml.ml_numchunks + 1;
+    }
+    tree = buf->b_ml.ml_chunktree;
+    mch_memmove(tree + 1, buf->b_ml.ml_chunksize, n * sizeof(chunksize_T));
+    for (i = 1; i <= n; ++i)
+    {
+	j = i + (i & -i);
+	if (j <= n)
+	{
+	    tree[j].mlcs_numlines += tree[i].mlcs_numlines;
+	    tree[j].mlcs_totalsize += tree[i].mlcs_totalsize;
+	}
+    }
+    buf->b_ml.ml_chunktree_len = n;
+    return OK;
+}
+
+/*
+ * Find the chunk that contains line "lnum" when it is not zero, or the chunk
+ * that contains byte "offset" when it is not zero.  The last chunk is used
+ * when beyond the end.  "ffdos" is TRUE when a CR is counted for each line in
+ * "offset".
+ * Sets "*curlinep" to the first line in the chunk and "*sizep" to the number
+ * of bytes before it, including CRs when "offset" is not zero.
+ * Returns the index of the chunk, -1 when out of memory.
+ */
+    static int
+ml_chunk_find(
+    buf_T	*buf,
+    linenr_T	lnum,
+    long	offset,
+    int		ffdos,
+    linenr_T	*curlinep,
+    long	*sizep)
+{
+    int		limit = buf->b_ml.ml_usedchunks - 1;
+    int		pos = 0;
+    int		step;
+    linenr_T	lines = 0;
+    long	size = 0;
+    chunksize_T	*t;
+
+    if (ml_chunktree_build(buf) == FAIL)
+	return -1;
+    for (step = 1; step * 2 <= limit; step *= 2)
+	;
+    for ( ; step > 0; step /= 2)
+    {
+	if (pos + step > limit)
+	    continue;
+	t = buf->b_ml.ml_chunktree + pos + step;
+	if ((lnum != 0 && lnum >= 1 + lines + t->mlcs_numlines)
+		|| (offset != 0 && offset > size + t->mlcs_totalsize
+				    + ffdos * (lines + t->mlcs_numlines)))
+	{
+	    pos += step;
+	    lines += t->mlcs_numlines;
+	    size += t->mlcs_totalsize;
+	}
+    }
+    *curlinep = lines + 1;
+    if (sizep != NULL)
+	*sizep = offset != 0 && ffdos ? size + lines : size;
+    return pos;
+}
+
 #define MLCS_MAXL 800	// max no of lines in chunk
 #define MLCS_MINL 400   // should be half of MLCS_MAXL
 
@@ -5400,6 +6552,7 @@ ml_updatechunk(
 	buf->b_ml.ml_usedchunks = 1;
 	buf->b_ml.ml_chunksize[0].mlcs_numlines = 1;
 	buf->b_ml.ml_chunksize[0].mlcs_totalsize = 1;
+	buf->b_ml.ml_chunktree_len = 0;
     }
 
     if (updtype == ML_CHNK_UPDLINE && buf->b_ml.ml_line_count == 1)
@@ -5410,6 +6563,7 @@ ml_updatechunk(
 	buf->b_ml.ml_usedchunks = 1;
 	buf->b_ml.ml_chunksize[0].mlcs_numlines = 1;
 	buf->b_ml.ml_chunksize[0].mlcs_totalsize = (long)buf->b_ml.ml_line_len;
+	buf->b_ml.ml_chunktree_len = 0;
 	return;
     }
 
@@ -5420,11 +6574,12 @@ ml_updatechunk(
     if (buf != ml_upd_lastbuf || line != ml_upd_lastline + 1
 	    || updtype != ML_CHNK_ADDLINE)
     {
-	for (curline = 1, curix = 0;
-	     curix < buf->b_ml.ml_usedchunks - 1
-	     && line >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	     curix++)
-	    curline += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
+	curix = ml_chunk_find(buf, line, 0L, FALSE, &curline, NULL);
+	if (curix < 0)
+	{
+	    buf->b_ml.ml_usedchunks = -1;
+	    return;
+	}
     }
     else if (curix < buf->b_ml.ml_usedchunks - 1
 	      && line >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines)
@@ -5438,6 +6593,8 @@ ml_updatechunk(
     if (updtype == ML_CHNK_DELLINE)
 	len = -len;
     curchnk->mlcs_totalsize += len;
+    ml_chunktree_add(buf, curix, updtype == ML_CHNK_ADDLINE ? 1
+				  : updtype == ML_CHNK_DELLINE ? -1 : 0, len);
     if (updtype == ML_CHNK_ADDLINE)
     {
 	curchnk->mlcs_numlines++;
@@ -5527,6 +6684,7 @@ ml_updatechunk(
 	    buf->b_ml.ml_chunksize[curix].mlcs_totalsize = size;
 	    buf->b_ml.ml_chunksize[curix + 1].mlcs_totalsize -= size;
 	    buf->b_ml.ml_usedchunks++;
+	    buf->b_ml.ml_chunktree_len = 0;
 	    ml_upd_lastbuf = NULL;   // Force recalc of curix & curline
 	    return;
 	}
@@ -5540,6 +6698,7 @@ ml_updatechunk(
 	     */
 	    curchnk = buf->b_ml.ml_chunksize + curix + 1;
 	    buf->b_ml.ml_usedchunks++;
+	    buf->b_ml.ml_chunktree_len = 0;
 	    if (line == buf->b_ml.ml_line_count)
 	    {
 		curchnk->mlcs_numlines = 0;
@@ -5585,6 +6744,7 @@ ml_updatechunk(
 	else if (curix == 0 && curchnk->mlcs_numlines <= 0)
 	{
 	    buf->b_ml.ml_usedchunks--;
+	    buf->b_ml.ml_chunktree_len = 0;
 	    mch_memmove(buf->b_ml.ml_chunksize, buf->b_ml.ml_chunksize + 1,
 			buf->b_ml.ml_usedchunks * sizeof(chunksize_T));
 	    return;
@@ -5600,6 +6760,7 @@ ml_updatechunk(
 	curchnk[-1].mlcs_numlines += curchnk->mlcs_numlines;
 	curchnk[-1].mlcs_totalsize += curchnk->mlcs_totalsize;
 	buf->b_ml.ml_usedchunks--;
+	buf->b_ml.ml_chunktree_len = 0;
 	if (curix < buf->b_ml.ml_usedchunks)
 	{
 	    mch_memmove(buf->b_ml.ml_chunksize + curix,
@@ -5625,7 +6786,6 @@ ml_updatechunk(
 ml_find_line_or_offset(buf_T *buf, linenr_T lnum, long *offp)
 {
     linenr_T	curline;
-    int		curix;
     long	size;
     bhdr_T	*hp;
     DATA_BL	*dp;
@@ -5641,6 +6801,10 @@ ml_find_line_or_offset(buf_T *buf, linenr_T lnum, long *offp)
     // take care of cached line first
     ml_flush_line(curbuf);
 
+#ifdef FEAT_MMAP
+    if (buf->b_ml.ml_mapped != NULL && lnum >= 0)
+	return ml_find_mapped_offset(buf, lnum, offp);
+#endif
     if (buf->b_ml.ml_usedchunks == -1
 	    || buf->b_ml.ml_chunksize == NULL
 	    || lnum < 0)
@@ -5653,24 +6817,10 @@ ml_find_line_or_offset(buf_T *buf, linenr_T lnum, long *offp)
     if (lnum == 0 && offset <= 0)
 	return 1;   // Not a "find offset" and offset 0 _must_ be in line 1
     /*
-     * Find the last chunk before the one containing our line. Last chunk is
-     * special because it will never qualify
+     * Find the chunk containing our line.
      */
-    curline = 1;
-    curix = size = 0;
-    while (curix < buf->b_ml.ml_usedchunks - 1
-	    && ((lnum != 0
-	     && lnum >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines)
-		|| (offset != 0
-	       && offset > size + buf->b_ml.ml_chunksize[curix].mlcs_totalsize
-		      + ffdos * buf->b_ml.ml_chunksize[curix].mlcs_numlines)))
-    {
-	curline += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	size += buf->b_ml.ml_chunksize[curix].mlcs_totalsize;
-	if (offset && ffdos)
-	    size += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	curix++;
-    }
+    if (ml_chunk_find(buf, lnum, offset, ffdos, &curline, &size) < 0)
+	return -1;
 
     while ((lnum != 0 && curline < lnum) || (offset != 0 && size < offset))
     {
@@ -2256,6 +2256,99 @@ veryfast_breakcheck(void)
 # define SEEK_END 2
 #endif
 
+/*
+ * Turn "buffer[len]", the output of a command, into the result of
+ * get_cmd_output().
+ */
+    static char_u *
+cmd_output_result(char_u *buffer, int len, int *ret_len)
+{
+    int		i;
+
+    if (ret_len == NULL)
+    {
+	// Change NUL into SOH, otherwise the string is truncated.
+	for (i = 0; i < len; ++i)
+	    if (buffer[i] == NUL)
+		buffer[i] = 1;
+
+	buffer[len] = NUL;	// make sure the buffer is terminated
+    }
+    else
+	*ret_len = len;
+    return buffer;
+}
+
+#if defined(UNIX) && !defined(USE_SYSTEM)
+/*
+ * Get the stdout of an external command through a pipe, like
+ * get_cmd_output() does with temp files.  "input[input_len]" is written to
+ * the stdin of the command.  When "input" is NULL stdin is /dev/null.
+ * When 'shellredir' can't be done with a pipe "*done" is set to FALSE and the
+ * caller needs to use temp files.
+ * Returns an allocated string, or NULL for error.
+ */
+    static char_u *
+get_cmd_output_pipe(
+    char_u	*cmd,
+    char_u	*input,
+    long	input_len,
+    int		flags,
+    int		*ret_len,
+    int		*done)
+{
+    char	*redir;
+    char_u	*shell_name;
+    int		is_fish_shell;
+    char_u	*command;
+    size_t	len;
+    shellio_T	io;
+
+    // Only handle the usual values, stdout and stderr of the command or just
+    // stdout.  Anything else, e.g. ">&" for csh, uses a temp file.
+    if (STRCMP(p_srr, ">%s 2>&1") == 0)
+	redir = " 2>&1";
+    else if (STRCMP(p_srr, ">") == 0 || STRCMP(p_srr, ">%s") == 0)
+	redir = "";
+    else
+    {
+	*done = FALSE;
+	return NULL;
+    }
+    *done = TRUE;
+
+    // Put braces around the command, like make_filter_cmd() does.
+    shell_name = get_isolated_shell_name();
+    is_fish_shell = (fnamecmp(shell_name, "fish") == 0);
+    vim_free(shell_name);
+    len = STRLEN(cmd) + 18;		// "begin; " + "; end" + " 2>&1" + NUL
+    command = alloc(len);
+    if (command == NULL)
+	return NULL;
+    vim_snprintf((char *)command, len,
+		   is_fish_shell ? "begin; %s; end%s" : "(%s)%s", cmd, redir);
+
+    io.si_input = input;
+    io.si_input_len = input_len;
+    ga_init2(&io.si_output, 1, 4096);
+
+    // Don't check timestamps here.
+    ++no_check_timestamps;
+    call_shell_io(command, SHELL_DOOUT | SHELL_EXPAND | flags, &io);
+    --no_check_timestamps;
+    vim_free(command);
+
+    // Make room for the terminating NUL.
+    if (ga_grow(&io.si_output, 1) == FAIL)
+    {
+	ga_clear(&io.si_output);
+	return NULL;
+    }
+    return cmd_output_result(io.si_output.ga_data, io.si_output.ga_len,
+								     ret_len);
+}
+#endif
+
 /*
  * Get the stdout of an external command.
  * If "ret_len" is NULL replace NUL characters with NL.  When "ret_len" is not
@@ -2279,6 +2372,17 @@ get_cmd_output(
     if (check_restricted() || check_secure())
 	return NULL;
 
+#if defined(UNIX) && !defined(USE_SYSTEM)
+    if (infile == NULL)
+    {
+	int	done;
+
+	buffer = get_cmd_output_pipe(cmd, NULL, 0L, flags, ret_len, &done);
+	if (done)
+	    return buffer;
+    }
+#endif
+
     // get a name for the temp file
     if ((tempname = vim_tempname('o', FALSE)) == NULL)
     {
@@ -2336,17 +2440,8 @@ get_cmd_output(
 	semsg(_(e_notread), tempname);
 	VIM_CLEAR(buffer);
     }
-    else if (ret_len == NULL)
-    {
-	// Change NUL into SOH, otherwise the string is truncated.
-	for (i = 0; i < len; ++i)
-	    if (buffer[i] == NUL)
-		buffer[i] = 1;
-
-	buffer[len] = NUL;	// make sure the buffer is terminated
-    }
     else
-	*ret_len = len;
+	cmd_output_result(buffer, len, ret_len);
 
 done:
     vim_free(tempname);
@@ -2355,6 +2450,86 @@ done:
 
 # if defined(FEAT_EVAL) || defined(PROTO)
 
+/*
+ * Append "line" to "gap", with NL characters changed to NUL.  When "add_nl"
+ * is TRUE append a NL.
+ * Returns FAIL when out of memory.
+ */
+    static int
+cmd_input_add_line(garray_T *gap, char_u *line, int add_nl)
+{
+    int		len = (int)STRLEN(line);
+    char_u	*p;
+    int		i;
+
+    if (ga_grow(gap, len + 1) == FAIL)
+	return FAIL;
+    p = (char_u *)gap->ga_data + gap->ga_len;
+    for (i = 0; i < len; ++i)
+	p[i] = line[i] == '\n' ? NUL : line[i];
+    if (add_nl)
+	p[len++] = NL;
+    gap->ga_len += len;
+    return OK;
+}
+
+/*
+ * Append the text of "tv", the input argument of system(), to "gap".
+ * NL characters in a line become NUL, like with writefile().
+ * Returns FAIL when there is an error, the message has been given.
+ */
+    static int
+cmd_input_to_ga(typval_T *tv, garray_T *gap)
+{
+    char_u	*p;
+
+    if (tv->v_type == VAR_NUMBER)
+    {
+	linenr_T	lnum;
+	buf_T		*buf;
+
+	buf = buflist_findnr(tv->vval.v_number);
+	if (buf == NULL)
+	{
+	    semsg(_(e_nobufnr), tv->vval.v_number);
+	    return FAIL;
+	}
+
+	for (lnum = 1; lnum <= buf->b_ml.ml_line_count; lnum++)
+	    if (cmd_input_add_line(gap, ml_get_buf(buf, lnum, FALSE), TRUE)
+								      == FAIL)
+		return FAIL;
+    }
+    else if (tv->v_type == VAR_LIST)
+    {
+	list_T	    *list = tv->vval.v_list;
+	listitem_T  *li;
+
+	if (list == NULL)
+	    return OK;
+	CHECK_LIST_MATERIALIZE(list);
+	FOR_ALL_LIST_ITEMS(list, li)
+	    if (cmd_input_add_line(gap, tv_get_string(&li->li_tv),
+						    li->li_next != NULL) == FAIL)
+		return FAIL;
+    }
+    else
+    {
+	char_u	buf[NUMBUFLEN];
+	int	len;
+
+	p = tv_get_string_buf_chk(tv, buf);
+	if (p == NULL)
+	    return FAIL;		// type error; errmsg already given
+	len = (int)STRLEN(p);
+	if (ga_grow(gap, len) == FAIL)
+	    return FAIL;
+	mch_memmove((char_u *)gap->ga_data + gap->ga_len, p, (size_t)len);
+	gap->ga_len += len;
+    }
+    return OK;
+}
+
     static void
 get_cmd_output_as_rettv(
     typval_T	*argvars,
@@ -2364,11 +2539,16 @@ get_cmd_output_as_rettv(
     char_u	*res = NULL;
     char_u	*p;
     char_u	*infile = NULL;
-    int		err = FALSE;
-    FILE	*fd;
+    garray_T	input;
+    int		has_input = FALSE;
     list_T	*list = NULL;
     int		flags = SHELL_SILENT;
+    int		len = 0;
+#if defined(UNIX) && !defined(USE_SYSTEM)
+    int		done = FALSE;
+#endif
 
+    ga_init2(&input, 1, 4096);
     rettv->v_type = VAR_STRING;
     rettv->vval.v_string = NULL;
     if (check_restricted() || check_secure())
@@ -2376,94 +2556,70 @@ get_cmd_output_as_rettv(
 
     if (argvars[1].v_type != VAR_UNKNOWN)
     {
-	/*
-	 * Write the text to a temp file, to be used for input of the shell
-	 * command.
-	 */
-	if ((infile = vim_tempname('i', TRUE)) == NULL)
-	{
-	    emsg(_(e_notmp));
+	// Collect the text to be used for input of the shell command.
+	if (cmd_input_to_ga(&argvars[1], &input) == FAIL)
 	    goto errret;
-	}
+	has_input = TRUE;
+    }
 
-	fd = mch_fopen((char *)infile, WRITEBIN);
-	if (fd == NULL)
-	{
-	    semsg(_(e_notopen), infile);
-	    goto errret;
-	}
-	if (argvars[1].v_type == VAR_NUMBER)
+    // Omit SHELL_COOKED when invoked with ":silent".  Avoids that the shell
+    // echoes typeahead, that messes up the display.
+    if (!msg_silent)
+	flags += SHELL_COOKED;
+
+#if defined(UNIX) && !defined(USE_SYSTEM)
+    // Pass the input and get the output through pipes.
+    // Empty input is not the same as no input, make sure ga_data is set.
+    if (has_input && ga_grow(&input, 1) == FAIL)
+	goto errret;
+    res = get_cmd_output_pipe(tv_get_string(&argvars[0]),
+		    has_input ? input.ga_data : NULL, (long)input.ga_len, flags,
+					       retlist ? &len : NULL, &done);
+    if (!done)
+#endif
+    {
+	if (has_input)
 	{
-	    linenr_T	lnum;
-	    buf_T	*buf;
+	    FILE	*fd;
+	    int		err = FALSE;
 
-	    buf = buflist_findnr(argvars[1].vval.v_number);
-	    if (buf == NULL)
+	    // Write the text to a temp file, to be used for input of the
+	    // shell command.
+	    if ((infile = vim_tempname('i', TRUE)) == NULL)
 	    {
-		semsg(_(e_nobufnr), argvars[1].vval.v_number);
-		fclose(fd);
+		emsg(_(e_notmp));
 		goto errret;
 	    }
 
-	    for (lnum = 1; lnum <= buf->b_ml.ml_line_count; lnum++)
+	    fd = mch_fopen((char *)infile, WRITEBIN);
+	    if (fd == NULL)
 	    {
-		for (p = ml_get_buf(buf, lnum, FALSE); *p != NUL; ++p)
-		    if (putc(*p == '\n' ? NUL : *p, fd) == EOF)
-		    {
-			err = TRUE;
-			break;
-		    }
-		if (putc(NL, fd) == EOF)
-		{
-		    err = TRUE;
-		    break;
-		}
+		semsg(_(e_notopen), infile);
+		goto errret;
 	    }
-	}
-	else if (argvars[1].v_type == VAR_LIST)
-	{
-	    if (write_list(fd, argvars[1].vval.v_list, TRUE) == FAIL)
+	    if (input.ga_len > 0
+		    && fwrite(input.ga_data, (size_t)input.ga_len, 1, fd) != 1)
 		err = TRUE;
-	}
-	else
-	{
-	    size_t	len;
-	    char_u	buf[NUMBUFLEN];
-
-	    p = tv_get_string_buf_chk(&argvars[1], buf);
-	    if (p == NULL)
+	    if (fclose(fd) != 0)
+		err = TRUE;
+	    if (err)
 	    {
-		fclose(fd);
-		goto errret;		// type error; errmsg already given
+		emsg(_("E677: Error writing temp file"));
+		goto errret;
 	    }
-	    len = STRLEN(p);
-	    if (len > 0 && fwrite(p, len, 1, fd) != 1)
-		err = TRUE;
-	}
-	if (fclose(fd) != 0)
-	    err = TRUE;
-	if (err)
-	{
-	    emsg(_("E677: Error writing temp file"));
-	    goto errret;
 	}
+	res = get_cmd_output(tv_get_string(&argvars[0]), infile, flags,
+						      retlist ? &len : NULL);
     }
 
-    // Omit SHELL_COOKED when invoked with ":silent".  Avoids that the shell
-    // echoes typeahead, that messes up the display.
-    if (!msg_silent)
-	flags += SHELL_COOKED;
-
     if (retlist)
     {
-	int		len;
 	listitem_T	*li;
 	char_u		*s = NULL;
 	char_u		*start;
 	char_u		*end;
 	int		i;
 
-	res = get_cmd_output(tv_get_string(&argvars[0]), infile, flags, &len);
 	if (res == NULL)
 	    goto errret;
 
@@ -2503,7 +2659,6 @@ get_cmd_output_as_rettv(
     }
     else
     {
-	res = get_cmd_output(tv_get_string(&argvars[0]), infile, flags, NULL);
 #ifdef USE_CRNL
 	// translate <CR><NL> into <NL>
 	if (res != NULL)
@@ -2525,6 +2680,7 @@ get_cmd_output_as_rettv(
     }
 
 errret:
+    ga_clear(&input);
     if (infile != NULL)
     {
 	mch_remove(infile);
@@ -3163,11 +3163,35 @@ default_fileformat(void)
     return EOL_UNIX;
 }
 
+/*
+ * Call mch_call_shell(), or mch_call_shell_io() when "io" is not NULL.
+ */
+    static int
+call_mch_shell(char_u *cmd, int opt, shellio_T *io UNUSED)
+{
+#if defined(UNIX) && !defined(USE_SYSTEM)
+    if (io != NULL)
+	return mch_call_shell_io(cmd, opt, io);
+#endif
+    return mch_call_shell(cmd, opt);
+}
+
 /*
  * Call shell.	Calls mch_call_shell, with 'shellxquote' added.
  */
     int
 call_shell(char_u *cmd, int opt)
+{
+    return call_shell_io(cmd, opt, NULL);
+}
+
+/*
+ * Like call_shell(), but when "io" is not NULL the command reads its stdin
+ * from "io->si_input" and its stdout is stored in "io->si_output", through
+ * pipes.  Only supported on Unix.
+ */
+    int
+call_shell_io(char_u *cmd, int opt, shellio_T *io)
 {
     char_u	*ncmd;
     int		retval;
@@ -3207,7 +3231,7 @@ call_shell(char_u *cmd, int opt)
 	tag_freematch();
 
 	if (cmd == NULL || *p_sxq == NUL)
-	    retval = mch_call_shell(cmd, opt);
+	    retval = call_mch_shell(cmd, opt, io);
 	else
 	{
 	    char_u *ecmd = cmd;
@@ -3228,7 +3252,7 @@ call_shell(char_u *cmd, int opt)
 		STRCAT(ncmd, *p_sxq == '(' ? (char_u *)")"
 		    : *p_sxq == '"' && *(p_sxq+1) == '(' ? (char_u *)")\""
 		    : p_sxq);
-		retval = mch_call_shell(ncmd, opt);
+		retval = call_mch_shell(ncmd, opt, io);
 		vim_free(ncmd);
 	    }
 	    else
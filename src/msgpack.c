@@ -0,0 +1,557 @@
+/* vi:set ts=8 sts=4 sw=4 noet:
+ *
+ * VIM - Vi IMproved	by Bram Moolenaar
+ *
+ * Do ":help uganda"  in Vim to read copying and usage conditions.
+ * Do ":help credits" in Vim to see a list of people who contributed.
+ * See README.txt for an overview of the Vim source code.
+ */
+
+/*
+ * msgpack.c: Encoding and decoding MessagePack, for channels in "msgpack"
+ * mode.
+ *
+ * Follows this specification: https://github.com/msgpack/msgpack/blob/master/spec.md
+ */
+#define USING_FLOAT_STUFF
+
+#include "vim.h"
+
+#if defined(FEAT_JOB_CHANNEL) || defined(PROTO)
+
+// Nesting deeper than this is refused when decoding.
+#define MSGPACK_MAXNEST 1000
+
+static char e_msgpack_recursive[] =
+	N_("E1902: Cannot send a List or Dictionary that contains itself");
+
+static int msgpack_encode_item(garray_T *gap, typval_T *val, int copyID);
+
+/*
+ * Append "nbytes" bytes of "val", big-endian, to "gap".
+ * Room must have been made.
+ */
+    static void
+mp_put_be(garray_T *gap, varnumber_T val, int nbytes)
+{
+    char_u  *p = (char_u *)gap->ga_data + gap->ga_len;
+    int	    i;
+
+    for (i = nbytes - 1; i >= 0; --i)
+    {
+	p[i] = (char_u)(val & 0xff);
+	val >>= 8;
+    }
+    gap->ga_len += nbytes;
+}
+
+/*
+ * Append the type byte "type" followed by "nbytes" of "val" to "gap".
+ */
+    static int
+mp_put_type_val(garray_T *gap, int type, varnumber_T val, int nbytes)
+{
+    if (ga_grow(gap, nbytes + 1) == FAIL)
+	return FAIL;
+    ((char_u *)gap->ga_data)[gap->ga_len++] = type;
+    mp_put_be(gap, val, nbytes);
+    return OK;
+}
+
+/*
+ * Append a header for an item of type "fix", "t8", "t16" or "t32" and length
+ * "len".  Use "fix" when "len" is below "fixmax", "t8" is not used when it
+ * is zero.
+ */
+    static int
+mp_put_header(
+	garray_T    *gap,
+	long_u	    len,
+	int	    fix,
+	long_u	    fixmax,
+	int	    t8,
+	int	    t16,
+	int	    t32)
+{
+    if (len < fixmax)
+	return mp_put_type_val(gap, fix | (int)len, 0, 0);
+    if (t8 != 0 && len <= 0xff)
+	return mp_put_type_val(gap, t8, (varnumber_T)len, 1);
+    if (len <= 0xffff)
+	return mp_put_type_val(gap, t16, (varnumber_T)len, 2);
+    return mp_put_type_val(gap, t32, (varnumber_T)len, 4);
+}
+
+/*
+ * Append a number to "gap", using the smallest format.
+ */
+    static int
+mp_put_number(garray_T *gap, varnumber_T n)
+{
+    if (n >= 0)
+    {
+	if (n < 0x80)
+	    return mp_put_type_val(gap, (int)n, 0, 0);
+	if (n <= 0xff)
+	    return mp_put_type_val(gap, 0xcc, n, 1);
+	if (n <= 0xffff)
+	    return mp_put_type_val(gap, 0xcd, n, 2);
+	if (n <= 0xffffffffLL)
+	    return mp_put_type_val(gap, 0xce, n, 4);
+	return mp_put_type_val(gap, 0xcf, n, 8);
+    }
+    if (n >= -32)
+	return mp_put_type_val(gap, (int)(n & 0xff), 0, 0);
+    if (n >= -0x80)
+	return mp_put_type_val(gap, 0xd0, n, 1);
+    if (n >= -0x8000)
+	return mp_put_type_val(gap, 0xd1, n, 2);
+    if (n >= -0x80000000LL)
+	return mp_put_type_val(gap, 0xd2, n, 4);
+    return mp_put_type_val(gap, 0xd3, n, 8);
+}
+
+/*
+ * Append "len" bytes of "p" as a "str" or "bin" item.
+ */
+    static int
+mp_put_bytes(garray_T *gap, char_u *p, long_u len, int bin)
+{
+    if ((bin ? mp_put_header(gap, len, 0, 0, 0xc4, 0xc5, 0xc6)
+	     : mp_put_header(gap, len, 0xa0, 32, 0xd9, 0xda, 0xdb)) == FAIL
+	    || ga_grow(gap, (int)len) == FAIL)
+	return FAIL;
+    if (len > 0)
+	mch_memmove((char_u *)gap->ga_data + gap->ga_len, p, (size_t)len);
+    gap->ga_len += (int)len;
+    return OK;
+}
+
+/*
+ * Encode "val" into "gap".
+ * Return FAIL or OK.
+ */
+    static int
+msgpack_encode_item(garray_T *gap, typval_T *val, int copyID)
+{
+    char_u	*s;
+    blob_T	*b;
+    list_T	*l;
+    dict_T	*d;
+
+    switch (val->v_type)
+    {
+	case VAR_BOOL:
+	    return mp_put_type_val(gap,
+		      val->vval.v_number == VVAL_TRUE ? 0xc3 : 0xc2, 0, 0);
+
+	case VAR_SPECIAL:
+	    // v:null and v:none both become nil
+	    return mp_put_type_val(gap, 0xc0, 0, 0);
+
+	case VAR_NUMBER:
+	    return mp_put_number(gap, val->vval.v_number);
+
+	case VAR_STRING:
+	    s = val->vval.v_string;
+	    return mp_put_bytes(gap, s, s == NULL ? 0 : (long_u)STRLEN(s), FALSE);
+
+	case VAR_BLOB:
+	    b = val->vval.v_blob;
+	    if (b == NULL)
+		return mp_put_bytes(gap, NULL, 0, TRUE);
+	    return mp_put_bytes(gap, b->bv_ga.ga_data, b->bv_ga.ga_len, TRUE);
+
+	case VAR_LIST:
+	    l = val->vval.v_list;
+	    if (l == NULL)
+		return mp_put_header(gap, 0, 0x90, 16, 0, 0xdc, 0xdd);
+	    if (l->lv_copyID == copyID)
+	    {
+		// A recursive reference can't be sent.
+		emsg(_(e_msgpack_recursive));
+		return FAIL;
+	    }
+	    else
+	    {
+		listitem_T	*li;
+		int		ret = OK;
+
+		CHECK_LIST_MATERIALIZE(l);
+		if (mp_put_header(gap, l->lv_len, 0x90, 16, 0, 0xdc, 0xdd)
+									== FAIL)
+		    return FAIL;
+		l->lv_copyID = copyID;
+		for (li = l->lv_first; li != NULL && ret == OK; li = li->li_next)
+		    ret = msgpack_encode_item(gap, &li->li_tv, copyID);
+		l->lv_copyID = 0;
+		return ret;
+	    }
+
+	case VAR_DICT:
+	    d = val->vval.v_dict;
+	    if (d == NULL)
+		return mp_put_header(gap, 0, 0x80, 16, 0, 0xde, 0xdf);
+	    if (d->dv_copyID == copyID)
+	    {
+		emsg(_(e_msgpack_recursive));
+		return FAIL;
+	    }
+	    else
+	    {
+		int		todo = (int)d->dv_hashtab.ht_used;
+		hashitem_T	*hi;
+		int		ret = OK;
+
+		if (mp_put_header(gap, todo, 0x80, 16, 0, 0xde, 0xdf) == FAIL)
+		    return FAIL;
+		d->dv_copyID = copyID;
+		for (hi = d->dv_hashtab.ht_array; todo > 0 && ret == OK; ++hi)
+		    if (!HASHITEM_EMPTY(hi))
+		    {
+			--todo;
+			ret = mp_put_bytes(gap, hi->hi_key,
+					     (long_u)STRLEN(hi->hi_key), FALSE);
+			if (ret == OK)
+			    ret = msgpack_encode_item(gap,
+					    &dict_lookup(hi)->di_tv, copyID);
+		    }
+		d->dv_copyID = 0;
+		return ret;
+	    }
+
+	case VAR_FLOAT:
+#ifdef FEAT_FLOAT
+	    {
+		double	f = val->vval.v_float;
+		char_u	*bytes = (char_u *)&f;
+		char_u	*p;
+		int	i;
+
+		if (ga_grow(gap, 9) == FAIL)
+		    return FAIL;
+		p = (char_u *)gap->ga_data + gap->ga_len;
+		*p++ = 0xcb;
+		for (i = 0; i < 8; ++i)
+# ifdef WORDS_BIGENDIAN
+		    p[i] = bytes[i];
+# else
+		    p[i] = bytes[7 - i];
+# endif
+		gap->ga_len += 9;
+		return OK;
+	    }
+#endif
+	case VAR_FUNC:
+	case VAR_PARTIAL:
+	case VAR_JOB:
+	case VAR_CHANNEL:
+	    // no MessagePack equivalent
+	    emsg(_(e_invarg));
+	    return FAIL;
+
+	case VAR_UNKNOWN:
+	case VAR_ANY:
+	case VAR_VOID:
+	    internal_error_no_abort("msgpack_encode_item()");
+	    return FAIL;
+    }
+    return OK;
+}
+
+/*
+ * Encode ["nr", "val"] into a channel message in allocated memory: the
+ * length as a four byte big-endian number, followed by a MessagePack array.
+ * The length of the result is stored in "*lenp".
+ * Returns NULL when "val" can't be encoded or out of memory.
+ */
+    char_u *
+msgpack_encode_nr_expr(int nr, typval_T *val, int *lenp)
+{
+    garray_T	ga;
+    int		len;
+
+    ga_init2(&ga, 1, 4000);
+    if (ga_grow(&ga, 5) == FAIL)
+	return NULL;
+    ga.ga_len = 4;	    // length is filled in below
+    ((char_u *)ga.ga_data)[ga.ga_len++] = 0x92;  // array with two items
+    if (mp_put_number(&ga, nr) == FAIL
+	    || msgpack_encode_item(&ga, val, get_copyID()) == FAIL)
+    {
+	ga_clear(&ga);
+	return NULL;
+    }
+    len = ga.ga_len;
+    ga.ga_len = 0;
+    mp_put_be(&ga, len - 4, 4);
+    *lenp = len;
+    return ga.ga_data;
+}
+
+/*
+ * Get "nbytes" bytes from "p" as a big-endian unsigned number.
+ */
+    static uvarnumber_T
+mp_get_be(char_u *p, int nbytes)
+{
+    uvarnumber_T    n = 0;
+    int		    i;
+
+    for (i = 0; i < nbytes; ++i)
+	n = (n << 8) | p[i];
+    return n;
+}
+
+/*
+ * Decode one item from "*pp", not going beyond "end", into "res", which must
+ * have been initialized.
+ * Advances "*pp" over the item.
+ * Return FAIL when the item is invalid or truncated.  "res" may then hold a
+ * partly decoded item that the caller must clear.
+ */
+    static int
+msgpack_decode_item(char_u **pp, char_u *end, typval_T *res, int depth)
+{
+    char_u	    *p = *pp;
+    int		    c;
+    int		    nbytes = 0;
+    long_u	    len;
+    uvarnumber_T    u;
+    int		    i;
+
+    if (p >= end || depth > MSGPACK_MAXNEST)
+	return FAIL;
+    c = *p++;
+
+    // Items with a fixed size.
+    if (c <= 0x7f || c >= 0xe0)
+    {
+	res->v_type = VAR_NUMBER;
+	res->vval.v_number = c <= 0x7f ? c : c - 0x100;
+	*pp = p;
+	return OK;
+    }
+    switch (c)
+    {
+	case 0xc0:
+	    res->v_type = VAR_SPECIAL;
+	    res->vval.v_number = VVAL_NULL;
+	    *pp = p;
+	    return OK;
+	case 0xc2:
+	case 0xc3:
+	    res->v_type = VAR_BOOL;
+	    res->vval.v_number = c == 0xc3 ? VVAL_TRUE : VVAL_FALSE;
+	    *pp = p;
+	    return OK;
+
+	case 0xcc: case 0xcd: case 0xce: case 0xcf:	// uint 8/16/32/64
+	case 0xd0: case 0xd1: case 0xd2: case 0xd3:	// int 8/16/32/64
+	    nbytes = 1 << (c & 3);
+	    if (end - p < nbytes)
+		return FAIL;
+	    u = mp_get_be(p, nbytes);
+	    res->v_type = VAR_NUMBER;
+	    if (c >= 0xd0)
+	    {
+		// sign extend
+		if (nbytes < (int)sizeof(uvarnumber_T)
+					&& (u & ((uvarnumber_T)1 << (nbytes * 8 - 1))))
+		    u |= ~(uvarnumber_T)0 << (nbytes * 8);
+		res->vval.v_number = (varnumber_T)u;
+	    }
+	    else if (u > (uvarnumber_T)VARNUM_MAX
+		    || (nbytes > (int)sizeof(uvarnumber_T)))
+		res->vval.v_number = VARNUM_MAX;
+	    else
+		res->vval.v_number = (varnumber_T)u;
+	    *pp = p + nbytes;
+	    return OK;
+
+	case 0xca:	// float 32
+	case 0xcb:	// float 64
+#ifdef FEAT_FLOAT
+	    nbytes = c == 0xca ? 4 : 8;
+	    if (end - p < nbytes)
+		return FAIL;
+	    res->v_type = VAR_FLOAT;
+	    if (c == 0xca)
+	    {
+		float	f32;
+		char_u	*bytes = (char_u *)&f32;
+
+		for (i = 0; i < 4; ++i)
+# ifdef WORDS_BIGENDIAN
+		    bytes[i] = p[i];
+# else
+		    bytes[i] = p[3 - i];
+# endif
+		res->vval.v_float = f32;
+	    }
+	    else
+	    {
+		double	f;
+		char_u	*bytes = (char_u *)&f;
+
+		for (i = 0; i < 8; ++i)
+# ifdef WORDS_BIGENDIAN
+		    bytes[i] = p[i];
+# else
+		    bytes[i] = p[7 - i];
+# endif
+		res->vval.v_float = f;
+	    }
+	    *pp = p + nbytes;
+	    return OK;
+#else
+	    return FAIL;
+#endif
+    }
+
+    // Items with a length: str, bin, array and map.
+    if ((c & 0xe0) == 0xa0 || (c & 0xf0) == 0x90 || (c & 0xf0) == 0x80)
+	len = c & ((c & 0xe0) == 0xa0 ? 0x1f : 0x0f);
+    else
+    {
+	switch (c)
+	{
+	    case 0xc4: case 0xd9: nbytes = 1; break;
+	    case 0xc5: case 0xda: case 0xdc: case 0xde: nbytes = 2; break;
+	    case 0xc6: case 0xdb: case 0xdd: case 0xdf: nbytes = 4; break;
+	    default: return FAIL;   // ext types and unused values
+	}
+	if (end - p < nbytes)
+	    return FAIL;
+	len = (long_u)mp_get_be(p, nbytes);
+	p += nbytes;
+    }
+
+    if ((c & 0xe0) == 0xa0 || c == 0xd9 || c == 0xda || c == 0xdb)
+    {
+	// str
+	if ((long_u)(end - p) < len)
+	    return FAIL;
+	res->v_type = VAR_STRING;
+	res->vval.v_string = alloc(len + 1);
+	if (res->vval.v_string == NULL)
+	    return FAIL;
+	mch_memmove(res->vval.v_string, p, (size_t)len);
+	res->vval.v_string[len] = NUL;
+	*pp = p + len;
+	return OK;
+    }
+
+    if (c == 0xc4 || c == 0xc5 || c == 0xc6)
+    {
+	// bin
+	blob_T *b;
+
+	if ((long_u)(end - p) < len || rettv_blob_alloc(res) == FAIL)
+	    return FAIL;
+	b = res->vval.v_blob;
+	if (len > 0)
+	{
+	    if (ga_grow(&b->bv_ga, (int)len) == FAIL)
+		return FAIL;
+	    mch_memmove(b->bv_ga.ga_data, p, (size_t)len);
+	    b->bv_ga.ga_len = (int)len;
+	}
+	*pp = p + len;
+	return OK;
+    }
+
+    if ((c & 0xf0) == 0x90 || c == 0xdc || c == 0xdd)
+    {
+	// array: every item takes at least one byte
+	list_T	*l;
+
+	if ((long_u)(end - p) < len)
+	    return FAIL;
+	l = list_alloc_with_items((int)len);
+	if (l == NULL)
+	    return FAIL;
+	rettv_list_set(res, l);
+	for (i = 0; i < (int)len; ++i)
+	{
+	    typval_T	tv;
+
+	    init_tv(&tv);
+	    if (msgpack_decode_item(&p, end, &tv, depth + 1) == FAIL)
+	    {
+		clear_tv(&tv);
+		return FAIL;
+	    }
+	    list_set_item(l, i, &tv);
+	}
+	*pp = p;
+	return OK;
+    }
+
+    // map: every key and value takes at least one byte
+    {
+	dict_T	    *d;
+	typval_T    keytv;
+	typval_T    tv;
+	dictitem_T  *di;
+
+	if ((long_u)(end - p) / 2 < len || rettv_dict_alloc(res) == FAIL)
+	    return FAIL;
+	d = res->vval.v_dict;
+	for (i = 0; i < (int)len; ++i)
+	{
+	    init_tv(&keytv);
+	    if (msgpack_decode_item(&p, end, &keytv, depth + 1) == FAIL)
+	    {
+		clear_tv(&keytv);
+		return FAIL;
+	    }
+	    if (keytv.v_type != VAR_STRING || keytv.vval.v_string == NULL
+		    || dict_find(d, keytv.vval.v_string, -1) != NULL)
+	    {
+		// Only a unique string key can be used.
+		clear_tv(&keytv);
+		return FAIL;
+	    }
+	    di = dictitem_alloc(keytv.vval.v_string);
+	    clear_tv(&keytv);
+	    if (di == NULL)
+		return FAIL;
+	    init_tv(&tv);
+	    if (msgpack_decode_item(&p, end, &tv, depth + 1) == FAIL)
+	    {
+		clear_tv(&tv);
+		dictitem_free(di);
+		return FAIL;
+	    }
+	    di->di_tv = tv;
+	    di->di_tv.v_lock = 0;
+	    if (dict_add(d, di) == FAIL)
+	    {
+		dictitem_free(di);
+		return FAIL;
+	    }
+	}
+	*pp = p;
+	return OK;
+    }
+}
+
+/*
+ * Decode the MessagePack item in "buf[len]" and store the result in "res".
+ * Return FAIL when the item is invalid or does not use exactly "len" bytes.
+ */
+    int
+msgpack_decode(char_u *buf, long_u len, typval_T *res)
+{
+    char_u  *p = buf;
+
+    init_tv(res);
+    if (msgpack_decode_item(&p, buf + len, res, 0) == OK && p == buf + len)
+	return OK;
+    clear_tv(res);
+    init_tv(res);
+    return FAIL;
+}
+
+#endif // FEAT_JOB_CHANNEL
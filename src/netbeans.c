@@ -373,56 +373,34 @@ handle_key_queue(void)
     void
 netbeans_parse_messages(void)
 {
-    readq_T	*node;
     char_u	*buffer;
     char_u	*p;
-    int		own_node;
+    char_u	*cmd;
 
     while (nb_channel != NULL)
     {
-	node = channel_peek(nb_channel, PART_SOCK);
-	if (node == NULL)
+	buffer = channel_peek(nb_channel, PART_SOCK, NULL);
+	if (buffer == NULL)
 	    break;	// nothing to read
 
-	// Locate the end of the first line in the first buffer.
-	p = channel_first_nl(node);
+	// Locate the end of the first line.  If the command isn't complete
+	// wait for more.
+	p = channel_first_nl(nb_channel, PART_SOCK);
 	if (p == NULL)
-	{
-	    // Command isn't complete.  If there is no following buffer,
-	    // return (wait for more). If there is another buffer following,
-	    // prepend the text to that buffer and delete this one.
-	    if (channel_collapse(nb_channel, PART_SOCK, TRUE) == FAIL)
-		return;
-	    continue;
-	}
+	    return;
 
-	// There is a complete command at the start of the buffer.
-	// Terminate it with a NUL.  When no more text is following unlink
-	// the buffer.  Do this before executing, because new buffers can
-	// be added while busy handling the command.
-	*p++ = NUL;
-	if (*p == NUL)
-	{
-	    own_node = TRUE;
-	    buffer = channel_get(nb_channel, PART_SOCK, NULL);
-	    // "node" is now invalid!
-	}
-	else
-	{
-	    own_node = FALSE;
-	    buffer = node->rq_buffer;
-	}
+	// There is a complete command at the start of the buffer.  Copy it
+	// and remove it from the channel before executing, because more text
+	// can be read while busy handling the command.
+	cmd = vim_strnsave(buffer, p - buffer);
+	if (cmd == NULL)
+	    return;
+	channel_consume(nb_channel, PART_SOCK, (int)(p - buffer) + 1);
 
 	// Now, parse and execute the commands.  This may set nb_channel to
 	// NULL if the channel is closed.
-	nb_parse_cmd(buffer);
-
-	if (own_node)
-	    // buffer finished, dispose of it
-	    vim_free(buffer);
-	else if (nb_channel != NULL)
-	    // more follows, move it to the start
-	    channel_consume(nb_channel, PART_SOCK, (int)(p - buffer));
+	nb_parse_cmd(cmd);
+	vim_free(cmd);
     }
 }
 
@@ -3755,6 +3755,18 @@ set_num_option(
 	errmsg = e_positive;
 	p_report = 1;
     }
+#ifdef FEAT_MMAP
+    if (p_mms < 0)
+    {
+	errmsg = e_positive;
+	p_mms = 0;
+    }
+#endif
+    if (p_mcm < 0)
+    {
+	errmsg = e_positive;
+	p_mcm = 0;
+    }
     if ((p_sj < -100 || p_sj >= Rows) && full_screen)
     {
 	if (Rows != old_Rows)	// Rows changed, just adjust p_sj
@@ -744,12 +744,16 @@ EXTERN long	p_mmd;		// 'maxmapdepth'
 EXTERN long	p_mm;		// 'maxmem'
 EXTERN long	p_mmp;		// 'maxmempattern'
 EXTERN long	p_mmt;		// 'maxmemtot'
+EXTERN long	p_mcm;		// 'memcompress'
 #ifdef FEAT_MENU
 EXTERN long	p_mis;		// 'menuitems'
 #endif
 #ifdef FEAT_SPELL
 EXTERN char_u	*p_msm;		// 'mkspellmem'
 #endif
+#ifdef FEAT_MMAP
+EXTERN long	p_mms;		// 'mmapsize'
+#endif
 EXTERN int	p_ml;		// 'modeline'
 EXTERN long	p_mle;		// 'modelineexpr'
 EXTERN long	p_mls;		// 'modelines'
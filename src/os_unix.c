@@ -18,6 +18,11 @@
  * changed beyond recognition.
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+// For POSIX_SPAWN_SETSID and posix_spawn_file_actions_addchdir_np().
+# define _GNU_SOURCE
+#endif
+
 #include "vim.h"
 
 #ifdef FEAT_MZSCHEME
@@ -186,10 +191,12 @@ static void catch_signals(RETSIGTYPE (*func_deadly)(), RETSIGTYPE (*func_other)(
 # define SIGSET_DECL(set)	sigset_t set;
 # define BLOCK_SIGNALS(set)	block_signals(set)
 # define UNBLOCK_SIGNALS(set)	unblock_signals(set)
+# define SIGSET_PTR(set)	(set)
 #else
 # define SIGSET_DECL(set)
 # define BLOCK_SIGNALS(set)	do { /**/ } while (0)
 # define UNBLOCK_SIGNALS(set)	do { /**/ } while (0)
+# define SIGSET_PTR(set)	NULL
 #endif
 static int  have_wildcard(int, char_u **);
 static int  have_dollars(int, char_u **);
@@ -882,7 +889,7 @@ sig_alarm SIGDEFARG(sigarg)
 
 #if (defined(HAVE_SETJMP_H) \
 	&& ((defined(FEAT_X11) && defined(FEAT_XCLIPBOARD)) \
-	    || defined(FEAT_LIBCALL))) \
+	    || defined(FEAT_LIBCALL) || defined(FEAT_MMAP))) \
     || defined(PROTO)
 # define USING_SETJMP 1
 
@@ -947,6 +954,37 @@ mch_didjmp(void)
 }
 #endif
 
+#if defined(FEAT_MMAP) || defined(PROTO)
+/*
+ * Call "func" with "arg" and catch a crash.  Used for accessing a file that
+ * is mapped in memory, which results in SIGBUS when the file was truncated.
+ * Returns what "func" returns, or FAIL when a signal was caught.
+ */
+    int
+mch_call_protected(int (*func)(void *), void *arg)
+{
+# ifdef USING_SETJMP
+    int	    retval;
+
+    // Can't use SETJMP() recursively, e.g. from mch_libcall().
+    if (lc_active)
+	return func(arg);
+
+    mch_startjmp();
+    if (SETJMP(lc_jump_env) != 0)
+    {
+	mch_didjmp();
+	return FAIL;
+    }
+    retval = func(arg);
+    mch_endjmp();
+    return retval;
+# else
+    return func(arg);
+# endif
+}
+#endif
+
 /*
  * This function handles deadly signals.
  * It tries to preserve any swap files and exit properly.
@@ -4279,6 +4317,228 @@ set_default_child_environment(int is_terminal)
 }
 #endif
 
+#if defined(USE_POSIX_SPAWN) \
+	&& (!defined(USE_SYSTEM) || defined(FEAT_JOB_CHANNEL))
+# define SPAWN_NULL	(-2)	// file descriptor for /dev/null
+
+extern char **environ;
+
+/*
+ * Start "argv" with posix_spawnp().  Unlike fork() this does not copy the
+ * page tables of Vim, which takes long when Vim uses a lot of memory.  Can
+ * only be used when nothing needs to be done between fork() and exec() that
+ * can't be expressed with spawn attributes and file actions.
+ * "fds[3]" are the file descriptors for stdin, stdout and stderr of the
+ * child: -1 to inherit, SPAWN_NULL to use /dev/null.
+ * "close_fds[close_count]" are closed in the child.
+ * "envp" is the environment for the child, NULL for the current one.
+ * "cwd" is the directory to start in, NULL for the current one.
+ * When "new_session" is TRUE the child gets its own session, like with
+ * setsid().
+ * "mask" is the signal mask for the child, NULL for the current one.
+ * Signal handlers are reset like reset_signals() does.
+ * Returns the pid of the child or -1 when it could not be started, then the
+ * caller can still try fork() to get the same error as before.
+ */
+    static pid_t
+spawn_child(
+	char	    **argv,
+	int	    *fds,
+	int	    *close_fds,
+	int	    close_count,
+	char	    **envp,
+	char_u	    *cwd UNUSED,
+	int	    new_session UNUSED,
+	sigset_t    *mask)
+{
+    posix_spawn_file_actions_t	actions;
+    posix_spawnattr_t		attr;
+    sigset_t			sigdefault;
+    short			flags = POSIX_SPAWN_SETSIGDEF;
+    pid_t			pid = -1;
+    int				i;
+    int				j;
+    int				err;
+
+# if !defined(HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP)
+    if (cwd != NULL)
+	return -1;
+# endif
+    if (posix_spawn_file_actions_init(&actions) != 0)
+	return -1;
+    if (posix_spawnattr_init(&attr) != 0)
+    {
+	posix_spawn_file_actions_destroy(&actions);
+	return -1;
+    }
+
+    // Handle signals normally in the child, like reset_signals().
+    sigemptyset(&sigdefault);
+    for (i = 0; signal_info[i].sig != -1; i++)
+	sigaddset(&sigdefault, signal_info[i].sig);
+# if defined(SIGCONT)
+    sigaddset(&sigdefault, SIGCONT);
+# endif
+    err = posix_spawnattr_setsigdefault(&attr, &sigdefault);
+    if (err == 0 && mask != NULL)
+    {
+	flags |= POSIX_SPAWN_SETSIGMASK;
+	err = posix_spawnattr_setsigmask(&attr, mask);
+    }
+# ifdef POSIX_SPAWN_SETSID
+    if (new_session)
+	flags |= POSIX_SPAWN_SETSID;
+# endif
+    if (err == 0)
+	err = posix_spawnattr_setflags(&attr, flags);
+
+    for (i = 0; i < 3 && err == 0; ++i)
+	if (fds[i] == SPAWN_NULL)
+	    err = posix_spawn_file_actions_addopen(&actions, i, "/dev/null",
+							  O_RDWR | O_EXTRA, 0);
+	else if (fds[i] >= 0)
+	    err = posix_spawn_file_actions_adddup2(&actions, fds[i], i);
+    for (i = 0; i < close_count && err == 0; ++i)
+    {
+	// Close each descriptor only once, and never stdin/stdout/stderr.
+	if (close_fds[i] <= 2)
+	    continue;
+	for (j = 0; j < i; ++j)
+	    if (close_fds[j] == close_fds[i])
+		break;
+	if (j == i)
+	    err = posix_spawn_file_actions_addclose(&actions, close_fds[i]);
+    }
+# ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP
+    if (err == 0 && cwd != NULL)
+	err = posix_spawn_file_actions_addchdir_np(&actions, (char *)cwd);
+# endif
+
+    if (err == 0)
+	err = posix_spawnp(&pid, argv[0], &actions, &attr, argv,
+					       envp == NULL ? environ : envp);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    if (err != 0)
+	return -1;
+    return pid;
+}
+#endif
+
+#if defined(FEAT_JOB_CHANNEL) && defined(USE_POSIX_SPAWN_JOB)
+/*
+ * Add "name=value" to environment "gap", unless "name" is already there.
+ * When "value" is NULL "name" is the whole "name=value" string.
+ */
+    static void
+child_envp_add(garray_T *gap, char *name, char *value)
+{
+    size_t	namelen = value == NULL ? strcspn(name, "=") : STRLEN(name);
+    char	*entry;
+    int		i;
+
+    for (i = 0; i < gap->ga_len; ++i)
+    {
+	entry = ((char **)gap->ga_data)[i];
+	if (STRNCMP(entry, name, namelen) == 0 && entry[namelen] == '=')
+	    return;
+    }
+    if (value == NULL)
+	entry = (char *)vim_strsave((char_u *)name);
+    else
+    {
+	entry = alloc(namelen + STRLEN(value) + 2);
+	if (entry != NULL)
+	    sprintf(entry, "%s=%s", name, value);
+    }
+    if (entry != NULL && ga_grow(gap, 1) == OK)
+	((char **)gap->ga_data)[gap->ga_len++] = entry;
+    else
+	vim_free(entry);
+}
+
+/*
+ * Return the environment for a job started with spawn_child(): the current
+ * environment with what set_child_environment() and the "env" option would
+ * change in the child after fork().
+ * Returns an allocated NULL terminated array, free it with
+ * free_child_envp().  Returns NULL when out of memory.
+ */
+    static char **
+make_child_envp(
+	long	rows,
+	long	columns,
+	char	*term,
+	int	is_terminal UNUSED,
+	dict_T	*env)
+{
+    garray_T	ga;
+    char	envbuf[50];
+    int		i;
+
+    ga_init2(&ga, (int)sizeof(char *), 64);
+
+    // Added first, so that they are not overruled by what comes below.
+    if (env != NULL)
+    {
+	hashitem_T	*hi;
+	int		todo = (int)env->dv_hashtab.ht_used;
+
+	for (hi = env->dv_hashtab.ht_array; todo > 0; ++hi)
+	    if (!HASHITEM_EMPTY(hi))
+	    {
+		typval_T *item = &dict_lookup(hi)->di_tv;
+
+		child_envp_add(&ga, (char *)hi->hi_key,
+					       (char *)tv_get_string(item));
+		--todo;
+	    }
+    }
+
+    // Keep in sync with set_child_environment().
+    child_envp_add(&ga, "TERM", term);
+    sprintf(envbuf, "%ld", rows);
+    child_envp_add(&ga, "ROWS", envbuf);
+    child_envp_add(&ga, "LINES", envbuf);
+    sprintf(envbuf, "%ld", columns);
+    child_envp_add(&ga, "COLUMNS", envbuf);
+    sprintf(envbuf, "%d", t_colors);
+    child_envp_add(&ga, "COLORS", envbuf);
+# ifdef FEAT_TERMINAL
+    if (is_terminal)
+    {
+	sprintf(envbuf, "%ld", (long)get_vim_var_nr(VV_VERSION));
+	child_envp_add(&ga, "VIM_TERMINAL", envbuf);
+    }
+# endif
+# ifdef FEAT_CLIENTSERVER
+    child_envp_add(&ga, "VIM_SERVERNAME",
+			  serverName == NULL ? "" : (char *)serverName);
+# endif
+
+    for (i = 0; environ[i] != NULL; ++i)
+	child_envp_add(&ga, environ[i], NULL);
+
+    if (ga_grow(&ga, 1) == FAIL)
+    {
+	ga_clear_strings(&ga);
+	return NULL;
+    }
+    ((char **)ga.ga_data)[ga.ga_len] = NULL;
+    return (char **)ga.ga_data;
+}
+
+    static void
+free_child_envp(char **envp)
+{
+    char    **p;
+
+    for (p = envp; *p != NULL; ++p)
+	vim_free(*p);
+    vim_free(envp);
+}
+#endif
+
 #if defined(FEAT_GUI) || defined(FEAT_JOB_CHANNEL)
 /*
  * Open a PTY, with FD for the master and slave side.
@@ -4664,7 +4924,26 @@ mch_call_shell_fork(
     {
 	SIGSET_DECL(curset)
 	BLOCK_SIGNALS(&curset);
-	pid = fork();	// maybe we should use vfork()
+# ifdef USE_POSIX_SPAWN
+	// Without pipes or a pty nothing needs to be done in the child
+	// after fork(), use posix_spawn().
+	pid = -1;
+	if (!((options & (SHELL_READ|SHELL_WRITE))
+#  ifdef FEAT_GUI
+		    || (gui.in_use && show_shell_mess)
+#  endif
+	     ))
+	{
+	    int	fds[3] = {-1, -1, -1};
+
+	    if (!show_shell_mess || (options & SHELL_EXPAND))
+		fds[0] = fds[1] = fds[2] = SPAWN_NULL;
+	    pid = spawn_child(argv, fds, NULL, 0, NULL, NULL, FALSE,
+							  SIGSET_PTR(&curset));
+	}
+	if (pid == -1)
+# endif
+	    pid = fork();
 	if (pid == -1)
 	{
 	    UNBLOCK_SIGNALS(&curset);
@@ -5403,6 +5682,358 @@ error:
 
     return retval;
 }
+
+// Max number of bytes read from the shell output after the shell exited.
+# define SHELL_IO_DRAIN_MAX (1024L * 1024L)
+
+/*
+ * Wait up to "msec" msec for "read_fd" to become readable or "write_fd" to
+ * become writable.  "write_fd" is ignored when negative.
+ * Returns the sum of 1 for readable and 2 for writable, 0 on timeout or when
+ * interrupted.
+ */
+    static int
+shell_io_wait(int read_fd, int write_fd, long msec)
+{
+    int		ret = 0;
+# ifndef HAVE_SELECT
+    struct pollfd   fds[2];
+    int		    nfd = 1;
+
+    fds[0].fd = read_fd;
+    fds[0].events = POLLIN;
+    if (write_fd >= 0)
+    {
+	fds[1].fd = write_fd;
+	fds[1].events = POLLOUT;
+	nfd = 2;
+    }
+    if (poll(fds, nfd, (int)msec) > 0)
+    {
+	if (fds[0].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL))
+	    ret += 1;
+	if (nfd == 2 && (fds[1].revents & (POLLOUT | POLLHUP | POLLERR
+								 | POLLNVAL)))
+	    ret += 2;
+    }
+# else
+    struct timeval  tv;
+    fd_set	    rfds;
+    fd_set	    wfds;
+    int		    maxfd = read_fd;
+
+    tv.tv_sec = msec / 1000;
+    tv.tv_usec = (msec % 1000) * 1000;
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_SET(read_fd, &rfds);
+    if (write_fd >= 0)
+    {
+	FD_SET(write_fd, &wfds);
+	if (write_fd > maxfd)
+	    maxfd = write_fd;
+    }
+    if (select(maxfd + 1, &rfds, &wfds, NULL, &tv) > 0)
+    {
+	if (FD_ISSET(read_fd, &rfds))
+	    ret += 1;
+	if (write_fd >= 0 && FD_ISSET(write_fd, &wfds))
+	    ret += 2;
+    }
+# endif
+    return ret;
+}
+
+/*
+ * Execute "cmd" with the shell, connecting its stdin and stdout to pipes.
+ * "io->si_input" is written to stdin, when it is NULL stdin is /dev/null.
+ * stdout is appended to "io->si_output" until the shell exited and there is
+ * no more output, a command started in the background by the shell may still
+ * have stdout open.  stderr goes to /dev/null,
+ * the command must redirect it when it is to be captured.
+ * This avoids creating, writing and reading back temp files, which is what
+ * most of the time of system() was spent on for short commands.
+ * Returns the exit value of the shell, -1 when it could not be started.
+ */
+    int
+mch_call_shell_io(
+    char_u	*cmd,
+    int		options,	// SHELL_*, see vim.h
+    shellio_T	*io)
+{
+    tmode_T	tmode = cur_tmode;
+    pid_t	pid;
+    pid_t	wait_pid;
+# ifdef HAVE_UNION_WAIT
+    union wait	status;
+# else
+    int		status = -1;
+# endif
+    int		retval = -1;
+    char	**argv = NULL;
+    char_u	*tofree1 = NULL;
+    char_u	*tofree2 = NULL;
+    int		fd_in[2] = {-1, -1};
+    int		fd_out[2] = {-1, -1};
+    long	written = 0;
+    long	drained = 0;
+    long	delay_msec = 1;
+    int		did_kill = FALSE;
+    int		shell_done = FALSE;
+
+    out_flush();
+    if (options & SHELL_COOKED)
+	settmode(TMODE_COOK);		// set to normal mode
+    if (tmode == TMODE_RAW)
+	// The shell may have messed with the mode, always set it later.
+	cur_tmode = TMODE_UNKNOWN;
+
+    if (unix_build_argv(cmd, &argv, &tofree1, &tofree2) == FAIL)
+	goto theend;
+
+    if ((io->si_input != NULL && pipe(fd_in) < 0) || pipe(fd_out) < 0)
+    {
+	msg_puts(_("\nCannot create pipes\n"));
+	goto theend;
+    }
+
+    {
+	SIGSET_DECL(curset)
+	BLOCK_SIGNALS(&curset);
+# ifdef USE_POSIX_SPAWN
+	{
+	    int	fds[3];
+	    int	close_fds[4];
+
+	    fds[0] = fd_in[0] >= 0 ? fd_in[0] : SPAWN_NULL;
+	    fds[1] = fd_out[1];
+	    fds[2] = SPAWN_NULL;
+	    close_fds[0] = fd_in[0];
+	    close_fds[1] = fd_in[1];
+	    close_fds[2] = fd_out[0];
+	    close_fds[3] = fd_out[1];
+	    pid = spawn_child(argv, fds, close_fds, 4, NULL, NULL, FALSE,
+							  SIGSET_PTR(&curset));
+	}
+	if (pid == -1)
+# endif
+	    pid = fork();
+	if (pid == -1)
+	{
+	    UNBLOCK_SIGNALS(&curset);
+	    msg_puts(_("\nCannot fork\n"));
+	    goto theend;
+	}
+	if (pid == 0)		// child
+	{
+	    int	null_fd;
+
+	    reset_signals();		// handle signals normally
+	    UNBLOCK_SIGNALS(&curset);
+
+# ifdef FEAT_JOB_CHANNEL
+	    if (ch_log_active())
+		// close the log file in the child
+		ch_logfile((char_u *)"", (char_u *)"");
+# endif
+	    // Same as mch_call_shell_fork() does with SHELL_EXPAND, which is
+	    // used when going through temp files: the shell does not get the
+	    // terminal, so that it can't hang waiting for input, and stderr is
+	    // dropped unless 'shellredir' redirects it to stdout.
+	    null_fd = open("/dev/null", O_RDWR | O_EXTRA, 0);
+	    if (null_fd < 0)
+		_exit(OPEN_NULL_FAILED);
+
+	    close(0);
+	    vim_ignored = dup(fd_in[0] >= 0 ? fd_in[0] : null_fd);
+	    close(1);
+	    vim_ignored = dup(fd_out[1]);
+	    close(2);
+	    vim_ignored = dup(null_fd);
+
+	    close(null_fd);
+	    if (fd_in[0] >= 0)
+	    {
+		close(fd_in[0]);
+		close(fd_in[1]);
+	    }
+	    close(fd_out[0]);
+	    close(fd_out[1]);
+
+	    execvp(argv[0], argv);
+	    _exit(EXEC_FAILED);	    // exec failed, return failure code
+	}
+
+	// parent
+	// While child is running, ignore terminating signals.
+	// Do catch CTRL-C, so that "got_int" is set.
+	catch_signals(SIG_IGN, SIG_ERR);
+	catch_int_signal();
+	UNBLOCK_SIGNALS(&curset);
+    }
+# ifdef FEAT_JOB_CHANNEL
+    ++dont_check_job_ended;
+# endif
+
+    close(fd_out[1]);
+    fd_out[1] = -1;
+    if (fd_in[0] >= 0)
+    {
+	close(fd_in[0]);
+	fd_in[0] = -1;
+	// Don't block on a full pipe, the command may first want to write
+	// its output.
+	(void)fcntl(fd_in[1], F_SETFL, O_NONBLOCK);
+	if (io->si_input_len == 0)
+	{
+	    close(fd_in[1]);
+	    fd_in[1] = -1;
+	}
+    }
+
+    for (;;)
+    {
+	int	ready;
+	int	len;
+
+	// A command started in the background may keep stdout open long
+	// after the shell exited, e.g. "sleep 9 &".  Don't wait for the end
+	// of the output then, only get what the shell itself wrote.
+	if (!shell_done)
+	{
+	    wait_pid = waitpid(pid, &status, WNOHANG);
+	    if (wait_pid == pid || (wait_pid == -1 && errno != EINTR))
+		shell_done = TRUE;
+	}
+
+	if (got_int && !did_kill)
+	{
+	    // CTRL-C sends a signal to the child, we ignore it ourselves
+	    kill(pid, SIGINT);
+	    did_kill = TRUE;
+	    if (fd_in[1] >= 0)
+	    {
+		close(fd_in[1]);
+		fd_in[1] = -1;
+	    }
+	}
+
+	// Wait for 1 to 10 msec, like wait4pid(), the shell exiting doesn't
+	// wake us up.  Once it exited only take what is available right now.
+	ready = shell_io_wait(fd_out[0], fd_in[1], shell_done ? 0L : delay_msec);
+	if (delay_msec < 10)
+	    ++delay_msec;
+	if (ready & 2)
+	{
+	    len = write(fd_in[1], io->si_input + written,
+				      (size_t)(io->si_input_len - written));
+	    if (len > 0)
+		written += len;
+	    if ((len < 0 && errno != EAGAIN && errno != EINTR)
+						|| written >= io->si_input_len)
+	    {
+		// All written, or the command does not read its input.
+		close(fd_in[1]);
+		fd_in[1] = -1;
+	    }
+	}
+	if (ready & 1)
+	{
+	    if (ga_grow(&io->si_output, 4096) == FAIL)
+		break;
+	    len = read(fd_out[0],
+			(char *)io->si_output.ga_data + io->si_output.ga_len,
+			(size_t)(io->si_output.ga_maxlen - io->si_output.ga_len));
+	    if (len > 0)
+	    {
+		io->si_output.ga_len += len;
+		if (shell_done)
+		{
+		    // Don't keep reading from a background command that
+		    // writes all the time.  What the shell wrote itself fits
+		    // in the pipe.
+		    drained += len;
+		    if (drained > SHELL_IO_DRAIN_MAX)
+			break;
+		}
+		delay_msec = 1;
+	    }
+	    else if (len == 0 || (errno != EAGAIN && errno != EINTR))
+		break;		// end of output
+	}
+	else if (shell_done)
+	    break;		// shell exited and no more output
+    }
+
+    if (fd_in[1] >= 0)
+    {
+	close(fd_in[1]);
+	fd_in[1] = -1;
+    }
+    close(fd_out[0]);
+    fd_out[0] = -1;
+
+    // The output was closed, normally the shell is exiting now.  Wait for it
+    // without the polling delay of wait4pid().
+    if (!shell_done)
+	do
+	    wait_pid = waitpid(pid, &status, 0);
+	while (wait_pid == -1 && errno == EINTR);
+    if (wait_pid == pid && WIFEXITED(status))
+    {
+	// LINTED avoid "bitwise operation on signed value"
+	retval = WEXITSTATUS(status);
+	if (retval != 0 && !emsg_silent)
+	{
+	    if (retval == EXEC_FAILED)
+	    {
+		msg_puts(_("\nCannot execute shell "));
+		msg_outtrans(p_sh);
+		msg_putchar('\n');
+	    }
+	    else if (!(options & SHELL_SILENT))
+	    {
+		msg_puts(_("\nshell returned "));
+		msg_outnum((long)retval);
+		msg_putchar('\n');
+	    }
+	}
+    }
+    else
+	msg_puts(_("\nCommand terminated\n"));
+
+# ifdef FEAT_JOB_CHANNEL
+    --dont_check_job_ended;
+# endif
+    // Set to raw mode right now, otherwise a CTRL-C after catch_signals()
+    // will kill Vim.
+    if (tmode == TMODE_RAW)
+    {
+	settmode(TMODE_RAW);
+	tmode = TMODE_UNKNOWN;
+    }
+    set_signals();
+
+theend:
+    if (fd_in[0] >= 0)
+	close(fd_in[0]);
+    if (fd_in[1] >= 0)
+	close(fd_in[1]);
+    if (fd_out[0] >= 0)
+	close(fd_out[0]);
+    if (fd_out[1] >= 0)
+	close(fd_out[1]);
+    if (tmode == TMODE_RAW)
+	settmode(TMODE_RAW);	// set to raw mode
+# ifdef FEAT_TITLE
+    resettitle();
+# endif
+    vim_free(argv);
+    vim_free(tofree1);
+    vim_free(tofree2);
+
+    return retval;
+}
 #endif // USE_SYSTEM
 
     int
@@ -5422,6 +6053,94 @@ mch_call_shell(
 }
 
 #if defined(FEAT_JOB_CHANNEL) || defined(PROTO)
+# ifdef FEAT_TERMINAL
+/*
+ * Return the value of $TERM for a job running in a terminal window.
+ */
+    static char *
+job_term_name(void)
+{
+    char *term = (char *)T_NAME;
+
+#  ifdef FEAT_GUI
+    if (term_is_gui(T_NAME))
+	// In the GUI 'term' is not what we want, use $TERM.
+	term = getenv("TERM");
+#  endif
+    // Use 'term' or $TERM if it starts with "xterm", otherwise fall
+    // back to "xterm" or "xterm-color".
+    if (term == NULL || *term == NUL || STRNCMP(term, "xterm", 5) != 0)
+    {
+	if (t_colors >= 256)
+	    // TODO: should we check this name is supported?
+	    term = "xterm-256color";
+	else if (t_colors > 16)
+	    term = "xterm-color";
+	else
+	    term = "xterm";
+    }
+    return term;
+}
+# endif
+
+# ifdef USE_POSIX_SPAWN_JOB
+/*
+ * Start the process for mch_job_start() with spawn_child(), setting up the
+ * same file descriptors and environment as the child after fork() does.
+ * Returns the pid of the child, or -1 when it was not started.
+ */
+    static pid_t
+job_spawn(
+	char	    **argv,
+	jobopt_T    *options,
+	int	    is_terminal,
+	int	    *fd_in,
+	int	    *fd_out,
+	int	    *fd_err,
+	sigset_t    *mask)
+{
+    char	**envp;
+    int		fds[3];
+    int		close_fds[6];
+    pid_t	pid;
+
+#  ifdef FEAT_TERMINAL
+    if (options->jo_term_rows > 0)
+	envp = make_child_envp((long)options->jo_term_rows,
+		  (long)options->jo_term_cols, job_term_name(), is_terminal,
+							     options->jo_env);
+    else
+#  endif
+	envp = make_child_envp(Rows, Columns, "dumb", is_terminal,
+							     options->jo_env);
+    if (envp == NULL)
+	return -1;
+
+    fds[0] = options->jo_io[PART_IN] == JIO_NULL ? SPAWN_NULL : fd_in[0];
+    fds[1] = options->jo_io[PART_OUT] == JIO_NULL ? SPAWN_NULL : fd_out[1];
+    if (options->jo_io[PART_ERR] == JIO_NULL
+	    || (options->jo_io[PART_ERR] == JIO_OUT
+				       && options->jo_io[PART_OUT] == JIO_NULL))
+	fds[2] = SPAWN_NULL;
+    else if (options->jo_io[PART_ERR] == JIO_OUT)
+	fds[2] = fd_out[1];
+    else
+	fds[2] = fd_err[1];
+
+    close_fds[0] = fd_in[0];
+    close_fds[1] = fd_in[1];
+    close_fds[2] = fd_out[0];
+    close_fds[3] = fd_out[1];
+    close_fds[4] = fd_err[0];
+    close_fds[5] = fd_err[1];
+
+    pid = spawn_child(argv, fds, close_fds, 6, envp, options->jo_cwd,
+								 TRUE, mask);
+    free_child_envp(envp);
+    return pid;
+}
+# endif
+
     void
 mch_job_start(char **argv, job_T *job, jobopt_T *options, int is_terminal)
 {
@@ -5522,7 +6241,16 @@ mch_job_start(char **argv, job_T *job, jobopt_T *options, int is_terminal)
     }
 
     BLOCK_SIGNALS(&curset);
-    pid = fork();	// maybe we should use vfork()
+# ifdef USE_POSIX_SPAWN_JOB
+    // A pty needs to be set up in the child after fork(), otherwise use
+    // posix_spawn().  When that fails fork() is used to report the error.
+    pid = -1;
+    if (pty_master_fd < 0)
+	pid = job_spawn(argv, options, is_terminal, fd_in, fd_out, fd_err,
+							  SIGSET_PTR(&curset));
+    if (pid == -1)
+# endif
+	pid = fork();
     if (pid == -1)
     {
 	// failed to fork
@@ -5553,32 +6281,11 @@ mch_job_start(char **argv, job_T *job, jobopt_T *options, int is_terminal)
 
 # ifdef FEAT_TERMINAL
 	if (options->jo_term_rows > 0)
-	{
-	    char *term = (char *)T_NAME;
-
-#ifdef FEAT_GUI
-	    if (term_is_gui(T_NAME))
-		// In the GUI 'term' is not what we want, use $TERM.
-		term = getenv("TERM");
-#endif
-	    // Use 'term' or $TERM if it starts with "xterm", otherwise fall
-	    // back to "xterm" or "xterm-color".
-	    if (term == NULL || *term == NUL || STRNCMP(term, "xterm", 5) != 0)
-	    {
-		if (t_colors >= 256)
-		    // TODO: should we check this name is supported?
-		    term = "xterm-256color";
-		else if (t_colors > 16)
-		    term = "xterm-color";
-		else
-		    term = "xterm";
-	    }
 	    set_child_environment(
 		    (long)options->jo_term_rows,
 		    (long)options->jo_term_cols,
-		    term,
+		    job_term_name(),
 		    is_terminal);
-	}
 	else
 # endif
 	    set_default_child_environment(is_terminal);
@@ -6146,9 +6853,12 @@ RealWaitForChar(int fd, long msec, int *check_for_gpm UNUSED, int *interrupted)
 # endif
 #endif
 #ifndef HAVE_SELECT
-			// each channel may use in, out and err
-	struct pollfd   fds[6 + 3 * MAX_OPEN_CHANNELS];
+	struct pollfd   fds_buf[36];
+	struct pollfd   *fds = fds_buf;
 	int		nfd;
+# ifdef FEAT_JOB_CHANNEL
+	int		use_channels = TRUE;
+# endif
 # ifdef FEAT_XCLIPBOARD
 	int		xterm_idx = -1;
 # endif
@@ -6167,6 +6877,20 @@ RealWaitForChar(int fd, long msec, int *check_for_gpm UNUSED, int *interrupted)
 	    towait = (int)p_mzq;    // don't wait longer than 'mzquantum'
 	    mzquantum_used = TRUE;
 	}
+# endif
+# ifdef FEAT_JOB_CHANNEL
+	// Allocate the array when the channels don't fit, besides the fds
+	// added below.
+	if (6 + channel_poll_count()
+			      > (int)(sizeof(fds_buf) / sizeof(struct pollfd)))
+	{
+	    fds = ALLOC_MULT(struct pollfd, 6 + channel_poll_count());
+	    if (fds == NULL)
+	    {
+		fds = fds_buf;
+		use_channels = FALSE;
+	    }
+	}
 # endif
 	fds[0].fd = fd;
 	fds[0].events = POLLIN;
@@ -6201,7 +6925,8 @@ RealWaitForChar(int fd, long msec, int *check_for_gpm UNUSED, int *interrupted)
 	}
 # endif
 #ifdef FEAT_JOB_CHANNEL
-	nfd = channel_poll_setup(nfd, &fds, &towait);
+	if (use_channels)
+	    nfd = channel_poll_setup(nfd, fds, &towait);
 #endif
 	if (interrupted != NULL)
 	    *interrupted = FALSE;
@@ -6252,9 +6977,11 @@ RealWaitForChar(int fd, long msec, int *check_for_gpm UNUSED, int *interrupted)
 # endif
 #ifdef FEAT_JOB_CHANNEL
 	// also call when ret == 0, we may be polling a keep-open channel
-	if (ret >= 0)
-	    channel_poll_check(ret, &fds);
+	if (ret >= 0 && use_channels)
+	    channel_poll_check(ret, fds);
 #endif
+	if (fds != fds_buf)
+	    vim_free(fds);
 
 #else // HAVE_SELECT
 
@@ -137,6 +137,10 @@
 
 #include <signal.h>
 
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
 #if defined(DIRSIZ) && !defined(MAXNAMLEN)
 # define MAXNAMLEN DIRSIZ
 #endif
@@ -402,8 +406,9 @@ typedef struct dsc$descriptor   DESC;
 # define TEMPNAMELEN    256
 #endif
 
-// Special wildcards that need to be handled by the shell
-#define SPECIAL_WILDCHAR    "`'{"
+// Special wildcards that need to be handled by the shell.  "{a,b}" is
+// expanded by gen_expand_wildcards().
+#define SPECIAL_WILDCHAR    "`'"
 
 /*
  * Unix has plenty of memory, use large buffers
@@ -114,3 +114,13 @@
 #  include <dl.h>
 # endif
 #endif
+
+// Starting processes without copying the page tables with fork().
+#if defined(HAVE_SPAWN_H) && defined(HAVE_POSIX_SPAWNP)
+# include <spawn.h>
+# define USE_POSIX_SPAWN
+// A job gets its own session, posix_spawn() must be able to do that.
+# if defined(POSIX_SPAWN_SETSID) || !defined(HAVE_SETSID)
+#  define USE_POSIX_SPAWN_JOB
+# endif
+#endif
@@ -387,7 +387,8 @@ popup_add_timeout(win_T *wp, int time)
     if (get_lambda_tv(&ptr, &tv, &EVALARG_EVALUATE) == OK)
     {
 	wp->w_popup_timer = create_timer(time, 0);
-	wp->w_popup_timer->tr_callback = get_callback(&tv);
+	if (wp->w_popup_timer != NULL)
+	    wp->w_popup_timer->tr_callback = get_callback(&tv);
 	clear_tv(&tv);
     }
 }
@@ -177,6 +177,7 @@ void qsort(void *base, size_t elm_count, size_t elm_size, int (*cmp)(const void
 # endif
 # include "mouse.pro"
 # include "move.pro"
+# include "msgpack.pro"
 # include "mbyte.pro"
 # ifdef VIMDLL
 // Function name differs when VIMDLL is defined
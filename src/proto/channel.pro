@@ -13,11 +13,10 @@ void channel_set_job(channel_T *channel, job_T *job, jobopt_T *options);
 void channel_buffer_free(buf_T *buf);
 void channel_write_any_lines(void);
 void channel_write_new_lines(buf_T *buf);
-readq_T *channel_peek(channel_T *channel, ch_part_T part);
-char_u *channel_first_nl(readq_T *node);
-char_u *channel_get(channel_T *channel, ch_part_T part, int *outlen);
+char_u *channel_peek(channel_T *channel, ch_part_T part, long_u *lenp);
+char_u *channel_first_nl(channel_T *channel, ch_part_T part);
 void channel_consume(channel_T *channel, ch_part_T part, int len);
-int channel_collapse(channel_T *channel, ch_part_T part, int want_nl);
+char_u *channel_get(channel_T *channel, ch_part_T part, int *outlen);
 int channel_can_write_to(channel_T *channel);
 int channel_is_open(channel_T *channel);
 char *channel_status(channel_T *channel, int req_part);
@@ -29,13 +28,16 @@ int channel_in_blocking_wait(void);
 void channel_handle_events(int only_keep_open);
 int channel_any_keep_open(void);
 void channel_set_nonblock(channel_T *channel, ch_part_T part);
-int channel_send(channel_T *channel, ch_part_T part, char_u *buf_arg, int len_arg, char *fun);
+int channel_send(channel_T *channel, ch_part_T part, char_u *buf, int len, char *fun);
+int channel_send_take(channel_T *channel, ch_part_T part, char_u *buf, int len, char *fun);
+int channel_poll_count(void);
 int channel_poll_setup(int nfd_in, void *fds_in, int *towait);
 int channel_poll_check(int ret_in, void *fds_in);
 int channel_select_setup(int maxfd_in, void *rfds_in, void *wfds_in, struct timeval *tv, struct timeval **tvp);
 int channel_select_check(int ret_in, void *rfds_in, void *wfds_in);
 int channel_parse_messages(void);
 int channel_any_readahead(void);
+int channel_any_decoding(void);
 int set_ref_in_channel(int copyID);
 void clear_job_options(jobopt_T *opt);
 int get_job_options(typval_T *tv, jobopt_T *opt, int supported, int supported2);
@@ -1,7 +1,11 @@
 /* json.c */
 char_u *json_encode(typval_T *val, int options);
-char_u *json_encode_nr_expr(int nr, typval_T *val, int options);
+char_u *json_encode_nr_expr(int nr, typval_T *val, int options, int *lenp);
 int json_decode(js_read_T *reader, typval_T *res, int options);
+int json_decode_resume(js_read_T *reader, js_decode_T **stp, typval_T *res, int options, long msec);
+void json_decode_free(js_decode_T *st);
+int json_decode_set_ref(js_decode_T *st, int copyID);
+int json_scan_message(js_scan_T *scan, char_u *buf, long_u len, int options);
 int json_find_end(js_read_T *reader, int options);
 void f_js_decode(typval_T *argvars, typval_T *rettv);
 void f_js_encode(typval_T *argvars, typval_T *rettv);
@@ -9,8 +9,12 @@ bhdr_T *mf_get(memfile_T *mfp, blocknr_T nr, int page_count);
 void mf_put(memfile_T *mfp, bhdr_T *hp, int dirty, int infile);
 void mf_free(memfile_T *mfp, bhdr_T *hp);
 int mf_sync(memfile_T *mfp, int flags);
+int mf_fsync_wait(memfile_T *mfp);
+void mf_fsync_wait_all(void);
 void mf_set_dirty(memfile_T *mfp);
 int mf_release_all(void);
+void mf_get_info(memfile_T *mfp, dict_T *d);
+void mf_compress_hidden(int force);
 blocknr_T mf_trans_del(memfile_T *mfp, blocknr_T old_nr);
 void mf_set_ffname(memfile_T *mfp);
 void mf_fullname(memfile_T *mfp);
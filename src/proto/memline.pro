@@ -21,13 +21,18 @@ char_u *ml_get_curline(void);
 char_u *ml_get_cursor(void);
 char_u *ml_get_buf(buf_T *buf, linenr_T lnum, int will_change);
 int ml_line_alloced(void);
+int ml_open_mapped(buf_T *buf, int fd, off_T size);
+int ml_unmap(buf_T *buf);
 int ml_append(linenr_T lnum, char_u *line, colnr_T len, int newfile);
 int ml_append_flags(linenr_T lnum, char_u *line, colnr_T len, int flags);
 int ml_append_buf(buf_T *buf, linenr_T lnum, char_u *line, colnr_T len, int newfile);
+int ml_append_buf_lines(buf_T *buf, linenr_T lnum, char_u **lines, colnr_T *lens, long count, int newfile);
+int ml_append_lines(linenr_T lnum, char_u **lines, colnr_T *lens, long count, int newfile);
 int ml_replace(linenr_T lnum, char_u *line, int copy);
 int ml_replace_len(linenr_T lnum, char_u *line_arg, colnr_T len_arg, int has_props, int copy);
 int ml_delete(linenr_T lnum);
 int ml_delete_flags(linenr_T lnum, int flags);
+int ml_delete_range(linenr_T lnum, long count, int flags);
 void ml_setmarked(linenr_T lnum);
 linenr_T ml_firstmarked(void);
 void ml_clearmarked(void);
@@ -82,6 +82,7 @@ int get_fileformat_force(buf_T *buf, exarg_T *eap);
 void set_fileformat(int t, int opt_flags);
 int default_fileformat(void);
 int call_shell(char_u *cmd, int opt);
+int call_shell_io(char_u *cmd, int opt, shellio_T *io);
 int get_real_state(void);
 int after_pathsep(char_u *b, char_u *p);
 int same_directory(char_u *f1, char_u *f2);
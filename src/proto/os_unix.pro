@@ -7,6 +7,7 @@ int mch_check_messages(void);
 long_u mch_total_mem(int special);
 void mch_delay(long msec, int ignoreinput);
 int mch_stackcheck(char *p);
+int mch_call_protected(int (*func)(void *), void *arg);
 void mch_suspend(void);
 void mch_init(void);
 void reset_signals(void);
@@ -59,6 +60,7 @@ int mch_report_winsize(int fd, int rows, int cols);
 void mch_set_shellsize(void);
 void mch_new_shellsize(void);
 int unix_build_argv(char_u *cmd, char ***argvp, char_u **sh_tofree, char_u **shcf_tofree);
+int mch_call_shell_io(char_u *cmd, int options, shellio_T *io);
 int mch_call_shell(char_u *cmd, int options);
 void mch_job_start(char **argv, job_T *job, jobopt_T *options, int is_terminal);
 char *mch_job_status(job_T *job);
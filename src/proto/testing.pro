@@ -21,6 +21,7 @@ void f_test_refcount(typval_T *argvars, typval_T *rettv);
 void f_test_garbagecollect_now(typval_T *argvars, typval_T *rettv);
 void f_test_garbagecollect_soon(typval_T *argvars, typval_T *rettv);
 void f_test_ignore_error(typval_T *argvars, typval_T *rettv);
+void f_test_memcompress_now(typval_T *argvars, typval_T *rettv);
 void f_test_null_blob(typval_T *argvars, typval_T *rettv);
 void f_test_null_channel(typval_T *argvars, typval_T *rettv);
 void f_test_null_dict(typval_T *argvars, typval_T *rettv);
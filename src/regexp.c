@@ -287,6 +287,7 @@ init_class_tab(void)
 #define RF_HASNL    4	// can match a NL
 #define RF_ICOMBINE 8	// ignore combining characters
 #define RF_LOOKBH   16	// uses "\@<=" or "\@<!"
+#define RF_HASEOL   32	// contains an EOL item, see vim_regcomp_had_eol()
 
 /*
  * Global work variables for vim_regcomp().
@@ -1088,12 +1089,31 @@ static void	reg_nextline(void);
 static int	match_with_backref(linenr_T start_lnum, colnr_T start_col, linenr_T end_lnum, colnr_T end_col, int *bytelen);
 
 /*
- * Sometimes need to save a copy of a line.  Since alloc()/free() is very
- * slow, we keep one allocated piece of memory and only re-allocate it when
- * it's too small.  It's freed in bt_regexec_both() when finished.
+ * Structure used to save the current input state, when it needs to be
+ * restored after trying a match.  Used by reg_save() and reg_restore().
+ * Also stores the length of "backpos".
  */
-static char_u	*reg_tofree = NULL;
-static unsigned	reg_tofreelen;
+typedef struct
+{
+    union
+    {
+	char_u	*ptr;	// rex->input pointer, for single-line regexp
+	lpos_T	pos;	// rex->input pos, for multi-line regexp
+    } rs_u;
+    int		rs_len;
+} regsave_T;
+
+// struct to save start/end pointer/position in for \(\)
+typedef struct
+{
+    union
+    {
+	char_u	*ptr;
+	lpos_T	pos;
+    } se_u;
+} save_se_T;
+
+#define NFA_POOL_SIZE	4	// nr of state lists kept for reuse
 
 /*
  * Structure used to store the execution state of the regex engine.
@@ -1112,7 +1132,7 @@ static unsigned	reg_tofreelen;
  * reg_maxline		0			last line nr
  * reg_line_lbr		FALSE or TRUE		FALSE
  */
-typedef struct {
+typedef struct regexec_S {
     regmatch_T		*reg_match;
     regmmatch_T		*reg_mmatch;
     char_u		**reg_startp;
@@ -1149,6 +1169,12 @@ typedef struct {
     // there is no maximum.
     colnr_T		reg_maxcol;
 
+    // The arguments from BRACE_LIMITS are stored here.  They are actually
+    // local to regmatch(), but they are here to reduce the amount of stack
+    // space used (it can be called recursively many times).
+    long		bl_minval;
+    long		bl_maxval;
+
     // State for the NFA engine regexec.
     int nfa_has_zend;	    // NFA regexp \ze operator encountered.
     int nfa_has_backref;    // NFA regexp \1 .. \9 encountered.
@@ -1164,10 +1190,104 @@ typedef struct {
 #ifdef FEAT_SYN_HL
     int nfa_has_zsubexpr;   // NFA regexp has \z( ), set zsubexpr.
 #endif
+    save_se_T	*nfa_endp;	// if not NULL match must end at this position
+    int		nfa_ll_index;	// 0 for first call to nfa_regmatch(), 1 for
+				// recursive call
+    int		nfa_match;	// whether a match has been found
+#ifdef FEAT_RELTIME
+    proftime_T  *nfa_time_limit;
+    int		*nfa_timed_out;
+    int		nfa_time_count;
+#endif
+    // State lists of nfa_regmatch() kept for the next call, to avoid invoking
+    // malloc() and free() for every line.
+    struct nfa_thread_S	*nfa_pool[NFA_POOL_SIZE];
+    int		nfa_pool_len[NFA_POOL_SIZE];  // nr of items in each list
+    int		nfa_pool_count;		      // nr of lists in "nfa_pool"
+
+    // State for the backtracking engine regexec.
+    garray_T	regstack;	// stack used by regmatch()
+    garray_T	backpos;	// table with backpos_T for BACK
+    regsave_T	behind_pos;
+    long	brace_min[10];	// Minimums for complex brace repeats
+    long	brace_max[10];	// Maximums for complex brace repeats
+    int		brace_count[10]; // Current counts for complex brace repeats
+
+#ifdef FEAT_SYN_HL
+    char_u	*reg_startzp[NSUBEXP];	// Workspace to mark beginning
+    char_u	*reg_endzp[NSUBEXP];	//   and end of \z(...\) matches
+    lpos_T	reg_startzpos[NSUBEXP];	// idem, beginning pos
+    lpos_T	reg_endzpos[NSUBEXP];	// idem, end pos
+#endif
+
+    // Sometimes need to save a copy of a line.  Since alloc()/free() is very
+    // slow, we keep one allocated piece of memory and only re-allocate it
+    // when it's too small.  It's freed in bt_regexec_both() when finished.
+    char_u	*reg_tofree;
+    unsigned	reg_tofreelen;
 } regexec_T;
 
-static regexec_T	rex;
-static int		rex_in_use = FALSE;
+/*
+ * The matching functions get the execution state passed from
+ * vim_regexec_multi() and others, and access it through "rex".
+ * "rex_toplevel" is used when not matching yet, it keeps "regstack",
+ * "backpos" and "reg_tofree" over calls to avoid invoking malloc() and free()
+ * often.  A nested match, e.g. from an expression in vim_regsub(), gets its
+ * own state.
+ * These are local to the thread, so that executing a regexp in one thread
+ * doesn't use the state of another one.  The program itself must not be
+ * executed by two threads at the same time, see "re_in_use".
+ */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L \
+	&& !defined(__STDC_NO_THREADS__)
+# define REX_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+# define REX_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+# define REX_THREAD_LOCAL __declspec(thread)
+#else
+# define REX_THREAD_LOCAL
+#endif
+static REX_THREAD_LOCAL regexec_T	rex_toplevel;
+static REX_THREAD_LOCAL regexec_T	*rex = NULL;
+static REX_THREAD_LOCAL int		rex_in_use = FALSE; // "rex_toplevel" is used
+
+static void nfa_pool_clear(regexec_T *rx);
+
+/*
+ * Get the execution state to use for matching: "rex_toplevel" when it is not
+ * in use, otherwise "nested", which is cleared.
+ */
+    static regexec_T *
+rex_get(regexec_T *nested)
+{
+    if (!rex_in_use)
+    {
+	rex_in_use = TRUE;
+	return &rex_toplevel;
+    }
+    CLEAR_POINTER(nested);
+    return nested;
+}
+
+/*
+ * Done with execution state "rx", obtained with rex_get().  Go back to using
+ * "prev".
+ */
+    static void
+rex_release(regexec_T *rx, regexec_T *prev)
+{
+    if (rx == &rex_toplevel)
+	rex_in_use = FALSE;
+    else
+    {
+	ga_clear(&rx->regstack);
+	ga_clear(&rx->backpos);
+	vim_free(rx->reg_tofree);
+	nfa_pool_clear(rx);
+    }
+    rex = prev;
+}
 
 /*
  * Return TRUE if character 'c' is included in 'iskeyword' option for
@@ -1176,7 +1296,7 @@ static int		rex_in_use = FALSE;
     static int
 reg_iswordc(int c)
 {
-    return vim_iswordc_buf(c, rex.reg_buf);
+    return vim_iswordc_buf(c, rex->reg_buf);
 }
 
 /*
@@ -1187,23 +1307,16 @@ reg_getline(linenr_T lnum)
 {
     // when looking behind for a match/no-match lnum is negative.  But we
     // can't go before line 1
-    if (rex.reg_firstlnum + lnum < 1)
+    if (rex->reg_firstlnum + lnum < 1)
 	return NULL;
-    if (lnum > rex.reg_maxline)
+    if (lnum > rex->reg_maxline)
 	// Must have matched the "\n" in the last line.
 	return (char_u *)"";
-    return ml_get_buf(rex.reg_buf, rex.reg_firstlnum + lnum, FALSE);
+    return ml_get_buf(rex->reg_buf, rex->reg_firstlnum + lnum, FALSE);
 }
 
-#ifdef FEAT_SYN_HL
-static char_u	*reg_startzp[NSUBEXP];	// Workspace to mark beginning
-static char_u	*reg_endzp[NSUBEXP];	//   and end of \z(...\) matches
-static lpos_T	reg_startzpos[NSUBEXP];	// idem, beginning pos
-static lpos_T	reg_endzpos[NSUBEXP];	// idem, end pos
-#endif
-
 // TRUE if using multi-line regexp.
-#define REG_MULTI	(rex.reg_match == NULL)
+#define REG_MULTI	(rex->reg_match == NULL)
 
 #ifdef FEAT_SYN_HL
 /*
@@ -1255,14 +1368,14 @@ unref_extmatch(reg_extmatch_T *em)
     static int
 reg_prev_class(void)
 {
-    if (rex.input > rex.line)
-	return mb_get_class_buf(rex.input - 1
-		       - (*mb_head_off)(rex.line, rex.input - 1), rex.reg_buf);
+    if (rex->input > rex->line)
+	return mb_get_class_buf(rex->input - 1
+		    - (*mb_head_off)(rex->line, rex->input - 1), rex->reg_buf);
     return -1;
 }
 
 /*
- * Return TRUE if the current rex.input position matches the Visual area.
+ * Return TRUE if the current rex->input position matches the Visual area.
  */
     static int
 reg_match_visual(void)
@@ -1270,14 +1383,14 @@ reg_match_visual(void)
     pos_T	top, bot;
     linenr_T    lnum;
     colnr_T	col;
-    win_T	*wp = rex.reg_win == NULL ? curwin : rex.reg_win;
+    win_T	*wp = rex->reg_win == NULL ? curwin : rex->reg_win;
     int		mode;
     colnr_T	start, end;
     colnr_T	start2, end2;
     colnr_T	cols;
 
     // Check if the buffer is the current buffer.
-    if (rex.reg_buf != curbuf || VIsual.lnum == 0)
+    if (rex->reg_buf != curbuf || VIsual.lnum == 0)
 	return FALSE;
 
     if (VIsual_active)
@@ -1308,13 +1421,13 @@ reg_match_visual(void)
 	}
 	mode = curbuf->b_visual.vi_mode;
     }
-    lnum = rex.lnum + rex.reg_firstlnum;
+    lnum = rex->lnum + rex->reg_firstlnum;
     if (lnum < top.lnum || lnum > bot.lnum)
 	return FALSE;
 
     if (mode == 'v')
     {
-	col = (colnr_T)(rex.input - rex.line);
+	col = (colnr_T)(rex->input - rex->line);
 	if ((lnum == top.lnum && col < top.col)
 		|| (lnum == bot.lnum && col >= bot.col + (*p_sel != 'e')))
 	    return FALSE;
@@ -1329,7 +1442,8 @@ reg_match_visual(void)
 	    end = end2;
 	if (top.col == MAXCOL || bot.col == MAXCOL)
 	    end = MAXCOL;
-	cols = win_linetabsize(wp, rex.line, (colnr_T)(rex.input - rex.line));
+	cols = win_linetabsize(wp, rex->line,
+					     (colnr_T)(rex->input - rex->line));
 	if (cols < start || cols > end - (*p_sel == 'e'))
 	    return FALSE;
     }
@@ -1345,7 +1459,7 @@ prog_magic_wrong(void)
 {
     regprog_T	*prog;
 
-    prog = REG_MULTI ? rex.reg_mmatch->regprog : rex.reg_match->regprog;
+    prog = REG_MULTI ? rex->reg_mmatch->regprog : rex->reg_match->regprog;
     if (prog->engine == &nfa_regengine)
 	// For NFA matcher we don't check the magic
 	return FALSE;
@@ -1366,20 +1480,20 @@ prog_magic_wrong(void)
     static void
 cleanup_subexpr(void)
 {
-    if (rex.need_clear_subexpr)
+    if (rex->need_clear_subexpr)
     {
 	if (REG_MULTI)
 	{
 	    // Use 0xff to set lnum to -1
-	    vim_memset(rex.reg_startpos, 0xff, sizeof(lpos_T) * NSUBEXP);
-	    vim_memset(rex.reg_endpos, 0xff, sizeof(lpos_T) * NSUBEXP);
+	    vim_memset(rex->reg_startpos, 0xff, sizeof(lpos_T) * NSUBEXP);
+	    vim_memset(rex->reg_endpos, 0xff, sizeof(lpos_T) * NSUBEXP);
 	}
 	else
 	{
-	    vim_memset(rex.reg_startp, 0, sizeof(char_u *) * NSUBEXP);
-	    vim_memset(rex.reg_endp, 0, sizeof(char_u *) * NSUBEXP);
+	    vim_memset(rex->reg_startp, 0, sizeof(char_u *) * NSUBEXP);
+	    vim_memset(rex->reg_endp, 0, sizeof(char_u *) * NSUBEXP);
 	}
-	rex.need_clear_subexpr = FALSE;
+	rex->need_clear_subexpr = FALSE;
     }
 }
 
@@ -1387,32 +1501,32 @@ cleanup_subexpr(void)
     static void
 cleanup_zsubexpr(void)
 {
-    if (rex.need_clear_zsubexpr)
+    if (rex->need_clear_zsubexpr)
     {
 	if (REG_MULTI)
 	{
 	    // Use 0xff to set lnum to -1
-	    vim_memset(reg_startzpos, 0xff, sizeof(lpos_T) * NSUBEXP);
-	    vim_memset(reg_endzpos, 0xff, sizeof(lpos_T) * NSUBEXP);
+	    vim_memset(rex->reg_startzpos, 0xff, sizeof(lpos_T) * NSUBEXP);
+	    vim_memset(rex->reg_endzpos, 0xff, sizeof(lpos_T) * NSUBEXP);
 	}
 	else
 	{
-	    vim_memset(reg_startzp, 0, sizeof(char_u *) * NSUBEXP);
-	    vim_memset(reg_endzp, 0, sizeof(char_u *) * NSUBEXP);
+	    vim_memset(rex->reg_startzp, 0, sizeof(char_u *) * NSUBEXP);
+	    vim_memset(rex->reg_endzp, 0, sizeof(char_u *) * NSUBEXP);
 	}
-	rex.need_clear_zsubexpr = FALSE;
+	rex->need_clear_zsubexpr = FALSE;
     }
 }
 #endif
 
 /*
- * Advance rex.lnum, rex.line and rex.input to the next line.
+ * Advance rex->lnum, rex->line and rex->input to the next line.
  */
     static void
 reg_nextline(void)
 {
-    rex.line = reg_getline(++rex.lnum);
-    rex.input = rex.line;
+    rex->line = reg_getline(++rex->lnum);
+    rex->input = rex->line;
     fast_breakcheck();
 }
 
@@ -1441,21 +1555,21 @@ match_with_backref(
     {
 	// Since getting one line may invalidate the other, need to make copy.
 	// Slow!
-	if (rex.line != reg_tofree)
+	if (rex->line != rex->reg_tofree)
 	{
-	    len = (int)STRLEN(rex.line);
-	    if (reg_tofree == NULL || len >= (int)reg_tofreelen)
+	    len = (int)STRLEN(rex->line);
+	    if (rex->reg_tofree == NULL || len >= (int)rex->reg_tofreelen)
 	    {
 		len += 50;	// get some extra
-		vim_free(reg_tofree);
-		reg_tofree = alloc(len);
-		if (reg_tofree == NULL)
+		vim_free(rex->reg_tofree);
+		rex->reg_tofree = alloc(len);
+		if (rex->reg_tofree == NULL)
 		    return RA_FAIL; // out of memory!
-		reg_tofreelen = len;
+		rex->reg_tofreelen = len;
 	    }
-	    STRCPY(reg_tofree, rex.line);
-	    rex.input = reg_tofree + (rex.input - rex.line);
-	    rex.line = reg_tofree;
+	    STRCPY(rex->reg_tofree, rex->line);
+	    rex->input = rex->reg_tofree + (rex->input - rex->line);
+	    rex->line = rex->reg_tofree;
 	}
 
 	// Get the line to compare with.
@@ -1465,13 +1579,13 @@ match_with_backref(
 	else
 	    len = (int)STRLEN(p + ccol);
 
-	if (cstrncmp(p + ccol, rex.input, &len) != 0)
+	if (cstrncmp(p + ccol, rex->input, &len) != 0)
 	    return RA_NOMATCH;  // doesn't match
 	if (bytelen != NULL)
 	    *bytelen += len;
 	if (clnum == end_lnum)
 	    break;		// match and at end!
-	if (rex.lnum >= rex.reg_maxline)
+	if (rex->lnum >= rex->reg_maxline)
 	    return RA_NOMATCH;  // text too short
 
 	// Advance to next line.
@@ -1484,7 +1598,7 @@ match_with_backref(
 	    return RA_FAIL;
     }
 
-    // found a match!  Note that rex.line may now point to a copy of the line,
+    // found a match!  Note that rex->line may now point to a copy of the line,
     // that should not matter.
     return RA_MATCH;
 }
@@ -1583,7 +1697,7 @@ mb_decompose(int c, int *c1, int *c2, int *c3)
 }
 
 /*
- * Compare two strings, ignore case if rex.reg_ic set.
+ * Compare two strings, ignore case if rex->reg_ic set.
  * Return 0 if strings match, non-zero otherwise.
  * Correct the length "*n" when composing characters are ignored.
  */
@@ -1592,13 +1706,13 @@ cstrncmp(char_u *s1, char_u *s2, int *n)
 {
     int		result;
 
-    if (!rex.reg_ic)
+    if (!rex->reg_ic)
 	result = STRNCMP(s1, s2, *n);
     else
 	result = MB_STRNICMP(s1, s2, *n);
 
     // if it failed and it's utf8 and we want to combineignore:
-    if (result != 0 && enc_utf8 && rex.reg_icombine)
+    if (result != 0 && enc_utf8 && rex->reg_icombine)
     {
 	char_u	*str1, *str2;
 	int	c1, c2, c11, c12;
@@ -1616,7 +1730,7 @@ cstrncmp(char_u *s1, char_u *s2, int *n)
 
 	    // Decompose the character if necessary, into 'base' characters.
 	    // Currently hard-coded for Hebrew, Arabic to be done...
-	    if (c1 != c2 && (!rex.reg_ic || utf_fold(c1) != utf_fold(c2)))
+	    if (c1 != c2 && (!rex->reg_ic || utf_fold(c1) != utf_fold(c2)))
 	    {
 		// decomposition necessary?
 		mb_decompose(c1, &c11, &junk, &junk);
@@ -1624,7 +1738,7 @@ cstrncmp(char_u *s1, char_u *s2, int *n)
 		c1 = c11;
 		c2 = c12;
 		if (c11 != c12
-			    && (!rex.reg_ic || utf_fold(c11) != utf_fold(c12)))
+			    && (!rex->reg_ic || utf_fold(c11) != utf_fold(c12)))
 		    break;
 	    }
 	}
@@ -1645,7 +1759,7 @@ cstrchr(char_u *s, int c)
     char_u	*p;
     int		cc;
 
-    if (!rex.reg_ic || (!enc_utf8 && mb_char2len(c) > 1))
+    if (!rex->reg_ic || (!enc_utf8 && mb_char2len(c) > 1))
 	return vim_strchr(s, c);
 
     // tolower() and toupper() can be slow, comparing twice should be a lot
@@ -1893,25 +2007,18 @@ vim_regsub(
     int		backslash)
 {
     int		result;
-    regexec_T	rex_save;
-    int		rex_in_use_save = rex_in_use;
-
-    if (rex_in_use)
-	// Being called recursively, save the state.
-	rex_save = rex;
-    rex_in_use = TRUE;
-
-    rex.reg_match = rmp;
-    rex.reg_mmatch = NULL;
-    rex.reg_maxline = 0;
-    rex.reg_buf = curbuf;
-    rex.reg_line_lbr = TRUE;
+    regexec_T	rex_nested;
+    regexec_T	*rex_save = rex;
+
+    rex = rex_get(&rex_nested);
+    rex->reg_match = rmp;
+    rex->reg_mmatch = NULL;
+    rex->reg_maxline = 0;
+    rex->reg_buf = curbuf;
+    rex->reg_line_lbr = TRUE;
     result = vim_regsub_both(source, expr, dest, copy, magic, backslash);
 
-    rex_in_use = rex_in_use_save;
-    if (rex_in_use)
-	rex = rex_save;
-
+    rex_release(rex, rex_save);
     return result;
 }
 
@@ -1926,26 +2033,19 @@ vim_regsub_multi(
     int		backslash)
 {
     int		result;
-    regexec_T	rex_save;
-    int		rex_in_use_save = rex_in_use;
-
-    if (rex_in_use)
-	// Being called recursively, save the state.
-	rex_save = rex;
-    rex_in_use = TRUE;
-
-    rex.reg_match = NULL;
-    rex.reg_mmatch = rmp;
-    rex.reg_buf = curbuf;	// always works on the current buffer!
-    rex.reg_firstlnum = lnum;
-    rex.reg_maxline = curbuf->b_ml.ml_line_count - lnum;
-    rex.reg_line_lbr = FALSE;
+    regexec_T	rex_nested;
+    regexec_T	*rex_save = rex;
+
+    rex = rex_get(&rex_nested);
+    rex->reg_match = NULL;
+    rex->reg_mmatch = rmp;
+    rex->reg_buf = curbuf;	// always works on the current buffer!
+    rex->reg_firstlnum = lnum;
+    rex->reg_maxline = curbuf->b_ml.ml_line_count - lnum;
+    rex->reg_line_lbr = FALSE;
     result = vim_regsub_both(source, NULL, dest, copy, magic, backslash);
 
-    rex_in_use = rex_in_use_save;
-    if (rex_in_use)
-	rex = rex_save;
-
+    rex_release(rex, rex_save);
     return result;
 }
 
@@ -2015,11 +2115,11 @@ vim_regsub_both(
 	    if (can_f_submatch)
 		rsm_save = rsm;
 	    can_f_submatch = TRUE;
-	    rsm.sm_match = rex.reg_match;
-	    rsm.sm_mmatch = rex.reg_mmatch;
-	    rsm.sm_firstlnum = rex.reg_firstlnum;
-	    rsm.sm_maxline = rex.reg_maxline;
-	    rsm.sm_line_lbr = rex.reg_line_lbr;
+	    rsm.sm_match = rex->reg_match;
+	    rsm.sm_mmatch = rex->reg_mmatch;
+	    rsm.sm_firstlnum = rex->reg_firstlnum;
+	    rsm.sm_maxline = rex->reg_maxline;
+	    rsm.sm_line_lbr = rex->reg_line_lbr;
 
 	    if (expr != NULL)
 	    {
@@ -2233,26 +2333,26 @@ vim_regsub_both(
 	{
 	    if (REG_MULTI)
 	    {
-		clnum = rex.reg_mmatch->startpos[no].lnum;
-		if (clnum < 0 || rex.reg_mmatch->endpos[no].lnum < 0)
+		clnum = rex->reg_mmatch->startpos[no].lnum;
+		if (clnum < 0 || rex->reg_mmatch->endpos[no].lnum < 0)
 		    s = NULL;
 		else
 		{
-		    s = reg_getline(clnum) + rex.reg_mmatch->startpos[no].col;
-		    if (rex.reg_mmatch->endpos[no].lnum == clnum)
-			len = rex.reg_mmatch->endpos[no].col
-					    - rex.reg_mmatch->startpos[no].col;
+		    s = reg_getline(clnum) + rex->reg_mmatch->startpos[no].col;
+		    if (rex->reg_mmatch->endpos[no].lnum == clnum)
+			len = rex->reg_mmatch->endpos[no].col
+					    - rex->reg_mmatch->startpos[no].col;
 		    else
 			len = (int)STRLEN(s);
 		}
 	    }
 	    else
 	    {
-		s = rex.reg_match->startp[no];
-		if (rex.reg_match->endp[no] == NULL)
+		s = rex->reg_match->startp[no];
+		if (rex->reg_match->endp[no] == NULL)
 		    s = NULL;
 		else
-		    len = (int)(rex.reg_match->endp[no] - s);
+		    len = (int)(rex->reg_match->endp[no] - s);
 	    }
 	    if (s != NULL)
 	    {
@@ -2262,14 +2362,14 @@ vim_regsub_both(
 		    {
 			if (REG_MULTI)
 			{
-			    if (rex.reg_mmatch->endpos[no].lnum == clnum)
+			    if (rex->reg_mmatch->endpos[no].lnum == clnum)
 				break;
 			    if (copy)
 				*dst = CAR;
 			    ++dst;
 			    s = reg_getline(++clnum);
-			    if (rex.reg_mmatch->endpos[no].lnum == clnum)
-				len = rex.reg_mmatch->endpos[no].col;
+			    if (rex->reg_mmatch->endpos[no].lnum == clnum)
+				len = rex->reg_mmatch->endpos[no].col;
 			    else
 				len = (int)STRLEN(s);
 			}
@@ -2362,16 +2462,16 @@ exit:
 reg_getline_submatch(linenr_T lnum)
 {
     char_u *s;
-    linenr_T save_first = rex.reg_firstlnum;
-    linenr_T save_max = rex.reg_maxline;
+    linenr_T save_first = rex->reg_firstlnum;
+    linenr_T save_max = rex->reg_maxline;
 
-    rex.reg_firstlnum = rsm.sm_firstlnum;
-    rex.reg_maxline = rsm.sm_maxline;
+    rex->reg_firstlnum = rsm.sm_firstlnum;
+    rex->reg_maxline = rsm.sm_maxline;
 
     s = reg_getline(lnum);
 
-    rex.reg_firstlnum = save_first;
-    rex.reg_maxline = save_max;
+    rex->reg_firstlnum = save_first;
+    rex->reg_maxline = save_max;
     return s;
 }
 
@@ -2552,21 +2652,22 @@ reg_submatch_list(int no)
  */
     static void
 init_regexec_multi(
+	regexec_T	*rx,
 	regmmatch_T	*rmp,
 	win_T		*win,	// window in which to search or NULL
 	buf_T		*buf,	// buffer in which to search
 	linenr_T	lnum)	// nr of line to start looking for match
 {
-    rex.reg_match = NULL;
-    rex.reg_mmatch = rmp;
-    rex.reg_buf = buf;
-    rex.reg_win = win;
-    rex.reg_firstlnum = lnum;
-    rex.reg_maxline = rex.reg_buf->b_ml.ml_line_count - lnum;
-    rex.reg_line_lbr = FALSE;
-    rex.reg_ic = rmp->rmm_ic;
-    rex.reg_icombine = FALSE;
-    rex.reg_maxcol = rmp->rmm_maxcol;
+    rx->reg_match = NULL;
+    rx->reg_mmatch = rmp;
+    rx->reg_buf = buf;
+    rx->reg_win = win;
+    rx->reg_firstlnum = lnum;
+    rx->reg_maxline = rx->reg_buf->b_ml.ml_line_count - lnum;
+    rx->reg_line_lbr = FALSE;
+    rx->reg_ic = rmp->rmm_ic;
+    rx->reg_icombine = FALSE;
+    rx->reg_maxcol = rmp->rmm_maxcol;
 }
 
 #include "regexp_bt.c"
@@ -2581,6 +2682,7 @@ static regengine_T bt_regengine =
 };
 
 #include "regexp_nfa.c"
+#include "regexp_dfa.c"
 
 static regengine_T nfa_regengine =
 {
@@ -2604,17 +2706,167 @@ static char_u regname[][30] = {
 #endif
 
 /*
- * Compile a regular expression into internal code.
- * Returns the program in allocated memory.
- * Use vim_regfree() to free the memory.
- * Returns NULL for an error.
+ * Cache of compiled programs.  When the same pattern is used again and again,
+ * e.g. with search() or match() in a loop, it is only compiled once.  The
+ * key is the pattern with everything else that the compiled program depends
+ * on.  The cache holds a reference to each program, see vim_regfree().
  */
-    regprog_T *
-vim_regcomp(char_u *expr_arg, int re_flags)
+#define REGCACHE_SIZE	32	// number of programs in the cache
+#define REGCACHE_MAXLEN	1000	// longer patterns are not cached
+
+typedef struct
+{
+    regprog_T	*rc_prog;	// NULL for an unused entry
+    hash_T	rc_hash;	// hash of the pattern
+    int		rc_flags;	// "re_flags" argument of vim_regcomp()
+    int		rc_engine;	// value of 'regexpengine'
+    int		rc_opts;	// 'cpoptions' flags and encoding
+    long_u	rc_used;	// "regcache_clock" when last used
+} regcache_T;
+
+static regcache_T regcache[REGCACHE_SIZE];
+static long_u	regcache_clock = 0;
+static long_u	regcache_hits = 0;
+static long_u	regcache_misses = 0;
+static long_u	regcache_evictions = 0;
+static long_u	regcache_copies = 0;
+
+/*
+ * Fill in the key for pattern "expr" in "rc".  Returns FALSE if the compiled
+ * program can't be cached.
+ */
+    static int
+regcache_key(char_u *expr, int re_flags, regcache_T *rc)
+{
+    // The backtracking engine uses the current option values for these.
+    static char *opt_classes[] = {"[:print:]", "[:ident:]", "[:keyword:]",
+								"[:fname:]"};
+    int		i;
+
+    // "~" is replaced with the last substitute string, \z( and \z1 are
+    // only allowed for syntax items.
+    if (vim_strchr(expr, '~') != NULL || STRLEN(expr) > REGCACHE_MAXLEN
+#ifdef FEAT_SYN_HL
+	    || reg_do_extmatch != 0
+#endif
+       )
+	return FALSE;
+    if (vim_strchr(expr, '[') != NULL)
+	for (i = 0; i < (int)(sizeof(opt_classes) / sizeof(char *)); ++i)
+	    if (strstr((char *)expr, opt_classes[i]) != NULL)
+		return FALSE;
+
+    rc->rc_hash = hash_hash(expr);
+    rc->rc_flags = re_flags;
+    rc->rc_engine = p_re;
+    rc->rc_opts = (vim_strchr(p_cpo, CPO_LITERAL) != NULL)
+		+ (vim_strchr(p_cpo, CPO_BACKSL) != NULL) * 2
+		+ enc_utf8 * 4 + enc_latin1like * 8 + (enc_dbcs << 4);
+    return TRUE;
+}
+
+/*
+ * Find the cache entry for pattern "expr" with the key in "key".
+ * Returns NULL if there is none.
+ */
+    static regcache_T *
+regcache_find(char_u *expr, regcache_T *key)
+{
+    regcache_T	*rc;
+
+    for (rc = regcache; rc < regcache + REGCACHE_SIZE; ++rc)
+	if (rc->rc_prog != NULL && rc->rc_hash == key->rc_hash
+		&& rc->rc_flags == key->rc_flags
+		&& rc->rc_engine == key->rc_engine
+		&& rc->rc_opts == key->rc_opts
+		&& STRCMP(rc->rc_prog->re_pat, expr) == 0)
+	    return rc;
+    return NULL;
+}
+
+/*
+ * Add "prog", compiled from pattern "expr", to the cache with the key in
+ * "key".  Replaces the least recently used entry when the cache is full.
+ */
+    static void
+regcache_add(char_u *expr, regcache_T *key, regprog_T *prog)
+{
+    regcache_T	*rc;
+    regcache_T	*lru = regcache;
+
+    if (prog->re_pat == NULL)
+    {
+	prog->re_pat = vim_strsave(expr);
+	if (prog->re_pat == NULL)
+	    return;
+    }
+
+    for (rc = regcache; rc < regcache + REGCACHE_SIZE; ++rc)
+    {
+	if (rc->rc_prog == NULL)
+	{
+	    lru = rc;
+	    break;
+	}
+	if (rc->rc_used < lru->rc_used)
+	    lru = rc;
+    }
+    if (lru->rc_prog != NULL)
+    {
+	vim_regfree(lru->rc_prog);
+	++regcache_evictions;
+    }
+
+    *lru = *key;
+    lru->rc_prog = prog;
+    lru->rc_used = ++regcache_clock;
+    ++prog->re_refcount;
+}
+
+/*
+ * Replace "prog" in the cache with "newprog", which was compiled from the
+ * same pattern with the backtracking engine.  When "newprog" is NULL the
+ * entry is removed.
+ */
+    static void
+regcache_replace(regprog_T *prog, regprog_T *newprog)
+{
+    regcache_T	*rc;
+
+    if (prog->re_pat == NULL)
+	return;	    // not in the cache
+    for (rc = regcache; rc < regcache + REGCACHE_SIZE; ++rc)
+	if (rc->rc_prog == prog)
+	{
+	    if (newprog != NULL && newprog->re_pat == NULL)
+		newprog->re_pat = vim_strsave(prog->re_pat);
+	    if (newprog == NULL || newprog->re_pat == NULL)
+		rc->rc_prog = NULL;
+	    else
+	    {
+		rc->rc_prog = newprog;
+		++newprog->re_refcount;
+	    }
+	    vim_regfree(prog);
+	}
+}
+
+/*
+ * Compile a regular expression into internal code, without using the cache.
+ */
+    static regprog_T *
+vim_regcomp_nocache(char_u *expr_arg, int re_flags)
 {
     regprog_T   *prog = NULL;
     char_u	*expr = expr_arg;
     int		called_emsg_before;
+    regexec_T	rex_compile;
+    regexec_T	*rex_save = rex;
+
+    // Compiling only needs "reg_buf", use a scratch context so that this can
+    // be done while matching with another program.
+    CLEAR_FIELD(rex_compile);
+    rex = &rex_compile;
 
     regexp_engine = p_re;
 
@@ -2644,8 +2896,8 @@ vim_regcomp(char_u *expr_arg, int re_flags)
     bt_regengine.expr = expr;
     nfa_regengine.expr = expr;
 #endif
-    // reg_iswordc() uses rex.reg_buf
-    rex.reg_buf = curbuf;
+    // reg_iswordc() uses rex->reg_buf
+    rex->reg_buf = curbuf;
 
     /*
      * First try the NFA engine, unless backtracking was requested.
@@ -2695,28 +2947,141 @@ vim_regcomp(char_u *expr_arg, int re_flags)
 	// out to be very slow when executing it.
 	prog->re_engine = regexp_engine;
 	prog->re_flags  = re_flags;
+	prog->re_refcount = 1;
+	prog->re_pat = NULL;
+    }
+
+    rex = rex_save;
+    return prog;
+}
+
+/*
+ * Compile a regular expression into internal code.
+ * Returns the program in allocated memory.  It may be shared with others,
+ * thus it must not be changed.
+ * Use vim_regfree() to free the memory.
+ * Returns NULL for an error.
+ */
+    regprog_T *
+vim_regcomp(char_u *expr_arg, int re_flags)
+{
+    regcache_T	key;
+    regcache_T	*rc;
+    regprog_T	*prog;
+    int		called_emsg_before = called_emsg;
+
+    if (!regcache_key(expr_arg, re_flags, &key))
+	return vim_regcomp_nocache(expr_arg, re_flags);
+
+    rc = regcache_find(expr_arg, &key);
+    if (rc != NULL)
+    {
+	++regcache_hits;
+	rc->rc_used = ++regcache_clock;
+	++rc->rc_prog->re_refcount;
+#ifdef FEAT_SYN_HL
+	// Not compiled now, vim_regcomp_had_eol() must still be correct.
+	had_eol = (rc->rc_prog->regflags & RF_HASEOL) != 0;
+#endif
+	return rc->rc_prog;
     }
 
+    ++regcache_misses;
+    prog = vim_regcomp_nocache(expr_arg, re_flags);
+
+    // Don't cache when there was an error message, it must be given again.
+    if (prog != NULL && called_emsg == called_emsg_before)
+	regcache_add(expr_arg, &key, prog);
     return prog;
 }
 
 /*
  * Free a compiled regexp program, returned by vim_regcomp().
+ * Only really frees it when there are no other users.
  */
     void
 vim_regfree(regprog_T *prog)
 {
-    if (prog != NULL)
+    if (prog != NULL && --prog->re_refcount <= 0)
+    {
+	vim_free(prog->re_pat);
 	prog->engine->regfree(prog);
+    }
+}
+
+/*
+ * "prog" is being executed and the same program is to be executed again.
+ * When another user got the same program from the cache, return a copy
+ * compiled again from the pattern.  Otherwise the program is really used
+ * recursively, return NULL.
+ */
+    static regprog_T *
+regprog_copy(regprog_T *prog)
+{
+    int		save_p_re = p_re;
+    int		users = prog->re_refcount;
+    regprog_T	*copy;
+    regcache_T	*rc;
+
+    if (prog->re_pat == NULL)
+	return NULL;
+    // The reference held by the cache itself does not count.
+    for (rc = regcache; rc < regcache + REGCACHE_SIZE; ++rc)
+	if (rc->rc_prog == prog)
+	{
+	    --users;
+	    break;
+	}
+    if (users <= 1)
+	return NULL;
+
+    p_re = prog->re_engine;
+    copy = vim_regcomp_nocache(prog->re_pat, prog->re_flags);
+    p_re = save_p_re;
+    if (copy != NULL)
+	++regcache_copies;
+    return copy;
 }
 
+#if defined(FEAT_EVAL) || defined(PROTO)
+/*
+ * Put statistics about the cache of compiled programs in dictionary "d".
+ * This is used by the regcacheinfo() function.
+ */
+    void
+regcache_get_info(dict_T *d)
+{
+    regcache_T	*rc;
+    int		entries = 0;
+
+    for (rc = regcache; rc < regcache + REGCACHE_SIZE; ++rc)
+	if (rc->rc_prog != NULL)
+	    ++entries;
+    dict_add_number(d, "hits", (varnumber_T)regcache_hits);
+    dict_add_number(d, "misses", (varnumber_T)regcache_misses);
+    dict_add_number(d, "evictions", (varnumber_T)regcache_evictions);
+    dict_add_number(d, "copies", (varnumber_T)regcache_copies);
+    dict_add_number(d, "entries", (varnumber_T)entries);
+    dict_add_number(d, "size", (varnumber_T)REGCACHE_SIZE);
+}
+#endif
+
 #if defined(EXITFREE) || defined(PROTO)
     void
 free_regexp_stuff(void)
 {
-    ga_clear(&regstack);
-    ga_clear(&backpos);
-    vim_free(reg_tofree);
+    regcache_T	*rc;
+
+    for (rc = regcache; rc < regcache + REGCACHE_SIZE; ++rc)
+	if (rc->rc_prog != NULL)
+	{
+	    vim_regfree(rc->rc_prog);
+	    rc->rc_prog = NULL;
+	}
+    ga_clear(&rex_toplevel.regstack);
+    ga_clear(&rex_toplevel.backpos);
+    vim_free(rex_toplevel.reg_tofree);
+    nfa_pool_clear(&rex_toplevel);
     vim_free(reg_prev_sub);
 }
 #endif
@@ -2747,6 +3112,73 @@ regprog_in_use(regprog_T *prog)
 }
 #endif
 
+/*
+ * Check if "line" from column "col" contains the text that every match of
+ * "prog" includes.  "ic" is TRUE when ignoring case.
+ * Return FALSE when there can't be a match, TRUE when there can be one or
+ * it's unknown.  This is a lot faster than trying to match, the text is found
+ * with strstr() or strpbrk(), which are optimized in most C libraries.
+ */
+    static int
+re_must_in_line(regprog_T *prog, char_u *line, colnr_T col, int ic)
+{
+    char_u	*must = prog->re_must;
+    int		len = prog->re_mustlen;
+    char_u	set[3];
+    char_u	*p;
+    int		start = 0;
+    int		i;
+
+    if (must == NULL || (prog->regflags & RF_ICOMBINE))
+	return TRUE;
+
+    // If pattern contains "\c" or "\C": overrule value of "ic"
+    if (prog->regflags & RF_ICASE)
+	ic = TRUE;
+    else if (prog->regflags & RF_NOICASE)
+	ic = FALSE;
+
+    if (!ic)
+	return strstr((char *)line + col, (char *)must) != NULL;
+
+    // When ignoring case use the longest part of the text with only ASCII
+    // characters, these only match ASCII characters in the same position.
+    // Except that in UTF-8 "k" and "s" also match the Kelvin sign and the
+    // long s.
+    len = 0;
+    for (i = 0; i <= prog->re_mustlen; ++i)
+	if (i == prog->re_mustlen || prog->re_must[i] >= 0x80
+		|| (enc_utf8 && (TOLOWER_ASC(prog->re_must[i]) == 'k'
+				 || TOLOWER_ASC(prog->re_must[i]) == 's')))
+	{
+	    if (i - start > len)
+	    {
+		must = prog->re_must + start;
+		len = i - start;
+	    }
+	    start = i + 1;
+	}
+    if (len == 0)
+	return TRUE;
+    if (STRLEN(line + col) < (size_t)len)
+	return FALSE;
+
+    // Look for a character that is not a letter, there is only one way to
+    // write it.  Otherwise look for both cases of the first letter.
+    for (i = 0; i < len - 1 && ASCII_ISALPHA(must[i]); ++i)
+	;
+    if (ASCII_ISALPHA(must[i]))
+	i = 0;
+    set[0] = TOLOWER_ASC(must[i]);
+    set[1] = TOUPPER_ASC(must[i]);
+    set[2] = NUL;
+    for (p = line + col + i; (p = (char_u *)strpbrk((char *)p, (char *)set))
+								!= NULL; ++p)
+	if (STRNICMP(p - i, must, len) == 0)
+	    return TRUE;
+    return FALSE;
+}
+
 /*
  * Match a regexp against a string.
  * "rmp->regprog" is a compiled regexp as returned by vim_regcomp().
@@ -2764,28 +3196,42 @@ vim_regexec_string(
     int		nl)
 {
     int		result;
-    regexec_T	rex_save;
-    int		rex_in_use_save = rex_in_use;
+    regexec_T	rex_nested;
+    regexec_T	*rex_save = rex;
+    regexec_T	*rx;
 
     // Cannot use the same prog recursively, it contains state.
     if (rmp->regprog->re_in_use)
     {
-	emsg(_(e_recursive));
-	return FALSE;
+	regprog_T   *prog = rmp->regprog;
+	regprog_T   *copy = regprog_copy(prog);
+
+	if (copy == NULL)
+	{
+	    emsg(_(e_recursive));
+	    return FALSE;
+	}
+	// The program is shared with someone else, use a copy for now.
+	rmp->regprog = copy;
+	result = vim_regexec_string(rmp, line, col, nl);
+	vim_regfree(rmp->regprog);
+	rmp->regprog = prog;
+	return result;
     }
-    rmp->regprog->re_in_use = TRUE;
 
-    if (rex_in_use)
-	// Being called recursively, save the state.
-	rex_save = rex;
-    rex_in_use = TRUE;
+    if (!re_must_in_line(rmp->regprog, line, col, rmp->rm_ic))
+	return FALSE;
+
+    rmp->regprog->re_in_use = TRUE;
 
-    rex.reg_startp = NULL;
-    rex.reg_endp = NULL;
-    rex.reg_startpos = NULL;
-    rex.reg_endpos = NULL;
+    // When called recursively use a separate execution state.
+    rx = rex_get(&rex_nested);
+    rx->reg_startp = NULL;
+    rx->reg_endp = NULL;
+    rx->reg_startpos = NULL;
+    rx->reg_endpos = NULL;
 
-    result = rmp->regprog->engine->regexec_nl(rmp, line, col, nl);
+    result = rmp->regprog->engine->regexec_nl(rx, rmp, line, col, nl);
     rmp->regprog->re_in_use = FALSE;
 
     // NFA engine aborted because it's very slow.
@@ -2795,31 +3241,32 @@ vim_regexec_string(
 	int    save_p_re = p_re;
 	int    re_flags = rmp->regprog->re_flags;
 	char_u *pat = vim_strsave(((nfa_regprog_T *)rmp->regprog)->pattern);
+	regprog_T *prog = rmp->regprog;
 
 	p_re = BACKTRACKING_ENGINE;
-	vim_regfree(rmp->regprog);
 	if (pat != NULL)
 	{
 #ifdef FEAT_EVAL
 	    report_re_switch(pat);
 #endif
 	    rmp->regprog = vim_regcomp(pat, re_flags);
+	    // When found in the cache next time use the new program as well.
+	    regcache_replace(prog, rmp->regprog);
 	    if (rmp->regprog != NULL)
 	    {
 		rmp->regprog->re_in_use = TRUE;
-		result = rmp->regprog->engine->regexec_nl(rmp, line, col, nl);
+		result = rmp->regprog->engine->regexec_nl(
+						       rx, rmp, line, col, nl);
 		rmp->regprog->re_in_use = FALSE;
 	    }
 	    vim_free(pat);
 	}
+	vim_regfree(prog);
 
 	p_re = save_p_re;
     }
 
-    rex_in_use = rex_in_use_save;
-    if (rex_in_use)
-	rex = rex_save;
-
+    rex_release(rx, rex_save);
     return result > 0;
 }
 
@@ -2885,24 +3332,43 @@ vim_regexec_multi(
     int		*timed_out)	// flag is set when timeout limit reached
 {
     int		result;
-    regexec_T	rex_save;
-    int		rex_in_use_save = rex_in_use;
+    regexec_T	rex_nested;
+    regexec_T	*rex_save = rex;
+    regexec_T	*rx;
 
     // Cannot use the same prog recursively, it contains state.
     if (rmp->regprog->re_in_use)
     {
-	emsg(_(e_recursive));
-	return FALSE;
+	regprog_T   *prog = rmp->regprog;
+	regprog_T   *copy = regprog_copy(prog);
+
+	if (copy == NULL)
+	{
+	    emsg(_(e_recursive));
+	    return FALSE;
+	}
+	// The program is shared with someone else, use a copy for now.
+	rmp->regprog = copy;
+	result = vim_regexec_multi(rmp, win, buf, lnum, col, tm, timed_out);
+	vim_regfree(rmp->regprog);
+	rmp->regprog = prog;
+	return result;
     }
+
+    // Skip the line when it doesn't contain the text that must match.  When
+    // the pattern can match a line break there is no such text.
+    if (lnum >= 1 && lnum <= buf->b_ml.ml_line_count
+	    && !re_must_in_line(rmp->regprog, ml_get_buf(buf, lnum, FALSE),
+							   col, rmp->rmm_ic))
+	return 0;
+
     rmp->regprog->re_in_use = TRUE;
 
-    if (rex_in_use)
-	// Being called recursively, save the state.
-	rex_save = rex;
-    rex_in_use = TRUE;
+    // When called recursively use a separate execution state.
+    rx = rex_get(&rex_nested);
 
     result = rmp->regprog->engine->regexec_multi(
-				      rmp, win, buf, lnum, col, tm, timed_out);
+				  rx, rmp, win, buf, lnum, col, tm, timed_out);
     rmp->regprog->re_in_use = FALSE;
 
     // NFA engine aborted because it's very slow.
@@ -2912,9 +3378,9 @@ vim_regexec_multi(
 	int    save_p_re = p_re;
 	int    re_flags = rmp->regprog->re_flags;
 	char_u *pat = vim_strsave(((nfa_regprog_T *)rmp->regprog)->pattern);
+	regprog_T *prog = rmp->regprog;
 
 	p_re = BACKTRACKING_ENGINE;
-	vim_regfree(rmp->regprog);
 	if (pat != NULL)
 	{
 #ifdef FEAT_EVAL
@@ -2929,22 +3395,22 @@ vim_regexec_multi(
 #ifdef FEAT_SYN_HL
 	    reg_do_extmatch = 0;
 #endif
+	    // When found in the cache next time use the new program as well.
+	    regcache_replace(prog, rmp->regprog);
 
 	    if (rmp->regprog != NULL)
 	    {
 		rmp->regprog->re_in_use = TRUE;
 		result = rmp->regprog->engine->regexec_multi(
-				      rmp, win, buf, lnum, col, tm, timed_out);
+				  rx, rmp, win, buf, lnum, col, tm, timed_out);
 		rmp->regprog->re_in_use = FALSE;
 	    }
 	    vim_free(pat);
 	}
+	vim_regfree(prog);
 	p_re = save_p_re;
     }
 
-    rex_in_use = rex_in_use_save;
-    if (rex_in_use)
-	rex = rex_save;
-
+    rex_release(rx, rex_save);
     return result <= 0 ? 0 : result;
 }
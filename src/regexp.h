@@ -53,6 +53,10 @@ typedef struct regprog
     unsigned		re_engine;   // automatic, backtracking or nfa engine
     unsigned		re_flags;    // second argument for vim_regcomp()
     int			re_in_use;   // prog is being executed
+    int			re_refcount; // number of users, see vim_regfree()
+    char_u		*re_pat;     // pattern, when in the cache, or NULL
+    char_u		*re_must;    // text any match must contain, or NULL
+    int			re_mustlen;  // length of "re_must"
 } regprog_T;
 
 /*
@@ -62,17 +66,19 @@ typedef struct regprog
  */
 typedef struct
 {
-    // These four members implement regprog_T
+    // These members implement regprog_T
     regengine_T		*engine;
     unsigned		regflags;
     unsigned		re_engine;
     unsigned		re_flags;
     int			re_in_use;
+    int			re_refcount;
+    char_u		*re_pat;
+    char_u		*re_must;	// points into program[]
+    int			re_mustlen;
 
     int			regstart;
     char_u		reganch;
-    char_u		*regmust;
-    int			regmlen;
 #ifdef FEAT_SYN_HL
     char_u		reghasz;
 #endif
@@ -99,17 +105,24 @@ struct nfa_state
  */
 typedef struct
 {
-    // These three members implement regprog_T
+    // These members implement regprog_T
     regengine_T		*engine;
     unsigned		regflags;
     unsigned		re_engine;
     unsigned		re_flags;
     int			re_in_use;
+    int			re_refcount;
+    char_u		*re_pat;
+    char_u		*re_must;	// allocated
+    int			re_mustlen;
 
     nfa_state_T		*start;		// points into state[]
 
     int			reganch;	// pattern starts with ^
     int			regstart;	// char at start of pattern
+    int			has_startmap;	// "startmap" is valid
+    char_u		startmap[32];	// bitmap of bytes a match can start
+					// with, used when "regstart" is NUL
     char_u		*match_text;	// plain text to match with
 
     int			has_zend;	// pattern contains \ze
@@ -117,6 +130,8 @@ typedef struct
 #ifdef FEAT_SYN_HL
     int			reghasz;
 #endif
+    struct regdfa_S	*dfa;		// lazy DFA, NULL when not built yet
+    int			no_dfa;		// can't use the lazy DFA
     char_u		*pattern;
     int			nsubexp;	// number of ()
     int			nstate;
@@ -164,12 +179,16 @@ typedef struct
     char_u		*matches[NSUBEXP];
 } reg_extmatch_T;
 
+struct regexec_S;	// execution state, defined in regexp.c
+
 struct regengine
 {
     regprog_T	*(*regcomp)(char_u*, int);
     void	(*regfree)(regprog_T *);
-    int		(*regexec_nl)(regmatch_T *, char_u *, colnr_T, int);
-    long	(*regexec_multi)(regmmatch_T *, win_T *, buf_T *, linenr_T, colnr_T, proftime_T *, int *);
+    int		(*regexec_nl)(struct regexec_S *, regmatch_T *, char_u *,
+								 colnr_T, int);
+    long	(*regexec_multi)(struct regexec_S *, regmmatch_T *, win_T *,
+			 buf_T *, linenr_T, colnr_T, proftime_T *, int *);
     char_u	*expr;
 };
 
@@ -48,18 +48,16 @@
  * regstart	char that must begin a match; NUL if none obvious; Can be a
  *		multi-byte character.
  * reganch	is the match anchored (at beginning-of-line only)?
- * regmust	string (pointer into program) that match must include, or NULL
- * regmlen	length of regmust string
+ * re_must	string (pointer into program) that match must include, or NULL
+ * re_mustlen	length of re_must string
  * regflags	RF_ values or'ed together
  *
  * Regstart and reganch permit very fast decisions on suitable starting points
- * for a match, cutting down the work a lot.  Regmust permits fast rejection
- * of lines that cannot possibly match.  The regmust tests are costly enough
- * that vim_regcomp() supplies a regmust only if the r.e. contains something
- * potentially expensive (at present, the only such thing detected is * or +
- * at the start of the r.e., which can involve a lot of backup).  Regmlen is
- * supplied because the test in vim_regexec() needs it and vim_regcomp() is
- * computing it anyway.
+ * for a match, cutting down the work a lot.  Re_must permits fast rejection
+ * of lines that cannot possibly match, it is checked in vim_regexec_multi()
+ * and vim_regexec_string() before the matcher is invoked.  Re_mustlen is
+ * supplied because that test needs it and vim_regcomp() is computing it
+ * anyway.
  */
 
 /*
@@ -246,9 +244,6 @@ static char_u	*regcode;	// Code-emit pointer, or JUST_CALC_SIZE
 static long	regsize;	// Code size.
 static int	reg_toolong;	// TRUE when offset out of range
 static char_u	had_endbrace[NSUBEXP];	// flags, TRUE if end of () found
-static long	brace_min[10];	// Minimums for complex brace repeats
-static long	brace_max[10];	// Maximums for complex brace repeats
-static int	brace_count[10]; // Current counts for complex brace repeats
 static int	one_exactly = FALSE;	// only do one char for EXACTLY
 
 // When making changes to classchars also change nfa_classcodes.
@@ -290,31 +285,6 @@ typedef enum regstate_E
     , RS_STAR_SHORT	// STAR/PLUS/BRACE_SIMPLE shortest match
 } regstate_T;
 
-/*
- * Structure used to save the current input state, when it needs to be
- * restored after trying a match.  Used by reg_save() and reg_restore().
- * Also stores the length of "backpos".
- */
-typedef struct
-{
-    union
-    {
-	char_u	*ptr;	// rex.input pointer, for single-line regexp
-	lpos_T	pos;	// rex.input pos, for multi-line regexp
-    } rs_u;
-    int		rs_len;
-} regsave_T;
-
-// struct to save start/end pointer/position in for \(\)
-typedef struct
-{
-    union
-    {
-	char_u	*ptr;
-	lpos_T	pos;
-    } se_u;
-} save_se_T;
-
 // used for BEHIND and NOBEHIND matching
 typedef struct regbehind_S
 {
@@ -340,7 +310,7 @@ typedef struct regitem_S
     {
 	save_se_T  sesave;
 	regsave_T  regsave;
-    } rs_un;			// room for saving rex.input
+    } rs_un;			// room for saving rex->input
 } regitem_T;
 
 
@@ -363,18 +333,11 @@ typedef struct backpos_S
 } backpos_T;
 
 /*
- * "regstack" and "backpos" are used by regmatch().  They are kept over calls
- * to avoid invoking malloc() and free() often.
+ * "rex->regstack" and "rex->backpos" are used by regmatch().
  * "regstack" is a stack with regitem_T items, sometimes preceded by regstar_T
  * or regbehind_T.
  * "backpos_T" is a table with backpos_T for BACK
- */
-static garray_T	regstack = {0, 0, 0, 0, NULL};
-static garray_T	backpos = {0, 0, 0, 0, NULL};
-
-static regsave_T behind_pos;
-
-/*
+ *
  * Both for regstack and backpos tables we use the following strategy of
  * allocation (to reduce malloc/free calls):
  * - Initial size is fairly small.
@@ -2325,13 +2288,17 @@ bt_regcomp(char_u *expr, int re_flags)
     // Dig out information for optimizations.
     r->regstart = NUL;		// Worst-case defaults.
     r->reganch = 0;
-    r->regmust = NULL;
-    r->regmlen = 0;
+    r->re_must = NULL;
+    r->re_mustlen = 0;
     r->regflags = regflags;
     if (flags & HASNL)
 	r->regflags |= RF_HASNL;
     if (flags & HASLOOKBH)
 	r->regflags |= RF_LOOKBH;
+#ifdef FEAT_SYN_HL
+    if (had_eol)
+	r->regflags |= RF_HASEOL;
+#endif
 #ifdef FEAT_SYN_HL
     // Remember whether this pattern has any \z specials in it.
     r->reghasz = re_has_z;
@@ -2368,17 +2335,14 @@ bt_regcomp(char_u *expr, int re_flags)
 		r->regstart = *OPERAND(regnext(scan));
 	}
 
-	// If there's something expensive in the r.e., find the longest
-	// literal string that must appear and make it the regmust.  Resolve
-	// ties in favor of later strings, since the regstart check works
-	// with the beginning of the r.e. and avoiding duplication
+	// Find the longest literal string that must appear and make it the
+	// re_must.  Resolve ties in favor of later strings, since the regstart
+	// check works with the beginning of the r.e. and avoiding duplication
 	// strengthens checking.  Not a strong reason, but sufficient in the
 	// absence of others.
-
-	// When the r.e. starts with BOW, it is faster to look for a regmust
-	// first. Used a lot for "#" and "*" commands. (Added by mool).
-	if ((flags & SPSTART || OP(scan) == BOW || OP(scan) == EOW)
-							  && !(flags & HASNL))
+	// Only when the match can't continue in the next line, the line to
+	// start matching in must contain the string.
+	if (!(flags & HASNL))
 	{
 	    longest = NULL;
 	    len = 0;
@@ -2388,8 +2352,8 @@ bt_regcomp(char_u *expr, int re_flags)
 		    longest = OPERAND(scan);
 		    len = (int)STRLEN(OPERAND(scan));
 		}
-	    r->regmust = longest;
-	    r->regmlen = len;
+	    r->re_must = longest;
+	    r->re_mustlen = len;
 	}
     }
 #ifdef BT_REGEXP_DUMP
@@ -2447,15 +2411,7 @@ bt_regfree(regprog_T *prog)
     vim_free(prog);
 }
 
-#define ADVANCE_REGINPUT() MB_PTR_ADV(rex.input)
-
-/*
- * The arguments from BRACE_LIMITS are stored here.  They are actually local
- * to regmatch(), but they are here to reduce the amount of stack space used
- * (it can be called recursively many times).
- */
-static long	bl_minval;
-static long	bl_maxval;
+#define ADVANCE_REGINPUT() MB_PTR_ADV(rex->input)
 
 /*
  * Save the input line and position in a regsave_T.
@@ -2465,11 +2421,11 @@ reg_save(regsave_T *save, garray_T *gap)
 {
     if (REG_MULTI)
     {
-	save->rs_u.pos.col = (colnr_T)(rex.input - rex.line);
-	save->rs_u.pos.lnum = rex.lnum;
+	save->rs_u.pos.col = (colnr_T)(rex->input - rex->line);
+	save->rs_u.pos.lnum = rex->lnum;
     }
     else
-	save->rs_u.ptr = rex.input;
+	save->rs_u.ptr = rex->input;
     save->rs_len = gap->ga_len;
 }
 
@@ -2481,17 +2437,17 @@ reg_restore(regsave_T *save, garray_T *gap)
 {
     if (REG_MULTI)
     {
-	if (rex.lnum != save->rs_u.pos.lnum)
+	if (rex->lnum != save->rs_u.pos.lnum)
 	{
 	    // only call reg_getline() when the line number changed to save
 	    // a bit of time
-	    rex.lnum = save->rs_u.pos.lnum;
-	    rex.line = reg_getline(rex.lnum);
+	    rex->lnum = save->rs_u.pos.lnum;
+	    rex->line = reg_getline(rex->lnum);
 	}
-	rex.input = rex.line + save->rs_u.pos.col;
+	rex->input = rex->line + save->rs_u.pos.col;
     }
     else
-	rex.input = save->rs_u.ptr;
+	rex->input = save->rs_u.ptr;
     gap->ga_len = save->rs_len;
 }
 
@@ -2502,9 +2458,9 @@ reg_restore(regsave_T *save, garray_T *gap)
 reg_save_equal(regsave_T *save)
 {
     if (REG_MULTI)
-	return rex.lnum == save->rs_u.pos.lnum
-				  && rex.input == rex.line + save->rs_u.pos.col;
-    return rex.input == save->rs_u.ptr;
+	return rex->lnum == save->rs_u.pos.lnum
+			       && rex->input == rex->line + save->rs_u.pos.col;
+    return rex->input == save->rs_u.ptr;
 }
 
 // Save the sub-expressions before attempting a match.
@@ -2529,20 +2485,20 @@ reg_save_equal(regsave_T *save)
 save_se_multi(save_se_T *savep, lpos_T *posp)
 {
     savep->se_u.pos = *posp;
-    posp->lnum = rex.lnum;
-    posp->col = (colnr_T)(rex.input - rex.line);
+    posp->lnum = rex->lnum;
+    posp->col = (colnr_T)(rex->input - rex->line);
 }
 
     static void
 save_se_one(save_se_T *savep, char_u **pp)
 {
     savep->se_u.ptr = *pp;
-    *pp = rex.input;
+    *pp = rex->input;
 }
 
 /*
  * regrepeat - repeatedly match something simple, return how many.
- * Advances rex.input (and rex.lnum) to just after the matched chars.
+ * Advances rex->input (and rex->lnum) to just after the matched chars.
  */
     static int
 regrepeat(
@@ -2555,7 +2511,7 @@ regrepeat(
     int		mask;
     int		testval = 0;
 
-    scan = rex.input;	    // Make local copy of rex.input for speed.
+    scan = rex->input;	    // Make local copy of rex->input for speed.
     opnd = OPERAND(p);
     switch (OP(p))
     {
@@ -2570,12 +2526,12 @@ regrepeat(
 		++count;
 		MB_PTR_ADV(scan);
 	    }
-	    if (!REG_MULTI || !WITH_NL(OP(p)) || rex.lnum > rex.reg_maxline
-				      || rex.reg_line_lbr || count == maxcount)
+	    if (!REG_MULTI || !WITH_NL(OP(p)) || rex->lnum > rex->reg_maxline
+				      || rex->reg_line_lbr || count == maxcount)
 		break;
 	    ++count;		// count the line-break
 	    reg_nextline();
-	    scan = rex.input;
+	    scan = rex->input;
 	    if (got_int)
 		break;
 	}
@@ -2595,15 +2551,15 @@ regrepeat(
 	    }
 	    else if (*scan == NUL)
 	    {
-		if (!REG_MULTI || !WITH_NL(OP(p)) || rex.lnum > rex.reg_maxline
-							   || rex.reg_line_lbr)
+		if (!REG_MULTI || !WITH_NL(OP(p))
+			 || rex->lnum > rex->reg_maxline || rex->reg_line_lbr)
 		    break;
 		reg_nextline();
-		scan = rex.input;
+		scan = rex->input;
 		if (got_int)
 		    break;
 	    }
-	    else if (rex.reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+	    else if (rex->reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
 		++scan;
 	    else
 		break;
@@ -2619,22 +2575,22 @@ regrepeat(
       case SKWORD + ADD_NL:
 	while (count < maxcount)
 	{
-	    if (vim_iswordp_buf(scan, rex.reg_buf)
+	    if (vim_iswordp_buf(scan, rex->reg_buf)
 					  && (testval || !VIM_ISDIGIT(*scan)))
 	    {
 		MB_PTR_ADV(scan);
 	    }
 	    else if (*scan == NUL)
 	    {
-		if (!REG_MULTI || !WITH_NL(OP(p)) || rex.lnum > rex.reg_maxline
-							   || rex.reg_line_lbr)
+		if (!REG_MULTI || !WITH_NL(OP(p))
+			 || rex->lnum > rex->reg_maxline || rex->reg_line_lbr)
 		    break;
 		reg_nextline();
-		scan = rex.input;
+		scan = rex->input;
 		if (got_int)
 		    break;
 	    }
-	    else if (rex.reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+	    else if (rex->reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
 		++scan;
 	    else
 		break;
@@ -2656,15 +2612,15 @@ regrepeat(
 	    }
 	    else if (*scan == NUL)
 	    {
-		if (!REG_MULTI || !WITH_NL(OP(p)) || rex.lnum > rex.reg_maxline
-							   || rex.reg_line_lbr)
+		if (!REG_MULTI || !WITH_NL(OP(p))
+			 || rex->lnum > rex->reg_maxline || rex->reg_line_lbr)
 		    break;
 		reg_nextline();
-		scan = rex.input;
+		scan = rex->input;
 		if (got_int)
 		    break;
 	    }
-	    else if (rex.reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+	    else if (rex->reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
 		++scan;
 	    else
 		break;
@@ -2682,11 +2638,11 @@ regrepeat(
 	{
 	    if (*scan == NUL)
 	    {
-		if (!REG_MULTI || !WITH_NL(OP(p)) || rex.lnum > rex.reg_maxline
-							   || rex.reg_line_lbr)
+		if (!REG_MULTI || !WITH_NL(OP(p))
+			 || rex->lnum > rex->reg_maxline || rex->reg_line_lbr)
 		    break;
 		reg_nextline();
-		scan = rex.input;
+		scan = rex->input;
 		if (got_int)
 		    break;
 	    }
@@ -2695,7 +2651,7 @@ regrepeat(
 	    {
 		MB_PTR_ADV(scan);
 	    }
-	    else if (rex.reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+	    else if (rex->reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
 		++scan;
 	    else
 		break;
@@ -2713,11 +2669,11 @@ do_class:
 
 	    if (*scan == NUL)
 	    {
-		if (!REG_MULTI || !WITH_NL(OP(p)) || rex.lnum > rex.reg_maxline
-							   || rex.reg_line_lbr)
+		if (!REG_MULTI || !WITH_NL(OP(p))
+			 || rex->lnum > rex->reg_maxline || rex->reg_line_lbr)
 		    break;
 		reg_nextline();
-		scan = rex.input;
+		scan = rex->input;
 		if (got_int)
 		    break;
 	    }
@@ -2729,7 +2685,7 @@ do_class:
 	    }
 	    else if ((class_tab[*scan] & mask) == testval)
 		++scan;
-	    else if (rex.reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+	    else if (rex->reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
 		++scan;
 	    else
 		break;
@@ -2813,7 +2769,7 @@ do_class:
 	    // This doesn't do a multi-byte character, because a MULTIBYTECODE
 	    // would have been used for it.  It does handle single-byte
 	    // characters, such as latin1.
-	    if (rex.reg_ic)
+	    if (rex->reg_ic)
 	    {
 		cu = MB_TOUPPER(*opnd);
 		cl = MB_TOLOWER(*opnd);
@@ -2843,14 +2799,14 @@ do_class:
 	    // compiling the program).
 	    if ((len = (*mb_ptr2len)(opnd)) > 1)
 	    {
-		if (rex.reg_ic && enc_utf8)
+		if (rex->reg_ic && enc_utf8)
 		    cf = utf_fold(utf_ptr2char(opnd));
 		while (count < maxcount && (*mb_ptr2len)(scan) >= len)
 		{
 		    for (i = 0; i < len; ++i)
 			if (opnd[i] != scan[i])
 			    break;
-		    if (i < len && (!rex.reg_ic || !enc_utf8
+		    if (i < len && (!rex->reg_ic || !enc_utf8
 					|| utf_fold(utf_ptr2char(scan)) != cf))
 			break;
 		    scan += len;
@@ -2873,15 +2829,15 @@ do_class:
 
 	    if (*scan == NUL)
 	    {
-		if (!REG_MULTI || !WITH_NL(OP(p)) || rex.lnum > rex.reg_maxline
-							   || rex.reg_line_lbr)
+		if (!REG_MULTI || !WITH_NL(OP(p))
+			 || rex->lnum > rex->reg_maxline || rex->reg_line_lbr)
 		    break;
 		reg_nextline();
-		scan = rex.input;
+		scan = rex->input;
 		if (got_int)
 		    break;
 	    }
-	    else if (rex.reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+	    else if (rex->reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
 		++scan;
 	    else if (has_mbyte && (len = (*mb_ptr2len)(scan)) > 1)
 	    {
@@ -2901,16 +2857,16 @@ do_class:
 
       case NEWL:
 	while (count < maxcount
-		&& ((*scan == NUL && rex.lnum <= rex.reg_maxline
-				       && !rex.reg_line_lbr && REG_MULTI)
-		    || (*scan == '\n' && rex.reg_line_lbr)))
+		&& ((*scan == NUL && rex->lnum <= rex->reg_maxline
+				       && !rex->reg_line_lbr && REG_MULTI)
+		    || (*scan == '\n' && rex->reg_line_lbr)))
 	{
 	    count++;
-	    if (rex.reg_line_lbr)
+	    if (rex->reg_line_lbr)
 		ADVANCE_REGINPUT();
 	    else
 		reg_nextline();
-	    scan = rex.input;
+	    scan = rex->input;
 	    if (got_int)
 		break;
 	}
@@ -2924,7 +2880,7 @@ do_class:
 	break;
     }
 
-    rex.input = scan;
+    rex->input = scan;
 
     return (int)count;
 }
@@ -2938,19 +2894,19 @@ regstack_push(regstate_T state, char_u *scan)
 {
     regitem_T	*rp;
 
-    if ((long)((unsigned)regstack.ga_len >> 10) >= p_mmp)
+    if ((long)((unsigned)rex->regstack.ga_len >> 10) >= p_mmp)
     {
 	emsg(_(e_maxmempat));
 	return NULL;
     }
-    if (ga_grow(&regstack, sizeof(regitem_T)) == FAIL)
+    if (ga_grow(&rex->regstack, sizeof(regitem_T)) == FAIL)
 	return NULL;
 
-    rp = (regitem_T *)((char *)regstack.ga_data + regstack.ga_len);
+    rp = (regitem_T *)((char *)rex->regstack.ga_data + rex->regstack.ga_len);
     rp->rs_state = state;
     rp->rs_scan = scan;
 
-    regstack.ga_len += sizeof(regitem_T);
+    rex->regstack.ga_len += sizeof(regitem_T);
     return rp;
 }
 
@@ -2962,10 +2918,11 @@ regstack_pop(char_u **scan)
 {
     regitem_T	*rp;
 
-    rp = (regitem_T *)((char *)regstack.ga_data + regstack.ga_len) - 1;
+    rp = (regitem_T *)((char *)rex->regstack.ga_data
+						   + rex->regstack.ga_len) - 1;
     *scan = rp->rs_scan;
 
-    regstack.ga_len -= sizeof(regitem_T);
+    rex->regstack.ga_len -= sizeof(regitem_T);
 }
 
 /*
@@ -2977,22 +2934,22 @@ save_subexpr(regbehind_T *bp)
 {
     int i;
 
-    // When "rex.need_clear_subexpr" is set we don't need to save the values,
+    // When "rex->need_clear_subexpr" is set we don't need to save the values,
     // only remember that this flag needs to be set again when restoring.
-    bp->save_need_clear_subexpr = rex.need_clear_subexpr;
-    if (!rex.need_clear_subexpr)
+    bp->save_need_clear_subexpr = rex->need_clear_subexpr;
+    if (!rex->need_clear_subexpr)
     {
 	for (i = 0; i < NSUBEXP; ++i)
 	{
 	    if (REG_MULTI)
 	    {
-		bp->save_start[i].se_u.pos = rex.reg_startpos[i];
-		bp->save_end[i].se_u.pos = rex.reg_endpos[i];
+		bp->save_start[i].se_u.pos = rex->reg_startpos[i];
+		bp->save_end[i].se_u.pos = rex->reg_endpos[i];
 	    }
 	    else
 	    {
-		bp->save_start[i].se_u.ptr = rex.reg_startp[i];
-		bp->save_end[i].se_u.ptr = rex.reg_endp[i];
+		bp->save_start[i].se_u.ptr = rex->reg_startp[i];
+		bp->save_end[i].se_u.ptr = rex->reg_endp[i];
 	    }
 	}
     }
@@ -3007,20 +2964,20 @@ restore_subexpr(regbehind_T *bp)
     int i;
 
     // Only need to restore saved values when they are not to be cleared.
-    rex.need_clear_subexpr = bp->save_need_clear_subexpr;
-    if (!rex.need_clear_subexpr)
+    rex->need_clear_subexpr = bp->save_need_clear_subexpr;
+    if (!rex->need_clear_subexpr)
     {
 	for (i = 0; i < NSUBEXP; ++i)
 	{
 	    if (REG_MULTI)
 	    {
-		rex.reg_startpos[i] = bp->save_start[i].se_u.pos;
-		rex.reg_endpos[i] = bp->save_end[i].se_u.pos;
+		rex->reg_startpos[i] = bp->save_start[i].se_u.pos;
+		rex->reg_endpos[i] = bp->save_end[i].se_u.pos;
 	    }
 	    else
 	    {
-		rex.reg_startp[i] = bp->save_start[i].se_u.ptr;
-		rex.reg_endp[i] = bp->save_end[i].se_u.ptr;
+		rex->reg_startp[i] = bp->save_start[i].se_u.ptr;
+		rex->reg_endp[i] = bp->save_end[i].se_u.ptr;
 	    }
 	}
     }
@@ -3036,9 +2993,9 @@ restore_subexpr(regbehind_T *bp)
  * (that don't need to know whether the rest of the match failed) by a nested
  * loop.
  *
- * Returns TRUE when there is a match.  Leaves rex.input and rex.lnum just after
- * the last matched character.
- * Returns FALSE when there is no match.  Leaves rex.input and rex.lnum in an
+ * Returns TRUE when there is a match.  Leaves rex->input and rex->lnum just
+ * after the last matched character.
+ * Returns FALSE when there is no match.  Leaves rex->input and rex->lnum in an
  * undefined state!
  */
     static int
@@ -3059,8 +3016,8 @@ regmatch(
 
   // Make "regstack" and "backpos" empty.  They are allocated and freed in
   // bt_regexec_both() to reduce malloc()/free() calls.
-  regstack.ga_len = 0;
-  backpos.ga_len = 0;
+  rex->regstack.ga_len = 0;
+  rex->backpos.ga_len = 0;
 
   // Repeat until "regstack" is empty.
   for (;;)
@@ -3128,12 +3085,12 @@ regmatch(
 
 	op = OP(scan);
 	// Check for character class with NL added.
-	if (!rex.reg_line_lbr && WITH_NL(op) && REG_MULTI
-			     && *rex.input == NUL && rex.lnum <= rex.reg_maxline)
+	if (!rex->reg_line_lbr && WITH_NL(op) && REG_MULTI
+			&& *rex->input == NUL && rex->lnum <= rex->reg_maxline)
 	{
 	    reg_nextline();
 	}
-	else if (rex.reg_line_lbr && WITH_NL(op) && *rex.input == '\n')
+	else if (rex->reg_line_lbr && WITH_NL(op) && *rex->input == '\n')
 	{
 	    ADVANCE_REGINPUT();
 	}
@@ -3142,13 +3099,13 @@ regmatch(
 	  if (WITH_NL(op))
 	      op -= ADD_NL;
 	  if (has_mbyte)
-	      c = (*mb_ptr2char)(rex.input);
+	      c = (*mb_ptr2char)(rex->input);
 	  else
-	      c = *rex.input;
+	      c = *rex->input;
 	  switch (op)
 	  {
 	  case BOL:
-	    if (rex.input != rex.line)
+	    if (rex->input != rex->line)
 		status = RA_NOMATCH;
 	    break;
 
@@ -3161,24 +3118,24 @@ regmatch(
 	    // We're not at the beginning of the file when below the first
 	    // line where we started, not at the start of the line or we
 	    // didn't start at the first line of the buffer.
-	    if (rex.lnum != 0 || rex.input != rex.line
-				       || (REG_MULTI && rex.reg_firstlnum > 1))
+	    if (rex->lnum != 0 || rex->input != rex->line
+				       || (REG_MULTI && rex->reg_firstlnum > 1))
 		status = RA_NOMATCH;
 	    break;
 
 	  case RE_EOF:
-	    if (rex.lnum != rex.reg_maxline || c != NUL)
+	    if (rex->lnum != rex->reg_maxline || c != NUL)
 		status = RA_NOMATCH;
 	    break;
 
 	  case CURSOR:
 	    // Check if the buffer is in a window and compare the
-	    // rex.reg_win->w_cursor position to the match position.
-	    if (rex.reg_win == NULL
-		    || (rex.lnum + rex.reg_firstlnum
-						 != rex.reg_win->w_cursor.lnum)
-		    || ((colnr_T)(rex.input - rex.line)
-						 != rex.reg_win->w_cursor.col))
+	    // rex->reg_win->w_cursor position to the match position.
+	    if (rex->reg_win == NULL
+		    || (rex->lnum + rex->reg_firstlnum
+						 != rex->reg_win->w_cursor.lnum)
+		    || ((colnr_T)(rex->input - rex->line)
+						 != rex->reg_win->w_cursor.col))
 		status = RA_NOMATCH;
 	    break;
 
@@ -3189,16 +3146,16 @@ regmatch(
 		int	cmp = OPERAND(scan)[1];
 		pos_T	*pos;
 
-		pos = getmark_buf(rex.reg_buf, mark, FALSE);
+		pos = getmark_buf(rex->reg_buf, mark, FALSE);
 		if (pos == NULL		     // mark doesn't exist
 			|| pos->lnum <= 0    // mark isn't set in reg_buf
-			|| (pos->lnum == rex.lnum + rex.reg_firstlnum
-				? (pos->col == (colnr_T)(rex.input - rex.line)
+			|| (pos->lnum == rex->lnum + rex->reg_firstlnum
+				? (pos->col == (colnr_T)(rex->input - rex->line)
 				    ? (cmp == '<' || cmp == '>')
-				    : (pos->col < (colnr_T)(rex.input - rex.line)
+				    : (pos->col < (colnr_T)(rex->input - rex->line)
 					? cmp != '>'
 					: cmp != '<'))
-				: (pos->lnum < rex.lnum + rex.reg_firstlnum
+				: (pos->lnum < rex->lnum + rex->reg_firstlnum
 				    ? cmp != '>'
 				    : cmp != '<')))
 		    status = RA_NOMATCH;
@@ -3211,24 +3168,25 @@ regmatch(
 	    break;
 
 	  case RE_LNUM:
-	    if (!REG_MULTI || !re_num_cmp((long_u)(rex.lnum + rex.reg_firstlnum),
-									scan))
+	    if (!REG_MULTI || !re_num_cmp(
+			      (long_u)(rex->lnum + rex->reg_firstlnum), scan))
 		status = RA_NOMATCH;
 	    break;
 
 	  case RE_COL:
-	    if (!re_num_cmp((long_u)(rex.input - rex.line) + 1, scan))
+	    if (!re_num_cmp((long_u)(rex->input - rex->line) + 1, scan))
 		status = RA_NOMATCH;
 	    break;
 
 	  case RE_VCOL:
 	    if (!re_num_cmp((long_u)win_linetabsize(
-			    rex.reg_win == NULL ? curwin : rex.reg_win,
-			    rex.line, (colnr_T)(rex.input - rex.line)) + 1, scan))
+			    rex->reg_win == NULL ? curwin : rex->reg_win,
+			    rex->line, (colnr_T)(rex->input - rex->line)) + 1,
+									scan))
 		status = RA_NOMATCH;
 	    break;
 
-	  case BOW:	// \<word; rex.input points to w
+	  case BOW:	// \<word; rex->input points to w
 	    if (c == NUL)	// Can't match at end of line
 		status = RA_NOMATCH;
 	    else if (has_mbyte)
@@ -3236,7 +3194,7 @@ regmatch(
 		int this_class;
 
 		// Get class of current and previous char (if it exists).
-		this_class = mb_get_class_buf(rex.input, rex.reg_buf);
+		this_class = mb_get_class_buf(rex->input, rex->reg_buf);
 		if (this_class <= 1)
 		    status = RA_NOMATCH;  // not on a word at all
 		else if (reg_prev_class() == this_class)
@@ -3244,21 +3202,21 @@ regmatch(
 	    }
 	    else
 	    {
-		if (!vim_iswordc_buf(c, rex.reg_buf) || (rex.input > rex.line
-				&& vim_iswordc_buf(rex.input[-1], rex.reg_buf)))
+		if (!vim_iswordc_buf(c, rex->reg_buf) || (rex->input > rex->line
+			     && vim_iswordc_buf(rex->input[-1], rex->reg_buf)))
 		    status = RA_NOMATCH;
 	    }
 	    break;
 
-	  case EOW:	// word\>; rex.input points after d
-	    if (rex.input == rex.line)    // Can't match at start of line
+	  case EOW:	// word\>; rex->input points after d
+	    if (rex->input == rex->line)    // Can't match at start of line
 		status = RA_NOMATCH;
 	    else if (has_mbyte)
 	    {
 		int this_class, prev_class;
 
 		// Get class of current and previous char (if it exists).
-		this_class = mb_get_class_buf(rex.input, rex.reg_buf);
+		this_class = mb_get_class_buf(rex->input, rex->reg_buf);
 		prev_class = reg_prev_class();
 		if (this_class == prev_class
 			|| prev_class == 0 || prev_class == 1)
@@ -3266,9 +3224,9 @@ regmatch(
 	    }
 	    else
 	    {
-		if (!vim_iswordc_buf(rex.input[-1], rex.reg_buf)
-			|| (rex.input[0] != NUL
-					   && vim_iswordc_buf(c, rex.reg_buf)))
+		if (!vim_iswordc_buf(rex->input[-1], rex->reg_buf)
+			|| (rex->input[0] != NUL
+					   && vim_iswordc_buf(c, rex->reg_buf)))
 		    status = RA_NOMATCH;
 	    }
 	    break; // Matched with EOW
@@ -3289,22 +3247,22 @@ regmatch(
 	    break;
 
 	  case SIDENT:
-	    if (VIM_ISDIGIT(*rex.input) || !vim_isIDc(c))
+	    if (VIM_ISDIGIT(*rex->input) || !vim_isIDc(c))
 		status = RA_NOMATCH;
 	    else
 		ADVANCE_REGINPUT();
 	    break;
 
 	  case KWORD:
-	    if (!vim_iswordp_buf(rex.input, rex.reg_buf))
+	    if (!vim_iswordp_buf(rex->input, rex->reg_buf))
 		status = RA_NOMATCH;
 	    else
 		ADVANCE_REGINPUT();
 	    break;
 
 	  case SKWORD:
-	    if (VIM_ISDIGIT(*rex.input)
-				    || !vim_iswordp_buf(rex.input, rex.reg_buf))
+	    if (VIM_ISDIGIT(*rex->input)
+				 || !vim_iswordp_buf(rex->input, rex->reg_buf))
 		status = RA_NOMATCH;
 	    else
 		ADVANCE_REGINPUT();
@@ -3318,21 +3276,21 @@ regmatch(
 	    break;
 
 	  case SFNAME:
-	    if (VIM_ISDIGIT(*rex.input) || !vim_isfilec(c))
+	    if (VIM_ISDIGIT(*rex->input) || !vim_isfilec(c))
 		status = RA_NOMATCH;
 	    else
 		ADVANCE_REGINPUT();
 	    break;
 
 	  case PRINT:
-	    if (!vim_isprintc(PTR2CHAR(rex.input)))
+	    if (!vim_isprintc(PTR2CHAR(rex->input)))
 		status = RA_NOMATCH;
 	    else
 		ADVANCE_REGINPUT();
 	    break;
 
 	  case SPRINT:
-	    if (VIM_ISDIGIT(*rex.input) || !vim_isprintc(PTR2CHAR(rex.input)))
+	    if (VIM_ISDIGIT(*rex->input) || !vim_isprintc(PTR2CHAR(rex->input)))
 		status = RA_NOMATCH;
 	    else
 		ADVANCE_REGINPUT();
@@ -3471,10 +3429,10 @@ regmatch(
 
 		opnd = OPERAND(scan);
 		// Inline the first byte, for speed.
-		if (*opnd != *rex.input
-			&& (!rex.reg_ic
+		if (*opnd != *rex->input
+			&& (!rex->reg_ic
 			    || (!enc_utf8
-			      && MB_TOLOWER(*opnd) != MB_TOLOWER(*rex.input))))
+			      && MB_TOLOWER(*opnd) != MB_TOLOWER(*rex->input))))
 		    status = RA_NOMATCH;
 		else if (*opnd == NUL)
 		{
@@ -3483,7 +3441,7 @@ regmatch(
 		}
 		else
 		{
-		    if (opnd[1] == NUL && !(enc_utf8 && rex.reg_ic))
+		    if (opnd[1] == NUL && !(enc_utf8 && rex->reg_ic))
 		    {
 			len = 1;	// matched a single byte above
 		    }
@@ -3491,15 +3449,15 @@ regmatch(
 		    {
 			// Need to match first byte again for multi-byte.
 			len = (int)STRLEN(opnd);
-			if (cstrncmp(opnd, rex.input, &len) != 0)
+			if (cstrncmp(opnd, rex->input, &len) != 0)
 			    status = RA_NOMATCH;
 		    }
 		    // Check for following composing character, unless %C
 		    // follows (skips over all composing chars).
 		    if (status != RA_NOMATCH
 			    && enc_utf8
-			    && UTF_COMPOSINGLIKE(rex.input, rex.input + len)
-			    && !rex.reg_icombine
+			    && UTF_COMPOSINGLIKE(rex->input, rex->input + len)
+			    && !rex->reg_icombine
 			    && OP(next) != RE_COMPOSING)
 		    {
 			// raaron: This code makes a composing character get
@@ -3508,7 +3466,7 @@ regmatch(
 			status = RA_NOMATCH;
 		    }
 		    if (status != RA_NOMATCH)
-			rex.input += len;
+			rex->input += len;
 		}
 	    }
 	    break;
@@ -3545,10 +3503,10 @@ regmatch(
 		    // When only a composing char is given match at any
 		    // position where that composing char appears.
 		    status = RA_NOMATCH;
-		    for (i = 0; rex.input[i] != NUL;
-						i += utf_ptr2len(rex.input + i))
+		    for (i = 0; rex->input[i] != NUL;
+					      i += utf_ptr2len(rex->input + i))
 		    {
-			inpc = utf_ptr2char(rex.input + i);
+			inpc = utf_ptr2char(rex->input + i);
 			if (!utf_iscomposing(inpc))
 			{
 			    if (i > 0)
@@ -3557,7 +3515,7 @@ regmatch(
 			else if (opndc == inpc)
 			{
 			    // Include all following composing chars.
-			    len = i + utfc_ptr2len(rex.input + i);
+			    len = i + utfc_ptr2len(rex->input + i);
 			    status = RA_MATCH;
 			    break;
 			}
@@ -3565,12 +3523,12 @@ regmatch(
 		}
 		else
 		    for (i = 0; i < len; ++i)
-			if (opnd[i] != rex.input[i])
+			if (opnd[i] != rex->input[i])
 			{
 			    status = RA_NOMATCH;
 			    break;
 			}
-		rex.input += len;
+		rex->input += len;
 	    }
 	    else
 		status = RA_NOMATCH;
@@ -3579,8 +3537,8 @@ regmatch(
 	    if (enc_utf8)
 	    {
 		// Skip composing characters.
-		while (utf_iscomposing(utf_ptr2char(rex.input)))
-		    MB_CPTR_ADV(rex.input);
+		while (utf_iscomposing(utf_ptr2char(rex->input)))
+		    MB_CPTR_ADV(rex->input);
 	    }
 	    break;
 
@@ -3598,21 +3556,21 @@ regmatch(
 		// at the same position as the previous time.
 		// The positions are stored in "backpos" and found by the
 		// current value of "scan", the position in the RE program.
-		bp = (backpos_T *)backpos.ga_data;
-		for (i = 0; i < backpos.ga_len; ++i)
+		bp = (backpos_T *)rex->backpos.ga_data;
+		for (i = 0; i < rex->backpos.ga_len; ++i)
 		    if (bp[i].bp_scan == scan)
 			break;
-		if (i == backpos.ga_len)
+		if (i == rex->backpos.ga_len)
 		{
 		    // First time at this BACK, make room to store the pos.
-		    if (ga_grow(&backpos, 1) == FAIL)
+		    if (ga_grow(&rex->backpos, 1) == FAIL)
 			status = RA_FAIL;
 		    else
 		    {
 			// get "ga_data" again, it may have changed
-			bp = (backpos_T *)backpos.ga_data;
+			bp = (backpos_T *)rex->backpos.ga_data;
 			bp[i].bp_scan = scan;
-			++backpos.ga_len;
+			++rex->backpos.ga_len;
 		    }
 		}
 		else if (reg_save_equal(&bp[i].bp_pos))
@@ -3620,7 +3578,7 @@ regmatch(
 		    status = RA_NOMATCH;
 
 		if (status != RA_FAIL && status != RA_NOMATCH)
-		    reg_save(&bp[i].bp_pos, &backpos);
+		    reg_save(&bp[i].bp_pos, &rex->backpos);
 	    }
 	    break;
 
@@ -3643,8 +3601,8 @@ regmatch(
 		else
 		{
 		    rp->rs_no = no;
-		    save_se(&rp->rs_un.sesave, &rex.reg_startpos[no],
-							  &rex.reg_startp[no]);
+		    save_se(&rp->rs_un.sesave, &rex->reg_startpos[no],
+							  &rex->reg_startp[no]);
 		    // We simply continue and handle the result when done.
 		}
 	    }
@@ -3676,8 +3634,8 @@ regmatch(
 		else
 		{
 		    rp->rs_no = no;
-		    save_se(&rp->rs_un.sesave, &reg_startzpos[no],
-							     &reg_startzp[no]);
+		    save_se(&rp->rs_un.sesave, &rex->reg_startzpos[no],
+							&rex->reg_startzp[no]);
 		    // We simply continue and handle the result when done.
 		}
 	    }
@@ -3703,8 +3661,8 @@ regmatch(
 		else
 		{
 		    rp->rs_no = no;
-		    save_se(&rp->rs_un.sesave, &rex.reg_endpos[no],
-							    &rex.reg_endp[no]);
+		    save_se(&rp->rs_un.sesave, &rex->reg_endpos[no],
+							    &rex->reg_endp[no]);
 		    // We simply continue and handle the result when done.
 		}
 	    }
@@ -3729,8 +3687,8 @@ regmatch(
 		else
 		{
 		    rp->rs_no = no;
-		    save_se(&rp->rs_un.sesave, &reg_endzpos[no],
-							      &reg_endzp[no]);
+		    save_se(&rp->rs_un.sesave, &rex->reg_endzpos[no],
+							  &rex->reg_endzp[no]);
 		    // We simply continue and handle the result when done.
 		}
 	    }
@@ -3753,7 +3711,8 @@ regmatch(
 		cleanup_subexpr();
 		if (!REG_MULTI)		// Single-line regexp
 		{
-		    if (rex.reg_startp[no] == NULL || rex.reg_endp[no] == NULL)
+		    if (rex->reg_startp[no] == NULL
+					       || rex->reg_endp[no] == NULL)
 		    {
 			// Backref was not set: Match an empty string.
 			len = 0;
@@ -3762,29 +3721,30 @@ regmatch(
 		    {
 			// Compare current input with back-ref in the same
 			// line.
-			len = (int)(rex.reg_endp[no] - rex.reg_startp[no]);
-			if (cstrncmp(rex.reg_startp[no], rex.input, &len) != 0)
+			len = (int)(rex->reg_endp[no] - rex->reg_startp[no]);
+			if (cstrncmp(rex->reg_startp[no], rex->input,
+								  &len) != 0)
 			    status = RA_NOMATCH;
 		    }
 		}
 		else				// Multi-line regexp
 		{
-		    if (rex.reg_startpos[no].lnum < 0
-						|| rex.reg_endpos[no].lnum < 0)
+		    if (rex->reg_startpos[no].lnum < 0
+						|| rex->reg_endpos[no].lnum < 0)
 		    {
 			// Backref was not set: Match an empty string.
 			len = 0;
 		    }
 		    else
 		    {
-			if (rex.reg_startpos[no].lnum == rex.lnum
-				&& rex.reg_endpos[no].lnum == rex.lnum)
+			if (rex->reg_startpos[no].lnum == rex->lnum
+				&& rex->reg_endpos[no].lnum == rex->lnum)
 			{
 			    // Compare back-ref within the current line.
-			    len = rex.reg_endpos[no].col
-						    - rex.reg_startpos[no].col;
-			    if (cstrncmp(rex.line + rex.reg_startpos[no].col,
-							  rex.input, &len) != 0)
+			    len = rex->reg_endpos[no].col
+						    - rex->reg_startpos[no].col;
+			    if (cstrncmp(rex->line + rex->reg_startpos[no].col,
+							rex->input, &len) != 0)
 				status = RA_NOMATCH;
 			}
 			else
@@ -3792,10 +3752,10 @@ regmatch(
 			    // Messy situation: Need to compare between two
 			    // lines.
 			    int r = match_with_backref(
-					    rex.reg_startpos[no].lnum,
-					    rex.reg_startpos[no].col,
-					    rex.reg_endpos[no].lnum,
-					    rex.reg_endpos[no].col,
+					    rex->reg_startpos[no].lnum,
+					    rex->reg_startpos[no].col,
+					    rex->reg_endpos[no].lnum,
+					    rex->reg_endpos[no].col,
 					    &len);
 
 			    if (r != RA_MATCH)
@@ -3805,7 +3765,7 @@ regmatch(
 		}
 
 		// Matched the backref, skip over it.
-		rex.input += len;
+		rex->input += len;
 	    }
 	    break;
 
@@ -3829,10 +3789,10 @@ regmatch(
 		{
 		    len = (int)STRLEN(re_extmatch_in->matches[no]);
 		    if (cstrncmp(re_extmatch_in->matches[no],
-							  rex.input, &len) != 0)
+							rex->input, &len) != 0)
 			status = RA_NOMATCH;
 		    else
-			rex.input += len;
+			rex->input += len;
 		}
 		else
 		{
@@ -3861,16 +3821,16 @@ regmatch(
 	    {
 		if (OP(next) == BRACE_SIMPLE)
 		{
-		    bl_minval = OPERAND_MIN(scan);
-		    bl_maxval = OPERAND_MAX(scan);
+		    rex->bl_minval = OPERAND_MIN(scan);
+		    rex->bl_maxval = OPERAND_MAX(scan);
 		}
 		else if (OP(next) >= BRACE_COMPLEX
 			&& OP(next) < BRACE_COMPLEX + 10)
 		{
 		    no = OP(next) - BRACE_COMPLEX;
-		    brace_min[no] = OPERAND_MIN(scan);
-		    brace_max[no] = OPERAND_MAX(scan);
-		    brace_count[no] = 0;
+		    rex->brace_min[no] = OPERAND_MIN(scan);
+		    rex->brace_max[no] = OPERAND_MAX(scan);
+		    rex->brace_count[no] = 0;
 		}
 		else
 		{
@@ -3892,11 +3852,12 @@ regmatch(
 	  case BRACE_COMPLEX + 9:
 	    {
 		no = op - BRACE_COMPLEX;
-		++brace_count[no];
+		++rex->brace_count[no];
 
 		// If not matched enough times yet, try one more
-		if (brace_count[no] <= (brace_min[no] <= brace_max[no]
-					     ? brace_min[no] : brace_max[no]))
+		if (rex->brace_count[no] <= (
+				   rex->brace_min[no] <= rex->brace_max[no]
+				    ? rex->brace_min[no] : rex->brace_max[no]))
 		{
 		    rp = regstack_push(RS_BRCPLX_MORE, scan);
 		    if (rp == NULL)
@@ -3904,7 +3865,7 @@ regmatch(
 		    else
 		    {
 			rp->rs_no = no;
-			reg_save(&rp->rs_un.regsave, &backpos);
+			reg_save(&rp->rs_un.regsave, &rex->backpos);
 			next = OPERAND(scan);
 			// We continue and handle the result when done.
 		    }
@@ -3912,10 +3873,10 @@ regmatch(
 		}
 
 		// If matched enough times, may try matching some more
-		if (brace_min[no] <= brace_max[no])
+		if (rex->brace_min[no] <= rex->brace_max[no])
 		{
 		    // Range is the normal way around, use longest match
-		    if (brace_count[no] <= brace_max[no])
+		    if (rex->brace_count[no] <= rex->brace_max[no])
 		    {
 			rp = regstack_push(RS_BRCPLX_LONG, scan);
 			if (rp == NULL)
@@ -3923,7 +3884,7 @@ regmatch(
 			else
 			{
 			    rp->rs_no = no;
-			    reg_save(&rp->rs_un.regsave, &backpos);
+			    reg_save(&rp->rs_un.regsave, &rex->backpos);
 			    next = OPERAND(scan);
 			    // We continue and handle the result when done.
 			}
@@ -3932,14 +3893,14 @@ regmatch(
 		else
 		{
 		    // Range is backwards, use shortest match first
-		    if (brace_count[no] <= brace_min[no])
+		    if (rex->brace_count[no] <= rex->brace_min[no])
 		    {
 			rp = regstack_push(RS_BRCPLX_SHORT, scan);
 			if (rp == NULL)
 			    status = RA_FAIL;
 			else
 			{
-			    reg_save(&rp->rs_un.regsave, &backpos);
+			    reg_save(&rp->rs_un.regsave, &rex->backpos);
 			    // We continue and handle the result when done.
 			}
 		    }
@@ -3958,7 +3919,7 @@ regmatch(
 		if (OP(next) == EXACTLY)
 		{
 		    rst.nextb = *OPERAND(next);
-		    if (rex.reg_ic)
+		    if (rex->reg_ic)
 		    {
 			if (MB_ISUPPER(rst.nextb))
 			    rst.nextb_ic = MB_TOLOWER(rst.nextb);
@@ -3980,8 +3941,8 @@ regmatch(
 		}
 		else
 		{
-		    rst.minval = bl_minval;
-		    rst.maxval = bl_maxval;
+		    rst.minval = rex->bl_minval;
+		    rst.maxval = rex->bl_maxval;
 		}
 
 		// When maxval > minval, try matching as much as possible, up
@@ -4000,16 +3961,16 @@ regmatch(
 		    // It could match.  Prepare for trying to match what
 		    // follows.  The code is below.  Parameters are stored in
 		    // a regstar_T on the regstack.
-		    if ((long)((unsigned)regstack.ga_len >> 10) >= p_mmp)
+		    if ((long)((unsigned)rex->regstack.ga_len >> 10) >= p_mmp)
 		    {
 			emsg(_(e_maxmempat));
 			status = RA_FAIL;
 		    }
-		    else if (ga_grow(&regstack, sizeof(regstar_T)) == FAIL)
+		    else if (ga_grow(&rex->regstack, sizeof(regstar_T)) == FAIL)
 			status = RA_FAIL;
 		    else
 		    {
-			regstack.ga_len += sizeof(regstar_T);
+			rex->regstack.ga_len += sizeof(regstar_T);
 			rp = regstack_push(rst.minval <= rst.maxval
 					? RS_STAR_LONG : RS_STAR_SHORT, scan);
 			if (rp == NULL)
@@ -4036,7 +3997,7 @@ regmatch(
 	    else
 	    {
 		rp->rs_no = op;
-		reg_save(&rp->rs_un.regsave, &backpos);
+		reg_save(&rp->rs_un.regsave, &rex->backpos);
 		next = OPERAND(scan);
 		// We continue and handle the result when done.
 	    }
@@ -4045,16 +4006,16 @@ regmatch(
 	  case BEHIND:
 	  case NOBEHIND:
 	    // Need a bit of room to store extra positions.
-	    if ((long)((unsigned)regstack.ga_len >> 10) >= p_mmp)
+	    if ((long)((unsigned)rex->regstack.ga_len >> 10) >= p_mmp)
 	    {
 		emsg(_(e_maxmempat));
 		status = RA_FAIL;
 	    }
-	    else if (ga_grow(&regstack, sizeof(regbehind_T)) == FAIL)
+	    else if (ga_grow(&rex->regstack, sizeof(regbehind_T)) == FAIL)
 		status = RA_FAIL;
 	    else
 	    {
-		regstack.ga_len += sizeof(regbehind_T);
+		rex->regstack.ga_len += sizeof(regbehind_T);
 		rp = regstack_push(RS_BEHIND1, scan);
 		if (rp == NULL)
 		    status = RA_FAIL;
@@ -4065,7 +4026,7 @@ regmatch(
 		    save_subexpr(((regbehind_T *)rp) - 1);
 
 		    rp->rs_no = op;
-		    reg_save(&rp->rs_un.regsave, &backpos);
+		    reg_save(&rp->rs_un.regsave, &rex->backpos);
 		    // First try if what follows matches.  If it does then we
 		    // check the behind match by looping.
 		}
@@ -4075,20 +4036,21 @@ regmatch(
 	  case BHPOS:
 	    if (REG_MULTI)
 	    {
-		if (behind_pos.rs_u.pos.col != (colnr_T)(rex.input - rex.line)
-			|| behind_pos.rs_u.pos.lnum != rex.lnum)
+		if (rex->behind_pos.rs_u.pos.col
+					   != (colnr_T)(rex->input - rex->line)
+			|| rex->behind_pos.rs_u.pos.lnum != rex->lnum)
 		    status = RA_NOMATCH;
 	    }
-	    else if (behind_pos.rs_u.ptr != rex.input)
+	    else if (rex->behind_pos.rs_u.ptr != rex->input)
 		status = RA_NOMATCH;
 	    break;
 
 	  case NEWL:
-	    if ((c != NUL || !REG_MULTI || rex.lnum > rex.reg_maxline
-			     || rex.reg_line_lbr)
-					   && (c != '\n' || !rex.reg_line_lbr))
+	    if ((c != NUL || !REG_MULTI || rex->lnum > rex->reg_maxline
+			     || rex->reg_line_lbr)
+					   && (c != '\n' || !rex->reg_line_lbr))
 		status = RA_NOMATCH;
-	    else if (rex.reg_line_lbr)
+	    else if (rex->reg_line_lbr)
 		ADVANCE_REGINPUT();
 	    else
 		reg_nextline();
@@ -4119,9 +4081,10 @@ regmatch(
 
     // If there is something on the regstack execute the code for the state.
     // If the state is popped then loop and use the older state.
-    while (regstack.ga_len > 0 && status != RA_FAIL)
+    while (rex->regstack.ga_len > 0 && status != RA_FAIL)
     {
-	rp = (regitem_T *)((char *)regstack.ga_data + regstack.ga_len) - 1;
+	rp = (regitem_T *)((char *)rex->regstack.ga_data
+						   + rex->regstack.ga_len) - 1;
 	switch (rp->rs_state)
 	{
 	  case RS_NOPEN:
@@ -4132,8 +4095,8 @@ regmatch(
 	  case RS_MOPEN:
 	    // Pop the state.  Restore pointers when there is no match.
 	    if (status == RA_NOMATCH)
-		restore_se(&rp->rs_un.sesave, &rex.reg_startpos[rp->rs_no],
-						  &rex.reg_startp[rp->rs_no]);
+		restore_se(&rp->rs_un.sesave, &rex->reg_startpos[rp->rs_no],
+						  &rex->reg_startp[rp->rs_no]);
 	    regstack_pop(&scan);
 	    break;
 
@@ -4141,8 +4104,8 @@ regmatch(
 	  case RS_ZOPEN:
 	    // Pop the state.  Restore pointers when there is no match.
 	    if (status == RA_NOMATCH)
-		restore_se(&rp->rs_un.sesave, &reg_startzpos[rp->rs_no],
-						 &reg_startzp[rp->rs_no]);
+		restore_se(&rp->rs_un.sesave, &rex->reg_startzpos[rp->rs_no],
+						 &rex->reg_startzp[rp->rs_no]);
 	    regstack_pop(&scan);
 	    break;
 #endif
@@ -4150,8 +4113,8 @@ regmatch(
 	  case RS_MCLOSE:
 	    // Pop the state.  Restore pointers when there is no match.
 	    if (status == RA_NOMATCH)
-		restore_se(&rp->rs_un.sesave, &rex.reg_endpos[rp->rs_no],
-						    &rex.reg_endp[rp->rs_no]);
+		restore_se(&rp->rs_un.sesave, &rex->reg_endpos[rp->rs_no],
+						    &rex->reg_endp[rp->rs_no]);
 	    regstack_pop(&scan);
 	    break;
 
@@ -4159,8 +4122,8 @@ regmatch(
 	  case RS_ZCLOSE:
 	    // Pop the state.  Restore pointers when there is no match.
 	    if (status == RA_NOMATCH)
-		restore_se(&rp->rs_un.sesave, &reg_endzpos[rp->rs_no],
-						   &reg_endzp[rp->rs_no]);
+		restore_se(&rp->rs_un.sesave, &rex->reg_endzpos[rp->rs_no],
+						   &rex->reg_endzp[rp->rs_no]);
 	    regstack_pop(&scan);
 	    break;
 #endif
@@ -4174,7 +4137,7 @@ regmatch(
 		if (status != RA_BREAK)
 		{
 		    // After a non-matching branch: try next one.
-		    reg_restore(&rp->rs_un.regsave, &backpos);
+		    reg_restore(&rp->rs_un.regsave, &rex->backpos);
 		    scan = rp->rs_scan;
 		}
 		if (scan == NULL || OP(scan) != BRANCH)
@@ -4187,7 +4150,7 @@ regmatch(
 		{
 		    // Prepare to try a branch.
 		    rp->rs_scan = regnext(scan);
-		    reg_save(&rp->rs_un.regsave, &backpos);
+		    reg_save(&rp->rs_un.regsave, &rex->backpos);
 		    scan = OPERAND(scan);
 		}
 	    }
@@ -4197,8 +4160,8 @@ regmatch(
 	    // Pop the state.  Restore pointers when there is no match.
 	    if (status == RA_NOMATCH)
 	    {
-		reg_restore(&rp->rs_un.regsave, &backpos);
-		--brace_count[rp->rs_no];	// decrement match count
+		reg_restore(&rp->rs_un.regsave, &rex->backpos);
+		--rex->brace_count[rp->rs_no];	// decrement match count
 	    }
 	    regstack_pop(&scan);
 	    break;
@@ -4208,8 +4171,8 @@ regmatch(
 	    if (status == RA_NOMATCH)
 	    {
 		// There was no match, but we did find enough matches.
-		reg_restore(&rp->rs_un.regsave, &backpos);
-		--brace_count[rp->rs_no];
+		reg_restore(&rp->rs_un.regsave, &rex->backpos);
+		--rex->brace_count[rp->rs_no];
 		// continue with the items after "\{}"
 		status = RA_CONT;
 	    }
@@ -4222,7 +4185,7 @@ regmatch(
 	    // Pop the state.  Restore pointers when there is no match.
 	    if (status == RA_NOMATCH)
 		// There was no match, try to match one more item.
-		reg_restore(&rp->rs_un.regsave, &backpos);
+		reg_restore(&rp->rs_un.regsave, &rex->backpos);
 	    regstack_pop(&scan);
 	    if (status == RA_NOMATCH)
 	    {
@@ -4241,7 +4204,7 @@ regmatch(
 	    {
 		status = RA_CONT;
 		if (rp->rs_no != SUBPAT)	// zero-width
-		    reg_restore(&rp->rs_un.regsave, &backpos);
+		    reg_restore(&rp->rs_un.regsave, &rex->backpos);
 	    }
 	    regstack_pop(&scan);
 	    if (status == RA_CONT)
@@ -4252,7 +4215,7 @@ regmatch(
 	    if (status == RA_NOMATCH)
 	    {
 		regstack_pop(&scan);
-		regstack.ga_len -= sizeof(regbehind_T);
+		rex->regstack.ga_len -= sizeof(regbehind_T);
 	    }
 	    else
 	    {
@@ -4263,7 +4226,7 @@ regmatch(
 		// the current position.
 
 		// save the position after the found match for next
-		reg_save(&(((regbehind_T *)rp) - 1)->save_after, &backpos);
+		reg_save(&(((regbehind_T *)rp) - 1)->save_after, &rex->backpos);
 
 		// Start looking for a match with operand at the current
 		// position.  Go back one character until we find the
@@ -4271,25 +4234,25 @@ regmatch(
 		// line (for multi-line matching).
 		// Set behind_pos to where the match should end, BHPOS
 		// will match it.  Save the current value.
-		(((regbehind_T *)rp) - 1)->save_behind = behind_pos;
-		behind_pos = rp->rs_un.regsave;
+		(((regbehind_T *)rp) - 1)->save_behind = rex->behind_pos;
+		rex->behind_pos = rp->rs_un.regsave;
 
 		rp->rs_state = RS_BEHIND2;
 
-		reg_restore(&rp->rs_un.regsave, &backpos);
+		reg_restore(&rp->rs_un.regsave, &rex->backpos);
 		scan = OPERAND(rp->rs_scan) + 4;
 	    }
 	    break;
 
 	  case RS_BEHIND2:
 	    // Looping for BEHIND / NOBEHIND match.
-	    if (status == RA_MATCH && reg_save_equal(&behind_pos))
+	    if (status == RA_MATCH && reg_save_equal(&rex->behind_pos))
 	    {
 		// found a match that ends where "next" started
-		behind_pos = (((regbehind_T *)rp) - 1)->save_behind;
+		rex->behind_pos = (((regbehind_T *)rp) - 1)->save_behind;
 		if (rp->rs_no == BEHIND)
 		    reg_restore(&(((regbehind_T *)rp) - 1)->save_after,
-								    &backpos);
+								&rex->backpos);
 		else
 		{
 		    // But we didn't want a match.  Need to restore the
@@ -4299,7 +4262,7 @@ regmatch(
 		    restore_subexpr(((regbehind_T *)rp) - 1);
 		}
 		regstack_pop(&scan);
-		regstack.ga_len -= sizeof(regbehind_T);
+		rex->regstack.ga_len -= sizeof(regbehind_T);
 	    }
 	    else
 	    {
@@ -4313,24 +4276,24 @@ regmatch(
 		{
 		    if (limit > 0
 			    && ((rp->rs_un.regsave.rs_u.pos.lnum
-						    < behind_pos.rs_u.pos.lnum
-				    ? (colnr_T)STRLEN(rex.line)
-				    : behind_pos.rs_u.pos.col)
+						< rex->behind_pos.rs_u.pos.lnum
+				    ? (colnr_T)STRLEN(rex->line)
+				    : rex->behind_pos.rs_u.pos.col)
 				- rp->rs_un.regsave.rs_u.pos.col >= limit))
 			no = FAIL;
 		    else if (rp->rs_un.regsave.rs_u.pos.col == 0)
 		    {
 			if (rp->rs_un.regsave.rs_u.pos.lnum
-					< behind_pos.rs_u.pos.lnum
+					< rex->behind_pos.rs_u.pos.lnum
 				|| reg_getline(
 					--rp->rs_un.regsave.rs_u.pos.lnum)
 								  == NULL)
 			    no = FAIL;
 			else
 			{
-			    reg_restore(&rp->rs_un.regsave, &backpos);
+			    reg_restore(&rp->rs_un.regsave, &rex->backpos);
 			    rp->rs_un.regsave.rs_u.pos.col =
-						 (colnr_T)STRLEN(rex.line);
+						 (colnr_T)STRLEN(rex->line);
 			}
 		    }
 		    else
@@ -4350,12 +4313,12 @@ regmatch(
 		}
 		else
 		{
-		    if (rp->rs_un.regsave.rs_u.ptr == rex.line)
+		    if (rp->rs_un.regsave.rs_u.ptr == rex->line)
 			no = FAIL;
 		    else
 		    {
-			MB_PTR_BACK(rex.line, rp->rs_un.regsave.rs_u.ptr);
-			if (limit > 0 && (long)(behind_pos.rs_u.ptr
+			MB_PTR_BACK(rex->line, rp->rs_un.regsave.rs_u.ptr);
+			if (limit > 0 && (long)(rex->behind_pos.rs_u.ptr
 				     - rp->rs_un.regsave.rs_u.ptr) > limit)
 			    no = FAIL;
 		    }
@@ -4363,7 +4326,7 @@ regmatch(
 		if (no == OK)
 		{
 		    // Advanced, prepare for finding match again.
-		    reg_restore(&rp->rs_un.regsave, &backpos);
+		    reg_restore(&rp->rs_un.regsave, &rex->backpos);
 		    scan = OPERAND(rp->rs_scan) + 4;
 		    if (status == RA_MATCH)
 		    {
@@ -4376,11 +4339,11 @@ regmatch(
 		else
 		{
 		    // Can't advance.  For NOBEHIND that's a match.
-		    behind_pos = (((regbehind_T *)rp) - 1)->save_behind;
+		    rex->behind_pos = (((regbehind_T *)rp) - 1)->save_behind;
 		    if (rp->rs_no == NOBEHIND)
 		    {
 			reg_restore(&(((regbehind_T *)rp) - 1)->save_after,
-								    &backpos);
+								&rex->backpos);
 			status = RA_MATCH;
 		    }
 		    else
@@ -4395,7 +4358,7 @@ regmatch(
 			}
 		    }
 		    regstack_pop(&scan);
-		    regstack.ga_len -= sizeof(regbehind_T);
+		    rex->regstack.ga_len -= sizeof(regbehind_T);
 		}
 	    }
 	    break;
@@ -4408,13 +4371,13 @@ regmatch(
 		if (status == RA_MATCH)
 		{
 		    regstack_pop(&scan);
-		    regstack.ga_len -= sizeof(regstar_T);
+		    rex->regstack.ga_len -= sizeof(regstar_T);
 		    break;
 		}
 
 		// Tried once already, restore input pointers.
 		if (status != RA_BREAK)
-		    reg_restore(&rp->rs_un.regsave, &backpos);
+		    reg_restore(&rp->rs_un.regsave, &rex->backpos);
 
 		// Repeat until we found a position where it could match.
 		for (;;)
@@ -4428,20 +4391,20 @@ regmatch(
 			    // didn't match -- back up one char.
 			    if (--rst->count < rst->minval)
 				break;
-			    if (rex.input == rex.line)
+			    if (rex->input == rex->line)
 			    {
 				// backup to last char of previous line
-				--rex.lnum;
-				rex.line = reg_getline(rex.lnum);
+				--rex->lnum;
+				rex->line = reg_getline(rex->lnum);
 				// Just in case regrepeat() didn't count
 				// right.
-				if (rex.line == NULL)
+				if (rex->line == NULL)
 				    break;
-				rex.input = rex.line + STRLEN(rex.line);
+				rex->input = rex->line + STRLEN(rex->line);
 				fast_breakcheck();
 			    }
 			    else
-				MB_PTR_BACK(rex.line, rex.input);
+				MB_PTR_BACK(rex->line, rex->input);
 			}
 			else
 			{
@@ -4461,10 +4424,10 @@ regmatch(
 			status = RA_NOMATCH;
 
 		    // If it could match, try it.
-		    if (rst->nextb == NUL || *rex.input == rst->nextb
-					     || *rex.input == rst->nextb_ic)
+		    if (rst->nextb == NUL || *rex->input == rst->nextb
+					     || *rex->input == rst->nextb_ic)
 		    {
-			reg_save(&rp->rs_un.regsave, &backpos);
+			reg_save(&rp->rs_un.regsave, &rex->backpos);
 			scan = regnext(rp->rs_scan);
 			status = RA_CONT;
 			break;
@@ -4474,7 +4437,7 @@ regmatch(
 		{
 		    // Failed.
 		    regstack_pop(&scan);
-		    regstack.ga_len -= sizeof(regstar_T);
+		    rex->regstack.ga_len -= sizeof(regstar_T);
 		    status = RA_NOMATCH;
 		}
 	    }
@@ -4484,7 +4447,7 @@ regmatch(
 	// If we want to continue the inner loop or didn't pop a state
 	// continue matching loop
 	if (status == RA_CONT || rp == (regitem_T *)
-			     ((char *)regstack.ga_data + regstack.ga_len) - 1)
+		    ((char *)rex->regstack.ga_data + rex->regstack.ga_len) - 1)
 	    break;
     }
 
@@ -4493,7 +4456,7 @@ regmatch(
 	continue;
 
     // If the regstack is empty or something failed we are done.
-    if (regstack.ga_len == 0 || status == RA_FAIL)
+    if (rex->regstack.ga_len == 0 || status == RA_FAIL)
     {
 	if (scan == NULL)
 	{
@@ -4513,7 +4476,7 @@ regmatch(
 }
 
 /*
- * regtry - try match of "prog" with at rex.line["col"].
+ * regtry - try match of "prog" with at rex->line["col"].
  * Returns 0 for failure, number of lines contained in the match otherwise.
  */
     static long
@@ -4523,11 +4486,11 @@ regtry(
     proftime_T		*tm,		// timeout limit or NULL
     int			*timed_out)	// flag set on timeout or NULL
 {
-    rex.input = rex.line + col;
-    rex.need_clear_subexpr = TRUE;
+    rex->input = rex->line + col;
+    rex->need_clear_subexpr = TRUE;
 #ifdef FEAT_SYN_HL
     // Clear the external match subpointers if necessary.
-    rex.need_clear_zsubexpr = (prog->reghasz == REX_SET);
+    rex->need_clear_zsubexpr = (prog->reghasz == REX_SET);
 #endif
 
     if (regmatch(prog->program + 1, tm, timed_out) == 0)
@@ -4536,26 +4499,26 @@ regtry(
     cleanup_subexpr();
     if (REG_MULTI)
     {
-	if (rex.reg_startpos[0].lnum < 0)
+	if (rex->reg_startpos[0].lnum < 0)
 	{
-	    rex.reg_startpos[0].lnum = 0;
-	    rex.reg_startpos[0].col = col;
+	    rex->reg_startpos[0].lnum = 0;
+	    rex->reg_startpos[0].col = col;
 	}
-	if (rex.reg_endpos[0].lnum < 0)
+	if (rex->reg_endpos[0].lnum < 0)
 	{
-	    rex.reg_endpos[0].lnum = rex.lnum;
-	    rex.reg_endpos[0].col = (int)(rex.input - rex.line);
+	    rex->reg_endpos[0].lnum = rex->lnum;
+	    rex->reg_endpos[0].col = (int)(rex->input - rex->line);
 	}
 	else
 	    // Use line number of "\ze".
-	    rex.lnum = rex.reg_endpos[0].lnum;
+	    rex->lnum = rex->reg_endpos[0].lnum;
     }
     else
     {
-	if (rex.reg_startp[0] == NULL)
-	    rex.reg_startp[0] = rex.line + col;
-	if (rex.reg_endp[0] == NULL)
-	    rex.reg_endp[0] = rex.input;
+	if (rex->reg_startp[0] == NULL)
+	    rex->reg_startp[0] = rex->line + col;
+	if (rex->reg_endp[0] == NULL)
+	    rex->reg_endp[0] = rex->input;
     }
 #ifdef FEAT_SYN_HL
     // Package any found \z(...\) matches for export. Default is none.
@@ -4575,25 +4538,25 @@ regtry(
 	    if (REG_MULTI)
 	    {
 		// Only accept single line matches.
-		if (reg_startzpos[i].lnum >= 0
-			&& reg_endzpos[i].lnum == reg_startzpos[i].lnum
-			&& reg_endzpos[i].col >= reg_startzpos[i].col)
+		if (rex->reg_startzpos[i].lnum >= 0
+		      && rex->reg_endzpos[i].lnum == rex->reg_startzpos[i].lnum
+			&& rex->reg_endzpos[i].col >= rex->reg_startzpos[i].col)
 		    re_extmatch_out->matches[i] =
-			vim_strnsave(reg_getline(reg_startzpos[i].lnum)
-						       + reg_startzpos[i].col,
-				   reg_endzpos[i].col - reg_startzpos[i].col);
+			vim_strnsave(reg_getline(rex->reg_startzpos[i].lnum)
+						   + rex->reg_startzpos[i].col,
+			  rex->reg_endzpos[i].col - rex->reg_startzpos[i].col);
 	    }
 	    else
 	    {
-		if (reg_startzp[i] != NULL && reg_endzp[i] != NULL)
+		if (rex->reg_startzp[i] != NULL && rex->reg_endzp[i] != NULL)
 		    re_extmatch_out->matches[i] =
-			    vim_strnsave(reg_startzp[i],
-						reg_endzp[i] - reg_startzp[i]);
+			    vim_strnsave(rex->reg_startzp[i],
+				      rex->reg_endzp[i] - rex->reg_startzp[i]);
 	    }
 	}
     }
 #endif
-    return 1 + rex.lnum;
+    return 1 + rex->lnum;
 }
 
 /*
@@ -4603,6 +4566,7 @@ regtry(
  */
     static long
 bt_regexec_both(
+    regexec_T	*rx,		// execution state
     char_u	*line,
     colnr_T	col,		// column to start looking for match
     proftime_T	*tm,		// timeout limit or NULL
@@ -4612,38 +4576,41 @@ bt_regexec_both(
     char_u	    *s;
     long	    retval = 0L;
 
+    // All functions called from here use "rex".
+    rex = rx;
+
     // Create "regstack" and "backpos" if they are not allocated yet.
     // We allocate *_INITIAL amount of bytes first and then set the grow size
     // to much bigger value to avoid many malloc calls in case of deep regular
     // expressions.
-    if (regstack.ga_data == NULL)
+    if (rex->regstack.ga_data == NULL)
     {
 	// Use an item size of 1 byte, since we push different things
 	// onto the regstack.
-	ga_init2(&regstack, 1, REGSTACK_INITIAL);
-	(void)ga_grow(&regstack, REGSTACK_INITIAL);
-	regstack.ga_growsize = REGSTACK_INITIAL * 8;
+	ga_init2(&rex->regstack, 1, REGSTACK_INITIAL);
+	(void)ga_grow(&rex->regstack, REGSTACK_INITIAL);
+	rex->regstack.ga_growsize = REGSTACK_INITIAL * 8;
     }
 
-    if (backpos.ga_data == NULL)
+    if (rex->backpos.ga_data == NULL)
     {
-	ga_init2(&backpos, sizeof(backpos_T), BACKPOS_INITIAL);
-	(void)ga_grow(&backpos, BACKPOS_INITIAL);
-	backpos.ga_growsize = BACKPOS_INITIAL * 8;
+	ga_init2(&rex->backpos, sizeof(backpos_T), BACKPOS_INITIAL);
+	(void)ga_grow(&rex->backpos, BACKPOS_INITIAL);
+	rex->backpos.ga_growsize = BACKPOS_INITIAL * 8;
     }
 
     if (REG_MULTI)
     {
-	prog = (bt_regprog_T *)rex.reg_mmatch->regprog;
+	prog = (bt_regprog_T *)rex->reg_mmatch->regprog;
 	line = reg_getline((linenr_T)0);
-	rex.reg_startpos = rex.reg_mmatch->startpos;
-	rex.reg_endpos = rex.reg_mmatch->endpos;
+	rex->reg_startpos = rex->reg_mmatch->startpos;
+	rex->reg_endpos = rex->reg_mmatch->endpos;
     }
     else
     {
-	prog = (bt_regprog_T *)rex.reg_match->regprog;
-	rex.reg_startp = rex.reg_match->startp;
-	rex.reg_endp = rex.reg_match->endp;
+	prog = (bt_regprog_T *)rex->reg_match->regprog;
+	rex->reg_startp = rex->reg_match->startp;
+	rex->reg_endp = rex->reg_match->endp;
     }
 
     // Be paranoid...
@@ -4658,60 +4625,21 @@ bt_regexec_both(
 	goto theend;
 
     // If the start column is past the maximum column: no need to try.
-    if (rex.reg_maxcol > 0 && col >= rex.reg_maxcol)
+    if (rex->reg_maxcol > 0 && col >= rex->reg_maxcol)
 	goto theend;
 
-    // If pattern contains "\c" or "\C": overrule value of rex.reg_ic
+    // If pattern contains "\c" or "\C": overrule value of rex->reg_ic
     if (prog->regflags & RF_ICASE)
-	rex.reg_ic = TRUE;
+	rex->reg_ic = TRUE;
     else if (prog->regflags & RF_NOICASE)
-	rex.reg_ic = FALSE;
+	rex->reg_ic = FALSE;
 
-    // If pattern contains "\Z" overrule value of rex.reg_icombine
+    // If pattern contains "\Z" overrule value of rex->reg_icombine
     if (prog->regflags & RF_ICOMBINE)
-	rex.reg_icombine = TRUE;
-
-    // If there is a "must appear" string, look for it.
-    if (prog->regmust != NULL)
-    {
-	int c;
+	rex->reg_icombine = TRUE;
 
-	if (has_mbyte)
-	    c = (*mb_ptr2char)(prog->regmust);
-	else
-	    c = *prog->regmust;
-	s = line + col;
-
-	// This is used very often, esp. for ":global".  Use three versions of
-	// the loop to avoid overhead of conditions.
-	if (!rex.reg_ic && !has_mbyte)
-	    while ((s = vim_strbyte(s, c)) != NULL)
-	    {
-		if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
-		    break;		// Found it.
-		++s;
-	    }
-	else if (!rex.reg_ic || (!enc_utf8 && mb_char2len(c) > 1))
-	    while ((s = vim_strchr(s, c)) != NULL)
-	    {
-		if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
-		    break;		// Found it.
-		MB_PTR_ADV(s);
-	    }
-	else
-	    while ((s = cstrchr(s, c)) != NULL)
-	    {
-		if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
-		    break;		// Found it.
-		MB_PTR_ADV(s);
-	    }
-	if (s == NULL)		// Not present.
-	    goto theend;
-    }
-
-    rex.line = line;
-    rex.lnum = 0;
-    reg_toolong = FALSE;
+    rex->line = line;
+    rex->lnum = 0;
 
     // Simplest case: Anchored match need be tried only once.
     if (prog->reganch)
@@ -4719,12 +4647,12 @@ bt_regexec_both(
 	int	c;
 
 	if (has_mbyte)
-	    c = (*mb_ptr2char)(rex.line + col);
+	    c = (*mb_ptr2char)(rex->line + col);
 	else
-	    c = rex.line[col];
+	    c = rex->line[col];
 	if (prog->regstart == NUL
 		|| prog->regstart == c
-		|| (rex.reg_ic
+		|| (rex->reg_ic
 		    && (((enc_utf8 && utf_fold(prog->regstart) == utf_fold(c)))
 			|| (c < 255 && prog->regstart < 255 &&
 			    MB_TOLOWER(prog->regstart) == MB_TOLOWER(c)))))
@@ -4744,20 +4672,20 @@ bt_regexec_both(
 	    {
 		// Skip until the char we know it must start with.
 		// Used often, do some work to avoid call overhead.
-		if (!rex.reg_ic && !has_mbyte)
-		    s = vim_strbyte(rex.line + col, prog->regstart);
+		if (!rex->reg_ic && !has_mbyte)
+		    s = vim_strbyte(rex->line + col, prog->regstart);
 		else
-		    s = cstrchr(rex.line + col, prog->regstart);
+		    s = cstrchr(rex->line + col, prog->regstart);
 		if (s == NULL)
 		{
 		    retval = 0;
 		    break;
 		}
-		col = (int)(s - rex.line);
+		col = (int)(s - rex->line);
 	    }
 
 	    // Check for maximum column to try.
-	    if (rex.reg_maxcol > 0 && col >= rex.reg_maxcol)
+	    if (rex->reg_maxcol > 0 && col >= rex->reg_maxcol)
 	    {
 		retval = 0;
 		break;
@@ -4768,15 +4696,15 @@ bt_regexec_both(
 		break;
 
 	    // if not currently on the first line, get it again
-	    if (rex.lnum != 0)
+	    if (rex->lnum != 0)
 	    {
-		rex.lnum = 0;
-		rex.line = reg_getline((linenr_T)0);
+		rex->lnum = 0;
+		rex->line = reg_getline((linenr_T)0);
 	    }
-	    if (rex.line[col] == NUL)
+	    if (rex->line[col] == NUL)
 		break;
 	    if (has_mbyte)
-		col += (*mb_ptr2len)(rex.line + col);
+		col += (*mb_ptr2len)(rex->line + col);
 	    else
 		++col;
 #ifdef FEAT_RELTIME
@@ -4798,12 +4726,12 @@ bt_regexec_both(
 theend:
     // Free "reg_tofree" when it's a bit big.
     // Free regstack and backpos if they are bigger than their initial size.
-    if (reg_tofreelen > 400)
-	VIM_CLEAR(reg_tofree);
-    if (regstack.ga_maxlen > REGSTACK_INITIAL)
-	ga_clear(&regstack);
-    if (backpos.ga_maxlen > BACKPOS_INITIAL)
-	ga_clear(&backpos);
+    if (rex->reg_tofreelen > 400)
+	VIM_CLEAR(rex->reg_tofree);
+    if (rex->regstack.ga_maxlen > REGSTACK_INITIAL)
+	ga_clear(&rex->regstack);
+    if (rex->backpos.ga_maxlen > BACKPOS_INITIAL)
+	ga_clear(&rex->backpos);
 
     return retval;
 }
@@ -4818,22 +4746,23 @@ theend:
  */
     static int
 bt_regexec_nl(
+    regexec_T	*rx,
     regmatch_T	*rmp,
     char_u	*line,	// string to match against
     colnr_T	col,	// column to start looking for match
     int		line_lbr)
 {
-    rex.reg_match = rmp;
-    rex.reg_mmatch = NULL;
-    rex.reg_maxline = 0;
-    rex.reg_line_lbr = line_lbr;
-    rex.reg_buf = curbuf;
-    rex.reg_win = NULL;
-    rex.reg_ic = rmp->rm_ic;
-    rex.reg_icombine = FALSE;
-    rex.reg_maxcol = 0;
-
-    return bt_regexec_both(line, col, NULL, NULL);
+    rx->reg_match = rmp;
+    rx->reg_mmatch = NULL;
+    rx->reg_maxline = 0;
+    rx->reg_line_lbr = line_lbr;
+    rx->reg_buf = curbuf;
+    rx->reg_win = NULL;
+    rx->reg_ic = rmp->rm_ic;
+    rx->reg_icombine = FALSE;
+    rx->reg_maxcol = 0;
+
+    return bt_regexec_both(rx, line, col, NULL, NULL);
 }
 
 /*
@@ -4846,6 +4775,7 @@ bt_regexec_nl(
  */
     static long
 bt_regexec_multi(
+    regexec_T	*rx,
     regmmatch_T	*rmp,
     win_T	*win,		// window in which to search or NULL
     buf_T	*buf,		// buffer in which to search
@@ -4854,8 +4784,8 @@ bt_regexec_multi(
     proftime_T	*tm,		// timeout limit or NULL
     int		*timed_out)	// flag set on timeout or NULL
 {
-    init_regexec_multi(rmp, win, buf, lnum);
-    return bt_regexec_both(NULL, col, tm, timed_out);
+    init_regexec_multi(rx, rmp, win, buf, lnum);
+    return bt_regexec_both(rx, NULL, col, tm, timed_out);
 }
 
 /*
@@ -4950,8 +4880,8 @@ regdump(char_u *pattern, bt_regprog_T *r)
 		: "multibyte", r->regstart);
     if (r->reganch)
 	fprintf(f, "anchored; ");
-    if (r->regmust != NULL)
-	fprintf(f, "must have \"%s\"", r->regmust);
+    if (r->re_must != NULL)
+	fprintf(f, "must have \"%s\"", r->re_must);
     fprintf(f, "\r\n");
 
 #ifdef BT_REGEXP_LOG
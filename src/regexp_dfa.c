@@ -0,0 +1,736 @@
+/* vi:set ts=8 sts=4 sw=4 noet:
+ *
+ * Lazy DFA for the NFA regular expression engine.
+ *
+ * This file is included in "regexp.c", after "regexp_nfa.c".
+ */
+
+/*
+ * nfa_regmatch() builds a list of NFA states for every character of the text
+ * and keeps track of the submatches for each state.  That is needed to find
+ * where the match is, but it is slow when most lines don't match at all.
+ *
+ * For patterns without back references, look-around and items that depend on
+ * the cursor, marks, etc. the NFA can also be run as a DFA: every set of NFA
+ * states that can be active at a position in the text is one DFA state.  The
+ * DFA states are only built when the text needs them, and kept in a cache of
+ * limited size.  Then checking a character is a table lookup.
+ *
+ * The DFA only finds out whether there is a match in the line.  Only when
+ * there is one nfa_regmatch() is used to find where it is.
+ *
+ * Zero-width items that depend on the next character, such as "$" and "\<",
+ * are handled when computing the transition for that character.  To be able
+ * to do that the DFA state holds the set of NFA states before following the
+ * empty transitions, plus the class of the previous character.
+ *
+ * Lines with composing characters or illegal bytes are left to
+ * nfa_regmatch(), these are matched differently depending on the item.
+ */
+
+// The return values of dfa_regexec() are defined in regexp_nfa.c.
+
+// Maximum number of bytes used by the cached states of one pattern.
+#define DFA_MAX_MEM	(256 * 1024)
+
+// When the cache gets full more often than this while matching one line it
+// is not effective, don't use the DFA for this line.
+#define DFA_MAX_FLUSH	3
+
+// After this many lines where the DFA was not effective it is not used for
+// the pattern any more.
+#define DFA_MAX_FAIL	10
+
+// Value for "ds_next" entries of a state: the character results in a match.
+#define DFA_MATCH_STATE	((dfa_state_T *)&dfa_match_dummy)
+
+typedef struct dfa_state_S dfa_state_T;
+
+struct dfa_state_S
+{
+    dfa_state_T	*ds_hash_next;	// next state in the same hash bucket
+    unsigned	ds_hash;
+    int		ds_prev_class;	// class of the previous character, -1 at
+				// the start of the line
+    int		ds_nkernel;	// number of items in "ds_kernel"
+    int		*ds_kernel;	// sorted indexes of NFA states to continue
+				// with, before following empty transitions
+    dfa_state_T	**ds_next;	// next state for each byte class, NULL when
+				// not computed yet
+};
+
+static int dfa_match_dummy;
+
+typedef struct regdfa_S regdfa_T;
+
+struct regdfa_S
+{
+    // The cached states are only valid for these values.
+    int		rd_ic;		// value of rex->reg_ic
+    int		rd_enc;		// value of enc_utf8 and enc_dbcs
+    char_u	rd_chartab[32];	// copy of rex->reg_buf->b_chartab
+    int		rd_valid;	// FALSE when the above were not set yet
+
+    int		rd_use_class;	// pattern contains "\<" or "\>"
+    int		rd_use_chartab;	// pattern uses 'iskeyword'
+
+    int		*rd_consume;	// indexes of NFA states that consume a char
+    int		rd_nconsume;
+
+    // Characters below 256 that are not a lead byte are put into classes,
+    // all characters in one class have the same transitions.
+    char_u	rd_byteclass[256];
+    int		rd_nclasses;
+    int		rd_charclass[256];	// result of mb_get_class_buf()
+
+    dfa_state_T	**rd_buckets;	// hash table with all the states
+    int		rd_nbuckets;
+    long	rd_mem;		// memory used by the states
+    int		rd_flushed;	// number of times the cache was cleared
+    int		rd_failed;	// number of lines where the DFA didn't work
+    dfa_state_T	*rd_start;	// state at the start of the line
+
+    int		*rd_mark;	// per NFA state: "rd_gen" when visited
+    int		*rd_mark_next;	// per NFA state: "rd_gen" when in "rd_work"
+    int		rd_gen;
+    int		*rd_stack;	// work stack for following empty transitions
+    int		*rd_work;	// kernel of the next state being built
+};
+
+/*
+ * Return TRUE if the DFA can handle NFA state "c".
+ */
+    static int
+dfa_state_ok(int c)
+{
+    if (c > 0)
+	return TRUE;
+    if (c >= NFA_ANY && c <= NFA_NUPPER_IC)
+	// These depend on global options, the cache would not notice a
+	// change.
+	return c != NFA_IDENT && c != NFA_SIDENT
+	    && c != NFA_FNAME && c != NFA_SFNAME
+	    && c != NFA_PRINT && c != NFA_SPRINT;
+    if (c >= NFA_MOPEN && c <= NFA_MCLOSE9)
+	return TRUE;
+#ifdef FEAT_SYN_HL
+    if (c >= NFA_ZOPEN && c <= NFA_ZCLOSE9)
+	return TRUE;
+#endif
+    if (c >= NFA_CLASS_ALNUM && c <= NFA_CLASS_FNAME)
+	return c != NFA_CLASS_PRINT && c != NFA_CLASS_IDENT
+						      && c != NFA_CLASS_FNAME;
+    switch (c)
+    {
+	case NFA_SPLIT:
+	case NFA_MATCH:
+	case NFA_EMPTY:
+	case NFA_START_COLL:
+	case NFA_END_COLL:
+	case NFA_START_NEG_COLL:
+	case NFA_RANGE_MIN:
+	case NFA_RANGE_MAX:
+	case NFA_BOL:
+	case NFA_EOL:
+	case NFA_BOW:
+	case NFA_EOW:
+	case NFA_ZSTART:
+	case NFA_ZEND:
+	case NFA_NOPEN:
+	case NFA_NCLOSE:
+	    return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Return TRUE if NFA state "c" consumes a character.
+ */
+    static int
+dfa_state_consumes(int c)
+{
+    return c > 0 || (c >= NFA_ANY && c <= NFA_NUPPER_IC)
+				|| c == NFA_START_COLL || c == NFA_START_NEG_COLL;
+}
+
+/*
+ * Return the state to continue with after state "state", which consumes a
+ * character.
+ */
+    static nfa_state_T *
+dfa_state_after(nfa_state_T *state)
+{
+    if (state->c == NFA_START_COLL || state->c == NFA_START_NEG_COLL)
+	return state->out1->out;    // skip over NFA_END_COLL
+    return state->out;
+}
+
+/*
+ * Return TRUE if "state", which consumes a character, matches character
+ * "curc" at "p".  This must do the same as nfa_regmatch().
+ */
+    static int
+dfa_char_matches(nfa_state_T *state, int curc, char_u *p)
+{
+    switch (state->c)
+    {
+	case NFA_START_COLL:
+	case NFA_START_NEG_COLL:
+	  {
+	    nfa_state_T	*st;
+	    int		result_if_matched;
+	    int		c1, c2;
+
+	    if (curc == NUL)
+		return FALSE;
+	    result_if_matched = (state->c == NFA_START_COLL);
+	    for (st = state->out; st->c != NFA_END_COLL; st = st->out)
+	    {
+		if (st->c == NFA_RANGE_MIN)
+		{
+		    c1 = st->val;
+		    st = st->out; // advance to NFA_RANGE_MAX
+		    c2 = st->val;
+		    if (curc >= c1 && curc <= c2)
+			return result_if_matched;
+		    if (rex->reg_ic)
+		    {
+			int curc_low = MB_CASEFOLD(curc);
+
+			for ( ; c1 <= c2; ++c1)
+			    if (MB_CASEFOLD(c1) == curc_low)
+				return result_if_matched;
+		    }
+		}
+		else if (st->c < 0 ? check_char_class(st->c, curc)
+			       : (curc == st->c
+				   || (rex->reg_ic && MB_CASEFOLD(curc)
+						     == MB_CASEFOLD(st->c))))
+		    return result_if_matched;
+	    }
+	    return !result_if_matched;
+	  }
+
+	case NFA_ANY:	    return curc > 0;
+	case NFA_KWORD:	    return vim_iswordp_buf(p, rex->reg_buf);
+	case NFA_SKWORD:    return !VIM_ISDIGIT(curc)
+				     && vim_iswordp_buf(p, rex->reg_buf);
+	case NFA_WHITE:	    return VIM_ISWHITE(curc);
+	case NFA_NWHITE:    return curc != NUL && !VIM_ISWHITE(curc);
+	case NFA_DIGIT:	    return ri_digit(curc);
+	case NFA_NDIGIT:    return curc != NUL && !ri_digit(curc);
+	case NFA_HEX:	    return ri_hex(curc);
+	case NFA_NHEX:	    return curc != NUL && !ri_hex(curc);
+	case NFA_OCTAL:	    return ri_octal(curc);
+	case NFA_NOCTAL:    return curc != NUL && !ri_octal(curc);
+	case NFA_WORD:	    return ri_word(curc);
+	case NFA_NWORD:	    return curc != NUL && !ri_word(curc);
+	case NFA_HEAD:	    return ri_head(curc);
+	case NFA_NHEAD:	    return curc != NUL && !ri_head(curc);
+	case NFA_ALPHA:	    return ri_alpha(curc);
+	case NFA_NALPHA:    return curc != NUL && !ri_alpha(curc);
+	case NFA_LOWER:	    return ri_lower(curc);
+	case NFA_NLOWER:    return curc != NUL && !ri_lower(curc);
+	case NFA_UPPER:	    return ri_upper(curc);
+	case NFA_NUPPER:    return curc != NUL && !ri_upper(curc);
+	case NFA_LOWER_IC:  return ri_lower(curc)
+					    || (rex->reg_ic && ri_upper(curc));
+	case NFA_NLOWER_IC: return curc != NUL
+		       && !(ri_lower(curc) || (rex->reg_ic && ri_upper(curc)));
+	case NFA_UPPER_IC:  return ri_upper(curc)
+					    || (rex->reg_ic && ri_lower(curc));
+	case NFA_NUPPER_IC: return curc != NUL
+		       && !(ri_upper(curc) || (rex->reg_ic && ri_lower(curc)));
+    }
+
+    // regular character
+    return state->c == curc
+		 || (rex->reg_ic && MB_CASEFOLD(state->c) == MB_CASEFOLD(curc));
+}
+
+/*
+ * Free all the cached states of "dfa".
+ */
+    static void
+dfa_clear_cache(regdfa_T *dfa)
+{
+    int		i;
+    dfa_state_T	*ds;
+    dfa_state_T	*next;
+
+    for (i = 0; i < dfa->rd_nbuckets; ++i)
+    {
+	for (ds = dfa->rd_buckets[i]; ds != NULL; ds = next)
+	{
+	    next = ds->ds_hash_next;
+	    vim_free(ds);
+	}
+	dfa->rd_buckets[i] = NULL;
+    }
+    dfa->rd_mem = 0;
+    dfa->rd_start = NULL;
+}
+
+/*
+ * Free "dfa" and everything it contains.
+ */
+    static void
+dfa_free(struct regdfa_S *dfa)
+{
+    if (dfa == NULL)
+	return;
+    dfa_clear_cache(dfa);
+    vim_free(dfa->rd_buckets);
+    vim_free(dfa->rd_consume);
+    vim_free(dfa->rd_mark);
+    vim_free(dfa->rd_mark_next);
+    vim_free(dfa->rd_stack);
+    vim_free(dfa->rd_work);
+    vim_free(dfa);
+}
+
+/*
+ * Create the DFA for "prog".  Returns NULL when the pattern contains
+ * something the DFA can't handle or out of memory.
+ */
+    static regdfa_T *
+dfa_new(nfa_regprog_T *prog)
+{
+    regdfa_T	*dfa;
+    int		i;
+
+    if (prog->has_backref || (prog->regflags & RF_ICOMBINE))
+	return NULL;
+    for (i = 0; i < prog->nstate; ++i)
+	if (!dfa_state_ok(prog->state[i].c))
+	    return NULL;
+
+    dfa = ALLOC_CLEAR_ONE(regdfa_T);
+    if (dfa == NULL)
+	return NULL;
+    dfa->rd_nbuckets = 256;
+    dfa->rd_buckets = ALLOC_CLEAR_MULT(dfa_state_T *, dfa->rd_nbuckets);
+    dfa->rd_consume = ALLOC_MULT(int, prog->nstate);
+    dfa->rd_mark = ALLOC_CLEAR_MULT(int, prog->nstate);
+    dfa->rd_mark_next = ALLOC_CLEAR_MULT(int, prog->nstate);
+    // The start state and the kernel, then every state can push two
+    // states, for NFA_SPLIT.
+    dfa->rd_stack = ALLOC_MULT(int, prog->nstate * 3 + 1);
+    dfa->rd_work = ALLOC_MULT(int, prog->nstate);
+    if (dfa->rd_buckets == NULL || dfa->rd_consume == NULL
+	    || dfa->rd_mark == NULL || dfa->rd_mark_next == NULL
+	    || dfa->rd_stack == NULL || dfa->rd_work == NULL)
+    {
+	dfa_free(dfa);
+	return NULL;
+    }
+
+    for (i = 0; i < prog->nstate; ++i)
+    {
+	int c = prog->state[i].c;
+
+	if (c == NFA_BOW || c == NFA_EOW)
+	    dfa->rd_use_class = TRUE;
+	if (c == NFA_BOW || c == NFA_EOW || c == NFA_KWORD
+				 || c == NFA_SKWORD || c == NFA_CLASS_KEYWORD)
+	    dfa->rd_use_chartab = TRUE;
+    }
+    return dfa;
+}
+
+/*
+ * Find the NFA states that consume a character and can be reached from the
+ * start state.  The characters in collections are not included.
+ */
+    static void
+dfa_find_consume(regdfa_T *dfa, nfa_regprog_T *prog)
+{
+    int		    sp = 0;
+    nfa_state_T	    *state;
+    int		    i;
+
+    ++dfa->rd_gen;
+    dfa->rd_nconsume = 0;
+    dfa->rd_stack[sp++] = (int)(prog->start - prog->state);
+    while (sp > 0)
+    {
+	i = dfa->rd_stack[--sp];
+	if (dfa->rd_mark[i] == dfa->rd_gen)
+	    continue;
+	dfa->rd_mark[i] = dfa->rd_gen;
+	state = &prog->state[i];
+	if (dfa_state_consumes(state->c))
+	{
+	    dfa->rd_consume[dfa->rd_nconsume++] = i;
+	    state = dfa_state_after(state);
+	    dfa->rd_stack[sp++] = (int)(state - prog->state);
+	}
+	else if (state->c != NFA_MATCH)
+	{
+	    dfa->rd_stack[sp++] = (int)(state->out - prog->state);
+	    if (state->c == NFA_SPLIT)
+		dfa->rd_stack[sp++] = (int)(state->out1 - prog->state);
+	}
+    }
+}
+
+/*
+ * Return TRUE if character "c" below 256 can be looked up in the byte class
+ * table.  Not for a lead byte of a double-byte character.
+ */
+    static int
+dfa_cached_char(int c)
+{
+    return !has_mbyte || enc_utf8 || MB_BYTE2LEN(c) == 1;
+}
+
+/*
+ * Set up "dfa" for the current values of 'ignorecase', 'iskeyword' and
+ * 'encoding'.  The characters below 256 are put into classes, all characters
+ * in one class match the same NFA states.  Clears the cached states when the
+ * classes change.
+ * Returns FAIL when out of memory.
+ */
+    static int
+dfa_setup(regdfa_T *dfa, nfa_regprog_T *prog)
+{
+    int		enc = enc_utf8 ? -1 : enc_dbcs;
+    int		nbytes;
+    char_u	*sigs;
+    char_u	*sig;
+    char_u	buf[MB_MAXBYTES + 1];
+    int		c;
+    int		i;
+
+    if (dfa->rd_valid && dfa->rd_ic == rex->reg_ic && dfa->rd_enc == enc
+	    && (!dfa->rd_use_chartab || memcmp(dfa->rd_chartab,
+		       rex->reg_buf->b_chartab, sizeof(dfa->rd_chartab)) == 0))
+	return OK;
+
+    dfa_clear_cache(dfa);
+    dfa->rd_valid = FALSE;
+    dfa->rd_ic = rex->reg_ic;
+    dfa->rd_enc = enc;
+    mch_memmove(dfa->rd_chartab, rex->reg_buf->b_chartab,
+						     sizeof(dfa->rd_chartab));
+    dfa_find_consume(dfa, prog);
+
+    // The signature of a character is a bit for each NFA state that
+    // consumes a character, telling whether it matches.  Characters with
+    // the same signature, class and NUL-ness can share the transitions.
+    nbytes = (dfa->rd_nconsume + 7) / 8;
+    sigs = alloc_clear(256 * nbytes + 1);
+    if (sigs == NULL)
+	return FAIL;
+
+    dfa->rd_nclasses = 0;
+    for (c = 0; c < 256; ++c)
+    {
+	if (!dfa_cached_char(c))
+	{
+	    dfa->rd_byteclass[c] = 0;
+	    dfa->rd_charclass[c] = 0;
+	    continue;
+	}
+	if (enc_utf8)
+	    buf[utf_char2bytes(c, buf)] = NUL;
+	else
+	{
+	    buf[0] = c;
+	    buf[1] = NUL;
+	}
+	dfa->rd_charclass[c] = dfa->rd_use_class
+				     ? mb_get_class_buf(buf, rex->reg_buf) : 0;
+
+	sig = sigs + c * nbytes;
+	for (i = 0; i < dfa->rd_nconsume; ++i)
+	    if (dfa_char_matches(&prog->state[dfa->rd_consume[i]], c, buf))
+		sig[i / 8] |= 1 << (i % 8);
+
+	// NUL is always in a class by itself.
+	for (i = 1; i < c; ++i)
+	    if (dfa_cached_char(i)
+		    && dfa->rd_charclass[i] == dfa->rd_charclass[c]
+		    && memcmp(sigs + i * nbytes, sig, nbytes) == 0)
+		break;
+	if (c > 0 && i < c)
+	    dfa->rd_byteclass[c] = dfa->rd_byteclass[i];
+	else
+	    dfa->rd_byteclass[c] = dfa->rd_nclasses++;
+    }
+    vim_free(sigs);
+
+    dfa->rd_valid = TRUE;
+    return OK;
+}
+
+/*
+ * Find the state with kernel "kernel[nkernel]" and previous character class
+ * "prev_class" in the cache.  Add it when it's not there yet.
+ * Returns NULL when out of memory.
+ */
+    static dfa_state_T *
+dfa_find_state(
+	regdfa_T    *dfa,
+	int	    *kernel,
+	int	    nkernel,
+	int	    prev_class)
+{
+    unsigned	hash = 2166136261u;
+    dfa_state_T	*ds;
+    dfa_state_T	**bucket;
+    size_t	size;
+    int		i;
+
+    hash = (hash ^ (unsigned)prev_class) * 16777619u;
+    for (i = 0; i < nkernel; ++i)
+	hash = (hash ^ (unsigned)kernel[i]) * 16777619u;
+
+    bucket = &dfa->rd_buckets[hash % dfa->rd_nbuckets];
+    for (ds = *bucket; ds != NULL; ds = ds->ds_hash_next)
+	if (ds->ds_hash == hash && ds->ds_prev_class == prev_class
+		&& ds->ds_nkernel == nkernel
+		&& (nkernel == 0 || memcmp(ds->ds_kernel, kernel,
+						    nkernel * sizeof(int)) == 0))
+	    return ds;
+
+    size = sizeof(dfa_state_T) + dfa->rd_nclasses * sizeof(dfa_state_T *)
+						       + nkernel * sizeof(int);
+    if (dfa->rd_mem + (long)size > DFA_MAX_MEM)
+    {
+	// Cache is full, start all over.  The caller must not use any
+	// state it got before.
+	dfa_clear_cache(dfa);
+	++dfa->rd_flushed;
+    }
+    ds = alloc_clear(size);
+    if (ds == NULL)
+	return NULL;
+    dfa->rd_mem += (long)size;
+    ds->ds_hash = hash;
+    ds->ds_prev_class = prev_class;
+    ds->ds_nkernel = nkernel;
+    ds->ds_next = (dfa_state_T **)(ds + 1);
+    ds->ds_kernel = (int *)(ds->ds_next + dfa->rd_nclasses);
+    if (nkernel > 0)
+	mch_memmove(ds->ds_kernel, kernel, nkernel * sizeof(int));
+    ds->ds_hash_next = *bucket;
+    *bucket = ds;
+    return ds;
+}
+
+    static int
+dfa_int_cmp(const void *a, const void *b)
+{
+    return *(int *)a - *(int *)b;
+}
+
+/*
+ * Compute the state that follows "ds" for character "curc" at "p", of class
+ * "cur_class".  Returns DFA_MATCH_STATE when there is a match before "curc".
+ * Returns NULL when out of memory.
+ */
+    static dfa_state_T *
+dfa_next_state(
+	regdfa_T	*dfa,
+	nfa_regprog_T	*prog,
+	dfa_state_T	*ds,
+	int		curc,
+	char_u		*p,
+	int		cur_class)
+{
+    int		    prev_class = ds->ds_prev_class;
+    int		    sp = 0;
+    int		    nwork = 0;
+    int		    i;
+    nfa_state_T	    *state;
+    nfa_state_T	    *next;
+
+    ++dfa->rd_gen;
+
+    // A match can start at every position, thus always add the start state.
+    dfa->rd_stack[sp++] = (int)(prog->start - prog->state);
+    for (i = 0; i < ds->ds_nkernel; ++i)
+	dfa->rd_stack[sp++] = ds->ds_kernel[i];
+
+    while (sp > 0)
+    {
+	i = dfa->rd_stack[--sp];
+	if (dfa->rd_mark[i] == dfa->rd_gen)
+	    continue;
+	dfa->rd_mark[i] = dfa->rd_gen;
+	state = &prog->state[i];
+	next = NULL;
+
+	switch (state->c)
+	{
+	    case NFA_MATCH:
+		return DFA_MATCH_STATE;
+
+	    case NFA_SPLIT:
+		dfa->rd_stack[sp++] = (int)(state->out1 - prog->state);
+		next = state->out;
+		break;
+
+	    case NFA_BOL:
+		if (prev_class == -1)
+		    next = state->out;
+		break;
+
+	    case NFA_EOL:
+		if (curc == NUL)
+		    next = state->out;
+		break;
+
+	    case NFA_BOW:
+		if (cur_class > 1 && prev_class != cur_class)
+		    next = state->out;
+		break;
+
+	    case NFA_EOW:
+		if (prev_class > 1 && cur_class != prev_class)
+		    next = state->out;
+		break;
+
+	    default:
+		if (dfa_state_consumes(state->c))
+		{
+		    if (dfa_char_matches(state, curc, p))
+		    {
+			int j = (int)(dfa_state_after(state) - prog->state);
+
+			if (dfa->rd_mark_next[j] != dfa->rd_gen)
+			{
+			    dfa->rd_mark_next[j] = dfa->rd_gen;
+			    dfa->rd_work[nwork++] = j;
+			}
+		    }
+		}
+		else
+		    // other zero-width items: submatches, \zs, \ze
+		    next = state->out;
+		break;
+	}
+	if (next != NULL)
+	    dfa->rd_stack[sp++] = (int)(next - prog->state);
+    }
+
+    if (nwork > 1)
+	qsort(dfa->rd_work, (size_t)nwork, sizeof(int), dfa_int_cmp);
+    return dfa_find_state(dfa, dfa->rd_work, nwork,
+				      dfa->rd_use_class ? cur_class : 0);
+}
+
+/*
+ * Find out if "prog" matches in "rex->line" at or after column "col".
+ * Must be called from nfa_regexec_both(), after "rex" was set up.
+ * Returns DFA_MATCH, DFA_NOMATCH or DFA_UNKNOWN.
+ */
+    static int
+dfa_regexec(nfa_regprog_T *prog, colnr_T col)
+{
+    regdfa_T	*dfa = prog->dfa;
+    dfa_state_T	*ds;
+    dfa_state_T	*next;
+    char_u	*p = rex->line + col;
+    int		flushed;
+    int		curc;
+    int		len;
+    int		bc;
+
+    if (prog->no_dfa || rex->reg_icombine)
+	return DFA_UNKNOWN;
+    if (dfa == NULL)
+    {
+	dfa = prog->dfa = dfa_new(prog);
+	if (dfa == NULL)
+	{
+	    prog->no_dfa = TRUE;
+	    return DFA_UNKNOWN;
+	}
+    }
+    if (dfa_setup(dfa, prog) == FAIL)
+	return DFA_UNKNOWN;
+
+    flushed = dfa->rd_flushed;
+    if (col == 0)
+    {
+	if (dfa->rd_start == NULL)
+	    dfa->rd_start = dfa_find_state(dfa, NULL, 0, -1);
+	ds = dfa->rd_start;
+    }
+    else
+	ds = dfa_find_state(dfa, NULL, 0, !dfa->rd_use_class ? 0
+		: mb_get_class_buf(p - 1 - (*mb_head_off)(rex->line, p - 1),
+								rex->reg_buf));
+    if (ds == NULL)
+	return DFA_UNKNOWN;
+
+    for (;;)
+    {
+	curc = *p;
+	len = 1;
+	if (curc >= 0x80 && has_mbyte)
+	{
+	    if (enc_utf8)
+	    {
+		curc = utf_ptr2char(p);
+		len = utf_ptr2len(p);
+		// Illegal bytes and composing characters are not matched
+		// the same way by every item.
+		if (len == 1 || utf_iscomposing(curc))
+		    return DFA_UNKNOWN;
+	    }
+	    else
+	    {
+		curc = (*mb_ptr2char)(p);
+		len = (*mb_ptr2len)(p);
+	    }
+	}
+
+	if (curc < 256 && dfa_cached_char(curc))
+	{
+	    bc = dfa->rd_byteclass[curc];
+	    next = ds->ds_next[bc];
+	    if (next == NULL)
+	    {
+		int before = dfa->rd_flushed;
+
+		next = dfa_next_state(dfa, prog, ds, curc, p,
+						   dfa->rd_charclass[curc]);
+		// when the cache was cleared "ds" was freed
+		if (next != NULL && dfa->rd_flushed == before)
+		    ds->ds_next[bc] = next;
+	    }
+	}
+	else
+	    next = dfa_next_state(dfa, prog, ds, curc, p,
+		    dfa->rd_use_class ? mb_get_class_buf(p, rex->reg_buf) : 0);
+
+	if (next == DFA_MATCH_STATE)
+	    return DFA_MATCH;
+	if (next == NULL)
+	    return DFA_UNKNOWN;
+	if (curc == NUL)
+	    return DFA_NOMATCH;
+	if (dfa->rd_flushed - flushed > DFA_MAX_FLUSH)
+	{
+	    // Too many different states for the cache, the DFA is not
+	    // faster than nfa_regmatch() for this pattern.
+	    if (++dfa->rd_failed >= DFA_MAX_FAIL)
+	    {
+		prog->no_dfa = TRUE;
+		dfa_free(dfa);
+		prog->dfa = NULL;
+	    }
+	    return DFA_UNKNOWN;
+	}
+	// When the pattern starts with "^" a match can't start after the
+	// first character.
+	if (prog->reganch && next->ds_nkernel == 0)
+	    return DFA_NOMATCH;
+
+	ds = next;
+	p += len;
+    }
+}
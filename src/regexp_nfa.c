@@ -256,12 +256,6 @@ static int *post_ptr;
 static int nstate;	// Number of states in the NFA.
 static int istate;	// Index in the state vector, used in alloc_state()
 
-// If not NULL match must end at this position
-static save_se_T *nfa_endp = NULL;
-
-// 0 for first call to nfa_regmatch(), 1 for recursive call.
-static int nfa_ll_index = 0;
-
 static int realloc_post_list(void);
 static int nfa_reg(int paren);
 #ifdef DEBUG
@@ -270,6 +264,13 @@ static void nfa_print_state2(FILE *debugf, nfa_state_T *state, garray_T *indent)
 static int match_follows(nfa_state_T *startstate, int depth);
 static int failure_chance(nfa_state_T *state, int depth);
 
+// Defined in regexp_dfa.c
+#define DFA_NOMATCH	0	// there is no match in the line
+#define DFA_MATCH	1	// there is a match in the line
+#define DFA_UNKNOWN	2	// can't tell, use nfa_regmatch()
+static int dfa_regexec(nfa_regprog_T *prog, colnr_T col);
+static void dfa_free(struct regdfa_S *dfa);
+
 // helper functions used when doing re2post() ... regatom() parsing
 #define EMIT(c)	do {				\
 		    if (post_ptr >= post_end && realloc_post_list() == FAIL) \
@@ -306,8 +307,8 @@ nfa_regcomp_start(
 	return FAIL;
     post_ptr = post_start;
     post_end = post_start + nstate_max;
-    rex.nfa_has_zend = FALSE;
-    rex.nfa_has_backref = FALSE;
+    rex->nfa_has_zend = FALSE;
+    rex->nfa_has_backref = FALSE;
 
     // shared with BT engine
     regcomp_start(expr, re_flags);
@@ -460,6 +461,126 @@ nfa_get_regstart(nfa_state_T *start, int depth)
     return 0;
 }
 
+/*
+ * Add ASCII character "c" to "map", in upper and lower case.
+ * Does nothing for a non-ASCII character.
+ */
+    static void
+nfa_startmap_add(char_u *map, int c)
+{
+    if (c >= 0x80)
+	return;
+    map[c >> 3] |= 1 << (c & 7);
+    map[TOUPPER_ASC(c) >> 3] |= 1 << (TOUPPER_ASC(c) & 7);
+    map[TOLOWER_ASC(c) >> 3] |= 1 << (TOLOWER_ASC(c) & 7);
+}
+
+/*
+ * Add the bytes that a match starting with state "start" can start with to
+ * "map".  Used when there is no single "regstart" character, e.g. for a list
+ * of alternatives.  Both cases of ASCII letters are added, so that the map
+ * can be used with and without ignoring case.  Non-ASCII characters and
+ * letters, which may match a non-ASCII character when ignoring case, add all
+ * bytes from 0x80.  A non-ASCII character that folds to ASCII also adds the
+ * ASCII letter.
+ * Returns FAIL when any byte may start a match.
+ */
+    static int
+nfa_get_startmap(nfa_state_T *start, char_u *map, int depth, int *count)
+{
+    nfa_state_T *p = start;
+    int		c;
+
+    if (depth > 10)
+	return FAIL;
+
+    while (p != NULL)
+    {
+	// avoid spending too much time on a complicated pattern
+	if (++*count > 2000)
+	    return FAIL;
+
+	switch (p->c)
+	{
+	    // all kinds of zero-width matches
+	    case NFA_BOL:
+	    case NFA_BOF:
+	    case NFA_BOW:
+	    case NFA_EOW:
+	    case NFA_ZSTART:
+	    case NFA_ZEND:
+	    case NFA_CURSOR:
+	    case NFA_VISUAL:
+	    case NFA_LNUM:
+	    case NFA_LNUM_GT:
+	    case NFA_LNUM_LT:
+	    case NFA_COL:
+	    case NFA_COL_GT:
+	    case NFA_COL_LT:
+	    case NFA_VCOL:
+	    case NFA_VCOL_GT:
+	    case NFA_VCOL_LT:
+	    case NFA_MARK:
+	    case NFA_MARK_GT:
+	    case NFA_MARK_LT:
+	    case NFA_EMPTY:
+
+	    case NFA_MOPEN:
+	    case NFA_MOPEN1:
+	    case NFA_MOPEN2:
+	    case NFA_MOPEN3:
+	    case NFA_MOPEN4:
+	    case NFA_MOPEN5:
+	    case NFA_MOPEN6:
+	    case NFA_MOPEN7:
+	    case NFA_MOPEN8:
+	    case NFA_MOPEN9:
+	    case NFA_NOPEN:
+#ifdef FEAT_SYN_HL
+	    case NFA_ZOPEN:
+	    case NFA_ZOPEN1:
+	    case NFA_ZOPEN2:
+	    case NFA_ZOPEN3:
+	    case NFA_ZOPEN4:
+	    case NFA_ZOPEN5:
+	    case NFA_ZOPEN6:
+	    case NFA_ZOPEN7:
+	    case NFA_ZOPEN8:
+	    case NFA_ZOPEN9:
+#endif
+		p = p->out;
+		break;
+
+	    case NFA_SPLIT:
+		if (nfa_get_startmap(p->out, map, depth + 1, count) == FAIL)
+		    return FAIL;
+		p = p->out1;
+		break;
+
+	    default:
+		// Anything else than a plain character, such as a class or a
+		// zero-width match, may start with any byte.
+		if (p->c <= 0)
+		    return FAIL;
+		c = p->c;
+		if (c >= 0x80 || ASCII_ISALPHA(c))
+		    vim_memset(map + 0x10, 0xff, 0x10);
+		if (c >= 0x80 && enc_utf8)
+		{
+		    // A few characters match an ASCII letter when ignoring
+		    // case, e.g. the Kelvin sign matches "k".
+		    nfa_startmap_add(map, utf_fold(c));
+		    nfa_startmap_add(map, utf_tolower(c));
+		    nfa_startmap_add(map, utf_toupper(c));
+		}
+		else
+		    nfa_startmap_add(map, c);
+		return OK;
+	}
+    }
+    return FAIL;
+}
+
 /*
  * Figure out if the NFA state list contains just literal text and nothing
  * else.  If so return a string in allocated memory with what must match after
@@ -502,6 +623,145 @@ nfa_get_match_text(nfa_state_T *start)
     return ret;
 }
 
+/*
+ * Return TRUE if state "p" matches exactly one character.
+ */
+    static int
+nfa_is_one_char(nfa_state_T *p)
+{
+    return (p->c > 0 && p->c < 0x80)
+	    || (p->c >= NFA_ANY && p->c <= NFA_NUPPER_IC)
+	    || p->c == NFA_START_COLL || p->c == NFA_START_NEG_COLL;
+}
+
+/*
+ * Return the state following "p", for which nfa_is_one_char() is TRUE.
+ */
+    static nfa_state_T *
+nfa_skip_one_char(nfa_state_T *p)
+{
+    if (p->c == NFA_START_COLL || p->c == NFA_START_NEG_COLL)
+	return p->out1->out;  // skip over NFA_END_COLL
+    return p->out;
+}
+
+/*
+ * Find the longest run of ASCII characters that any match of "prog" must
+ * contain.  Only follows the states that every match goes through, stops at
+ * alternatives, repeated groups and anything complicated.  A repeated single
+ * character item, such as ".*", is skipped.
+ * Returns NULL when there is no such text or the pattern may match a line
+ * break.  Otherwise returns the text in allocated memory and sets "*lenp".
+ */
+    static char_u *
+nfa_get_must_text(nfa_regprog_T *prog, int *lenp)
+{
+    nfa_state_T *p = prog->start;
+    nfa_state_T *q;
+    nfa_state_T *run = NULL;
+    nfa_state_T *best = NULL;
+    int		runlen = 0;
+    int		bestlen = 0;
+    int		i;
+    char_u	*ret;
+
+    for (i = 0; i < prog->nstate; ++i)
+	if (prog->state[i].c == NFA_NEWL
+		|| (prog->state[i].c >= NFA_FIRST_NL
+					&& prog->state[i].c <= NFA_LAST_NL))
+	    return NULL;
+
+    while (p != NULL)
+    {
+	if (p->c > 0 && p->c < 0x80)
+	{
+	    if (runlen == 0)
+		run = p;
+	    if (++runlen >= bestlen)
+	    {
+		best = run;
+		bestlen = runlen;
+	    }
+	    p = p->out;
+	    continue;
+	}
+
+	switch (p->c)
+	{
+	    // zero-width items don't break up a run of characters
+	    case NFA_EMPTY:
+	    case NFA_BOL:
+	    case NFA_EOL:
+	    case NFA_BOW:
+	    case NFA_EOW:
+	    case NFA_BOF:
+	    case NFA_EOF:
+	    case NFA_ZSTART:
+	    case NFA_ZEND:
+	    case NFA_NOPEN:
+	    case NFA_NCLOSE:
+	    case NFA_MOPEN:
+	    case NFA_MOPEN1:
+	    case NFA_MOPEN2:
+	    case NFA_MOPEN3:
+	    case NFA_MOPEN4:
+	    case NFA_MOPEN5:
+	    case NFA_MOPEN6:
+	    case NFA_MOPEN7:
+	    case NFA_MOPEN8:
+	    case NFA_MOPEN9:
+	    case NFA_MCLOSE:
+	    case NFA_MCLOSE1:
+	    case NFA_MCLOSE2:
+	    case NFA_MCLOSE3:
+	    case NFA_MCLOSE4:
+	    case NFA_MCLOSE5:
+	    case NFA_MCLOSE6:
+	    case NFA_MCLOSE7:
+	    case NFA_MCLOSE8:
+	    case NFA_MCLOSE9:
+		p = p->out;
+		break;
+
+	    case NFA_SPLIT:
+		// Skip over a repeated single character item.
+		runlen = 0;
+		q = p->out;
+		if (q != NULL && nfa_is_one_char(q)
+						 && nfa_skip_one_char(q) == p)
+		    p = p->out1;
+		else if ((q = p->out1) != NULL && nfa_is_one_char(q)
+						 && nfa_skip_one_char(q) == p)
+		    p = p->out;
+		else
+		    p = NULL;
+		break;
+
+	    default:
+		runlen = 0;
+		if (nfa_is_one_char(p))
+		    p = nfa_skip_one_char(p);
+		else
+		    p = NULL;
+		break;
+	}
+    }
+
+    if (bestlen == 0)
+	return NULL;
+    ret = alloc(bestlen + 1);
+    if (ret != NULL)
+    {
+	for (i = 0; i < bestlen; best = best->out)
+	    // skip zero-width items
+	    if (best->c > 0 && best->c < 0x80)
+		ret[i++] = best->c;
+	ret[bestlen] = NUL;
+	*lenp = bestlen;
+    }
+    return ret;
+}
+
 /*
  * Allocate more space for post_start.  Called when
  * running above the estimated number of states.
@@ -1394,7 +1654,7 @@ nfa_regatom(void)
 		if (!seen_endbrace(refnum + 1))
 		    return FAIL;
 		EMIT(NFA_BACKREF1 + refnum);
-		rex.nfa_has_backref = TRUE;
+		rex->nfa_has_backref = TRUE;
 	    }
 	    break;
 
@@ -1409,7 +1669,7 @@ nfa_regatom(void)
 		    break;
 		case 'e':
 		    EMIT(NFA_ZEND);
-		    rex.nfa_has_zend = TRUE;
+		    rex->nfa_has_zend = TRUE;
 		    if (re_mult_next("\\ze") == FAIL)
 			return FAIL;
 		    break;
@@ -1427,8 +1687,8 @@ nfa_regatom(void)
 		    if ((reg_do_extmatch & REX_USE) == 0)
 			EMSG_RET_FAIL(_(e_z1_not_allowed));
 		    EMIT(NFA_ZREF1 + (no_Magic(c) - '1'));
-		    // No need to set rex.nfa_has_backref, the sub-matches don't
-		    // change when \z1 .. \z9 matches or not.
+		    // No need to set rex->nfa_has_backref, the sub-matches
+		    // don't change when \z1 .. \z9 matches or not.
 		    re_has_z = REX_USE;
 		    break;
 		case '(':
@@ -3788,10 +4048,12 @@ typedef struct
     // When REG_MULTI is TRUE list.multi is used, otherwise list.line.
     union
     {
+	// The line numbers are relative to "reg_firstlnum", an int is
+	// sufficient and keeps the threads small.
 	struct multipos
 	{
-	    linenr_T	start_lnum;
-	    linenr_T	end_lnum;
+	    int		start_lnum;
+	    int		end_lnum;
 	    colnr_T	start_col;
 	    colnr_T	end_col;
 	} multi[NSUBEXP];
@@ -3833,7 +4095,7 @@ struct nfa_pim_S
 
 
 // nfa_thread_T contains execution information of a NFA state
-typedef struct
+typedef struct nfa_thread_S
 {
     nfa_state_T	*state;
     int		count;
@@ -3860,7 +4122,7 @@ log_subsexpr(regsubs_T *subs)
 {
     log_subexpr(&subs->norm);
 # ifdef FEAT_SYN_HL
-    if (rex.nfa_has_zsubexpr)
+    if (rex->nfa_has_zsubexpr)
 	log_subexpr(&subs->synt);
 # endif
 }
@@ -3900,21 +4162,13 @@ pim_info(nfa_pim_T *pim)
     else
     {
 	sprintf(buf, " PIM col %d", REG_MULTI ? (int)pim->end.pos.col
-		: (int)(pim->end.ptr - rex.input));
+		: (int)(pim->end.ptr - rex->input));
     }
     return buf;
 }
 
 #endif
 
-// Used during execution: whether a match has been found.
-static int	    nfa_match;
-#ifdef FEAT_RELTIME
-static proftime_T  *nfa_time_limit;
-static int	   *nfa_timed_out;
-static int	    nfa_time_count;
-#endif
-
 static void copy_sub(regsub_T *to, regsub_T *from);
 static int pim_equal(nfa_pim_T *one, nfa_pim_T *two);
 
@@ -3928,7 +4182,7 @@ copy_pim(nfa_pim_T *to, nfa_pim_T *from)
     to->state = from->state;
     copy_sub(&to->subs.norm, &from->subs.norm);
 #ifdef FEAT_SYN_HL
-    if (rex.nfa_has_zsubexpr)
+    if (rex->nfa_has_zsubexpr)
 	copy_sub(&to->subs.synt, &from->subs.synt);
 #endif
     to->end = from->end;
@@ -3940,10 +4194,10 @@ clear_sub(regsub_T *sub)
     if (REG_MULTI)
 	// Use 0xff to set lnum to -1
 	vim_memset(sub->list.multi, 0xff,
-				  sizeof(struct multipos) * rex.nfa_nsubexpr);
+				  sizeof(struct multipos) * rex->nfa_nsubexpr);
     else
 	vim_memset(sub->list.line, 0,
-				   sizeof(struct linepos) * rex.nfa_nsubexpr);
+				   sizeof(struct linepos) * rex->nfa_nsubexpr);
     sub->in_use = 0;
 }
 
@@ -3996,7 +4250,7 @@ copy_sub_off(regsub_T *to, regsub_T *from)
     static void
 copy_ze_off(regsub_T *to, regsub_T *from)
 {
-    if (rex.nfa_has_zend)
+    if (rex->nfa_has_zend)
     {
 	if (REG_MULTI)
 	{
@@ -4047,7 +4301,7 @@ sub_equal(regsub_T *sub1, regsub_T *sub2)
 					     != sub2->list.multi[i].start_col)
 		return FALSE;
 
-	    if (rex.nfa_has_backref)
+	    if (rex->nfa_has_backref)
 	    {
 		if (i < sub1->in_use)
 		    s1 = sub1->list.multi[i].end_lnum;
@@ -4079,7 +4333,7 @@ sub_equal(regsub_T *sub1, regsub_T *sub2)
 		sp2 = NULL;
 	    if (sp1 != sp2)
 		return FALSE;
-	    if (rex.nfa_has_backref)
+	    if (rex->nfa_has_backref)
 	    {
 		if (i < sub1->in_use)
 		    sp1 = sub1->list.line[i].end;
@@ -4113,7 +4367,7 @@ report_state(char *action,
     else if (REG_MULTI)
 	col = sub->list.multi[0].start_col;
     else
-	col = (int)(sub->list.line[0].start - rex.line);
+	col = (int)(sub->list.line[0].start - rex->line);
     nfa_set_code(state->c);
     fprintf(log_fd, "> %s state %d to list %d. char %d: %s (start col %d)%s\n",
 	    action, abs(state->id), lid, state->c, code, col,
@@ -4141,7 +4395,7 @@ has_state_with_pos(
 	if (thread->state->id == state->id
 		&& sub_equal(&thread->subs.norm, &subs->norm)
 #ifdef FEAT_SYN_HL
-		&& (!rex.nfa_has_zsubexpr
+		&& (!rex->nfa_has_zsubexpr
 				|| sub_equal(&thread->subs.synt, &subs->synt))
 #endif
 		&& pim_equal(&thread->pim, pim))
@@ -4278,9 +4532,9 @@ state_in_list(
     nfa_state_T		*state,	// state to update
     regsubs_T		*subs)	// pointers to subexpressions
 {
-    if (state->lastlist[nfa_ll_index] == l->id)
+    if (state->lastlist[rex->nfa_ll_index] == l->id)
     {
-	if (!rex.nfa_has_backref || has_state_with_pos(l, state, subs, NULL))
+	if (!rex->nfa_has_backref || has_state_with_pos(l, state, subs, NULL))
 	    return TRUE;
     }
     return FALSE;
@@ -4374,11 +4628,11 @@ addstate(
 	    // "^" won't match past end-of-line, don't bother trying.
 	    // Except when at the end of the line, or when we are going to the
 	    // next line for a look-behind match.
-	    if (rex.input > rex.line
-		    && *rex.input != NUL
-		    && (nfa_endp == NULL
+	    if (rex->input > rex->line
+		    && *rex->input != NUL
+		    && (rex->nfa_endp == NULL
 			|| !REG_MULTI
-			|| rex.lnum == nfa_endp->se_u.pos.lnum))
+			|| rex->lnum == rex->nfa_endp->se_u.pos.lnum))
 		goto skip_add;
 	    // FALLTHROUGH
 
@@ -4410,13 +4664,14 @@ addstate(
 	    // endless loop for "\(\)*"
 
 	default:
-	    if (state->lastlist[nfa_ll_index] == l->id && state->c != NFA_SKIP)
+	    if (state->lastlist[rex->nfa_ll_index] == l->id
+						       && state->c != NFA_SKIP)
 	    {
 		// This state is already in the list, don't add it again,
 		// unless it is an MOPEN that is used for a backreference or
 		// when there is a PIM. For NFA_MATCH check the position,
 		// lower position is preferred.
-		if (!rex.nfa_has_backref && pim == NULL && !l->has_pim
+		if (!rex->nfa_has_backref && pim == NULL && !l->has_pim
 						     && state->c != NFA_MATCH)
 		{
 		    // When called from addstate_here() do insert before
@@ -4470,7 +4725,7 @@ skip_add:
 		    // copy before it becomes invalid.
 		    copy_sub(&temp_subs.norm, &subs->norm);
 #ifdef FEAT_SYN_HL
-		    if (rex.nfa_has_zsubexpr)
+		    if (rex->nfa_has_zsubexpr)
 			copy_sub(&temp_subs.synt, &subs->synt);
 #endif
 		    subs = &temp_subs;
@@ -4488,7 +4743,7 @@ skip_add:
 	    }
 
 	    // add the state to the list
-	    state->lastlist[nfa_ll_index] = l->id;
+	    state->lastlist[rex->nfa_ll_index] = l->id;
 	    thread = &l->t[l->n++];
 	    thread->state = state;
 	    if (pim == NULL)
@@ -4500,7 +4755,7 @@ skip_add:
 	    }
 	    copy_sub(&thread->subs.norm, &subs->norm);
 #ifdef FEAT_SYN_HL
-	    if (rex.nfa_has_zsubexpr)
+	    if (rex->nfa_has_zsubexpr)
 		copy_sub(&thread->subs.synt, &subs->synt);
 #endif
 #ifdef ENABLE_LOG
@@ -4596,14 +4851,14 @@ skip_add:
 		}
 		if (off == -1)
 		{
-		    sub->list.multi[subidx].start_lnum = rex.lnum + 1;
+		    sub->list.multi[subidx].start_lnum = rex->lnum + 1;
 		    sub->list.multi[subidx].start_col = 0;
 		}
 		else
 		{
-		    sub->list.multi[subidx].start_lnum = rex.lnum;
+		    sub->list.multi[subidx].start_lnum = rex->lnum;
 		    sub->list.multi[subidx].start_col =
-					  (colnr_T)(rex.input - rex.line + off);
+				       (colnr_T)(rex->input - rex->line + off);
 		}
 		sub->list.multi[subidx].end_lnum = -1;
 	    }
@@ -4624,7 +4879,7 @@ skip_add:
 		    }
 		    sub->in_use = subidx + 1;
 		}
-		sub->list.line[subidx].start = rex.input + off;
+		sub->list.line[subidx].start = rex->input + off;
 	    }
 
 	    subs = addstate(l, state->out, subs, pim, off_arg);
@@ -4650,7 +4905,7 @@ skip_add:
 	    break;
 
 	case NFA_MCLOSE:
-	    if (rex.nfa_has_zend && (REG_MULTI
+	    if (rex->nfa_has_zend && (REG_MULTI
 			? subs->norm.list.multi[0].end_lnum >= 0
 			: subs->norm.list.line[0].end != NULL))
 	    {
@@ -4709,14 +4964,14 @@ skip_add:
 		save_multipos = sub->list.multi[subidx];
 		if (off == -1)
 		{
-		    sub->list.multi[subidx].end_lnum = rex.lnum + 1;
+		    sub->list.multi[subidx].end_lnum = rex->lnum + 1;
 		    sub->list.multi[subidx].end_col = 0;
 		}
 		else
 		{
-		    sub->list.multi[subidx].end_lnum = rex.lnum;
+		    sub->list.multi[subidx].end_lnum = rex->lnum;
 		    sub->list.multi[subidx].end_col =
-					  (colnr_T)(rex.input - rex.line + off);
+				       (colnr_T)(rex->input - rex->line + off);
 		}
 		// avoid compiler warnings
 		save_ptr = NULL;
@@ -4724,7 +4979,7 @@ skip_add:
 	    else
 	    {
 		save_ptr = sub->list.line[subidx].end;
-		sub->list.line[subidx].end = rex.input + off;
+		sub->list.line[subidx].end = rex->input + off;
 		// avoid compiler warnings
 		CLEAR_FIELD(save_multipos);
 	    }
@@ -4957,13 +5212,13 @@ retempty:
 	if (sub->list.multi[subidx].start_lnum < 0
 				       || sub->list.multi[subidx].end_lnum < 0)
 	    goto retempty;
-	if (sub->list.multi[subidx].start_lnum == rex.lnum
-			       && sub->list.multi[subidx].end_lnum == rex.lnum)
+	if (sub->list.multi[subidx].start_lnum == rex->lnum
+			       && sub->list.multi[subidx].end_lnum == rex->lnum)
 	{
 	    len = sub->list.multi[subidx].end_col
 					  - sub->list.multi[subidx].start_col;
-	    if (cstrncmp(rex.line + sub->list.multi[subidx].start_col,
-							 rex.input, &len) == 0)
+	    if (cstrncmp(rex->line + sub->list.multi[subidx].start_col,
+							 rex->input, &len) == 0)
 	    {
 		*bytelen = len;
 		return TRUE;
@@ -4986,7 +5241,7 @@ retempty:
 					|| sub->list.line[subidx].end == NULL)
 	    goto retempty;
 	len = (int)(sub->list.line[subidx].end - sub->list.line[subidx].start);
-	if (cstrncmp(sub->list.line[subidx].start, rex.input, &len) == 0)
+	if (cstrncmp(sub->list.line[subidx].start, rex->input, &len) == 0)
 	{
 	    *bytelen = len;
 	    return TRUE;
@@ -5017,7 +5272,7 @@ match_zref(
     }
 
     len = (int)STRLEN(re_extmatch_in->matches[subidx]);
-    if (cstrncmp(re_extmatch_in->matches[subidx], rex.input, &len) == 0)
+    if (cstrncmp(re_extmatch_in->matches[subidx], rex->input, &len) == 0)
     {
 	*bytelen = len;
 	return TRUE;
@@ -5089,11 +5344,11 @@ recursive_regmatch(
     int		    **listids,
     int		    *listids_len)
 {
-    int		save_reginput_col = (int)(rex.input - rex.line);
-    int		save_reglnum = rex.lnum;
-    int		save_nfa_match = nfa_match;
-    int		save_nfa_listid = rex.nfa_listid;
-    save_se_T   *save_nfa_endp = nfa_endp;
+    int		save_reginput_col = (int)(rex->input - rex->line);
+    int		save_reglnum = rex->lnum;
+    int		save_nfa_match = rex->nfa_match;
+    int		save_nfa_listid = rex->nfa_listid;
+    save_se_T   *save_nfa_endp = rex->nfa_endp;
     save_se_T   endpos;
     save_se_T   *endposp = NULL;
     int		result;
@@ -5103,9 +5358,9 @@ recursive_regmatch(
     {
 	// start at the position where the postponed match was
 	if (REG_MULTI)
-	    rex.input = rex.line + pim->end.pos.col;
+	    rex->input = rex->line + pim->end.pos.col;
 	else
-	    rex.input = pim->end.ptr;
+	    rex->input = pim->end.ptr;
     }
 
     if (state->c == NFA_START_INVISIBLE_BEFORE
@@ -5120,8 +5375,8 @@ recursive_regmatch(
 	{
 	    if (pim == NULL)
 	    {
-		endpos.se_u.pos.col = (int)(rex.input - rex.line);
-		endpos.se_u.pos.lnum = rex.lnum;
+		endpos.se_u.pos.col = (int)(rex->input - rex->line);
+		endpos.se_u.pos.lnum = rex->lnum;
 	    }
 	    else
 		endpos.se_u.pos = pim->end.pos;
@@ -5129,7 +5384,7 @@ recursive_regmatch(
 	else
 	{
 	    if (pim == NULL)
-		endpos.se_u.ptr = rex.input;
+		endpos.se_u.ptr = rex->input;
 	    else
 		endpos.se_u.ptr = pim->end.ptr;
 	}
@@ -5142,37 +5397,37 @@ recursive_regmatch(
 	{
 	    if (REG_MULTI)
 	    {
-		rex.line = reg_getline(--rex.lnum);
-		if (rex.line == NULL)
+		rex->line = reg_getline(--rex->lnum);
+		if (rex->line == NULL)
 		    // can't go before the first line
-		    rex.line = reg_getline(++rex.lnum);
+		    rex->line = reg_getline(++rex->lnum);
 	    }
-	    rex.input = rex.line;
+	    rex->input = rex->line;
 	}
 	else
 	{
-	    if (REG_MULTI && (int)(rex.input - rex.line) < state->val)
+	    if (REG_MULTI && (int)(rex->input - rex->line) < state->val)
 	    {
 		// Not enough bytes in this line, go to end of
 		// previous line.
-		rex.line = reg_getline(--rex.lnum);
-		if (rex.line == NULL)
+		rex->line = reg_getline(--rex->lnum);
+		if (rex->line == NULL)
 		{
 		    // can't go before the first line
-		    rex.line = reg_getline(++rex.lnum);
-		    rex.input = rex.line;
+		    rex->line = reg_getline(++rex->lnum);
+		    rex->input = rex->line;
 		}
 		else
-		    rex.input = rex.line + STRLEN(rex.line);
+		    rex->input = rex->line + STRLEN(rex->line);
 	    }
-	    if ((int)(rex.input - rex.line) >= state->val)
+	    if ((int)(rex->input - rex->line) >= state->val)
 	    {
-		rex.input -= state->val;
+		rex->input -= state->val;
 		if (has_mbyte)
-		    rex.input -= mb_head_off(rex.line, rex.input);
+		    rex->input -= mb_head_off(rex->line, rex->input);
 	    }
 	    else
-		rex.input = rex.line;
+		rex->input = rex->line;
 	}
     }
 
@@ -5183,7 +5438,7 @@ recursive_regmatch(
 #endif
     // Have to clear the lastlist field of the NFA nodes, so that
     // nfa_regmatch() and addstate() can run properly after recursion.
-    if (nfa_ll_index == 1)
+    if (rex->nfa_ll_index == 1)
     {
 	// Already calling nfa_regmatch() recursively.  Save the lastlist[1]
 	// values and clear them.
@@ -5200,42 +5455,42 @@ recursive_regmatch(
 	}
 	nfa_save_listids(prog, *listids);
 	need_restore = TRUE;
-	// any value of rex.nfa_listid will do
+	// any value of rex->nfa_listid will do
     }
     else
     {
 	// First recursive nfa_regmatch() call, switch to the second lastlist
-	// entry.  Make sure rex.nfa_listid is different from a previous
+	// entry.  Make sure rex->nfa_listid is different from a previous
 	// recursive call, because some states may still have this ID.
-	++nfa_ll_index;
-	if (rex.nfa_listid <= rex.nfa_alt_listid)
-	    rex.nfa_listid = rex.nfa_alt_listid;
+	++rex->nfa_ll_index;
+	if (rex->nfa_listid <= rex->nfa_alt_listid)
+	    rex->nfa_listid = rex->nfa_alt_listid;
     }
 
     // Call nfa_regmatch() to check if the current concat matches at this
     // position. The concat ends with the node NFA_END_INVISIBLE
-    nfa_endp = endposp;
+    rex->nfa_endp = endposp;
     result = nfa_regmatch(prog, state->out, submatch, m);
 
     if (need_restore)
 	nfa_restore_listids(prog, *listids);
     else
     {
-	--nfa_ll_index;
-	rex.nfa_alt_listid = rex.nfa_listid;
+	--rex->nfa_ll_index;
+	rex->nfa_alt_listid = rex->nfa_listid;
     }
 
     // restore position in input text
-    rex.lnum = save_reglnum;
+    rex->lnum = save_reglnum;
     if (REG_MULTI)
-	rex.line = reg_getline(rex.lnum);
-    rex.input = rex.line + save_reginput_col;
+	rex->line = reg_getline(rex->lnum);
+    rex->input = rex->line + save_reginput_col;
     if (result != NFA_TOO_EXPENSIVE)
     {
-	nfa_match = save_nfa_match;
-	rex.nfa_listid = save_nfa_listid;
+	rex->nfa_match = save_nfa_match;
+	rex->nfa_listid = save_nfa_listid;
     }
-    nfa_endp = save_nfa_endp;
+    rex->nfa_endp = save_nfa_endp;
 
 #ifdef ENABLE_LOG
     log_fd = fopen(NFA_REGEXP_RUN_LOG, "a");
@@ -5428,13 +5683,13 @@ skip_to_start(int c, colnr_T *colp)
     char_u *s;
 
     // Used often, do some work to avoid call overhead.
-    if (!rex.reg_ic && !has_mbyte)
-	s = vim_strbyte(rex.line + *colp, c);
+    if (!rex->reg_ic && !has_mbyte)
+	s = vim_strbyte(rex->line + *colp, c);
     else
-	s = cstrchr(rex.line + *colp, c);
+	s = cstrchr(rex->line + *colp, c);
     if (s == NULL)
 	return FAIL;
-    *colp = (int)(s - rex.line);
+    *colp = (int)(s - rex->line);
     return OK;
 }
 
@@ -5458,8 +5713,9 @@ find_match_text(colnr_T startcol, int regstart, char_u *match_text)
 	for (len1 = 0; match_text[len1] != NUL; len1 += MB_CHAR2LEN(c1))
 	{
 	    c1 = PTR2CHAR(match_text + len1);
-	    c2 = PTR2CHAR(rex.line + col + len2);
-	    if (c1 != c2 && (!rex.reg_ic || MB_CASEFOLD(c1) != MB_CASEFOLD(c2)))
+	    c2 = PTR2CHAR(rex->line + col + len2);
+	    if (c1 != c2 && (!rex->reg_ic
+				      || MB_CASEFOLD(c1) != MB_CASEFOLD(c2)))
 	    {
 		match = FALSE;
 		break;
@@ -5469,20 +5725,20 @@ find_match_text(colnr_T startcol, int regstart, char_u *match_text)
 	if (match
 		// check that no composing char follows
 		&& !(enc_utf8
-			  && utf_iscomposing(PTR2CHAR(rex.line + col + len2))))
+			  && utf_iscomposing(PTR2CHAR(rex->line + col + len2))))
 	{
 	    cleanup_subexpr();
 	    if (REG_MULTI)
 	    {
-		rex.reg_startpos[0].lnum = rex.lnum;
-		rex.reg_startpos[0].col = col;
-		rex.reg_endpos[0].lnum = rex.lnum;
-		rex.reg_endpos[0].col = col + len2;
+		rex->reg_startpos[0].lnum = rex->lnum;
+		rex->reg_startpos[0].col = col;
+		rex->reg_endpos[0].lnum = rex->lnum;
+		rex->reg_endpos[0].col = col + len2;
 	    }
 	    else
 	    {
-		rex.reg_startp[0] = rex.line + col;
-		rex.reg_endp[0] = rex.line + col + len2;
+		rex->reg_startp[0] = rex->line + col;
+		rex->reg_endp[0] = rex->line + col + len2;
 	    }
 	    return 1L;
 	}
@@ -5499,20 +5755,72 @@ find_match_text(colnr_T startcol, int regstart, char_u *match_text)
     static int
 nfa_did_time_out()
 {
-    if (nfa_time_limit != NULL && profile_passed_limit(nfa_time_limit))
+    if (rex->nfa_time_limit != NULL
+			       && profile_passed_limit(rex->nfa_time_limit))
     {
-	if (nfa_timed_out != NULL)
-	    *nfa_timed_out = TRUE;
+	if (rex->nfa_timed_out != NULL)
+	    *rex->nfa_timed_out = TRUE;
 	return TRUE;
     }
     return FALSE;
 }
 #endif
 
+/*
+ * Get memory for list "l" to hold at least "len" states.  A list kept from a
+ * previous call to nfa_regmatch() is used when possible.
+ * Returns FAIL when out of memory.
+ */
+    static int
+nfa_list_alloc(nfa_list_T *l, int len)
+{
+    if (rex->nfa_pool_count > 0)
+    {
+	--rex->nfa_pool_count;
+	l->t = rex->nfa_pool[rex->nfa_pool_count];
+	l->len = rex->nfa_pool_len[rex->nfa_pool_count];
+	if (l->len >= len)
+	    return OK;
+	vim_free(l->t);
+    }
+    l->t = ALLOC_MULT(nfa_thread_T, len);
+    l->len = len;
+    return l->t == NULL ? FAIL : OK;
+}
+
+/*
+ * Done with list "l", keep its memory for the next nfa_regmatch() call.
+ */
+    static void
+nfa_list_free(nfa_list_T *l)
+{
+    if (l->t == NULL)
+	return;
+    if (rex->nfa_pool_count < NFA_POOL_SIZE)
+    {
+	rex->nfa_pool[rex->nfa_pool_count] = l->t;
+	rex->nfa_pool_len[rex->nfa_pool_count] = l->len;
+	++rex->nfa_pool_count;
+    }
+    else
+	vim_free(l->t);
+    l->t = NULL;
+}
+
+/*
+ * Free the state lists kept in execution state "rx".
+ */
+    static void
+nfa_pool_clear(regexec_T *rx)
+{
+    while (rx->nfa_pool_count > 0)
+	vim_free(rx->nfa_pool[--rx->nfa_pool_count]);
+}
+
 /*
  * Main matching routine.
  *
- * Run NFA to determine whether it matches rex.input.
+ * Run NFA to determine whether it matches rex->input.
  *
  * When "nfa_endp" is not NULL it is a required end-of-match position.
  *
@@ -5530,7 +5838,6 @@ nfa_regmatch(
     regsubs_T		*m)
 {
     int		result = FALSE;
-    size_t	size = 0;
     int		flag = 0;
     int		go_to_nextline = FALSE;
     nfa_thread_T *t;
@@ -5568,16 +5875,13 @@ nfa_regmatch(
 	return FALSE;
     }
 #endif
-    nfa_match = FALSE;
-
-    // Allocate memory for the lists of nodes.
-    size = (prog->nstate + 1) * sizeof(nfa_thread_T);
+    rex->nfa_match = FALSE;
 
-    list[0].t = alloc(size);
-    list[0].len = prog->nstate + 1;
-    list[1].t = alloc(size);
-    list[1].len = prog->nstate + 1;
-    if (list[0].t == NULL || list[1].t == NULL)
+    // Get memory for the lists of nodes.
+    list[0].t = NULL;
+    list[1].t = NULL;
+    if (nfa_list_alloc(&list[0], prog->nstate + 1) == FAIL
+	    || nfa_list_alloc(&list[1], prog->nstate + 1) == FAIL)
 	goto theend;
 
 #ifdef ENABLE_LOG
@@ -5606,7 +5910,7 @@ nfa_regmatch(
 #ifdef ENABLE_LOG
     fprintf(log_fd, "(---) STARTSTATE first\n");
 #endif
-    thislist->id = rex.nfa_listid + 1;
+    thislist->id = rex->nfa_listid + 1;
 
     // Inline optimized code for addstate(thislist, start, m, 0) if we know
     // it's the first MOPEN.
@@ -5614,11 +5918,11 @@ nfa_regmatch(
     {
 	if (REG_MULTI)
 	{
-	    m->norm.list.multi[0].start_lnum = rex.lnum;
-	    m->norm.list.multi[0].start_col = (colnr_T)(rex.input - rex.line);
+	    m->norm.list.multi[0].start_lnum = rex->lnum;
+	    m->norm.list.multi[0].start_col = (colnr_T)(rex->input - rex->line);
 	}
 	else
-	    m->norm.list.line[0].start = rex.input;
+	    m->norm.list.line[0].start = rex->input;
 	m->norm.in_use = 1;
 	r = addstate(thislist, start->out, m, NULL, 0);
     }
@@ -5626,7 +5930,7 @@ nfa_regmatch(
 	r = addstate(thislist, start, m, NULL, 0);
     if (r == NULL)
     {
-	nfa_match = NFA_TOO_EXPENSIVE;
+	rex->nfa_match = NFA_TOO_EXPENSIVE;
 	goto theend;
     }
 
@@ -5646,12 +5950,12 @@ nfa_regmatch(
 
 	if (has_mbyte)
 	{
-	    curc = (*mb_ptr2char)(rex.input);
-	    clen = (*mb_ptr2len)(rex.input);
+	    curc = (*mb_ptr2char)(rex->input);
+	    clen = (*mb_ptr2len)(rex->input);
 	}
 	else
 	{
-	    curc = *rex.input;
+	    curc = *rex->input;
 	    clen = 1;
 	}
 	if (curc == NUL)
@@ -5665,25 +5969,25 @@ nfa_regmatch(
 	nextlist = &list[flag ^= 1];
 	nextlist->n = 0;	    // clear nextlist
 	nextlist->has_pim = FALSE;
-	++rex.nfa_listid;
+	++rex->nfa_listid;
 	if (prog->re_engine == AUTOMATIC_ENGINE
-		&& (rex.nfa_listid >= NFA_MAX_STATES
+		&& (rex->nfa_listid >= NFA_MAX_STATES
 # ifdef FEAT_EVAL
 		    || nfa_fail_for_testing
 # endif
 		    ))
 	{
 	    // too many states, retry with old engine
-	    nfa_match = NFA_TOO_EXPENSIVE;
+	    rex->nfa_match = NFA_TOO_EXPENSIVE;
 	    goto theend;
 	}
 
-	thislist->id = rex.nfa_listid;
-	nextlist->id = rex.nfa_listid + 1;
+	thislist->id = rex->nfa_listid;
+	nextlist->id = rex->nfa_listid + 1;
 
 #ifdef ENABLE_LOG
 	fprintf(log_fd, "------------------------------------------\n");
-	fprintf(log_fd, ">>> Reginput is \"%s\"\n", rex.input);
+	fprintf(log_fd, ">>> Reginput is \"%s\"\n", rex->input);
 	fprintf(log_fd, ">>> Advanced one character... Current char is %c (code %d) \n", curc, (int)curc);
 	fprintf(log_fd, ">>> Thislist has %d states available: ", thislist->n);
 	{
@@ -5713,9 +6017,9 @@ nfa_regmatch(
 	    if (got_int)
 		break;
 #ifdef FEAT_RELTIME
-	    if (nfa_time_limit != NULL && ++nfa_time_count == 20)
+	    if (rex->nfa_time_limit != NULL && ++rex->nfa_time_count == 20)
 	    {
-		nfa_time_count = 0;
+		rex->nfa_time_count = 0;
 		if (nfa_did_time_out())
 		    break;
 	    }
@@ -5735,7 +6039,7 @@ nfa_regmatch(
 		else if (REG_MULTI)
 		    col = t->subs.norm.list.multi[0].start_col;
 		else
-		    col = (int)(t->subs.norm.list.line[0].start - rex.line);
+		    col = (int)(t->subs.norm.list.line[0].start - rex->line);
 		nfa_set_code(t->state->c);
 		fprintf(log_fd, "(%d) char %d %s (start col %d)%s... \n",
 			abs(t->state->id), (int)t->state->c, code, col,
@@ -5755,14 +6059,14 @@ nfa_regmatch(
 	    case NFA_MATCH:
 	      {
 		// If the match ends before a composing characters and
-		// rex.reg_icombine is not set, that is not really a match.
-		if (enc_utf8 && !rex.reg_icombine && utf_iscomposing(curc))
+		// rex->reg_icombine is not set, that is not really a match.
+		if (enc_utf8 && !rex->reg_icombine && utf_iscomposing(curc))
 		    break;
 
-		nfa_match = TRUE;
+		rex->nfa_match = TRUE;
 		copy_sub(&submatch->norm, &t->subs.norm);
 #ifdef FEAT_SYN_HL
-		if (rex.nfa_has_zsubexpr)
+		if (rex->nfa_has_zsubexpr)
 		    copy_sub(&submatch->synt, &t->subs.synt);
 #endif
 #ifdef ENABLE_LOG
@@ -5770,7 +6074,7 @@ nfa_regmatch(
 #endif
 		// Found the left-most longest match, do not look at any other
 		// states at this position.  When the list of states is going
-		// to be empty quit without advancing, so that "rex.input" is
+		// to be empty quit without advancing, so that "rex->input" is
 		// correct.
 		if (nextlist->n == 0)
 		    clen = 0;
@@ -5792,27 +6096,27 @@ nfa_regmatch(
 		 * Submatches are stored in *m, and used in the parent call.
 		 */
 #ifdef ENABLE_LOG
-		if (nfa_endp != NULL)
+		if (rex->nfa_endp != NULL)
 		{
 		    if (REG_MULTI)
 			fprintf(log_fd, "Current lnum: %d, endp lnum: %d; current col: %d, endp col: %d\n",
-				(int)rex.lnum,
-				(int)nfa_endp->se_u.pos.lnum,
-				(int)(rex.input - rex.line),
-				nfa_endp->se_u.pos.col);
+				(int)rex->lnum,
+				(int)rex->nfa_endp->se_u.pos.lnum,
+				(int)(rex->input - rex->line),
+				rex->nfa_endp->se_u.pos.col);
 		    else
 			fprintf(log_fd, "Current col: %d, endp col: %d\n",
-				(int)(rex.input - rex.line),
-				(int)(nfa_endp->se_u.ptr - rex.input));
+				(int)(rex->input - rex->line),
+				(int)(rex->nfa_endp->se_u.ptr - rex->input));
 		}
 #endif
 		// If "nfa_endp" is set it's only a match if it ends at
 		// "nfa_endp"
-		if (nfa_endp != NULL && (REG_MULTI
-			? (rex.lnum != nfa_endp->se_u.pos.lnum
-			    || (int)(rex.input - rex.line)
-						!= nfa_endp->se_u.pos.col)
-			: rex.input != nfa_endp->se_u.ptr))
+		if (rex->nfa_endp != NULL && (REG_MULTI
+			? (rex->lnum != rex->nfa_endp->se_u.pos.lnum
+			    || (int)(rex->input - rex->line)
+						!= rex->nfa_endp->se_u.pos.col)
+			: rex->input != rex->nfa_endp->se_u.ptr))
 		    break;
 
 		// do not set submatches for \@!
@@ -5820,7 +6124,7 @@ nfa_regmatch(
 		{
 		    copy_sub(&m->norm, &t->subs.norm);
 #ifdef FEAT_SYN_HL
-		    if (rex.nfa_has_zsubexpr)
+		    if (rex->nfa_has_zsubexpr)
 			copy_sub(&m->synt, &t->subs.synt);
 #endif
 		}
@@ -5828,7 +6132,7 @@ nfa_regmatch(
 		fprintf(log_fd, "Match found:\n");
 		log_subsexpr(m);
 #endif
-		nfa_match = TRUE;
+		rex->nfa_match = TRUE;
 		// See comment above at "goto nextchar".
 		if (nextlist->n == 0)
 		    clen = 0;
@@ -5862,7 +6166,7 @@ nfa_regmatch(
 			// of what happens on success below.
 			copy_sub_off(&m->norm, &t->subs.norm);
 #ifdef FEAT_SYN_HL
-			if (rex.nfa_has_zsubexpr)
+			if (rex->nfa_has_zsubexpr)
 			    copy_sub_off(&m->synt, &t->subs.synt);
 #endif
 
@@ -5874,7 +6178,7 @@ nfa_regmatch(
 					  submatch, m, &listids, &listids_len);
 			if (result == NFA_TOO_EXPENSIVE)
 			{
-			    nfa_match = result;
+			    rex->nfa_match = result;
 			    goto theend;
 			}
 
@@ -5890,7 +6194,7 @@ nfa_regmatch(
 			    // Copy submatch info from the recursive call
 			    copy_sub_off(&t->subs.norm, &m->norm);
 #ifdef FEAT_SYN_HL
-			    if (rex.nfa_has_zsubexpr)
+			    if (rex->nfa_has_zsubexpr)
 				copy_sub_off(&t->subs.synt, &m->synt);
 #endif
 			    // If the pattern has \ze and it matched in the
@@ -5923,11 +6227,11 @@ nfa_regmatch(
 #endif
 			if (REG_MULTI)
 			{
-			    pim.end.pos.col = (int)(rex.input - rex.line);
-			    pim.end.pos.lnum = rex.lnum;
+			    pim.end.pos.col = (int)(rex->input - rex->line);
+			    pim.end.pos.lnum = rex->lnum;
 			}
 			else
-			    pim.end.ptr = rex.input;
+			    pim.end.ptr = rex->input;
 
 			// t->state->out1 is the corresponding END_INVISIBLE
 			// node; Add its out to the current list (zero-width
@@ -5935,7 +6239,7 @@ nfa_regmatch(
 			if (addstate_here(thislist, t->state->out1->out,
 					     &t->subs, &pim, &listidx) == NULL)
 			{
-			    nfa_match = NFA_TOO_EXPENSIVE;
+			    rex->nfa_match = NFA_TOO_EXPENSIVE;
 			    goto theend;
 			}
 		    }
@@ -5987,7 +6291,7 @@ nfa_regmatch(
 		// happens afterwards.
 		copy_sub_off(&m->norm, &t->subs.norm);
 #ifdef FEAT_SYN_HL
-		if (rex.nfa_has_zsubexpr)
+		if (rex->nfa_has_zsubexpr)
 		    copy_sub_off(&m->synt, &t->subs.synt);
 #endif
 
@@ -5996,7 +6300,7 @@ nfa_regmatch(
 					  submatch, m, &listids, &listids_len);
 		if (result == NFA_TOO_EXPENSIVE)
 		{
-		    nfa_match = result;
+		    rex->nfa_match = result;
 		    goto theend;
 		}
 		if (result)
@@ -6010,7 +6314,7 @@ nfa_regmatch(
 		    // Copy submatch info from the recursive call
 		    copy_sub_off(&t->subs.norm, &m->norm);
 #ifdef FEAT_SYN_HL
-		    if (rex.nfa_has_zsubexpr)
+		    if (rex->nfa_has_zsubexpr)
 			copy_sub_off(&t->subs.synt, &m->synt);
 #endif
 		    // Now we need to skip over the matched text and then
@@ -6018,9 +6322,9 @@ nfa_regmatch(
 		    if (REG_MULTI)
 			// TODO: multi-line match
 			bytelen = m->norm.list.multi[0].end_col
-						  - (int)(rex.input - rex.line);
+					       - (int)(rex->input - rex->line);
 		    else
-			bytelen = (int)(m->norm.list.line[0].end - rex.input);
+			bytelen = (int)(m->norm.list.line[0].end - rex->input);
 
 #ifdef ENABLE_LOG
 		    fprintf(log_fd, "NFA_START_PATTERN length: %d\n", bytelen);
@@ -6053,7 +6357,7 @@ nfa_regmatch(
 	      }
 
 	    case NFA_BOL:
-		if (rex.input == rex.line)
+		if (rex->input == rex->line)
 		{
 		    add_here = TRUE;
 		    add_state = t->state->out;
@@ -6078,15 +6382,15 @@ nfa_regmatch(
 		    int this_class;
 
 		    // Get class of current and previous char (if it exists).
-		    this_class = mb_get_class_buf(rex.input, rex.reg_buf);
+		    this_class = mb_get_class_buf(rex->input, rex->reg_buf);
 		    if (this_class <= 1)
 			result = FALSE;
 		    else if (reg_prev_class() == this_class)
 			result = FALSE;
 		}
-		else if (!vim_iswordc_buf(curc, rex.reg_buf)
-			   || (rex.input > rex.line
-				&& vim_iswordc_buf(rex.input[-1], rex.reg_buf)))
+		else if (!vim_iswordc_buf(curc, rex->reg_buf)
+			   || (rex->input > rex->line
+			    && vim_iswordc_buf(rex->input[-1], rex->reg_buf)))
 		    result = FALSE;
 		if (result)
 		{
@@ -6097,22 +6401,22 @@ nfa_regmatch(
 
 	    case NFA_EOW:
 		result = TRUE;
-		if (rex.input == rex.line)
+		if (rex->input == rex->line)
 		    result = FALSE;
 		else if (has_mbyte)
 		{
 		    int this_class, prev_class;
 
 		    // Get class of current and previous char (if it exists).
-		    this_class = mb_get_class_buf(rex.input, rex.reg_buf);
+		    this_class = mb_get_class_buf(rex->input, rex->reg_buf);
 		    prev_class = reg_prev_class();
 		    if (this_class == prev_class
 					|| prev_class == 0 || prev_class == 1)
 			result = FALSE;
 		}
-		else if (!vim_iswordc_buf(rex.input[-1], rex.reg_buf)
-			|| (rex.input[0] != NUL
-					&& vim_iswordc_buf(curc, rex.reg_buf)))
+		else if (!vim_iswordc_buf(rex->input[-1], rex->reg_buf)
+			|| (rex->input[0] != NUL
+					&& vim_iswordc_buf(curc, rex->reg_buf)))
 		    result = FALSE;
 		if (result)
 		{
@@ -6122,8 +6426,8 @@ nfa_regmatch(
 		break;
 
 	    case NFA_BOF:
-		if (rex.lnum == 0 && rex.input == rex.line
-				     && (!REG_MULTI || rex.reg_firstlnum == 1))
+		if (rex->lnum == 0 && rex->input == rex->line
+				     && (!REG_MULTI || rex->reg_firstlnum == 1))
 		{
 		    add_here = TRUE;
 		    add_state = t->state->out;
@@ -6131,7 +6435,7 @@ nfa_regmatch(
 		break;
 
 	    case NFA_EOF:
-		if (rex.lnum == rex.reg_maxline && curc == NUL)
+		if (rex->lnum == rex->reg_maxline && curc == NUL)
 		{
 		    add_here = TRUE;
 		    add_state = t->state->out;
@@ -6157,7 +6461,7 @@ nfa_regmatch(
 		    // (no preceding character).
 		    len += mb_char2len(mc);
 		}
-		if (rex.reg_icombine && len == 0)
+		if (rex->reg_icombine && len == 0)
 		{
 		    // If \Z was present, then ignore composing characters.
 		    // When ignoring the base character this always matches.
@@ -6182,7 +6486,7 @@ nfa_regmatch(
 		    // Get them into cchars[] first.
 		    while (len < clen)
 		    {
-			mc = mb_ptr2char(rex.input + len);
+			mc = mb_ptr2char(rex->input + len);
 			cchars[ccount++] = mc;
 			len += mb_char2len(mc);
 			if (ccount == MAX_MCO)
@@ -6215,8 +6519,8 @@ nfa_regmatch(
 	    }
 
 	    case NFA_NEWL:
-		if (curc == NUL && !rex.reg_line_lbr && REG_MULTI
-						 && rex.lnum <= rex.reg_maxline)
+		if (curc == NUL && !rex->reg_line_lbr && REG_MULTI
+					      && rex->lnum <= rex->reg_maxline)
 		{
 		    go_to_nextline = TRUE;
 		    // Pass -1 for the offset, which means taking the position
@@ -6224,7 +6528,7 @@ nfa_regmatch(
 		    add_state = t->state->out;
 		    add_off = -1;
 		}
-		else if (curc == '\n' && rex.reg_line_lbr)
+		else if (curc == '\n' && rex->reg_line_lbr)
 		{
 		    // match \n as if it is an ordinary character
 		    add_state = t->state->out;
@@ -6269,7 +6573,7 @@ nfa_regmatch(
 			    result = result_if_matched;
 			    break;
 			}
-			if (rex.reg_ic)
+			if (rex->reg_ic)
 			{
 			    int curc_low = MB_CASEFOLD(curc);
 			    int done = FALSE;
@@ -6287,7 +6591,7 @@ nfa_regmatch(
 		    }
 		    else if (state->c < 0 ? check_char_class(state->c, curc)
 			       : (curc == state->c
-				   || (rex.reg_ic && MB_CASEFOLD(curc)
+				   || (rex->reg_ic && MB_CASEFOLD(curc)
 						    == MB_CASEFOLD(state->c))))
 		    {
 			result = result_if_matched;
@@ -6343,13 +6647,13 @@ nfa_regmatch(
 		break;
 
 	    case NFA_KWORD:	//  \k
-		result = vim_iswordp_buf(rex.input, rex.reg_buf);
+		result = vim_iswordp_buf(rex->input, rex->reg_buf);
 		ADD_STATE_IF_MATCH(t->state);
 		break;
 
 	    case NFA_SKWORD:	//  \K
 		result = !VIM_ISDIGIT(curc)
-				     && vim_iswordp_buf(rex.input, rex.reg_buf);
+				  && vim_iswordp_buf(rex->input, rex->reg_buf);
 		ADD_STATE_IF_MATCH(t->state);
 		break;
 
@@ -6364,12 +6668,13 @@ nfa_regmatch(
 		break;
 
 	    case NFA_PRINT:	//  \p
-		result = vim_isprintc(PTR2CHAR(rex.input));
+		result = vim_isprintc(PTR2CHAR(rex->input));
 		ADD_STATE_IF_MATCH(t->state);
 		break;
 
 	    case NFA_SPRINT:	//  \P
-		result = !VIM_ISDIGIT(curc) && vim_isprintc(PTR2CHAR(rex.input));
+		result = !VIM_ISDIGIT(curc)
+				       && vim_isprintc(PTR2CHAR(rex->input));
 		ADD_STATE_IF_MATCH(t->state);
 		break;
 
@@ -6464,24 +6769,24 @@ nfa_regmatch(
 		break;
 
 	    case NFA_LOWER_IC:	// [a-z]
-		result = ri_lower(curc) || (rex.reg_ic && ri_upper(curc));
+		result = ri_lower(curc) || (rex->reg_ic && ri_upper(curc));
 		ADD_STATE_IF_MATCH(t->state);
 		break;
 
 	    case NFA_NLOWER_IC:	// [^a-z]
 		result = curc != NUL
-			&& !(ri_lower(curc) || (rex.reg_ic && ri_upper(curc)));
+			&& !(ri_lower(curc) || (rex->reg_ic && ri_upper(curc)));
 		ADD_STATE_IF_MATCH(t->state);
 		break;
 
 	    case NFA_UPPER_IC:	// [A-Z]
-		result = ri_upper(curc) || (rex.reg_ic && ri_lower(curc));
+		result = ri_upper(curc) || (rex->reg_ic && ri_lower(curc));
 		ADD_STATE_IF_MATCH(t->state);
 		break;
 
 	    case NFA_NUPPER_IC:	// ^[A-Z]
 		result = curc != NUL
-			&& !(ri_upper(curc) || (rex.reg_ic && ri_lower(curc)));
+			&& !(ri_upper(curc) || (rex->reg_ic && ri_lower(curc)));
 		ADD_STATE_IF_MATCH(t->state);
 		break;
 
@@ -6572,7 +6877,7 @@ nfa_regmatch(
 	    case NFA_LNUM_LT:
 		result = (REG_MULTI &&
 			nfa_re_num_cmp(t->state->val, t->state->c - NFA_LNUM,
-			    (long_u)(rex.lnum + rex.reg_firstlnum)));
+			    (long_u)(rex->lnum + rex->reg_firstlnum)));
 		if (result)
 		{
 		    add_here = TRUE;
@@ -6584,7 +6889,7 @@ nfa_regmatch(
 	    case NFA_COL_GT:
 	    case NFA_COL_LT:
 		result = nfa_re_num_cmp(t->state->val, t->state->c - NFA_COL,
-			(long_u)(rex.input - rex.line) + 1);
+			(long_u)(rex->input - rex->line) + 1);
 		if (result)
 		{
 		    add_here = TRUE;
@@ -6597,8 +6902,8 @@ nfa_regmatch(
 	    case NFA_VCOL_LT:
 		{
 		    int     op = t->state->c - NFA_VCOL;
-		    colnr_T col = (colnr_T)(rex.input - rex.line);
-		    win_T   *wp = rex.reg_win == NULL ? curwin : rex.reg_win;
+		    colnr_T col = (colnr_T)(rex->input - rex->line);
+		    win_T   *wp = rex->reg_win == NULL ? curwin : rex->reg_win;
 
 		    // Bail out quickly when there can't be a match, avoid the
 		    // overhead of win_linetabsize() on long lines.
@@ -6618,7 +6923,7 @@ nfa_regmatch(
 		    }
 		    if (!result)
 			result = nfa_re_num_cmp(t->state->val, op,
-				(long_u)win_linetabsize(wp, rex.line, col) + 1);
+			      (long_u)win_linetabsize(wp, rex->line, col) + 1);
 		    if (result)
 		    {
 			add_here = TRUE;
@@ -6631,18 +6936,18 @@ nfa_regmatch(
 	    case NFA_MARK_GT:
 	    case NFA_MARK_LT:
 	      {
-		pos_T	*pos = getmark_buf(rex.reg_buf, t->state->val, FALSE);
+		pos_T	*pos = getmark_buf(rex->reg_buf, t->state->val, FALSE);
 
 		// Compare the mark position to the match position.
 		result = (pos != NULL		     // mark doesn't exist
 			&& pos->lnum > 0    // mark isn't set in reg_buf
-			&& (pos->lnum == rex.lnum + rex.reg_firstlnum
-				? (pos->col == (colnr_T)(rex.input - rex.line)
+			&& (pos->lnum == rex->lnum + rex->reg_firstlnum
+				? (pos->col == (colnr_T)(rex->input - rex->line)
 				    ? t->state->c == NFA_MARK
-				    : (pos->col < (colnr_T)(rex.input - rex.line)
+				    : (pos->col < (colnr_T)(rex->input - rex->line)
 					? t->state->c == NFA_MARK_GT
 					: t->state->c == NFA_MARK_LT))
-				: (pos->lnum < rex.lnum + rex.reg_firstlnum
+				: (pos->lnum < rex->lnum + rex->reg_firstlnum
 				    ? t->state->c == NFA_MARK_GT
 				    : t->state->c == NFA_MARK_LT)));
 		if (result)
@@ -6654,11 +6959,11 @@ nfa_regmatch(
 	      }
 
 	    case NFA_CURSOR:
-		result = (rex.reg_win != NULL
-			&& (rex.lnum + rex.reg_firstlnum
-						 == rex.reg_win->w_cursor.lnum)
-			&& ((colnr_T)(rex.input - rex.line)
-						== rex.reg_win->w_cursor.col));
+		result = (rex->reg_win != NULL
+			&& (rex->lnum + rex->reg_firstlnum
+						 == rex->reg_win->w_cursor.lnum)
+			&& ((colnr_T)(rex->input - rex->line)
+						== rex->reg_win->w_cursor.col));
 		if (result)
 		{
 		    add_here = TRUE;
@@ -6712,12 +7017,12 @@ nfa_regmatch(
 #endif
 		result = (c == curc);
 
-		if (!result && rex.reg_ic)
+		if (!result && rex->reg_ic)
 		    result = MB_CASEFOLD(c) == MB_CASEFOLD(curc);
-		// If rex.reg_icombine is not set only skip over the character
+		// If rex->reg_icombine is not set only skip over the character
 		// itself.  When it is set skip over composing characters.
-		if (result && enc_utf8 && !rex.reg_icombine)
-		    clen = utf_ptr2len(rex.input);
+		if (result && enc_utf8 && !rex->reg_icombine)
+		    clen = utf_ptr2len(rex->input);
 		ADD_STATE_IF_MATCH(t->state);
 		break;
 	      }
@@ -6761,7 +7066,7 @@ nfa_regmatch(
 			    // Copy submatch info from the recursive call
 			    copy_sub_off(&pim->subs.norm, &m->norm);
 #ifdef FEAT_SYN_HL
-			    if (rex.nfa_has_zsubexpr)
+			    if (rex->nfa_has_zsubexpr)
 				copy_sub_off(&pim->subs.synt, &m->synt);
 #endif
 			}
@@ -6788,7 +7093,7 @@ nfa_regmatch(
 			// Copy submatch info from the recursive call
 			copy_sub_off(&t->subs.norm, &pim->subs.norm);
 #ifdef FEAT_SYN_HL
-			if (rex.nfa_has_zsubexpr)
+			if (rex->nfa_has_zsubexpr)
 			    copy_sub_off(&t->subs.synt, &pim->subs.synt);
 #endif
 		    }
@@ -6821,7 +7126,7 @@ nfa_regmatch(
 		}
 		if (r == NULL)
 		{
-		    nfa_match = NFA_TOO_EXPENSIVE;
+		    rex->nfa_match = NFA_TOO_EXPENSIVE;
 		    goto theend;
 		}
 	    }
@@ -6836,19 +7141,20 @@ nfa_regmatch(
 	// because recursive calls should only start in the first position.
 	// Unless "nfa_endp" is not NULL, then we match the end position.
 	// Also don't start a match past the first line.
-	if (nfa_match == FALSE
+	if (rex->nfa_match == FALSE
 		&& ((toplevel
-			&& rex.lnum == 0
+			&& rex->lnum == 0
 			&& clen != 0
-			&& (rex.reg_maxcol == 0
-			    || (colnr_T)(rex.input - rex.line) < rex.reg_maxcol))
-		    || (nfa_endp != NULL
+			&& (rex->reg_maxcol == 0
+			    || (colnr_T)(rex->input - rex->line)
+							    < rex->reg_maxcol))
+		    || (rex->nfa_endp != NULL
 			&& (REG_MULTI
-			    ? (rex.lnum < nfa_endp->se_u.pos.lnum
-			       || (rex.lnum == nfa_endp->se_u.pos.lnum
-				   && (int)(rex.input - rex.line)
-						    < nfa_endp->se_u.pos.col))
-			    : rex.input < nfa_endp->se_u.ptr))))
+			    ? (rex->lnum < rex->nfa_endp->se_u.pos.lnum
+			       || (rex->lnum == rex->nfa_endp->se_u.pos.lnum
+				   && (int)(rex->input - rex->line)
+						< rex->nfa_endp->se_u.pos.col))
+			    : rex->input < rex->nfa_endp->se_u.ptr))))
 	{
 #ifdef ENABLE_LOG
 	    fprintf(log_fd, "(---) STARTSTATE\n");
@@ -6864,7 +7170,7 @@ nfa_regmatch(
 		{
 		    if (nextlist->n == 0)
 		    {
-			colnr_T col = (colnr_T)(rex.input - rex.line) + clen;
+			colnr_T col = (colnr_T)(rex->input - rex->line) + clen;
 
 			// Nextlist is empty, we can skip ahead to the
 			// character that must appear at the start.
@@ -6872,16 +7178,16 @@ nfa_regmatch(
 			    break;
 #ifdef ENABLE_LOG
 			fprintf(log_fd, "  Skipping ahead %d bytes to regstart\n",
-				col - ((colnr_T)(rex.input - rex.line) + clen));
+			     col - ((colnr_T)(rex->input - rex->line) + clen));
 #endif
-			rex.input = rex.line + col - clen;
+			rex->input = rex->line + col - clen;
 		    }
 		    else
 		    {
 			// Checking if the required start character matches is
 			// cheaper than adding a state that won't match.
-			c = PTR2CHAR(rex.input + clen);
-			if (c != prog->regstart && (!rex.reg_ic
+			c = PTR2CHAR(rex->input + clen);
+			if (c != prog->regstart && (!rex->reg_ic
 			     || MB_CASEFOLD(c) != MB_CASEFOLD(prog->regstart)))
 			{
 #ifdef ENABLE_LOG
@@ -6891,17 +7197,41 @@ nfa_regmatch(
 			}
 		    }
 		}
+		else if (prog->has_startmap && clen != 0)
+		{
+		    c = rex->input[clen];
+		    if ((prog->startmap[c >> 3] & (1 << (c & 7))) == 0)
+		    {
+			// The next byte can't start a match, e.g. it isn't the
+			// first letter of any of the alternatives.
+			if (nextlist->n == 0)
+			{
+			    char_u *p = rex->input + clen;
+
+			    // Nextlist is empty, skip ahead to a byte that can
+			    // start a match.
+			    while (*p != NUL && (prog->startmap[*p >> 3]
+							& (1 << (*p & 7))) == 0)
+				MB_PTR_ADV(p);
+			    if (*p == NUL)
+				break;
+			    rex->input = p - clen;
+			}
+			else
+			    add = FALSE;
+		    }
+		}
 
 		if (add)
 		{
 		    if (REG_MULTI)
 			m->norm.list.multi[0].start_col =
-					 (colnr_T)(rex.input - rex.line) + clen;
+				      (colnr_T)(rex->input - rex->line) + clen;
 		    else
-			m->norm.list.line[0].start = rex.input + clen;
+			m->norm.list.line[0].start = rex->input + clen;
 		    if (addstate(nextlist, start->out, m, NULL, clen) == NULL)
 		    {
-			nfa_match = NFA_TOO_EXPENSIVE;
+			rex->nfa_match = NFA_TOO_EXPENSIVE;
 			goto theend;
 		    }
 		}
@@ -6910,7 +7240,7 @@ nfa_regmatch(
 	    {
 		if (addstate(nextlist, start, m, NULL, clen) == NULL)
 		{
-		    nfa_match = NFA_TOO_EXPENSIVE;
+		    rex->nfa_match = NFA_TOO_EXPENSIVE;
 		    goto theend;
 		}
 	    }
@@ -6931,9 +7261,9 @@ nextchar:
 	// Advance to the next character, or advance to the next line, or
 	// finish.
 	if (clen != 0)
-	    rex.input += clen;
-	else if (go_to_nextline || (nfa_endp != NULL && REG_MULTI
-					&& rex.lnum < nfa_endp->se_u.pos.lnum))
+	    rex->input += clen;
+	else if (go_to_nextline || (rex->nfa_endp != NULL && REG_MULTI
+				  && rex->lnum < rex->nfa_endp->se_u.pos.lnum))
 	    reg_nextline();
 	else
 	    break;
@@ -6944,9 +7274,9 @@ nextchar:
 	    break;
 #ifdef FEAT_RELTIME
 	// Check for timeout once in a twenty times to avoid overhead.
-	if (nfa_time_limit != NULL && ++nfa_time_count == 20)
+	if (rex->nfa_time_limit != NULL && ++rex->nfa_time_count == 20)
 	{
-	    nfa_time_count = 0;
+	    rex->nfa_time_count = 0;
 	    if (nfa_did_time_out())
 		break;
 	}
@@ -6960,20 +7290,20 @@ nextchar:
 #endif
 
 theend:
-    // Free memory
-    vim_free(list[0].t);
-    vim_free(list[1].t);
+    // Keep the lists for the next call.
+    nfa_list_free(&list[1]);
+    nfa_list_free(&list[0]);
     vim_free(listids);
 #undef ADD_STATE_IF_MATCH
 #ifdef NFA_REGEXP_DEBUG_LOG
     fclose(debug);
 #endif
 
-    return nfa_match;
+    return rex->nfa_match;
 }
 
 /*
- * Try match of "prog" with at rex.line["col"].
+ * Try match of "prog" with at rex->line["col"].
  * Returns <= 0 for failure, number of lines contained in the match otherwise.
  */
     static long
@@ -6991,11 +7321,11 @@ nfa_regtry(
     FILE	*f;
 #endif
 
-    rex.input = rex.line + col;
+    rex->input = rex->line + col;
 #ifdef FEAT_RELTIME
-    nfa_time_limit = tm;
-    nfa_timed_out = timed_out;
-    nfa_time_count = 0;
+    rex->nfa_time_limit = tm;
+    rex->nfa_timed_out = timed_out;
+    rex->nfa_time_count = 0;
 #endif
 
 #ifdef ENABLE_LOG
@@ -7006,7 +7336,7 @@ nfa_regtry(
 #ifdef DEBUG
 	fprintf(f, "\tRegexp is \"%s\"\n", nfa_regengine.expr);
 #endif
-	fprintf(f, "\tInput text is \"%s\" \n", rex.input);
+	fprintf(f, "\tInput text is \"%s\" \n", rex->input);
 	fprintf(f, "\t=======================================================\n\n");
 	nfa_print_state(f, start);
 	fprintf(f, "\n\n");
@@ -7034,40 +7364,40 @@ nfa_regtry(
     {
 	for (i = 0; i < subs.norm.in_use; i++)
 	{
-	    rex.reg_startpos[i].lnum = subs.norm.list.multi[i].start_lnum;
-	    rex.reg_startpos[i].col = subs.norm.list.multi[i].start_col;
+	    rex->reg_startpos[i].lnum = subs.norm.list.multi[i].start_lnum;
+	    rex->reg_startpos[i].col = subs.norm.list.multi[i].start_col;
 
-	    rex.reg_endpos[i].lnum = subs.norm.list.multi[i].end_lnum;
-	    rex.reg_endpos[i].col = subs.norm.list.multi[i].end_col;
+	    rex->reg_endpos[i].lnum = subs.norm.list.multi[i].end_lnum;
+	    rex->reg_endpos[i].col = subs.norm.list.multi[i].end_col;
 	}
 
-	if (rex.reg_startpos[0].lnum < 0)
+	if (rex->reg_startpos[0].lnum < 0)
 	{
-	    rex.reg_startpos[0].lnum = 0;
-	    rex.reg_startpos[0].col = col;
+	    rex->reg_startpos[0].lnum = 0;
+	    rex->reg_startpos[0].col = col;
 	}
-	if (rex.reg_endpos[0].lnum < 0)
+	if (rex->reg_endpos[0].lnum < 0)
 	{
 	    // pattern has a \ze but it didn't match, use current end
-	    rex.reg_endpos[0].lnum = rex.lnum;
-	    rex.reg_endpos[0].col = (int)(rex.input - rex.line);
+	    rex->reg_endpos[0].lnum = rex->lnum;
+	    rex->reg_endpos[0].col = (int)(rex->input - rex->line);
 	}
 	else
 	    // Use line number of "\ze".
-	    rex.lnum = rex.reg_endpos[0].lnum;
+	    rex->lnum = rex->reg_endpos[0].lnum;
     }
     else
     {
 	for (i = 0; i < subs.norm.in_use; i++)
 	{
-	    rex.reg_startp[i] = subs.norm.list.line[i].start;
-	    rex.reg_endp[i] = subs.norm.list.line[i].end;
+	    rex->reg_startp[i] = subs.norm.list.line[i].start;
+	    rex->reg_endp[i] = subs.norm.list.line[i].end;
 	}
 
-	if (rex.reg_startp[0] == NULL)
-	    rex.reg_startp[0] = rex.line + col;
-	if (rex.reg_endp[0] == NULL)
-	    rex.reg_endp[0] = rex.input;
+	if (rex->reg_startp[0] == NULL)
+	    rex->reg_startp[0] = rex->line + col;
+	if (rex->reg_endp[0] == NULL)
+	    rex->reg_endp[0] = rex->input;
     }
 
 #ifdef FEAT_SYN_HL
@@ -7109,7 +7439,7 @@ nfa_regtry(
     }
 #endif
 
-    return 1 + rex.lnum;
+    return 1 + rex->lnum;
 }
 
 /*
@@ -7120,6 +7450,7 @@ nfa_regtry(
  */
     static long
 nfa_regexec_both(
+    regexec_T	*rx,		// execution state
     char_u	*line,
     colnr_T	startcol,	// column to start looking for match
     proftime_T	*tm,		// timeout limit or NULL
@@ -7130,18 +7461,21 @@ nfa_regexec_both(
     int		    i;
     colnr_T	    col = startcol;
 
+    // All functions called from here use "rex".
+    rex = rx;
+
     if (REG_MULTI)
     {
-	prog = (nfa_regprog_T *)rex.reg_mmatch->regprog;
+	prog = (nfa_regprog_T *)rex->reg_mmatch->regprog;
 	line = reg_getline((linenr_T)0);    // relative to the cursor
-	rex.reg_startpos = rex.reg_mmatch->startpos;
-	rex.reg_endpos = rex.reg_mmatch->endpos;
+	rex->reg_startpos = rex->reg_mmatch->startpos;
+	rex->reg_endpos = rex->reg_mmatch->endpos;
     }
     else
     {
-	prog = (nfa_regprog_T *)rex.reg_match->regprog;
-	rex.reg_startp = rex.reg_match->startp;
-	rex.reg_endp = rex.reg_match->endp;
+	prog = (nfa_regprog_T *)rex->reg_match->regprog;
+	rex->reg_startp = rex->reg_match->startp;
+	rex->reg_endp = rex->reg_match->endp;
     }
 
     // Be paranoid...
@@ -7151,24 +7485,24 @@ nfa_regexec_both(
 	goto theend;
     }
 
-    // If pattern contains "\c" or "\C": overrule value of rex.reg_ic
+    // If pattern contains "\c" or "\C": overrule value of rex->reg_ic
     if (prog->regflags & RF_ICASE)
-	rex.reg_ic = TRUE;
+	rex->reg_ic = TRUE;
     else if (prog->regflags & RF_NOICASE)
-	rex.reg_ic = FALSE;
+	rex->reg_ic = FALSE;
 
-    // If pattern contains "\Z" overrule value of rex.reg_icombine
+    // If pattern contains "\Z" overrule value of rex->reg_icombine
     if (prog->regflags & RF_ICOMBINE)
-	rex.reg_icombine = TRUE;
+	rex->reg_icombine = TRUE;
 
-    rex.line = line;
-    rex.lnum = 0;    // relative to line
+    rex->line = line;
+    rex->lnum = 0;    // relative to line
 
-    rex.nfa_has_zend = prog->has_zend;
-    rex.nfa_has_backref = prog->has_backref;
-    rex.nfa_nsubexpr = prog->nsubexp;
-    rex.nfa_listid = 1;
-    rex.nfa_alt_listid = 2;
+    rex->nfa_has_zend = prog->has_zend;
+    rex->nfa_has_backref = prog->has_backref;
+    rex->nfa_nsubexpr = prog->nsubexp;
+    rex->nfa_listid = 1;
+    rex->nfa_alt_listid = 2;
 #ifdef DEBUG
     nfa_regengine.expr = prog->pattern;
 #endif
@@ -7176,18 +7510,18 @@ nfa_regexec_both(
     if (prog->reganch && col > 0)
 	return 0L;
 
-    rex.need_clear_subexpr = TRUE;
+    rex->need_clear_subexpr = TRUE;
 #ifdef FEAT_SYN_HL
     // Clear the external match subpointers if necessary.
     if (prog->reghasz == REX_SET)
     {
-	rex.nfa_has_zsubexpr = TRUE;
-	rex.need_clear_zsubexpr = TRUE;
+	rex->nfa_has_zsubexpr = TRUE;
+	rex->need_clear_zsubexpr = TRUE;
     }
     else
     {
-	rex.nfa_has_zsubexpr = FALSE;
-	rex.need_clear_zsubexpr = FALSE;
+	rex->nfa_has_zsubexpr = FALSE;
+	rex->need_clear_zsubexpr = FALSE;
     }
 #endif
 
@@ -7200,12 +7534,16 @@ nfa_regexec_both(
 
 	// If match_text is set it contains the full text that must match.
 	// Nothing else to try. Doesn't handle combining chars well.
-	if (prog->match_text != NULL && !rex.reg_icombine)
+	if (prog->match_text != NULL && !rex->reg_icombine)
 	    return find_match_text(col, prog->regstart, prog->match_text);
     }
 
     // If the start column is past the maximum column: no need to try.
-    if (rex.reg_maxcol > 0 && col >= rex.reg_maxcol)
+    if (rex->reg_maxcol > 0 && col >= rex->reg_maxcol)
+	goto theend;
+
+    // Use the lazy DFA to find out quickly if there is any match.
+    if (dfa_regexec(prog, col) == DFA_NOMATCH)
 	goto theend;
 
     // Set the "nstate" used by nfa_regcomp() to zero to trigger an error when
@@ -7298,17 +7636,34 @@ nfa_regcomp(char_u *expr, int re_flags)
 	goto fail;
 
     prog->regflags = regflags;
+#ifdef FEAT_SYN_HL
+    if (had_eol)
+	prog->regflags |= RF_HASEOL;
+#endif
     prog->engine = &nfa_regengine;
     prog->nstate = nstate;
-    prog->has_zend = rex.nfa_has_zend;
-    prog->has_backref = rex.nfa_has_backref;
+    prog->has_zend = rex->nfa_has_zend;
+    prog->has_backref = rex->nfa_has_backref;
     prog->nsubexp = regnpar;
 
     nfa_postprocess(prog);
 
     prog->reganch = nfa_get_reganch(prog->start, 0);
     prog->regstart = nfa_get_regstart(prog->start, 0);
+    CLEAR_FIELD(prog->startmap);
+    prog->has_startmap = FALSE;
+    if (prog->regstart == NUL)
+    {
+	int count = 0;
+
+	prog->has_startmap = nfa_get_startmap(prog->start, prog->startmap,
+							     0, &count) == OK;
+    }
     prog->match_text = nfa_get_match_text(prog->start);
+    prog->re_mustlen = 0;
+    prog->re_must = nfa_get_must_text(prog, &prog->re_mustlen);
+    prog->dfa = NULL;
+    prog->no_dfa = FALSE;
 
 #ifdef ENABLE_LOG
     nfa_postfix_dump(expr, OK);
@@ -7349,6 +7704,8 @@ nfa_regfree(regprog_T *prog)
     if (prog != NULL)
     {
 	vim_free(((nfa_regprog_T *)prog)->match_text);
+	vim_free(((nfa_regprog_T *)prog)->re_must);
+	dfa_free(((nfa_regprog_T *)prog)->dfa);
 	vim_free(((nfa_regprog_T *)prog)->pattern);
 	vim_free(prog);
     }
@@ -7364,21 +7721,22 @@ nfa_regfree(regprog_T *prog)
  */
     static int
 nfa_regexec_nl(
+    regexec_T	*rx,
     regmatch_T	*rmp,
     char_u	*line,	// string to match against
     colnr_T	col,	// column to start looking for match
     int		line_lbr)
 {
-    rex.reg_match = rmp;
-    rex.reg_mmatch = NULL;
-    rex.reg_maxline = 0;
-    rex.reg_line_lbr = line_lbr;
-    rex.reg_buf = curbuf;
-    rex.reg_win = NULL;
-    rex.reg_ic = rmp->rm_ic;
-    rex.reg_icombine = FALSE;
-    rex.reg_maxcol = 0;
-    return nfa_regexec_both(line, col, NULL, NULL);
+    rx->reg_match = rmp;
+    rx->reg_mmatch = NULL;
+    rx->reg_maxline = 0;
+    rx->reg_line_lbr = line_lbr;
+    rx->reg_buf = curbuf;
+    rx->reg_win = NULL;
+    rx->reg_ic = rmp->rm_ic;
+    rx->reg_icombine = FALSE;
+    rx->reg_maxcol = 0;
+    return nfa_regexec_both(rx, line, col, NULL, NULL);
 }
 
 
@@ -7409,6 +7767,7 @@ nfa_regexec_nl(
  */
     static long
 nfa_regexec_multi(
+    regexec_T	*rx,
     regmmatch_T	*rmp,
     win_T	*win,		// window in which to search or NULL
     buf_T	*buf,		// buffer in which to search
@@ -7417,8 +7776,8 @@ nfa_regexec_multi(
     proftime_T	*tm,		// timeout limit or NULL
     int		*timed_out)	// flag set on timeout or NULL
 {
-    init_regexec_multi(rmp, win, buf, lnum);
-    return nfa_regexec_both(NULL, col, tm, timed_out);
+    init_regexec_multi(rx, rmp, win, buf, lnum);
+    return nfa_regexec_both(rx, NULL, col, tm, timed_out);
 }
 
 #ifdef DEBUG
@@ -484,16 +484,39 @@ typedef struct mf_hashtab_S
     char	    mht_fixed;	    // non-zero value forbids growth
 } mf_hashtab_T;
 
+/*
+ * mf_blockidx_T is an open addressing hashtable that finds the block header
+ * of a block in memory by its number.  Collisions are resolved with linear
+ * probing.  When removing an entry the following entries of the same probe
+ * sequence are moved back, thus no "deleted" markers are needed.
+ */
+#define MBI_INIT_SIZE	64
+
+typedef struct mf_blockidx_S
+{
+    long_u	mbi_mask;	    // nr of slots - 1, nr of slots is a power
+				    // of two
+    long_u	mbi_count;	    // nr of block headers in the index
+    int		mbi_shift;	    // shift for the hash: 32 - log2(slots)
+    bhdr_T	**mbi_slots;	    // points to mbi_small_slots or
+				    // dynamically allocated array
+    bhdr_T	*mbi_small_slots[MBI_INIT_SIZE];   // initial slots
+} mf_blockidx_T;
+
 /*
  * for each (previously) used block in the memfile there is one block header.
  *
  * The block may be linked in the used list OR in the free list.
  * The used blocks are also kept in hash lists.
  *
- * The used list is a doubly linked list, most recently used block first.
+ * The used list is a doubly linked list, recently used blocks first.
  *	The blocks in the used list have a block of memory allocated.
  *	mf_used_count is the number of pages in the used list.
- * The hash lists are used to quickly find a block in the used list.
+ *	Using a block only sets BH_REFERENCED, it is not moved.  The list is
+ *	used as the face of a CLOCK: mf_release() looks at the last block, a
+ *	referenced or locked block gets a second chance and is moved to the
+ *	front, otherwise it is released.
+ * The block index is used to quickly find a block in the used list.
  * The free list is a single linked list, not sorted.
  *	The blocks in the free list have no block of memory allocated and
  *	the contents of the block in the file (if any) is irrelevant.
@@ -501,9 +524,7 @@ typedef struct mf_hashtab_S
 
 struct block_hdr
 {
-    mf_hashitem_T bh_hashitem;      // header for hash table and key
-#define bh_bnum bh_hashitem.mhi_key // block number, part of bh_hashitem
-
+    blocknr_T	bh_bnum;	    // block number
     bhdr_T	*bh_next;	    // next block_hdr in free or used list
     bhdr_T	*bh_prev;	    // previous block_hdr in used list
     char_u	*bh_data;	    // pointer to memory (for used block)
@@ -511,7 +532,11 @@ struct block_hdr
 
 #define BH_DIRTY    1
 #define BH_LOCKED   2
-    char	bh_flags;	    // BH_DIRTY or BH_LOCKED
+#define BH_REFERENCED 4		    // used since last looked at by mf_release()
+#define BH_NOCOMPRESS 8		    // compressing did not save memory
+    char	bh_flags;	    // BH_DIRTY, BH_LOCKED, etc.
+    unsigned	bh_csize;	    // when not zero: bh_data is compressed to
+				    // this many bytes, see 'memcompress'
 };
 
 /*
@@ -659,7 +684,7 @@ struct memfile
     bhdr_T	*mf_used_last;		// lru block_hdr in used list
     unsigned	mf_used_count;		// number of pages in used list
     unsigned	mf_used_count_max;	// maximum number of pages in memory
-    mf_hashtab_T mf_hash;		// hash lists
+    mf_blockidx_T mf_blocks;		// index of blocks in the used list
     mf_hashtab_T mf_trans;		// trans lists
     blocknr_T	mf_blocknr_max;		// highest positive block number + 1
     blocknr_T	mf_blocknr_min;		// lowest negative block number - 1
@@ -667,6 +692,22 @@ struct memfile
     blocknr_T	mf_infile_count;	// number of pages in the file
     unsigned	mf_page_size;		// number of bytes in a page
     int		mf_dirty;		// TRUE if there are dirty blocks
+    long_u	mf_hits;		// nr of times mf_get() found the block
+					// in memory
+    long_u	mf_misses;		// nr of times mf_get() read the block
+    long_u	mf_evictions;		// nr of blocks released to the file
+    long_u	mf_comp_count;		// nr of compressed blocks
+    long_u	mf_comp_size;		// bytes used by compressed blocks
+    int		mf_hidden_count;	// nr of idle checks the buffer was
+					// hidden, see mf_compress_hidden()
+#ifdef MF_FSYNC_THREAD
+    pthread_t	mf_fsync_thread;	// thread doing fsync() in the background
+    int		mf_fsync_running;	// mf_fsync_thread was started and not
+					// joined yet
+    int		mf_fsync_fd;		// file descriptor for mf_fsync_thread
+    volatile int mf_fsync_done;		// set when mf_fsync_thread finished
+    int		mf_fsync_result;	// result of fsync() in mf_fsync_thread
+#endif
 #ifdef FEAT_CRYPT
     buf_T	*mf_buffer;		// buffer this memfile is for
     char_u	mf_seed[MF_SEED_LEN];	// seed for encryption
@@ -695,6 +736,25 @@ typedef struct info_pointer
     int		ip_index;	// index for block with current lnum
 } infoptr_T;	// block/index pair
 
+/*
+ * Recently used data blocks with the stack leading to them, so that going
+ * back and forth between distant lines does not require walking down the
+ * tree each time.  Cleared when lines are inserted or deleted.
+ */
+#define ML_LEAF_CACHE_SIZE	8   // number of cached data blocks
+#define ML_LEAF_CACHE_DEPTH	6   // max stack depth of a cached block
+
+typedef struct ml_leaf
+{
+    blocknr_T	lc_bnum;	// data block number, zero if unused
+    int		lc_page_count;	// number of pages in the data block
+    linenr_T	lc_low;		// first line in the data block
+    linenr_T	lc_high;	// last line in the data block
+    unsigned	lc_used;	// value of ml_leaf_clock when last used
+    int		lc_stack_top;	// number of entries in lc_stack
+    infoptr_T	lc_stack[ML_LEAF_CACHE_DEPTH];	// copy of ml_stack
+} mlleaf_T;
+
 #ifdef FEAT_BYTEOFF
 typedef struct ml_chunksize
 {
@@ -710,6 +770,32 @@ typedef struct ml_chunksize
 # define ML_CHNK_UPDLINE 3
 #endif
 
+#ifdef FEAT_MMAP
+/*
+ * A file that was mapped in memory instead of being read into the memline,
+ * see 'mmapsize'.  The lines are found through a sparse index that holds the
+ * byte offset of every MM_INDEX_STEP'th line.
+ */
+# define MM_INDEX_STEP	64
+
+typedef struct mlmapped
+{
+    char_u	*mm_addr;	// start of the mapping
+    off_T	mm_size;	// size of the mapping in bytes
+    int		mm_no_eol;	// last line does not end in a NL
+    linenr_T	mm_lnum_count;	// number of lines in the file
+    int		mm_failed;	// accessing the file failed, it was
+				// probably truncated
+    off_T	*mm_index;	// offset of lines 1, 1 + MM_INDEX_STEP, etc.
+    linenr_T	mm_lnum;	// line number of "mm_start", zero if not set
+    off_T	mm_start;	// offset of line "mm_lnum", speeds up
+				// sequential access
+    char_u	*mm_line;	// copy of the last line obtained
+    colnr_T	mm_line_size;	// allocated size of "mm_line"
+    char_u	*mm_marks;	// bitmap for ml_setmarked(), NULL if unused
+} mlmapped_T;
+#endif
+
 /*
  * the memline structure holds all the information about a memline
  */
@@ -737,10 +823,21 @@ typedef struct memline
     linenr_T	ml_locked_low;	// first line in ml_locked
     linenr_T	ml_locked_high;	// last line in ml_locked
     int		ml_locked_lineadd;  // number of lines inserted in ml_locked
+
+    mlleaf_T	*ml_leaf_cache;	// ML_LEAF_CACHE_SIZE entries or NULL
+    unsigned	ml_leaf_clock;	// incremented for every ml_leaf_cache use
 #ifdef FEAT_BYTEOFF
     chunksize_T *ml_chunksize;
     int		ml_numchunks;
     int		ml_usedchunks;
+    chunksize_T *ml_chunktree;	    // Fenwick tree of ml_chunksize sums,
+				    // index starts at one
+    int		ml_chunktree_size;  // allocated entries in ml_chunktree
+    int		ml_chunktree_len;   // nr of chunks in ml_chunktree, zero
+				    // when it needs to be rebuilt
+#endif
+#ifdef FEAT_MMAP
+    mlmapped_T	*ml_mapped;	// file mapped in memory, NULL if not mapped
 #endif
 } memline_T;
 
@@ -1973,17 +2070,39 @@ struct jobvar_S
 /*
  * Structures to hold info about a Channel.
  */
+// State of json_scan_message(), kept while a message arrives in pieces.
+typedef struct
+{
+    long_u	js_scanned;	// number of bytes scanned
+    int		js_depth;	// nesting depth of arrays and objects
+    int		js_quote;	// quote of the string we are in or NUL
+    int		js_escape;	// TRUE just after a backslash in a string
+} js_scan_T;
+
+// State of decoding a JSON message that is continued later, see
+// json_decode_resume().  Defined in json.c.
+typedef struct js_decode_S js_decode_T;
+
+/*
+ * Text read from a channel part.  It is kept in one block of memory, so that
+ * a message never needs to be concatenated from pieces.  Text is appended at
+ * "rq_end" and consumed from "rq_start".
+ */
 struct readq_S
 {
-    char_u	*rq_buffer;
-    long_u	rq_buflen;
-    readq_T	*rq_next;
-    readq_T	*rq_prev;
+    char_u	*rq_buffer;	// NUL terminated at rq_end, can be NULL
+    long_u	rq_size;	// allocated size, excluding room for the NUL
+    long_u	rq_start;	// offset of the first unread byte
+    long_u	rq_end;		// offset of the end of the text
+    long_u	rq_scanned;	// no NL from rq_start up to this offset
+    js_scan_T	rq_json;	// JSON message scanned from rq_start
+    js_decode_T	*rq_decode;	// JSON message at rq_start being decoded
 };
 
 struct writeq_S
 {
     garray_T	wq_ga;
+    int		wq_sent;	// number of bytes in wq_ga already written
     writeq_T	*wq_next;
     writeq_T	*wq_prev;
 };
@@ -2011,6 +2130,7 @@ typedef enum
     MODE_RAW,
     MODE_JSON,
     MODE_JS,
+    MODE_MSGPACK,
 } ch_mode_T;
 
 typedef enum {
@@ -2063,7 +2183,7 @@ typedef struct {
     job_io_T	ch_io;
     int		ch_timeout;	// request timeout in msec
 
-    readq_T	ch_head;	// header for circular raw read queue
+    readq_T	ch_readq;	// text read and not consumed yet
     jsonq_T	ch_json_head;	// header for circular json read queue
     garray_T	ch_block_ids;	// list of IDs that channel_read_json_block()
 				// is waiting for
@@ -2081,6 +2201,8 @@ typedef struct {
 				// does not block, 1 simulate blocking
     int		ch_nonblocking;	// write() is non-blocking
     writeq_T	ch_writeque;	// header for write queue
+    long_u	ch_wq_len;	// number of bytes in ch_writeque not written
+    int		ch_wq_full;	// TRUE when ch_wq_len went over ch_highwater
 
     cbq_T	ch_cb_head;	// dummy node for per-request callbacks
     callback_T	ch_callback;	// call when a msg is not handled
@@ -2126,8 +2248,16 @@ struct channel_S {
 #endif
     callback_T	ch_callback;	// call when any msg is not handled
     callback_T	ch_close_cb;	// call when channel is closed
+    callback_T	ch_drain_cb;	// call when write queue was drained
+    int		ch_drain_pending; // TRUE when ch_drain_cb is to be invoked
+    long	ch_highwater;	// write queue size in bytes above which
+				// writing is to be held back
     int		ch_drop_never;
     int		ch_keep_open;	// do not close on read error
+#ifdef CHANNEL_EPOLL
+    int		ch_epoll_polled; // keep-open channel counted in
+				 // "epoll_keep_open_count"
+#endif
     int		ch_nonblock;
 
     job_T	*ch_job;	// Job that uses this channel; this does not
@@ -2195,6 +2325,8 @@ struct channel_S {
 #define JO2_BUFNR	    0x20000	// "bufnr"
 #define JO2_TERM_API	    0x40000	// "term_api"
 #define JO2_TERM_HIGHLIGHT  0x80000	// "highlight"
+#define JO2_DRAIN_CB	    0x100000	// "drain_cb"
+#define JO2_HIGHWATER	    0x200000	// "highwater"
 
 #define JO_MODE_ALL	(JO_MODE + JO_IN_MODE + JO_OUT_MODE + JO_ERR_MODE)
 #define JO_CB_ALL \
@@ -2231,12 +2363,14 @@ typedef struct
     callback_T	jo_out_cb;
     callback_T	jo_err_cb;
     callback_T	jo_close_cb;
+    callback_T	jo_drain_cb;
     callback_T	jo_exit_cb;
     int		jo_drop_never;
     int		jo_waittime;
     int		jo_timeout;
     int		jo_out_timeout;
     int		jo_err_timeout;
+    long	jo_highwater;
     int		jo_block_write;	// for testing only
     int		jo_part;
     int		jo_id;
@@ -2353,6 +2487,9 @@ struct timer_S
 #ifdef FEAT_TIMERS
     timer_T	*tr_next;
     timer_T	*tr_prev;
+    int		tr_heap_idx;	    // index in "timer_heap", -1 when not in it
+    long	tr_check_nr;	    // check_due_timer() call that invoked it
+    char_u	tr_key[NUMBUFLEN];  // "tr_id" as a string, key in "timer_ht"
     proftime_T	tr_due;		    // when the callback is to be invoked
     char	tr_firing;	    // when TRUE callback is being called
     char	tr_paused;	    // when TRUE callback is not invoked
@@ -4202,6 +4339,16 @@ typedef struct
     int		sa_wrapped;	// search wrapped around
 } searchit_arg_T;
 
+/*
+ * Input and output of a shell command executed with call_shell_io().
+ */
+typedef struct
+{
+    char_u	*si_input;	// text for stdin, NULL to use /dev/null
+    long	si_input_len;	// number of bytes in "si_input"
+    garray_T	si_output;	// stdout of the command, ga_itemsize is 1
+} shellio_T;
+
 
 #define WRITEBUFSIZE	8192	// size of normal write buffer
 
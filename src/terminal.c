@@ -1619,6 +1619,41 @@ add_scrollback_line_to_buffer(term_T *term, char_u *text, int len)
     }
 }
 
+/*
+ * Add "count" lines of scrollback text "texts[]" to the buffer in the window
+ * at once.
+ */
+    static void
+add_scrollback_lines_to_buffer(term_T *term, char_u **texts, int count)
+{
+    buf_T	*buf = term->tl_buffer;
+    int		empty = (buf->b_ml.ml_flags & ML_EMPTY);
+
+#ifdef MSWIN
+    if (!enc_utf8 && enc_codepage > 0)
+    {
+	int i;
+
+	// Each line needs to be converted.
+	for (i = 0; i < count; ++i)
+	    add_scrollback_line_to_buffer(term, texts[i],
+						       (int)STRLEN(texts[i]));
+	return;
+    }
+#endif
+    if (count == 0)
+	return;
+    ml_append_buf_lines(buf, buf->b_ml.ml_line_count, texts, NULL,
+							(long)count, FALSE);
+    if (empty)
+    {
+	// Delete the empty line that was in the empty buffer.
+	curbuf = buf;
+	ml_delete(1);
+	curbuf = curwin->w_buffer;
+    }
+}
+
     static void
 cell2cellattr(const VTermScreenCell *cell, cellattr_T *attr)
 {
@@ -3272,7 +3307,9 @@ handle_pushline(int cols, const VTermScreenCell *cells, void *user)
     static void
 handle_postponed_scrollback(term_T *term)
 {
-    int i;
+    int		i;
+    int		count = 0;
+    char_u	**texts;
 
     if (term->tl_scrollback_postponed.ga_len == 0)
 	return;
@@ -3282,6 +3319,9 @@ handle_postponed_scrollback(term_T *term)
     // above it.
     cleanup_scrollback(term);
 
+    // Collect the text to append all lines to the buffer at once.
+    texts = ALLOC_MULT(char_u *, term->tl_scrollback_postponed.ga_len);
+
     for (i = 0; i < term->tl_scrollback_postponed.ga_len; ++i)
     {
 	char_u		*text;
@@ -3295,8 +3335,13 @@ handle_postponed_scrollback(term_T *term)
 	text = pp_line->sb_text;
 	if (text == NULL)
 	    text = (char_u *)"";
-	add_scrollback_line_to_buffer(term, text, (int)STRLEN(text));
-	vim_free(pp_line->sb_text);
+	if (texts != NULL)
+	    texts[count++] = text;
+	else
+	{
+	    add_scrollback_line_to_buffer(term, text, (int)STRLEN(text));
+	    vim_free(pp_line->sb_text);
+	}
 
 	line = (sb_line_T *)term->tl_scrollback.ga_data
 						 + term->tl_scrollback.ga_len;
@@ -3308,6 +3353,14 @@ handle_postponed_scrollback(term_T *term)
 	++term->tl_scrollback.ga_len;
     }
 
+    if (texts != NULL)
+    {
+	add_scrollback_lines_to_buffer(term, texts, count);
+	for (i = 0; i < count; ++i)
+	    vim_free(((sb_line_T *)term->tl_scrollback_postponed.ga_data
+								+ i)->sb_text);
+	vim_free(texts);
+    }
     ga_clear(&term->tl_scrollback_postponed);
     limit_scrollback(term, &term->tl_scrollback, TRUE);
 }
@@ -4243,6 +4296,7 @@ parse_osc(int command, VTermStringFragment frag, void *user)
 
     ((char *)gap->ga_data)[gap->ga_len] = 0;
     reader.js_buf = gap->ga_data;
+    reader.js_end = NULL;
     reader.js_fill = NULL;
     reader.js_used = 0;
     if (json_decode(&reader, &tv, 0) == OK
@@ -188,12 +188,14 @@ NEW_TESTS = \
 	test_match \
 	test_matchadd_conceal \
 	test_matchadd_conceal_utf8 \
+	test_memcompress \
 	test_memory_usage \
 	test_menu \
 	test_messages \
 	test_method \
 	test_mksession \
 	test_mksession_utf8 \
+	test_mmap \
 	test_modeless \
 	test_modeline \
 	test_move \
@@ -423,11 +425,13 @@ NEW_TESTS_RES = \
 	test_match.res \
 	test_matchadd_conceal.res \
 	test_matchadd_conceal_utf8.res \
+	test_memcompress.res \
 	test_memory_usage.res \
 	test_menu.res \
 	test_messages.res \
 	test_method.res \
 	test_mksession.res \
+	test_mmap.res \
 	test_modeless.res \
 	test_modeline.res \
 	test_nested_function.res \
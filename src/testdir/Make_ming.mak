@@ -35,7 +35,10 @@ include Make_all.mak
 
 SCRIPTS = $(SCRIPTS_ALL) $(SCRIPTS_MORE1) $(SCRIPTS_MORE4) $(SCRIPTS_WIN32)
 
-SCRIPTS_BENCH = test_bench_regexp.res
+SCRIPTS_BENCH = test_bench_regexp.res test_bench_readfile.res \
+		test_bench_memline.res test_bench_glob.res \
+		test_bench_system.res test_bench_job.res \
+		test_bench_channel.res
 
 # Must run test1 first to create small.vim.
 $(SCRIPTS) $(SCRIPTS_GUI) $(SCRIPTS_WIN32) $(NEW_TESTS_RES): $(SCRIPTS_FIRST)
@@ -111,6 +114,14 @@ nolog:
 	-@if exist messages $(DEL) messages
 
 test_bench_regexp.res: test_bench_regexp.vim
+test_bench_readfile.res: test_bench_readfile.vim
+test_bench_memline.res: test_bench_memline.vim
+test_bench_glob.res: test_bench_glob.vim
+test_bench_system.res: test_bench_system.vim
+test_bench_job.res: test_bench_job.vim
+test_bench_channel.res: test_bench_channel.vim
+
+$(SCRIPTS_BENCH):
 	-$(DEL) benchmark.out
 	@echo $(VIMPROG) > vimcmd
 	$(VIMPROG) -u NONE $(NO_INITS) -S runtest.vim $*.vim
@@ -39,6 +39,8 @@ let test_values = {
       \ 'imstyle': [[0, 1], [-1, 2, 999]],
       \ 'lines': [[2, 24], [-1, 0, 1]],
       \ 'linespace': [[0, 2, 4], ['']],
+      \ 'memcompress': [[0, 1, 1000], [-1]],
+      \ 'mmapsize': [[0, 1, 1000], [-1]],
       \ 'numberwidth': [[1, 4, 8, 10, 11, 20], [-1, 0, 21]],
       \ 'regexpengine': [[0, 1, 2], [-1, 3, 999]],
       \ 'report': [[0, 1, 2, 9999], [-1]],
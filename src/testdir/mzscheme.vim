@@ -0,0 +1,4 @@
+e! test.ok
+w! test.out
+qa!
+
@@ -0,0 +1,157 @@
+" Test for benchmarking sending and receiving large messages on a channel
+
+source check.vim
+source shared.vim
+CheckFeature job
+CheckFeature reltime
+CheckFeature timers
+CheckExecutable cat
+
+func s:Received(count, ch, msg)
+  let g:received += 1
+  if g:received == a:count
+    call feedkeys('x', 't')
+  endif
+endfunc
+
+" Let a job write "fname" and measure how long it takes until "count"
+" messages were received in "mode".  Waits in getchar(), like Vim waits for
+" typed keys.  Write the best speed in Mbyte per second to benchmark.out.
+func s:Measure(fname, mode, count, descr)
+  let best = 0.0
+  for i in range(3)
+    let g:received = 0
+    let start = reltime()
+    let job = job_start(['cat', a:fname], {'mode': a:mode,
+          \ 'callback': function('s:Received', [a:count])})
+    let g:timed_out = 0
+    let timer = timer_start(60000,
+          \ {-> execute('let g:timed_out = 1') + feedkeys('x', 't')})
+    while g:received < a:count && !g:timed_out
+      call getchar()
+    endwhile
+    call timer_stop(timer)
+    let elapsed = reltimefloat(reltime(start))
+    call assert_equal(a:count, g:received)
+    if best == 0.0 || elapsed < best
+      let best = elapsed
+    endif
+    call WaitForAssert({-> assert_equal('dead', job_status(job))})
+  endfor
+  let mbyte = getfsize(a:fname) / 1024.0 / 1024.0
+  let s = printf('channel: %-22s %6.1f Mbyte, %8.1f Mbyte/s', a:descr, mbyte,
+        \ mbyte / best)
+  call writefile([s], 'benchmark.out', 'a')
+  unlet g:received g:timed_out
+endfunc
+
+" Send "expr" with ch_sendexpr() to a job in "mode" that discards it and
+" write the best speed in Mbyte per second to benchmark.out.  The size is
+" that of the JSON encoding, so that the modes can be compared.
+func s:MeasureSend(mode, expr, descr)
+  let job = job_start(['sh', '-c', 'cat >/dev/null'], {'mode': a:mode})
+  let best = 0.0
+  for i in range(3)
+    let start = reltime()
+    call ch_sendexpr(job, a:expr)
+    let elapsed = reltimefloat(reltime(start))
+    if best == 0.0 || elapsed < best
+      let best = elapsed
+    endif
+  endfor
+  call job_stop(job)
+  call WaitForAssert({-> assert_equal('dead', job_status(job))})
+  let mbyte = len(json_encode(a:expr)) / 1024.0 / 1024.0
+  let s = printf('channel: %-22s %6.1f Mbyte, %8.1f Mbyte/s', a:descr, mbyte,
+        \ mbyte / best)
+  call writefile([s], 'benchmark.out', 'a')
+endfunc
+
+" Send "expr" to "cat" in "mode" and measure how long it takes until it was
+" received back.  Write the best speed in Mbyte per second to benchmark.out,
+" using the size of the JSON encoding.
+func s:MeasureEcho(mode, expr, descr)
+  let job = job_start('cat', {'mode': a:mode, 'noblock': 1})
+  let best = 0.0
+  for i in range(3)
+    let g:received = 0
+    let start = reltime()
+    call ch_sendexpr(job, a:expr, {'callback': function('s:Received', [1])})
+    let g:timed_out = 0
+    let timer = timer_start(60000,
+          \ {-> execute('let g:timed_out = 1') + feedkeys('x', 't')})
+    while g:received < 1 && !g:timed_out
+      call getchar()
+    endwhile
+    call timer_stop(timer)
+    let elapsed = reltimefloat(reltime(start))
+    call assert_equal(1, g:received)
+    if best == 0.0 || elapsed < best
+      let best = elapsed
+    endif
+  endfor
+  call job_stop(job)
+  call WaitForAssert({-> assert_equal('dead', job_status(job))})
+  let mbyte = len(json_encode(a:expr)) / 1024.0 / 1024.0
+  let s = printf('channel: %-22s %6.1f Mbyte, %8.1f Mbyte/s', a:descr, mbyte,
+        \ mbyte / best)
+  call writefile([s], 'benchmark.out', 'a')
+  unlet g:received g:timed_out
+endfunc
+
+" Let a job read the current buffer from stdin and measure how long it takes
+" until the job is done.  Write the best speed in Mbyte per second to
+" benchmark.out.
+func s:MeasureInBuf(descr)
+  let best = 0.0
+  for i in range(3)
+    let start = reltime()
+    let job = job_start(['sh', '-c', 'cat >/dev/null'],
+          \ {'in_io': 'buffer', 'in_buf': bufnr('')})
+    while job_status(job) == 'run'
+      sleep 1m
+    endwhile
+    let elapsed = reltimefloat(reltime(start))
+    if best == 0.0 || elapsed < best
+      let best = elapsed
+    endif
+  endfor
+  let mbyte = (line2byte(line('$') + 1) - 1) / 1024.0 / 1024.0
+  let s = printf('channel: %-22s %6.1f Mbyte, %8.1f Mbyte/s', a:descr, mbyte,
+        \ mbyte / best)
+  call writefile([s], 'benchmark.out', 'a')
+endfunc
+
+func Test_Channel_Benchmark()
+  let text = repeat('abcdefgh ', 7)
+
+  call writefile([repeat(text, 300000)], 'Xbench')
+  call s:Measure('Xbench', 'nl', 1, 'nl, one long line')
+
+  call writefile(repeat([text], 300000), 'Xbench')
+  call s:Measure('Xbench', 'nl', 300000, 'nl, short lines')
+
+  call writefile(['[0,' .. json_encode(repeat(text, 300000)) .. ']'], 'Xbench')
+  call s:Measure('Xbench', 'json', 1, 'json, one large message')
+
+  call writefile(repeat(['[0,' .. json_encode(text) .. ']'], 100000), 'Xbench')
+  call s:Measure('Xbench', 'json', 100000, 'json, small messages')
+
+  call delete('Xbench')
+
+  new
+  call setline(1, repeat([text], 300000))
+  call s:MeasureInBuf('buffer to job stdin')
+  bwipe!
+
+  call s:MeasureSend('json', repeat([text], 100000), 'send, list of lines')
+  call s:MeasureSend('json', repeat(text, 100000), 'send, one long string')
+  call s:MeasureSend('msgpack', repeat([text], 100000), 'msgpack send, lines')
+  call s:MeasureSend('msgpack', repeat(text, 100000), 'msgpack send, string')
+
+  let value = repeat([{'line': 12, 'text': text, 'valid': v:true}], 20000)
+  call s:MeasureEcho('json', value, 'json echo, dicts')
+  call s:MeasureEcho('msgpack', value, 'msgpack echo, dicts')
+endfunc
+
+" vim: shiftwidth=2 sts=2 expandtab
@@ -0,0 +1,39 @@
+" Test for benchmarking glob() with and without using a shell
+
+source check.vim
+CheckFeature reltime
+CheckUnix
+
+" Call glob() "count" times with "pat" and write the average time per call
+" to benchmark.out.
+func s:Measure(pat, count, descr)
+  let start = reltime()
+  for i in range(a:count)
+    let files = glob(a:pat, 0, 1)
+  endfor
+  let elapsed = reltimefloat(reltime(start))
+  let s = printf('glob: %-28s %3d files, %8.3f msec per call', a:descr,
+        \ len(files), elapsed * 1000 / a:count)
+  call writefile([s], 'benchmark.out', 'a')
+endfunc
+
+func Test_Glob_Benchmark()
+  for dir in ['autoload', 'plugin', 'ftplugin', 'syntax']
+    call mkdir('Xbench/' .. dir, 'p')
+    for i in range(20)
+      call writefile([], 'Xbench/' .. dir .. '/file' .. i .. '.vim')
+    endfor
+  endfor
+
+  call s:Measure('Xbench/plugin/*.vim', 500, 'wildcards')
+  call s:Measure('Xbench/**/*.vim', 500, 'recursive')
+  call s:Measure('Xbench/{plugin,syntax}/*.vim', 500, 'braces')
+  " The same expanded by the shell, like it was done for braces before.  Not
+  " every shell supports braces.
+  call s:Measure('`printf "%s\n" Xbench/plugin/*.vim Xbench/syntax/*.vim`',
+        \ 50, 'using the shell')
+
+  call delete('Xbench', 'rf')
+endfunc
+
+" vim: shiftwidth=2 sts=2 expandtab
@@ -0,0 +1,61 @@
+" Test for benchmarking starting a job and running a shell command, with
+" Vim using little and a lot of memory.
+
+source check.vim
+source shared.vim
+CheckFeature job
+CheckFeature reltime
+CheckUnix
+
+" Return the resident set size of Vim in Mbyte, -1 if unknown.
+func s:RssMbyte()
+  let status = '/proc/' .. getpid() .. '/status'
+  if filereadable(status)
+    for line in readfile(status)
+      if line =~ '^VmRSS:'
+        return str2nr(matchstr(line, '\d\+')) / 1024
+      endif
+    endfor
+  endif
+  return -1
+endfunc
+
+" Start "count" jobs and run "count" commands with system(), write the
+" average time per call to benchmark.out.
+func s:Measure(count)
+  let job_time = 0.0
+  for i in range(a:count)
+    let start = reltime()
+    let job = job_start(['true'])
+    let job_time += reltimefloat(reltime(start))
+    call WaitForAssert({-> assert_equal('dead', job_status(job))})
+  endfor
+
+  let start = reltime()
+  for i in range(a:count)
+    call system('true')
+  endfor
+  let system_time = reltimefloat(reltime(start))
+
+  let s = printf('spawn: RSS %5d Mbyte, job_start() %7.3f msec, system() %7.3f msec',
+        \ s:RssMbyte(), job_time * 1000 / a:count,
+        \ system_time * 1000 / a:count)
+  call writefile([s], 'benchmark.out', 'a')
+endfunc
+
+func Test_Spawn_Benchmark()
+  call s:Measure(200)
+
+  " Use a few hundred Mbyte and then more than a Gbyte, each item is
+  " allocated and written, thus resident.
+  let big = []
+  for n in [2, 8]
+    while len(big) < n
+      call add(big, repeat([repeat('x', 100)], 1000000))
+    endwhile
+    call s:Measure(200)
+  endfor
+  unlet big
+endfunc
+
+" vim: shiftwidth=2 sts=2 expandtab
@@ -0,0 +1,70 @@
+" Test for benchmarking getting lines from distant parts of a buffer
+
+source check.vim
+CheckFeature reltime
+
+" A compiled function, so that the time is not mostly spent executing the
+" script.
+def s:GetLines(lnums: list<number>): number
+  let n = 0
+  for lnum in lnums
+    n += len(getline(lnum))
+  endfor
+  return n
+enddef
+
+" Get "count" lines, going around "regions" places in the buffer and picking
+" a random line near each place.  Write the best speed in lines per second to
+" benchmark.out.
+func s:Measure(regions, count, descr)
+  let nlines = line('$')
+  let starts = map(range(a:regions), 'v:val * nlines / a:regions + 1')
+  let seed = 1
+  let lnums = []
+  for i in range(a:count)
+    let seed = (seed * 1103515245 + 12345) % 2147483648
+    call add(lnums, starts[i % a:regions] + seed % 40)
+  endfor
+
+  let best = 0.0
+  for i in range(5)
+    let start = reltime()
+    call s:GetLines(lnums)
+    let elapsed = reltimefloat(reltime(start))
+    if best == 0.0 || elapsed < best
+      let best = elapsed
+    endif
+  endfor
+  let s = printf('memline: %-26s %10.0f lines/s', a:descr, a:count / best)
+  call writefile([s], 'benchmark.out', 'a')
+endfunc
+
+func Test_Memline_Benchmark()
+  new
+  call setline(1, map(range(1, 1000000), '"line " .. v:val'))
+  call s:Measure(1, 500000, 'one region')
+  call s:Measure(2, 500000, 'alternate two regions')
+  call s:Measure(4, 500000, 'alternate four regions')
+  call s:Measure(16, 500000, 'sixteen regions')
+
+  " Two windows on the same buffer far apart, redrawing both.
+  normal! gg
+  split
+  normal! G
+  let best = 0.0
+  for i in range(3)
+    let start = reltime()
+    for n in range(200)
+      redraw!
+    endfor
+    let elapsed = reltimefloat(reltime(start))
+    if best == 0.0 || elapsed < best
+      let best = elapsed
+    endif
+  endfor
+  let s = printf('memline: %-26s %10.0f redraws/s', 'two windows', 200 / best)
+  call writefile([s], 'benchmark.out', 'a')
+  bwipe!
+endfunc
+
+" vim: shiftwidth=2 sts=2 expandtab
@@ -0,0 +1,55 @@
+" Test for benchmarking reading a file into a buffer
+
+source check.vim
+CheckFeature reltime
+
+" Create a file of about "mbyte" Mbyte by repeating "line".
+func s:MakeFile(fname, line, mbyte, flags)
+  let lnum = a:mbyte * 1024 * 1024 / (strlen(a:line) + 1)
+  call writefile(repeat([a:line], lnum), a:fname, a:flags)
+endfunc
+
+" Edit "fname" a few times and write the best speed in Mbyte per second to
+" benchmark.out.
+func s:Measure(fname, descr)
+  let best = 0.0
+  for i in range(3)
+    let start = reltime()
+    exe 'edit! ' .. a:fname
+    let elapsed = reltimefloat(reltime(start))
+    if best == 0.0 || elapsed < best
+      let best = elapsed
+    endif
+  endfor
+  let mbyte = getfsize(a:fname) / 1024.0 / 1024.0
+  let s = printf('readfile: %-22s %6.1f Mbyte, %8.1f Mbyte/s', a:descr, mbyte,
+	\ mbyte / best)
+  call writefile([s], 'benchmark.out', 'a')
+  bwipe!
+endfunc
+
+func Test_Readfile_Benchmark()
+  let save_enc = &encoding
+  set encoding=utf-8 fileencodings=ucs-bom,utf-8,latin1 noswapfile
+
+  call s:MakeFile('Xbench', repeat('abcdefgh ', 7), 20, '')
+  call s:Measure('Xbench', 'ascii, short lines')
+
+  call s:MakeFile('Xbench', repeat('abcdefgh ', 800), 20, '')
+  call s:Measure('Xbench', 'ascii, long lines')
+
+  call s:MakeFile('Xbench', repeat("abcé世界 ", 8), 20, '')
+  call s:Measure('Xbench', 'utf-8, short lines')
+
+  call s:MakeFile('Xbench', repeat('abcdefgh ', 7) .. "\r", 20, '')
+  call s:Measure('Xbench', 'ascii, dos line breaks')
+
+  call s:MakeFile('Xbench', repeat("abcdefg\xe9 ", 7), 20, '')
+  call s:Measure('Xbench', 'latin1, short lines')
+
+  call delete('Xbench')
+  set fileencodings& swapfile&
+  let &encoding = save_enc
+endfunc
+
+" vim: shiftwidth=2 sts=2 expandtab
@@ -21,4 +21,79 @@ func Test_Regex_Benchmark()
   call Measure('samples/re.freeze.txt', '\s\+\%#\@<!$', '+5')
 endfunc
 
+" Search for patterns that require a literal text in a large buffer where
+" only the last line matches.  Most lines are skipped without trying to
+" match.  Write the best time for each engine to benchmark.out.
+func s:MeasureSearch(pattern)
+  for re in range(3)
+    exe 'set re=' .. re
+    let best = 0.0
+    for i in range(3)
+      call cursor(1, 1)
+      let start = reltime()
+      call search(a:pattern, 'W')
+      let elapsed = reltimefloat(reltime(start))
+      if best == 0.0 || elapsed < best
+        let best = elapsed
+      endif
+    endfor
+    call assert_equal(line('$'), line('.'))
+    let s = printf('regexp: %-30s re: %d %8.4f sec', a:pattern, re, best)
+    call writefile([s], 'benchmark.out', 'a')
+  endfor
+  set re&
+endfunc
+
+func Test_Regex_Benchmark_must_text()
+  new
+  call setline(1, repeat(['    call SomeOtherHandler(foo, bar) " the quick brown fox'], 200000))
+  call append('$', '    call FooBarHandler(foo, bar)')
+  call s:MeasureSearch('\<FooBarHandler\>')
+  call s:MeasureSearch('\cfoobarhandler(')
+  call s:MeasureSearch('\s\+\w*FooBar\w*(')
+  call s:MeasureSearch('FooBar\w*(\w\+, \w\+)')
+  bwipe!
+endfunc
+
+" Patterns without literal text, the NFA engine uses the lazy DFA for these.
+func Test_Regex_Benchmark_dfa()
+  new
+  call setline(1, repeat(['    let x = s:Compute(a1, b22, "c-3") + 12 # 4.5 .. y'], 100000))
+  call append('$', '    let Xyz9 = 123-4567')
+  call s:MeasureSearch('\d\{3}-\d\{4}')
+  call s:MeasureSearch('\<\u\l\+\d\>')
+  call s:MeasureSearch('\a\+\d\s*=\s*[0-9-]\+$')
+  bwipe!
+endfunc
+
+" Patterns with many alternatives where every line matches, the NFA engine
+" has to run for each line.  Write the time for each engine to benchmark.out.
+func Test_Regex_Benchmark_alternation()
+  let words = map(range(200), {i -> printf('%s%03dx', nr2char(97 + i % 26), i)})
+  let alt = join(words, '\|')
+  new
+  call setline(1, repeat(['  let t123x = r017x + foo(r199x, bar) " s122x'], 2000))
+  for [name, pattern, expected] in [
+        \ ['words', '\<\%(' .. alt .. '\)\>', 8000],
+        \ ['submatch', '\<\(' .. alt .. '\)\>', 8000],
+        \ ['lookbehind', '\(\s\)\@<=\%(' .. alt .. '\)', 6000],
+        \ ['backref', '\(' .. alt .. '\) .*\1', 0]]
+    for re in range(3)
+      exe 'set re=' .. re
+      let start = reltime()
+      let msg = execute('%s/' .. pattern .. '//gne')
+      let elapsed = reltimefloat(reltime(start))
+      if expected > 0
+        call assert_match(expected .. ' matches on 2000 lines', msg)
+      else
+        call assert_equal('', trim(msg))
+      endif
+      let s = printf('alternation: %-10s re: %d %8.4f sec', name, re, elapsed)
+      call writefile([s], 'benchmark.out', 'a')
+    endfor
+  endfor
+  set re&
+  bwipe!
+endfunc
+
 " vim: shiftwidth=2 sts=2 expandtab
@@ -0,0 +1,35 @@
+" Test for benchmarking system() and systemlist() with short commands
+
+source check.vim
+CheckFeature reltime
+
+" Execute "Cmd" 1000 times and write the average time per call to
+" benchmark.out.
+func s:Measure(Cmd, descr)
+  let start = reltime()
+  for i in range(1000)
+    call a:Cmd()
+  endfor
+  " Seconds for 1000 calls is msec per call.
+  let elapsed = reltimefloat(reltime(start))
+  let s = printf('system: %-28s %8.3f msec per call', a:descr, elapsed)
+  call writefile([s], 'benchmark.out', 'a')
+endfunc
+
+func Test_System_Benchmark()
+  new
+  call setline(1, range(20))
+  if has('win32')
+    call s:Measure({-> system('rem')}, 'no output')
+    call s:Measure({-> system('echo hello')}, 'one line of output')
+    call s:Measure({-> systemlist('more', ['one', 'two'])}, 'list input')
+  else
+    call s:Measure({-> system('true')}, 'no output')
+    call s:Measure({-> system('echo hello')}, 'one line of output')
+    call s:Measure({-> systemlist('cat', ['one', 'two'])}, 'list input')
+    call s:Measure({-> system('cat', bufnr())}, 'buffer input')
+  endif
+  bwipe!
+endfunc
+
+" vim: shiftwidth=2 sts=2 expandtab
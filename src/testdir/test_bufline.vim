@@ -202,3 +202,35 @@ func Test_appendbufline_redraw()
   call StopVimInTerminal(buf)
   call delete('XscriptMatchCommon')
 endfunc
+
+" Going back and forth between distant lines uses cached data blocks, which
+" must be forgotten when lines are inserted or deleted.
+func Test_getline_distant_regions()
+  new
+  let lines = map(range(1, 30000), '"line " .. v:val')
+  call setline(1, lines)
+  let seed = 3
+  for round in range(300)
+    for region in range(6)
+      let seed = (seed * 1103515245 + 12345) % 2147483648
+      let lnum = region * len(lines) / 6 + seed % 100 + 1
+      call assert_equal(lines[lnum - 1], getline(lnum))
+    endfor
+    let what = seed / 100 % 4
+    if what == 0
+      call setline(lnum, 'changed ' .. round)
+      let lines[lnum - 1] = 'changed ' .. round
+    elseif what == 1
+      call append(lnum, ['added ' .. round, 'another ' .. round])
+      call extend(lines, ['added ' .. round, 'another ' .. round], lnum)
+    elseif what == 2
+      exe lnum .. 'delete'
+      call remove(lines, lnum - 1)
+    else
+      call deletebufline('', lnum, lnum + 300)
+      call remove(lines, lnum - 1, lnum + 299)
+    endif
+  endfor
+  call assert_equal(lines, getline(1, '$'))
+  bwipe!
+endfunc
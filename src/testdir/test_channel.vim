@@ -808,6 +808,25 @@ func Test_close_output_buffer()
   endtry
 endfunc
 
+func Test_pipe_many_lines_to_buffer()
+  " Lines that are available together are appended to the buffer at once.
+  let options = {'out_io': 'buffer', 'out_name': 'Xmanylines', 'out_msg': 0}
+  let job = job_start([s:python, '-c',
+	\ 'for i in range(1, 20001): print("line %d" % i + "x" * (i % 70))'],
+	\ options)
+  let bnr = bufnr('Xmanylines')
+  try
+    call WaitForAssert({-> assert_equal(20000, getbufinfo(bnr)[0].linecount)})
+    call WaitForAssert({-> assert_equal('dead', job_status(job))})
+    call assert_equal(map(range(1, 20000),
+	  \ {i, v -> 'line ' .. v .. repeat('x', v % 70)}),
+	  \ getbufline(bnr, 1, '$'))
+  finally
+    call job_stop(job)
+  endtry
+  exe 'bwipe! ' .. bnr
+endfunc
+
 func Run_test_pipe_err_to_buffer(use_name, nomod, do_msg)
   let options = {'err_io': 'buffer'}
   let expected = ['', 'line one', 'line two', 'this', 'AND this']
@@ -1892,6 +1911,218 @@ func Test_cwd()
   endtry
 endfunc
 
+" The environment of a job is set up like for fork(), also when it is
+" started with posix_spawn().
+func Test_job_env_and_script()
+  CheckUnix
+  let g:envstr = ''
+  let cmd = [&shell, &shellcmdflag, 'echo $FOO $TERM $COLUMNS']
+  let job = job_start(cmd, {'callback': {ch, msg -> execute(":let g:envstr .= msg")},
+        \ 'env': {'FOO': 'bar', 'COLUMNS': '33'}})
+  call WaitForAssert({-> assert_equal('bar dumb 33', g:envstr)})
+  call WaitForAssert({-> assert_equal('dead', job_status(job))})
+
+  " A script without "#!" is executed by the shell, like with execvp().
+  call writefile(['echo from script'], 'Xscript')
+  call setfperm('Xscript', 'rwx------')
+  let g:envstr = ''
+  let job = job_start(['./Xscript'], {'callback': {ch, msg -> execute(":let g:envstr .= msg")}})
+  call WaitForAssert({-> assert_equal('from script', g:envstr)})
+  call WaitForAssert({-> assert_equal('dead', job_status(job))})
+  call assert_equal(0, job_info(job).exitval)
+
+  call delete('Xscript')
+  unlet g:envstr
+endfunc
+
+" More channels than the old fixed limit can be open at the same time.
+func Test_many_jobs()
+  CheckUnix
+  let g:out = []
+  let jobs = []
+  for i in range(30)
+    call add(jobs, job_start('cat', {'callback': {ch, msg -> add(g:out, msg)}}))
+  endfor
+  for i in range(30)
+    call ch_sendraw(jobs[i], 'line ' .. i .. "\n")
+  endfor
+  call WaitForAssert({-> assert_equal(30, len(g:out))})
+  call assert_equal(sort(map(range(30), '"line " .. v:val')), sort(g:out))
+
+  for job in jobs
+    call job_stop(job)
+  endfor
+  for job in jobs
+    call WaitForAssert({-> assert_equal('dead', job_status(job))})
+  endfor
+  unlet g:out
+endfunc
+
+" A JSON message that arrives in pieces is decoded once it is complete.
+func Test_json_message_in_pieces()
+  CheckUnix
+  let g:out = []
+  let job = job_start('cat', {'mode': 'json',
+        \ 'callback': {ch, msg -> add(g:out, msg)}})
+  let text = repeat('x] "}\', 5000)
+  let msg = '[0,' .. json_encode(text) .. ']'
+  let half = len(msg) / 2
+  call ch_sendraw(job, msg[: half - 1])
+  sleep 20m
+  call ch_sendraw(job, msg[half :] .. "\n[0,{\"a\": [\"]\"]}]\n")
+  call WaitForAssert({-> assert_equal(2, len(g:out))})
+  call assert_equal(text, g:out[0])
+  call assert_equal({'a': [']']}, g:out[1])
+
+  call job_stop(job)
+  call WaitForAssert({-> assert_equal('dead', job_status(job))})
+  unlet g:out
+endfunc
+
+" Decoding a large JSON message is done in parts, so that Vim remains
+" responsive.
+func Test_json_message_decoded_in_parts()
+  CheckUnix
+  call ch_logfile('Xchlog', 'w')
+  let g:out = []
+  let job = job_start('cat', {'mode': 'json', 'noblock': 1,
+        \ 'callback': {ch, msg -> add(g:out, msg)}})
+  let value = map(range(100000), {i, v -> [v, {'k': 'v' .. v}]})
+  call ch_sendraw(job, json_encode([0, value]) .. "\n")
+  " Garbage collection in between must not free the partly decoded lists.
+  for i in range(1000)
+    sleep 10m
+    call test_garbagecollect_now()
+    if !empty(g:out)
+      break
+    endif
+  endfor
+  call assert_equal([value], g:out)
+  call ch_logfile('')
+  call assert_match('Decoding interrupted', join(readfile('Xchlog'), "\n"))
+
+  call job_stop(job)
+  call WaitForAssert({-> assert_equal('dead', job_status(job))})
+  call delete('Xchlog')
+  unlet g:out
+endfunc
+
+" A large message that can't be written at once is queued and written later.
+func Test_json_large_message_noblock()
+  CheckUnix
+  let g:out = []
+  let job = job_start('cat', {'mode': 'json', 'noblock': 1})
+  let text = repeat('abcdefgh ', 100000)
+  call ch_sendexpr(job, text, {'callback': {ch, msg -> add(g:out, msg)}})
+  call ch_sendexpr(job, [1, 2], {'callback': {ch, msg -> add(g:out, msg)}})
+  call WaitForAssert({-> assert_equal(2, len(g:out))})
+  call assert_equal(text, g:out[0])
+  call assert_equal([1, 2], g:out[1])
+
+  call job_stop(job)
+  call WaitForAssert({-> assert_equal('dead', job_status(job))})
+  unlet g:out
+endfunc
+
+" A large buffer is written to a job that reads it slowly, the lines that
+" can't be written at once are queued.
+func Test_pipe_large_buffer_to_file()
+  CheckUnix
+  new
+  let lines = map(range(200000), '"line " .. v:val')
+  call setline(1, lines)
+  let job = job_start(['sh', '-c', 'sleep 0.2; cat > Xpipeout'],
+        \ {'in_io': 'buffer', 'in_buf': bufnr('')})
+  call WaitForAssert({-> assert_equal('dead', job_status(job))})
+  call assert_equal(lines, readfile('Xpipeout'))
+  call delete('Xpipeout')
+  bwipe!
+endfunc
+
+" The drain callback is invoked when the write queue went over the high water
+" mark and was written.
+func Test_write_queue_drain_cb()
+  CheckUnix
+  let g:drained = 0
+  let job = job_start(['sh', '-c', 'sleep 0.2; cat > /dev/null'],
+        \ {'noblock': 1, 'highwater': 1000,
+        \  'drain_cb': {ch -> execute('let g:drained += 1')}})
+  let ch = job_getchannel(job)
+  call assert_equal(0, ch_info(ch).in_queued)
+  call ch_sendraw(job, repeat('x', 1000000))
+  call assert_inrange(1001, 1000000, ch_info(ch).in_queued)
+  call WaitForAssert({-> assert_equal(1, g:drained)})
+  call assert_equal(0, ch_info(ch).in_queued)
+
+  " Below the high water mark the callback is not invoked.
+  call ch_setoptions(ch, {'highwater': 2000000})
+  call ch_sendraw(job, repeat('x', 1000000))
+  call WaitForAssert({-> assert_equal(0, ch_info(ch).in_queued)})
+  call assert_equal(1, g:drained)
+
+  call job_stop(job)
+  call WaitForAssert({-> assert_equal('dead', job_status(job))})
+  call assert_fails("call job_start('cat', {'highwater': -1})", 'E475:')
+  unlet g:drained
+endfunc
+
+" Values sent in msgpack mode come back unchanged when echoed.
+func Test_msgpack_mode()
+  CheckUnix
+  let g:out = []
+  let job = job_start('cat', {'mode': 'msgpack', 'noblock': 1})
+  call assert_equal('MSGPACK', ch_info(job_getchannel(job)).in_mode)
+  let values = [0, 1, 127, 128, 255, 256, 65535, 65536, -1, -32, -33, -128,
+        \ -129, -32768, -32769, 'x', '', repeat('a', 31), repeat('b', 32),
+        \ repeat('c', 256), repeat('d', 70000), 0z, 0z0001FF,
+        \ [], range(15), range(16), range(70000), {}, {'a': 1, 'b': [{}]},
+        \ v:true, v:false, v:null, [1, [2, [3, {'x': "\n\x80"}]]]]
+  if has('num64')
+    let values += [4294967295, 4294967296, 9223372036854775807,
+          \ -2147483648, -2147483649, -9223372036854775807]
+  endif
+  if has('float')
+    let values += [0.5, -1.25e100, 1.0e-300]
+  endif
+  for value in values
+    call ch_sendexpr(job, value, {'callback': {ch, msg -> add(g:out, msg)}})
+  endfor
+  call WaitForAssert({-> assert_equal(len(values), len(g:out))})
+  call assert_equal(values, g:out)
+
+  " A funcref can't be sent.
+  call assert_fails('call ch_sendexpr(job, function("tr"))', 'E474:')
+
+  " Raw bytes of the command ["ex", "let g:mp_ex = 5"]
+  let cmd = 'let g:mp_ex = 5'
+  let msg = 0z00000014.92A26578AF
+  for c in str2list(cmd)
+    call add(msg, c)
+  endfor
+  call ch_sendraw(job, msg)
+  call WaitForAssert({-> assert_equal(5, get(g:, 'mp_ex'))})
+  unlet g:mp_ex
+
+  " A list or dict that contains itself can't be sent.
+  let l = [1]
+  call add(l, l)
+  call assert_fails('call ch_sendexpr(job, l)', 'E1902:')
+  let d = {}
+  let d.d = d
+  call assert_fails('call ch_sendexpr(job, [d])', 'E1902:')
+
+  " A length that is much too big drops the input.
+  call ch_sendraw(job, 0zFFFFFFFF92A2)
+  sleep 100m
+  let g:out = []
+  call ch_sendexpr(job, 'ok', {'callback': {ch, msg -> add(g:out, msg)}})
+  call WaitForAssert({-> assert_equal(['ok'], g:out)})
+
+  call job_stop(job)
+  call WaitForAssert({-> assert_equal('dead', job_status(job))})
+  unlet g:out
+endfunc
+
 function Ch_test_close_lambda(port)
   let handle = ch_open(s:localhost . a:port, s:chopt)
   if ch_status(handle) == "fail"
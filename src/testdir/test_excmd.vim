@@ -399,6 +399,30 @@ func Test_read_cmd()
   call delete('Xfile')
 endfunc
 
+" Test for :read with many lines, which are appended in batches, in the
+" middle of a buffer and with all file formats.
+func Test_read_many_lines()
+  let lines = map(range(1, 5000), {i, v -> 'line ' .. v .. repeat('x', v % 90)})
+  for ff in ['unix', 'dos', 'mac']
+    if ff == 'mac'
+      call writefile([join(lines, "\r") .. "\r"], 'Xfile', 'b')
+    else
+      call writefile(ff == 'dos' ? map(copy(lines), {i, v -> v .. "\r"})
+	    \ : lines, 'Xfile')
+    endif
+    new
+    call setline(1, ['first', 'last'])
+    let &undolevels = &undolevels
+    exe 'read ++ff=' .. ff .. ' Xfile'
+    call assert_equal(['first'] + lines + ['last'], getline(1, '$'))
+    call assert_equal(8 + len(join(lines, "\n")), line2byte(5002))
+    undo
+    call assert_equal(['first', 'last'], getline(1, '$'))
+    close!
+  endfor
+  call delete('Xfile')
+endfunc
+
 " Test for running Ex commands when text is locked.
 " <C-\>e in the command line is used to lock the text
 func Test_run_excmd_with_text_locked()
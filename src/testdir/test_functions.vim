@@ -1079,6 +1079,38 @@ func Test_byte2line_line2byte()
   bw!
 endfunc
 
+" Check line2byte() and byte2line() while lines are inserted, changed and
+" deleted all over a big buffer, the offsets are kept in a tree of chunks.
+func Test_line2byte_many_changes()
+  new
+  call setline(1, map(range(1, 3000), 'repeat("x", v:val % 37)'))
+  let seed = srand(1234)
+  for i in range(600)
+    let lnum = rand(seed) % line('$') + 1
+    let what = rand(seed) % 3
+    if what == 0
+      call append(lnum, repeat(['new ' .. i], rand(seed) % 900))
+    elseif what == 1
+      call setline(lnum, repeat('y', rand(seed) % 50))
+    else
+      exe lnum .. ',' .. min([line('$'), lnum + rand(seed) % 900]) .. 'delete'
+    endif
+
+    if i % 100 == 0
+      let offset = 1
+      for l in range(1, line('$'))
+        call assert_equal(offset, line2byte(l))
+        let offset += len(getline(l)) + 1
+      endfor
+      call assert_equal(offset, line2byte(line('$') + 1))
+    endif
+    let l = rand(seed) % line('$') + 1
+    call assert_equal(l, byte2line(line2byte(l)))
+    call assert_equal(l, byte2line(line2byte(l + 1) - 1))
+  endfor
+  bwipe!
+endfunc
+
 " Test for byteidx() and byteidxcomp() functions
 func Test_byteidx()
   let a = '.é.' " one char of two bytes
@@ -2524,6 +2556,43 @@ func Test_glob()
   call assert_equal('', globpath(test_null_string(), test_null_string()))
 endfunc
 
+" Test for "{a,b}" in glob(), expanded without using a shell.
+func Test_glob_braces()
+  CheckUnix
+  call mkdir('Xglob/a/x', 'p')
+  call mkdir('Xglob/b', 'p')
+  call mkdir('Xglob/c', 'p')
+  for name in ['a/1.txt', 'a/2.c', 'b/3.txt', 'c/4.txt', 'a/x/5.txt']
+    call writefile([], 'Xglob/' .. name)
+  endfor
+
+  " Execute these commands in the sandbox, so that using the shell fails.
+  sandbox call assert_equal(['Xglob/a/1.txt', 'Xglob/b/3.txt'],
+        \ glob('Xglob/{a,b}/*.txt', 0, 1))
+  " the order of the alternatives is kept
+  sandbox call assert_equal(['Xglob/b/3.txt', 'Xglob/a/1.txt', 'Xglob/a/2.c'],
+        \ glob('Xglob/{b,a}/*.{txt,c}', 0, 1))
+  " nested groups and a slash inside a group
+  sandbox call assert_equal(['Xglob/a/1.txt', 'Xglob/b/3.txt', 'Xglob/c/4.txt'],
+        \ glob('Xglob/{a,{b,c}}/*.txt', 0, 1))
+  sandbox call assert_equal(['Xglob/a/x/5.txt', 'Xglob/a/1.txt'],
+        \ glob('Xglob/a/{x/5,1}.txt', 0, 1))
+  " names that don't exist are dropped
+  sandbox call assert_equal(['Xglob/c'], glob('Xglob/{nope,c}', 0, 1))
+  sandbox call assert_equal(['Xglob/a/x/5.txt', 'Xglob/c/4.txt'],
+        \ glob('Xglob/**/{5,4}.txt', 0, 1))
+  " an escaped brace is not a group
+  sandbox call assert_equal([], glob('Xglob/\{a,b}', 0, 1))
+  " "${name}" is an environment variable
+  let $XGLOBDIR = 'Xglob'
+  sandbox call assert_equal(['Xglob/c/4.txt'], glob('${XGLOBDIR}/c/*', 0, 1))
+  unlet $XGLOBDIR
+  sandbox call assert_equal("Xglob/a/1.txt\nXglob/c/4.txt",
+        \ expand('Xglob/{a,c}/*.txt'))
+
+  call delete('Xglob', 'rf')
+endfunc
+
 " Test for browse()
 func Test_browse()
   CheckFeature browse
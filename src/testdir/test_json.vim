@@ -125,6 +125,12 @@ func Test_json_decode()
   call assert_equal(s:varsp2, json_decode(s:jsonsp2))
 
   call assert_equal(s:varnr, json_decode(s:jsonnr))
+  if has('num64')
+    call assert_equal(-123456789012345678, json_decode('-123456789012345678'))
+    call assert_equal(1234567890123456789, json_decode('1234567890123456789'))
+    call assert_equal(9223372036854775807, json_decode('99999999999999999999'))
+  endif
+  call assert_equal(['ab"c\d', 'x'], json_decode('["ab\"c\\d", "x"]'))
   if has('float')
     call assert_equal(s:varfl, json_decode(s:jsonfl))
   endif
@@ -0,0 +1,119 @@
+" Tests for compressing the memory blocks of hidden buffers ('memcompress')
+
+source check.vim
+
+func SetUp()
+  set memcompress=100000 hidden
+endfunc
+
+func TearDown()
+  set memcompress& hidden&
+endfunc
+
+" Check that the lines of buffer "buf" are equal to "lines".
+func s:CheckLines(buf, lines)
+  call assert_equal(len(a:lines), getbufinfo(a:buf)[0].linecount)
+  call assert_equal(a:lines, getbufline(a:buf, 1, '$'))
+endfunc
+
+func Test_memcompress_hidden_buffer()
+  edit Xmemcomp
+  let lines = map(range(1, 20000), '"line " .. v:val .. " of a hidden buffer"')
+  call setline(1, lines)
+  let buf = bufnr()
+  enew
+
+  " A buffer in a window is not compressed.
+  call test_memcompress_now()
+  call assert_true(memfileinfo(buf).compblocks > 0)
+  call assert_true(memfileinfo(buf).compmem < memfileinfo(buf).memused)
+  call assert_equal(0, memfileinfo('%').compblocks)
+
+  " Reading lines decompresses blocks.
+  let before = memfileinfo().decompressed
+  call s:CheckLines(buf, lines)
+  call assert_true(memfileinfo().decompressed > before)
+
+  " Make random changes, compressing in between, and compare with a shadow
+  " list.
+  let seed = 7
+  for round in range(20)
+    call test_memcompress_now()
+    for i in range(10)
+      let seed = (seed * 1103515245 + 12345) % 2147483648
+      let lnum = seed % len(lines) + 1
+      let what = seed / 7 % 3
+      if what == 0
+        let text = 'changed ' .. round .. ' ' .. i
+        call setbufline(buf, lnum, text)
+        let lines[lnum - 1] = text
+      elseif what == 1
+        let new = map(range(seed % 50), '"added " .. round .. " " .. v:val')
+        call appendbufline(buf, lnum, new)
+        call extend(lines, new, lnum)
+      else
+        let last = min([lnum + seed % 30, len(lines)])
+        call deletebufline(buf, lnum, last)
+        call remove(lines, lnum - 1, last - 1)
+      endif
+    endfor
+    call test_memcompress_now()
+    call s:CheckLines(buf, lines)
+  endfor
+
+  " Writing the buffer writes the decompressed text.
+  call test_memcompress_now()
+  exe 'buffer ' .. buf
+  write
+  call assert_equal(lines, readfile('Xmemcomp'))
+
+  " Preserving writes all blocks to the swap file, recovery must work.
+  enew
+  call test_memcompress_now()
+  call setbufline(buf, 1, 'unsaved change')
+  let lines[0] = 'unsaved change'
+  call test_memcompress_now()
+  exe 'buffer ' .. buf
+  preserve
+  let swname = swapname('')
+  let sw = readfile(swname, 'B')
+  set nohidden
+  bwipe!
+  call writefile(sw, swname)
+  set hidden
+  exe 'recover! Xmemcomp'
+  call assert_equal(lines, getline(1, '$'))
+  bwipe!
+
+  call delete(swname)
+  call delete('Xmemcomp')
+endfunc
+
+func Test_memcompress_off()
+  set memcompress=0
+  edit Xmemcomp
+  call setline(1, range(1, 10000))
+  let buf = bufnr()
+  enew
+  call test_memcompress_now()
+  call assert_equal(0, memfileinfo(buf).compblocks)
+  exe 'bwipe! ' .. buf
+endfunc
+
+func Test_memcompress_limit()
+  " The limit is in Kbyte, compressing stops when going over it.
+  set memcompress=1
+  edit Xmemcomp
+  call setline(1, range(1, 100000))
+  let buf = bufnr()
+  enew
+  call test_memcompress_now()
+  let info = memfileinfo()
+  call assert_inrange(1, 5, info.compmem)
+  call assert_true(info.compblocks < memfileinfo(buf).blocks)
+  call assert_equal(map(range(1, 100000), 'string(v:val)'),
+        \ getbufline(buf, 1, '$'))
+  exe 'bwipe! ' .. buf
+endfunc
+
+" vim: shiftwidth=2 sts=2 expandtab
@@ -0,0 +1,182 @@
+" Tests for mapping a file in memory with 'mmapsize'.
+
+source check.vim
+CheckFeature mmap
+
+func s:MakeLines(count)
+  return map(range(1, a:count), {i, v -> 'line ' .. v .. repeat('x', v % 50)})
+endfunc
+
+func Test_mmap_read()
+  let lines = s:MakeLines(5000)
+  call writefile(lines, 'Xmmap')
+  set mmapsize=1
+  edit Xmmap
+  " No swap file while the file is mapped.
+  call assert_equal('', swapname('%'))
+  call assert_equal(5000, line('$'))
+  call assert_equal(lines, getline(1, '$'))
+  call assert_equal(lines[4321], getline(4322))
+  call assert_equal(lines[63:65], getline(64, 66))
+  call assert_equal('unix', &fileformat)
+  call assert_true(&eol)
+  call assert_false(&modified)
+
+  " Searching and :global do not need a copy of the text.
+  call cursor(1, 1)
+  call assert_equal(4001, search('^line 4001x'))
+  let found = []
+  g/^line 10\d\d/call add(found, line('.'))
+  call assert_equal(range(1000, 1099), found)
+  call assert_equal('', swapname('%'))
+
+  bwipe!
+  set mmapsize&
+  call delete('Xmmap')
+endfunc
+
+func Test_mmap_line2byte()
+  let lines = s:MakeLines(1000)
+  call writefile(lines, 'Xmmap')
+  edit Xmmap
+  let expected = map(range(1, 1001), {i, v -> line2byte(v)})
+  let expected_lines = map(range(1, 20000, 97), {i, v -> byte2line(v)})
+  bwipe!
+
+  set mmapsize=1
+  edit Xmmap
+  call assert_equal('', swapname('%'))
+  call assert_equal(expected, map(range(1, 1001), {i, v -> line2byte(v)}))
+  call assert_equal(expected_lines,
+	\ map(range(1, 20000, 97), {i, v -> byte2line(v)}))
+  call assert_equal(-1, byte2line(getfsize('Xmmap') + 1))
+  " "go" uses the byte offset
+  exe 'goto ' .. line2byte(777)
+  call assert_equal(777, line('.'))
+
+  bwipe!
+  set mmapsize&
+  call delete('Xmmap')
+endfunc
+
+func Test_mmap_noeol()
+  let lines = s:MakeLines(2000)
+  call writefile(lines, 'Xmmap', 'b')
+  edit Xmmap
+  let expected = line2byte(line('$') + 1)
+  set nofixeol
+  let expected_nofixeol = line2byte(line('$') + 1)
+  set fixeol&
+  bwipe!
+
+  set mmapsize=1
+  edit Xmmap
+  call assert_equal('', swapname('%'))
+  call assert_false(&eol)
+  call assert_equal(lines, getline(1, '$'))
+  call assert_equal(expected, line2byte(line('$') + 1))
+  set nofixeol
+  call assert_equal(expected_nofixeol, line2byte(line('$') + 1))
+  call assert_equal(getfsize('Xmmap') + 1, line2byte(line('$') + 1))
+  set fixeol&
+  bwipe!
+  set mmapsize&
+  call delete('Xmmap')
+endfunc
+
+func Test_mmap_change()
+  let lines = s:MakeLines(3000)
+  call writefile(lines, 'Xmmap')
+  set mmapsize=1
+  edit Xmmap
+  call assert_equal('', swapname('%'))
+
+  " Marked lines stay marked when the first change copies the text.
+  g/^line \d*0x/d
+  call assert_notequal('', swapname('%'))
+  call assert_equal(filter(copy(lines), {i, v -> v !~ '^line \d*0x'}),
+	\ getline(1, '$'))
+  undo
+  call assert_equal(lines, getline(1, '$'))
+
+  call setline(1, 'changed')
+  write
+  call assert_equal(['changed'] + lines[1:], readfile('Xmmap'))
+
+  bwipe!
+  set mmapsize&
+  call delete('Xmmap')
+endfunc
+
+func Test_mmap_copy_fails()
+  let lines = s:MakeLines(3000)
+  call writefile(lines, 'Xmmap')
+  set mmapsize=1
+  edit Xmmap
+
+  " When copying the lines fails halfway the buffer stays mapped.
+  call test_alloc_fail(GetAllocId('mf_block'), 10, 0)
+  call assert_fails('call setline(1, "changed")', 'E342:')
+  call assert_equal(lines, getline(1, '$'))
+  call assert_false(&modified)
+
+  call setline(1, 'changed')
+  call assert_equal(['changed'] + lines[1:], getline(1, '$'))
+
+  bwipe!
+  set mmapsize&
+  call delete('Xmmap')
+endfunc
+
+func Test_mmap_write()
+  let lines = s:MakeLines(3000)
+  call writefile(lines, 'Xmmap')
+  set mmapsize=1
+  edit Xmmap
+  " Writing the unchanged buffer over the file must not lose text.
+  set backupcopy=yes
+  write!
+  call assert_equal(lines, readfile('Xmmap'))
+  call assert_equal(lines, getline(1, '$'))
+  bwipe!
+  set mmapsize& backupcopy&
+  call delete('Xmmap')
+endfunc
+
+func Test_mmap_not_used()
+  let lines = s:MakeLines(3000)
+  set mmapsize=1
+
+  " Too small.
+  call writefile(lines[:10], 'Xmmap')
+  edit Xmmap
+  call assert_notequal('', swapname('%'))
+  bwipe!
+
+  " Not with CR-LF line breaks.
+  call writefile(map(copy(lines), {i, v -> v .. "\r"}), 'Xmmap')
+  edit Xmmap
+  call assert_notequal('', swapname('%'))
+  call assert_equal('dos', &fileformat)
+  call assert_equal(lines, getline(1, '$'))
+  bwipe!
+
+  " Not when conversion is needed.
+  call writefile(lines, 'Xmmap')
+  edit ++enc=latin1 Xmmap
+  call assert_notequal('', swapname('%'))
+  bwipe!
+
+  set mmapsize&
+  call delete('Xmmap')
+endfunc
+
+func Test_mmap_option()
+  call assert_fails('set mmapsize=-1', 'E487:')
+  set mmapsize=100
+  call assert_equal(100, &mmapsize)
+  set mmapsize&
+  call assert_equal(0, &mmapsize)
+endfunc
+
+" vim: shiftwidth=2 sts=2 expandtab
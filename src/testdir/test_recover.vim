@@ -66,3 +66,37 @@ func Test_swap_file()
   set undolevels&
   enew! | only
 endfunc
+
+" Changes lines all over a buffer after it was preserved, so that many dirty
+" blocks are written at once, some of them next to each other in the swap
+" file.  Then recovers from the swap file and checks the text.
+func Test_swap_file_scattered_changes()
+  set fileformat=unix undolevels=-1 swapsync=fsync
+  edit! Xtest
+  call setline(1, map(range(1, 5000), 'v:val .. repeat("x", 60)'))
+  preserve
+  for lnum in range(1, 5000, 7)
+    call setline(lnum, lnum .. repeat('y', 60 + lnum % 40))
+  endfor
+  call append(2500, repeat(['inserted'], 100))
+  4000,4200delete
+  preserve
+  let expected = getline(1, '$')
+
+  " make a copy of the swap file in Xswap
+  let swname = swapname('%')
+  set binary
+  exe 'sp ' . swname
+  w! Xswap
+  set nobinary
+  new
+  only!
+  bwipe! Xtest
+  call rename('Xswap', swname)
+  recover Xtest
+  call delete(swname)
+  call assert_equal(expected, getline(1, '$'))
+
+  set undolevels& swapsync&
+  enew! | only
+endfunc
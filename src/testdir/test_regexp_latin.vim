@@ -95,7 +95,8 @@ endfunc
 
 func Test_out_of_memory()
   new
-  s/^/,n
+  " The ";" is needed, otherwise it is quickly found there is no match.
+  s/^/,n;
   " This will be slow...
   call assert_fails('call search("\\v((n||<)+);")', 'E363:')
 endfunc
@@ -930,4 +931,46 @@ func Test_regexp_last_subst_string()
   close!
 endfunc
 
+" Compiled patterns are cached
+func Test_regexp_cache()
+  let info = regcacheinfo()
+  for i in range(10)
+    call assert_equal(3, match('foobar', 'b[aeiou]r'))
+  endfor
+  let newinfo = regcacheinfo()
+  call assert_true(newinfo.hits >= info.hits + 9)
+  call assert_true(newinfo.entries >= 1)
+  call assert_true(newinfo.entries <= newinfo.size)
+
+  " a different 'regexpengine' or 'magic' is a different entry
+  let info = regcacheinfo()
+  set regexpengine=1
+  call assert_equal(3, match('foobar', 'b[aeiou]r'))
+  set regexpengine&
+  call assert_equal(info.misses + 1, regcacheinfo().misses)
+  new
+  call setline(1, ['b[aeiou]r', 'bar'])
+  call assert_equal(2, search('b[aeiou]r', 'n'))
+  set nomagic
+  call assert_equal(1, search('b[aeiou]r', 'n'))
+  set magic
+  call assert_equal(info.misses + 3, regcacheinfo().misses)
+
+  " "~" is not cached, it depends on the last substitute string
+  call setline(1, 'one two')
+  s/one/two/
+  call assert_equal(0, match('two', '~'))
+  s/two/one/
+  call assert_equal(-1, match('two', '~'))
+  bwipe!
+
+  " with many different patterns older ones are removed
+  let info = regcacheinfo()
+  for i in range(info.size + 1)
+    call match('x', 'a' .. i)
+  endfor
+  call assert_true(regcacheinfo().evictions > info.evictions)
+  call assert_equal(info.size, regcacheinfo().entries)
+endfunc
+
 " vim: shiftwidth=2 sts=2 expandtab
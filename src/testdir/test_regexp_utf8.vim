@@ -374,4 +374,112 @@ func Test_regexp_ignore_case()
   set regexpengine&
 endfunc
 
+" Lines that don't contain the text that a pattern requires are skipped
+" without trying to match.  Check this doesn't skip lines that do match.
+func Run_regexp_must_text()
+  call assert_equal(3, match('xx FooBarHandler', '\<FooBarHandler\>'))
+  call assert_equal(-1, match('xx FooBarHandlers', '\<FooBarHandler\>'))
+  call assert_equal(3, match('xx FOOBARHANDLER', '\c\<FooBarHandler\>'))
+  call assert_equal(4, match('foo bar', 'foo.*\zsbar'))
+  call assert_equal(3, match('fooxbar', '\%[abc]foo\zsx\(bar\)'))
+  call assert_equal(3, match('foobar', '\(foo\)\@<=bar'))
+  call assert_equal(0, match('ÄfooÖbar', '\cäFOOöBAR'))
+
+  new
+  call setline(1, ['one', 'foo', 'bar', 'two'])
+  call cursor(1, 1)
+  call assert_equal([2, 1], searchpos('foo\nbar'))
+  call assert_equal([2, 3], searchpos('o\_sba'))
+  call assert_equal([2, 2], searchpos('oo\_[a-z]*ba'))
+  call assert_equal([0, 0], searchpos('foobar'))
+  set ignorecase
+  call assert_equal([3, 1], searchpos('BAR'))
+  set ignorecase&
+  bwipe!
+endfunc
+
+func Test_regexp_must_text()
+  set regexpengine=1
+  call Run_regexp_must_text()
+  set regexpengine=2
+  call Run_regexp_must_text()
+  " "k" and "s" also match the Kelvin sign and the long s
+  call assert_equal(0, match("ab\u212acd", '\cabkcd'))
+  call assert_equal(0, match("ab\u017fcd", '\cabscd'))
+  set regexpengine&
+endfunc
+
+" Check that the backtracking and the NFA engine find the same match for
+" each of "pats" in each of "texts".
+func s:CompareEngines(pats, texts)
+  for pat in a:pats
+    for text in a:texts
+      for col in [0, 1, 3]
+	call assert_equal(matchstrpos(text, '\%#=1' .. pat, col),
+	      \ matchstrpos(text, '\%#=2' .. pat, col), pat .. ' / ' .. text)
+      endfor
+    endfor
+  endfor
+endfunc
+
+" The NFA engine first checks with a DFA whether a line matches.  Check that
+" it finds the same matches as the backtracking engine.
+func Test_regexp_dfa()
+  let pats = ['foo', '\<foo\>', '\<\k\+\>', 'x\>', '^ab', 'c$', '^$', 'b*',
+	\ '[a-c]\+d', '[^a-c ]\+', '\d\{2,}', '\a\+\s\+\d', '\cFOO', 'é\+',
+	\ '[[:upper:]][[:lower:]]*', '[éa]b', 'a\zsb\zec', '\(foo\|bar\)baz',
+	\ '\%(ab\|cd\)\+$', '\h\w*(', '\x\x\X', '[[:keyword:]]\+!',
+	\ '\u\l', '\_^ab', 'Ä.', '\<\a', '\A\>', '.\{-}b', 'ab\|\<cd']
+  let texts = ['foo', ' foo bar', 'foobar', 'foo!', 'xab c', 'abc', '',
+	\ 'aabbd', 'xyz é é', 'ab 12 x', 'FoO', 'Éé', 'Hello World', 'ab éb',
+	\ 'abc abc', 'foobaz barbaz', 'abcdab', 'f(x)', 'x1g', 'étè!', 'äÄx',
+	\ 'a-b-c-d', 'x  cd', 'abcd', '日本語 ab', '12ab']
+  call s:CompareEngines(pats, texts)
+
+  " changing 'ignorecase' and 'iskeyword' must be noticed
+  new
+  call setline(1, ['', 'foo-bar', 'FOO'])
+  set regexpengine=2
+  call assert_equal(3, search('^\k\+$', 'n'))
+  setlocal iskeyword+=-
+  call assert_equal(2, search('^\k\+$', 'n'))
+  setlocal iskeyword&
+  call assert_equal(3, search('^\k\+$', 'n'))
+  call assert_equal(0, search('^foo$', 'n'))
+  set ignorecase
+  call assert_equal(3, search('^foo$', 'n'))
+  set ignorecase& regexpengine&
+  bwipe!
+endfunc
+
+" The NFA engine skips positions where none of the alternatives can start.
+func Test_regexp_alternatives()
+  let pats = ['\%(foo\|bar\|baz\)', '\<\(ab\|cd\|éf\)\>', '\(x\|y\)\1',
+	\ '\%(\s\)\@<=\%(ab\|cd\)', '\cFOO\|Bar', '\%(ab\|\)c', 'a\|b\|\d']
+  let texts = ['foo bar baz', 'xx cd ab', '- éf -', 'abcd yy', 'fOo BAR',
+	\ 'ddc abc', '日本 éf bar', 'x9']
+  call s:CompareEngines(pats, texts)
+
+  " Kelvin sign and long s match "k" and "s" when ignoring case
+  call assert_equal(['K', 3, 6],
+	\ matchstrpos("ab K", '\%#=2\c\%(k\|x\)'))
+  call assert_equal(["\u017f", 3, 5],
+	\ matchstrpos("ab \u017f", '\%#=2\c\%(s\|x\)'))
+  " and the other way around
+  set ignorecase
+  call assert_equal(1, match('xk', "\\%#=2\u212a\\|zzz"))
+  call assert_equal(1, match('xs', "\\%#=2\u017f\\|qqq"))
+  call assert_equal(1, match('xK', "\\%#=2\u212a\\|zzz"))
+  call assert_equal(1, match('xS', "\\%#=2\u017f\\|qqq"))
+  set ignorecase&
+
+  new
+  call setline(1, ['  one', 'two three', 'x'])
+  set regexpengine=2
+  call assert_equal(2, search('\<\%(four\|three\|five\)\>', 'n'))
+  call assert_equal(3, search('\%(y\|x\)$', 'n'))
+  set regexpengine&
+  bwipe!
+endfunc
+
 " vim: shiftwidth=2 sts=2 expandtab
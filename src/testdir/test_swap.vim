@@ -377,4 +377,48 @@ func Test_swap_prompt_splitwin()
   call delete('Xfile1')
 endfunc
 
+func Test_memfileinfo()
+  " a buffer that is not loaded has no memfile
+  let buf = bufadd('Xnotloaded')
+  call assert_equal({}, memfileinfo(buf))
+  exe 'bwipe ' .. buf
+  let total = memfileinfo()
+  call assert_equal(['blocks', 'compblocks', 'compmem', 'compressed',
+        \ 'decompressed', 'evictions', 'hits', 'memused', 'misses'],
+        \ sort(keys(total)))
+
+  " With a small 'maxmem' blocks must be released to the swap file and read
+  " back when going over the lines.
+  set maxmem=64
+  new Xmemfile
+  call setline(1, range(1, 20000))
+  for i in range(2)
+    for lnum in range(1, line('$'), 10)
+      call getline(lnum)
+    endfor
+  endfor
+  let info = memfileinfo('%')
+  call assert_equal(['blocks', 'compblocks', 'compmem', 'evictions', 'hits',
+        \ 'memmax', 'memused', 'misses', 'swapfile'], sort(keys(info)))
+  call assert_equal(1, info.swapfile)
+  call assert_equal(64, info.memmax)
+  call assert_inrange(1, 64, info.memused)
+  call assert_true(info.hits > 0)
+  call assert_true(info.misses > 0)
+  call assert_true(info.evictions > 0)
+  call assert_true(info.blocks > 0)
+  call assert_equal(info, bufnr()->memfileinfo())
+
+  let newtotal = memfileinfo()
+  call assert_true(newtotal.hits >= total.hits + info.hits)
+  call assert_true(newtotal.misses >= total.misses + info.misses)
+  call assert_true(newtotal.evictions >= total.evictions + info.evictions)
+
+  " the file still has the right contents after reading blocks back
+  call assert_equal(range(1, 20000), map(getline(1, '$'), 'str2nr(v:val)'))
+
+  bwipe!
+  set maxmem&
+endfunc
+
 " vim: shiftwidth=2 sts=2 expandtab
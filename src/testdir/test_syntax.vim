@@ -822,4 +822,23 @@ func Test_search_syntax_skip()
   bwipe!
 endfunc
 
+" A contained match that ends in "$" continues the region in the next line.
+" This must also work when the pattern was compiled before.
+func Test_syntax_match_had_eol()
+  new
+  syntax on
+  call setline(1, ['# foo \', 'bar'])
+  for i in range(2)
+    syn clear
+    syn region R start=/#/ end=/$/ contains=C
+    " a new pattern is compiled just before the cached one is used
+    exe 'syn match E /yyy' .. i .. '/'
+    syn match C /\\$/ contained
+    syn sync fromstart
+    call assert_equal('R', synIDattr(synID(2, 1, 1), 'name'), 'round ' .. i)
+  endfor
+  syntax off
+  bwipe!
+endfunc
+
 " vim: shiftwidth=2 sts=2 expandtab
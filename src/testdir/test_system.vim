@@ -144,6 +144,41 @@ func Test_system_with_shell_quote()
   endtry
 endfunc
 
+" Test passing input and output of system() through pipes, including
+" falling back to temp files for an unusual 'shellredir'.
+func Test_system_pipe_io()
+  CheckUnix
+
+  call assert_equal('', system('cat', ''))
+  call assert_equal("a\nb", system('cat', "a\nb"))
+  call assert_equal(['x', "y\nz", ''], systemlist('cat', ['x', "y\nz", '', '']))
+  call assert_equal("a\x01b", system('printf "a\\000b"'))
+  call assert_equal("", system('exit 3'))
+  call assert_equal(3, v:shell_error)
+
+  " Large input and output must not deadlock.
+  let text = repeat('x', 300000)
+  call assert_equal(text, system('cat', text))
+  call assert_equal(400000, strlen(system('yes | head -c 400000')))
+  " The command does not read its input.
+  call assert_equal("done\n", system('echo done', text))
+  call assert_equal(0, v:shell_error)
+
+  let save_srr = &shellredir
+  set shellredir=>%s\ 2>&1
+  call assert_equal("err\nout\n", system('echo err >&2; echo out'))
+  set shellredir=>
+  call assert_equal("out\n", system('echo err >&2; echo out'))
+  set shellredir=>%s\ 2>/dev/null
+  call assert_equal("a\nb", system('cat', "a\nb"))
+  let &shellredir = save_srr
+
+  " A command in the background keeps stdout open, don't wait for it.
+  let start = reltime()
+  call assert_equal("a\n", system('echo a; sleep 5 &'))
+  call assert_inrange(0.0, 3.0, reltimefloat(reltime(start)))
+endfunc
+
 " Test for 'shellxquote'
 func Test_Shellxquote()
   CheckUnix
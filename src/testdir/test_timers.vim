@@ -449,4 +449,46 @@ func Test_timer_changing_function_list()
   call delete('XTest_timerchange')
 endfunc
 
+" Timers are invoked in the order they are due, not the order they were
+" created in.
+func Test_timer_due_order()
+  let g:order = []
+  call timer_start(60, {-> add(g:order, 3)})
+  call timer_start(20, {-> add(g:order, 1)})
+  call timer_start(40, {-> add(g:order, 2)})
+  call WaitForAssert({-> assert_equal([1, 2, 3], g:order)})
+  unlet g:order
+endfunc
+
+" Create and stop a lot of timers, this must not take a long time.
+func Test_timer_many()
+  let start = reltime()
+  let timers = []
+  for i in range(100000)
+    call add(timers, timer_start(100000 + i % 1000, 'MyHandler'))
+  endfor
+  call assert_equal(100000, len(timer_info()))
+  call assert_equal(timers[5000], timer_info(timers[5000])[0].id)
+
+  " Some fire quickly while the others are waiting.
+  let g:val = 0
+  for i in range(10)
+    call timer_start(i, {-> execute('let g:val += 1')})
+  endfor
+  call WaitForAssert({-> assert_equal(10, g:val)})
+
+  " stop every other one, then the rest in reverse order
+  for i in range(0, 99999, 2)
+    call timer_stop(timers[i])
+  endfor
+  call assert_equal([], timer_info(timers[0]))
+  call assert_equal(50000, len(timer_info()))
+  for i in range(99999, 1, -2)
+    call timer_stop(timers[i])
+  endfor
+  call assert_equal([], timer_info())
+  call assert_inrange(0, 30.0, reltimefloat(reltime(start)))
+  unlet g:val
+endfunc
+
 " vim: shiftwidth=2 sts=2 expandtab
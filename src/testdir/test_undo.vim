@@ -713,4 +713,46 @@ func Test_undofile_cryptmethod_blowfish2()
   set undofile& undolevels& cryptmethod&
 endfunc
 
+" Deleting many lines removes whole data blocks at once, check the text, the
+" byte offsets and undo/redo.
+func Test_undo_delete_many_lines()
+  new
+  let lines = map(range(1, 20000), {i, v -> v .. repeat('x', v % 120)})
+  call setline(1, lines)
+  let &undolevels = &undolevels
+  let expected = copy(lines)
+  " the last one deletes the last 500 lines
+  for [first, last] in [[100, 15000], [1, 3], [2, 1000], [900, 950], [0, 0]]
+    if first == 0
+      let [first, last] = [line('$') - 499, line('$')]
+    endif
+    exe first .. ',' .. last .. 'delete'
+    call remove(expected, first - 1, last - 1)
+    call assert_equal(expected, getline(1, '$'))
+    call assert_equal(len(join(expected, "\n")) + 2, line2byte(line('$') + 1))
+    let &undolevels = &undolevels
+  endfor
+  call deletebufline('', 10, 20)
+  call remove(expected, 9, 19)
+  call assert_equal(expected, getline(1, '$'))
+
+  " undo everything, then redo everything
+  while undotree().seq_cur > 1
+    undo
+  endwhile
+  call assert_equal(lines, getline(1, '$'))
+  call assert_equal(len(join(lines, "\n")) + 2, line2byte(line('$') + 1))
+  while undotree().seq_cur < undotree().seq_last
+    redo
+  endwhile
+  call assert_equal(expected, getline(1, '$'))
+
+  " deleting all lines leaves one empty line
+  %delete
+  call assert_equal([''], getline(1, '$'))
+  undo
+  call assert_equal(expected, getline(1, '$'))
+  bwipe!
+endfunc
+
 " vim: shiftwidth=2 sts=2 expandtab
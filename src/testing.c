@@ -1023,6 +1023,15 @@ f_test_ignore_error(typval_T *argvars, typval_T *rettv UNUSED)
      ignore_error_for_testing(tv_get_string(&argvars[0]));
 }
 
+/*
+ * "test_memcompress_now()" function
+ */
+    void
+f_test_memcompress_now(typval_T *argvars UNUSED, typval_T *rettv UNUSED)
+{
+    mf_compress_hidden(TRUE);
+}
+
     void
 f_test_null_blob(typval_T *argvars UNUSED, typval_T *rettv)
 {
@@ -339,6 +339,20 @@ f_strptime(typval_T *argvars, typval_T *rettv)
 static timer_T	*first_timer = NULL;
 static long	last_timer_id = 0;
 
+// Timers that are waiting to be invoked, ordered as a binary heap on the due
+// time, the first one is due first.  Paused timers and a timer that is being
+// invoked are not in the heap.
+static garray_T	timer_heap = {0, 0, sizeof(timer_T *), 100, NULL};
+#define TIMER_HEAP(idx) (((timer_T **)timer_heap.ga_data)[idx])
+
+// Timers by ID, for find_timer().
+static hashtab_T timer_ht;
+static int	timer_ht_initialized = FALSE;
+#define HI2TIMER(hi) ((timer_T *)((hi)->hi_key - offsetof(timer_T, tr_key)))
+
+// Incremented for every check_due_timer() call.
+static long	timer_check_nr = 0;
+
 /*
  * Return time left until "due".  Negative if past "due".
  */
@@ -362,9 +376,108 @@ proftime_time_left(proftime_T *due, proftime_T *now)
 }
 
 /*
- * Insert a timer in the list of timers.
+ * Return TRUE if "t1" is to be invoked before "t2".
+ * Timers with the same due time are invoked in the order they were created.
+ */
+    static int
+timer_before(timer_T *t1, timer_T *t2)
+{
+#  ifdef MSWIN
+    if (t1->tr_due.QuadPart != t2->tr_due.QuadPart)
+	return t1->tr_due.QuadPart < t2->tr_due.QuadPart;
+#  else
+    if (t1->tr_due.tv_sec != t2->tr_due.tv_sec)
+	return t1->tr_due.tv_sec < t2->tr_due.tv_sec;
+    if (t1->tr_due.tv_usec != t2->tr_due.tv_usec)
+	return t1->tr_due.tv_usec < t2->tr_due.tv_usec;
+#  endif
+    return t1->tr_id < t2->tr_id;
+}
+
+/*
+ * Put "timer" at index "idx" of the timer heap.
  */
     static void
+timer_heap_set(int idx, timer_T *timer)
+{
+    TIMER_HEAP(idx) = timer;
+    timer->tr_heap_idx = idx;
+}
+
+/*
+ * Move the timer at index "idx" of the timer heap up or down until it is in
+ * the right position.
+ */
+    static void
+timer_heap_fix(int idx)
+{
+    timer_T *timer = TIMER_HEAP(idx);
+    int	    child;
+
+    // move up while it is due before its parent
+    while (idx > 0 && timer_before(timer, TIMER_HEAP((idx - 1) / 2)))
+    {
+	timer_heap_set(idx, TIMER_HEAP((idx - 1) / 2));
+	idx = (idx - 1) / 2;
+    }
+
+    // move down while a child is due before it
+    for (;;)
+    {
+	child = idx * 2 + 1;
+	if (child >= timer_heap.ga_len)
+	    break;
+	if (child + 1 < timer_heap.ga_len
+		&& timer_before(TIMER_HEAP(child + 1), TIMER_HEAP(child)))
+	    ++child;
+	if (!timer_before(TIMER_HEAP(child), timer))
+	    break;
+	timer_heap_set(idx, TIMER_HEAP(child));
+	idx = child;
+    }
+    timer_heap_set(idx, timer);
+}
+
+/*
+ * Add "timer" to the timer heap, when it isn't there yet.
+ * Returns FAIL when out of memory, the timer would never be invoked.
+ */
+    static int
+timer_heap_add(timer_T *timer)
+{
+    if (timer->tr_heap_idx >= 0)
+	return OK;
+    if (ga_grow(&timer_heap, 1) == FAIL)
+	return FAIL;
+    timer_heap_set(timer_heap.ga_len++, timer);
+    timer_heap_fix(timer->tr_heap_idx);
+    return OK;
+}
+
+/*
+ * Remove "timer" from the timer heap, when it is there.
+ */
+    static void
+timer_heap_remove(timer_T *timer)
+{
+    int	idx = timer->tr_heap_idx;
+
+    if (idx < 0)
+	return;
+    timer->tr_heap_idx = -1;
+    if (idx < --timer_heap.ga_len)
+    {
+	// move the last one into the gap
+	timer_heap_set(idx, TIMER_HEAP(timer_heap.ga_len));
+	timer_heap_fix(idx);
+    }
+}
+
+/*
+ * Insert a timer in the list of timers.
+ * Returns FAIL when out of memory, the caller must use remove_timer().
+ */
+    static int
 insert_timer(timer_T *timer)
 {
     timer->tr_next = first_timer;
@@ -372,7 +485,40 @@ insert_timer(timer_T *timer)
     if (first_timer != NULL)
 	first_timer->tr_prev = timer;
     first_timer = timer;
+
+    if (!timer_ht_initialized)
+    {
+	hash_init(&timer_ht);
+	timer_ht_initialized = TRUE;
+    }
+    timer->tr_heap_idx = -1;
+    vim_snprintf((char *)timer->tr_key, NUMBUFLEN, "%ld", timer->tr_id);
+    if (hash_add(&timer_ht, timer->tr_key) == FAIL)
+    {
+	timer->tr_key[0] = NUL;
+	return FAIL;
+    }
+
+    if (timer_heap_add(timer) == FAIL)
+	return FAIL;
     did_add_timer = TRUE;
+    return OK;
+}
+
+/*
+ * Remove "timer" from "timer_ht", if it is there.
+ */
+    static void
+timer_ht_remove(timer_T *timer)
+{
+    hashitem_T	*hi;
+
+    if (timer->tr_key[0] == NUL)
+	return;
+    hi = hash_find(&timer_ht, timer->tr_key);
+    if (!HASHITEM_EMPTY(hi) && HI2TIMER(hi) == timer)
+	hash_remove(&timer_ht, hi);
+    timer->tr_key[0] = NUL;
 }
 
 /*
@@ -387,6 +533,9 @@ remove_timer(timer_T *timer)
 	timer->tr_prev->tr_next = timer->tr_next;
     if (timer->tr_next != NULL)
 	timer->tr_next->tr_prev = timer->tr_prev;
+
+    timer_ht_remove(timer);
+    timer_heap_remove(timer);
 }
 
     static void
@@ -412,12 +561,19 @@ create_timer(long msec, int repeat)
 	// Overflow!  Might cause duplicates...
 	last_timer_id = 0;
     timer->tr_id = last_timer_id;
-    insert_timer(timer);
     if (repeat != 0)
 	timer->tr_repeat = repeat - 1;
     timer->tr_interval = msec;
 
     profile_setlimit(msec, &timer->tr_due);
+    // Not to be invoked by a check_due_timer() call that is busy now.
+    timer->tr_check_nr = timer_check_nr;
+    if (insert_timer(timer) == FAIL)
+    {
+	remove_timer(timer);
+	free_timer(timer);
+	return NULL;
+    }
     return timer;
 }
 
@@ -447,27 +603,25 @@ timer_callback(timer_T *timer)
 check_due_timer(void)
 {
     timer_T	*timer;
-    timer_T	*timer_next;
     long	this_due;
     long	next_due = -1;
     proftime_T	now;
     int		did_one = FALSE;
     int		need_update_screen = FALSE;
     long	current_id = last_timer_id;
+    long	check_nr = ++timer_check_nr;
 
     // Don't run any timers while exiting or dealing with an error.
     if (exiting || aborting())
 	return next_due;
 
     profile_start(&now);
-    for (timer = first_timer; timer != NULL && !got_int; timer = timer_next)
+    while (timer_heap.ga_len > 0 && !got_int)
     {
-	timer_next = timer->tr_next;
-
-	if (timer->tr_id == -1 || timer->tr_firing || timer->tr_paused)
-	    continue;
+	// The first timer in the heap is the one due first.
+	timer = TIMER_HEAP(0);
 	this_due = proftime_time_left(&timer->tr_due, &now);
-	if (this_due <= 1)
+	if (this_due <= 1 && timer->tr_check_nr != check_nr)
 	{
 	    // Save and restore a lot of flags, because the timer fires while
 	    // waiting for a character, which might be halfway a command.
@@ -497,11 +651,14 @@ check_due_timer(void)
 	    may_garbage_collect = FALSE;
 	    save_vimvars(&vvsave);
 
+	    // Not in the heap while invoked, so that it's not invoked
+	    // recursively.
+	    timer_heap_remove(timer);
+	    timer->tr_check_nr = check_nr;
 	    timer->tr_firing = TRUE;
 	    timer_callback(timer);
 	    timer->tr_firing = FALSE;
 
-	    timer_next = timer->tr_next;
 	    did_one = TRUE;
 	    timer_busy = save_timer_busy;
 	    vgetc_busy = save_vgetc_busy;
@@ -526,21 +683,27 @@ check_due_timer(void)
 		    && timer->tr_emsg_count < 3)
 	    {
 		profile_setlimit(timer->tr_interval, &timer->tr_due);
-		this_due = proftime_time_left(&timer->tr_due, &now);
-		if (this_due < 1)
-		    this_due = 1;
 		if (timer->tr_repeat > 0)
 		    --timer->tr_repeat;
+		if (!timer->tr_paused && timer_heap_add(timer) == FAIL)
+		{
+		    // Out of memory, it can't be invoked again.
+		    remove_timer(timer);
+		    free_timer(timer);
+		}
 	    }
 	    else
 	    {
-		this_due = -1;
 		remove_timer(timer);
 		free_timer(timer);
 	    }
 	}
-	if (this_due > 0 && (next_due == -1 || next_due > this_due))
-	    next_due = this_due;
+	else
+	{
+	    // Not due yet, or created or already invoked in this call.
+	    next_due = this_due < 1 ? 1 : this_due;
+	    break;
+	}
     }
 
     if (did_one)
@@ -583,13 +746,15 @@ check_due_timer(void)
     static timer_T *
 find_timer(long id)
 {
-    timer_T *timer;
+    char_u	key[NUMBUFLEN];
+    hashitem_T	*hi;
 
-    if (id >= 0)
+    if (id >= 0 && timer_ht_initialized)
     {
-	FOR_ALL_TIMERS(timer)
-	    if (timer->tr_id == id)
-		return timer;
+	vim_snprintf((char *)key, NUMBUFLEN, "%ld", id);
+	hi = hash_find(&timer_ht, key);
+	if (!HASHITEM_EMPTY(hi))
+	    return HI2TIMER(hi);
     }
     return NULL;
 }
@@ -602,8 +767,11 @@ find_timer(long id)
 stop_timer(timer_T *timer)
 {
     if (timer->tr_firing)
+    {
 	// Free the timer after the callback returns.
+	timer_ht_remove(timer);
 	timer->tr_id = -1;
+    }
     else
     {
 	remove_timer(timer);
@@ -707,6 +875,12 @@ timer_free_all()
 	remove_timer(timer);
 	free_timer(timer);
     }
+    ga_clear(&timer_heap);
+    if (timer_ht_initialized)
+    {
+	hash_clear(&timer_ht);
+	timer_ht_initialized = FALSE;
+    }
 }
 # endif
 
@@ -750,7 +924,16 @@ f_timer_pause(typval_T *argvars, typval_T *rettv UNUSED)
     {
 	timer = find_timer((int)tv_get_number(&argvars[0]));
 	if (timer != NULL)
+	{
 	    timer->tr_paused = paused;
+	    // A paused timer is not in the heap, a timer being invoked is added
+	    // back when its callback returns.
+	    if (paused)
+		timer_heap_remove(timer);
+	    else if (!timer->tr_firing && timer_heap_add(timer) == FAIL)
+		// Out of memory, it stays paused.
+		timer->tr_paused = TRUE;
+	}
     }
 }
 
@@ -361,6 +361,11 @@ inchar_loop(
 	    // we should call it again soon.
 	    if (channel_any_readahead())
 		wait_time = 10L;
+
+	    // If decoding a message was interrupted only check for typed
+	    // keys and then continue.
+	    if (channel_any_decoding())
+		wait_time = 0L;
 	}
 #endif
 #ifdef FEAT_BEVAL_GUI
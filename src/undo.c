@@ -2775,18 +2775,17 @@ u_undoredo(int undo)
 		}
 		break;
 	    }
-	    // delete backwards, it goes faster in most cases
-	    for (lnum = bot - 1, i = oldsize; --i >= 0; --lnum)
+	    for (lnum = top + 1, i = 0; i < oldsize; ++lnum, ++i)
 	    {
 		// what can we do when we run out of memory?
 		if (u_save_line(&newarray[i], lnum) == FAIL)
 		    do_outofmem_msg((long_u)0);
-		// remember we deleted the last line in the buffer, and a
-		// dummy empty line will be inserted
-		if (curbuf->b_ml.ml_line_count == 1)
-		    empty_buffer = TRUE;
-		ml_delete_flags(lnum, ML_DEL_UNDO);
 	    }
+	    // remember we deleted the last line in the buffer, and a
+	    // dummy empty line will be inserted
+	    if (oldsize >= curbuf->b_ml.ml_line_count)
+		empty_buffer = TRUE;
+	    ml_delete_range(top + 1, oldsize, ML_DEL_UNDO);
 	}
 	else
 	    newarray = NULL;
@@ -374,6 +374,11 @@ static char *(features[]) =
 	"+mksession",
 #else
 	"-mksession",
+#endif
+#ifdef FEAT_MMAP
+	"+mmap",
+#else
+	"-mmap",
 #endif
 	"+modify_fname",
 	"+mouse",
@@ -1060,6 +1060,13 @@ extern int (*dyn_libintl_wputenv)(const wchar_t *envstring);
 #define MFS_STOP	2	// stop syncing when a character is available
 #define MFS_FLUSH	4	// flushed file to disk
 #define MFS_ZERO	8	// only write block 0
+#define MFS_ASYNC	16	// with MFS_FLUSH: may flush in the background
+
+// A thread is used to flush swap files to disk without waiting for it.
+#if defined(UNIX) && defined(HAVE_FSYNC) && defined(HAVE_PTHREAD_CREATE)
+# define MF_FSYNC_THREAD
+# include <pthread.h>
+#endif
 
 // flags for buf_copy_options()
 #define BCO_ENTER	1	// going to enter the buffer
@@ -1818,6 +1825,13 @@ typedef int sock_T;
 
 // Note that gui.h is included by structs.h
 
+// On Linux the fds of channels are kept in an epoll set, instead of adding
+// them to the select() or poll() arguments on every wait.
+#if defined(FEAT_JOB_CHANNEL) && defined(UNIX) && defined(HAVE_SYS_EPOLL_H) \
+	&& defined(HAVE_EPOLL_CREATE1)
+# define CHANNEL_EPOLL
+#endif
+
 #include "structs.h"	// defines many structures
 
 #include "alloc.h"
@@ -2503,12 +2517,6 @@ typedef enum {
 // Character used as separated in autoload function/variable names.
 #define AUTOLOAD_CHAR '#'
 
-#ifdef FEAT_JOB_CHANNEL
-# define MAX_OPEN_CHANNELS 10
-#else
-# define MAX_OPEN_CHANNELS 0
-#endif
-
 #if defined(MSWIN)
 # define MAX_NAMED_PIPE_SIZE 65535
 #endif